@@ -19,11 +19,13 @@
 
 #define ENABLE_CORE_DEBUGSYSTEM   1 //=== Enable/Disable Debug System for debug builds
 #define ENABLE_CORE_DEBUGLOGGING  0 //=== Enable/Disable Debug System output C:\\Users\\Public\\Documents\\DebugLog.txt
+#define ENABLE_CORE_TRACEPOINTS   1 //=== Compile in tracepoints, selected per system at run time (tracepoint.h)
 
 #else                   //=== RELEASE BUILD SETTINGS ===================================================
 
 #define ENABLE_CORE_DEBUGSYSTEM   0 //=== Enable/Disable Debug System for debug builds
 #define ENABLE_CORE_DEBUGLOGGING  0 //=== Enable/Disable Debug System output C:\\Users\\Public\\Documents\\DebugLog.txt
+#define ENABLE_CORE_TRACEPOINTS   1 //=== Compile in tracepoints, selected per system at run time (tracepoint.h)
 
 #endif
 
@@ -40,3 +42,9 @@
 #else
 #undef  CORE_DEBUGLOGGING
 #endif
+
+#if ENABLE_CORE_TRACEPOINTS==1
+#define CORE_TRACEPOINTS
+#else
+#undef  CORE_TRACEPOINTS
+#endif
@@ -33,12 +33,12 @@ namespace Core
     class cTMarker
     {
     public:
-        cTMarker() : X( 0 ), Y( 0 ), Z( 0 ), ID( cUID::kInvalid ), ActiveID( 0 ), Size( 0 ), Label( cLabel::kInvalid ), Residual( 0 ), Selected( false ),
+        cTMarker() : ID( cUID::kInvalid ), ActiveID( 0 ), X( 0 ), Y( 0 ), Z( 0 ), Size( 0 ), Residual( 0 ), Label( cLabel::kInvalid ), Selected( false ),
             Synthetic( false ), Flags( 0 ) { }
-        cTMarker( T x, T y, T z ) : X( x ), Y( y ), Z( z ), ID( cUID::kInvalid ), ActiveID( 0 ), Size( 0 ), Label( cLabel::kInvalid ), Residual( 0 ), Selected( false ),
+        cTMarker( T x, T y, T z ) : ID( cUID::kInvalid ), ActiveID( 0 ), X( x ), Y( y ), Z( z ), Size( 0 ), Residual( 0 ), Label( cLabel::kInvalid ), Selected( false ),
             Synthetic( false ), Flags( 0 ) { }
-        cTMarker( const cVector3<T>& pos ) : X( pos.X() ), Y( pos.Y() ), Z( pos.Z() ), ID( cUID::kInvalid ), ActiveID( 0 ), Size( 0 ),
-            Label( cLabel::kInvalid ), Residual( 0 ), Selected( false ), Synthetic( false ), Flags( 0 ) { }
+        cTMarker( const cVector3<T>& pos ) : ID( cUID::kInvalid ), ActiveID( 0 ), X( pos.X() ), Y( pos.Y() ), Z( pos.Z() ), Size( 0 ),
+            Residual( 0 ), Label( cLabel::kInvalid ), Selected( false ), Synthetic( false ), Flags( 0 ) { }
 
         bool operator==( const cTMarker& other ) const { return ( Label == other.Label ); }
         bool operator!=( const cTMarker& other ) const { return ( Label != other.Label ); }
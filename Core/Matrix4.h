@@ -51,7 +51,7 @@ namespace Core
         void CopyValues( const cMatrix4<T>& src, int start, int count );
 
         /// <summary>Access to the data array.</summary>
-        const T* Data() const;
+        const T* Data() const { return mVals; }
 
         /// <summary>Translation matrix.</summary>
         void Translate( T x, T y, T z );
@@ -104,8 +104,35 @@ namespace Core
         /// <summary>Returns the inverse of the matrix.<summary>
         cMatrix4 Inverse() const;
 
+        /// <summary>Replaces a rotation and translation matrix with its inverse: the transposed rotation and the
+        /// translation rotated back. Much cheaper than Invert(), but only valid without scale or shear.</summary>
+        void InvertRigid();
+
+        /// <summary>Returns the inverse of a rotation and translation matrix. See InvertRigid().</summary>
+        cMatrix4 RigidInverse() const;
+
         /// <summary>Returns the transpose of this matrix.<summary>
-        cMatrix4 Transposed();
+        cMatrix4 Transposed() const;
+
+        //====================================================================================
+        // In-place kernels. These take their operands by reference and write straight into
+        // this matrix, which may itself be one of the operands.
+        //====================================================================================
+
+        /// <summary>Set this matrix to m1 * m2.</summary>
+        void SetToProduct( const cMatrix4& m1, const cMatrix4& m2 );
+
+        /// <summary>Set this matrix to lhs * this; operator*= gives this * rhs.</summary>
+        void PreMultiply( const cMatrix4& lhs ) { SetToProduct( lhs, *this ); }
+
+        /// <summary>Set this matrix to the inverse of the affine matrix m (last column 0, 0, 0, 1).</summary>
+        void SetToInverse( const cMatrix4& m );
+
+        /// <summary>Set this matrix to the inverse of the rotation and translation matrix m.</summary>
+        void SetToRigidInverse( const cMatrix4& m );
+
+        /// <summary>Set this matrix to the transpose of m.</summary>
+        void SetToTranspose( const cMatrix4& m );
 
         /// <summary>Builds perspective view projection matrix for right handed coordinate.</summary>
         void PerspectiveFovRH( float fovY, float aspect, float nearClipPlane, float farClipPlane );
@@ -125,10 +152,24 @@ namespace Core
         /// <summary>Post-multiply the given vector by this matrix.</summary>
         cVector3<T> Multiply( const cVector3<T>& vec ) const
         {
-            cMatrix4<T> m1( 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, vec[0], vec[1], vec[2], 1 );
-            m1 *= *this;
+            return TransformPoint( vec );
+        }
+
+        /// <summary>Transform a point, i.e. the row vector [x y z 1] times this matrix, without the projective divide.
+        /// Gives the same result as translating the identity and multiplying by this matrix, in 9 multiplies.</summary>
+        cVector3<T> TransformPoint( const cVector3<T>& p ) const
+        {
+            return cVector3<T>( p[0] * mVals[0] + p[1] * mVals[4] + p[2] * mVals[8] + mVals[12],
+                                p[0] * mVals[1] + p[1] * mVals[5] + p[2] * mVals[9] + mVals[13],
+                                p[0] * mVals[2] + p[1] * mVals[6] + p[2] * mVals[10] + mVals[14] );
+        }
 
-            return cVector3<T>( m1.Value( 3, 0 ), m1.Value( 3, 1 ), m1.Value( 3, 2 ) );
+        /// <summary>Transform a direction, i.e. the row vector [x y z 0] times this matrix: rotation and scale, no translation.</summary>
+        cVector3<T> TransformDirection( const cVector3<T>& d ) const
+        {
+            return cVector3<T>( d[0] * mVals[0] + d[1] * mVals[4] + d[2] * mVals[8],
+                                d[0] * mVals[1] + d[1] * mVals[5] + d[2] * mVals[9],
+                                d[0] * mVals[2] + d[1] * mVals[6] + d[2] * mVals[10] );
         }
 
         //====================================================================================
@@ -151,7 +192,7 @@ namespace Core
         bool operator==( const cMatrix4& rhs ) const;
         bool operator!=( const cMatrix4& rhs ) const;
         cMatrix4& operator*=( const cMatrix4& rhs );
-        inline cMatrix4<T> operator*(const cMatrix4<T>& rhs) const { return cMatrix4(*this) *= rhs; };
+        inline cMatrix4<T> operator*(const cMatrix4<T>& rhs) const { cMatrix4 result; result.SetToProduct( *this, rhs ); return result; };
 
         cMatrix4 &operator+=( const cMatrix4 &rhs );
         inline cMatrix4<T> operator+(const cMatrix4<T>& rhs) const { return cMatrix4(*this) += rhs; };
@@ -174,10 +215,6 @@ namespace Core
         /*  8  9 10 11 */
         /* 12 13 14 15 */
         T mVals[16];
-
-        void SetToTranspose( const cMatrix4 m );
-        void SetToInverse( const cMatrix4 m );
-        void SetToProduct( const cMatrix4 m1, const cMatrix4 m2 );
     };
 
     //=========================================================================
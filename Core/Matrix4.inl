@@ -2,13 +2,88 @@
 // Copyright 2012, NaturalPoint Inc.
 //======================================================================================================
 
+// System includes
+#include <cmath>
+#include <type_traits>
+#include <utility>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define CORE_MATRIX4_SSE
+#include <xmmintrin.h>
+#endif
+
 // Local includes
 #include "Core/Vector3.h"
 
-#if !defined(__PLATFORM__LINUX__)
-
 namespace Core
 {
+#if defined(CORE_MATRIX4_SSE)
+    namespace Detail
+    {
+        // Row-major product out = a * b. All of b is loaded up front and each row of a is read before that
+        // row of out is written, so out may alias either operand.
+        inline void Matrix4ProductSse( const float* a, const float* b, float* out )
+        {
+            const __m128 b0 = _mm_loadu_ps( b );
+            const __m128 b1 = _mm_loadu_ps( b + 4 );
+            const __m128 b2 = _mm_loadu_ps( b + 8 );
+            const __m128 b3 = _mm_loadu_ps( b + 12 );
+
+            for( int row = 0; row < 16; row += 4 )
+            {
+                // Summed left to right, as the scalar loop does, so both paths give identical results.
+                __m128 r = _mm_mul_ps( _mm_set1_ps( a[row] ), b0 );
+                r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( a[row + 1] ), b1 ) );
+                r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( a[row + 2] ), b2 ) );
+                r = _mm_add_ps( r, _mm_mul_ps( _mm_set1_ps( a[row + 3] ), b3 ) );
+                _mm_storeu_ps( out + row, r );
+            }
+        }
+
+        inline __m128 Cross3Sse( __m128 a, __m128 b )
+        {
+            const __m128 aYzx = _mm_shuffle_ps( a, a, _MM_SHUFFLE( 3, 0, 2, 1 ) );
+            const __m128 bYzx = _mm_shuffle_ps( b, b, _MM_SHUFFLE( 3, 0, 2, 1 ) );
+            const __m128 c = _mm_sub_ps( _mm_mul_ps( a, bYzx ), _mm_mul_ps( aYzx, b ) );
+            return _mm_shuffle_ps( c, c, _MM_SHUFFLE( 3, 0, 2, 1 ) );
+        }
+
+        // Affine inverse: the 3x3 inverse is the transposed cross products of its rows over the determinant,
+        // and the translation is carried back through it. All loads come before the stores, so out may be m.
+        inline void Matrix4AffineInverseSse( const float* m, float* out )
+        {
+            const __m128 r0 = _mm_loadu_ps( m );
+            const __m128 r1 = _mm_loadu_ps( m + 4 );
+            const __m128 r2 = _mm_loadu_ps( m + 8 );
+            const __m128 t  = _mm_loadu_ps( m + 12 );
+
+            __m128 c0 = Cross3Sse( r1, r2 );
+            __m128 c1 = Cross3Sse( r2, r0 );
+            __m128 c2 = Cross3Sse( r0, r1 );
+            __m128 c3 = _mm_setzero_ps();
+
+            __m128 det = _mm_mul_ps( r0, c0 );
+            det = _mm_add_ps( det, _mm_shuffle_ps( det, det, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+            det = _mm_add_ps( det, _mm_shuffle_ps( det, det, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+            const __m128 invDet = _mm_div_ps( _mm_set1_ps( 1.0f ), det );
+
+            _MM_TRANSPOSE4_PS( c0, c1, c2, c3 );
+            c0 = _mm_mul_ps( c0, invDet );
+            c1 = _mm_mul_ps( c1, invDet );
+            c2 = _mm_mul_ps( c2, invDet );
+
+            const __m128 moved = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_shuffle_ps( t, t, _MM_SHUFFLE( 0, 0, 0, 0 ) ), c0 ),
+                                                         _mm_mul_ps( _mm_shuffle_ps( t, t, _MM_SHUFFLE( 1, 1, 1, 1 ) ), c1 ) ),
+                                              _mm_mul_ps( _mm_shuffle_ps( t, t, _MM_SHUFFLE( 2, 2, 2, 2 ) ), c2 ) );
+
+            _mm_storeu_ps( out, c0 );
+            _mm_storeu_ps( out + 4, c1 );
+            _mm_storeu_ps( out + 8, c2 );
+            _mm_storeu_ps( out + 12, _mm_sub_ps( _mm_setr_ps( 0.0f, 0.0f, 0.0f, 1.0f ), moved ) );
+        }
+    }
+#endif
+
     template<typename T>
     inline cMatrix4<T>::cMatrix4() 
     { 
@@ -112,12 +187,6 @@ namespace Core
             mVals[start + i] = src.mVals[start + i];
     }
 
-    template<typename T>
-    inline const T* cMatrix4<T>::Data() const 
-    { 
-        return mVals; 
-    }
-
     template<typename T>
     inline void cMatrix4<T>::Translate( T x, T y, T z )
     {
@@ -157,7 +226,7 @@ namespace Core
         m[7] = mVals[6];
         m[8] = mVals[10];
 
-        q.FromOrientationMatrix<T>( m );
+        q.template FromOrientationMatrix<T>( m );
 
         return q;
     }
@@ -252,7 +321,7 @@ namespace Core
         *this = kIdentity;
 
         T m[9];
-        q.ToOrientationMatrix<T>( m );
+        q.template ToOrientationMatrix<T>( m );
 
         mVals[0] = m[0];
         mVals[4] = m[1];
@@ -332,33 +401,95 @@ namespace Core
     }
 
     template<typename T>
-    inline void cMatrix4<T>::SetToInverse( const cMatrix4<T> m )
+    inline void cMatrix4<T>::SetToInverse( const cMatrix4<T>& m )
+    {
+#if defined(CORE_MATRIX4_SSE)
+        if constexpr( std::is_same<T, float>::value )
+        {
+            Detail::Matrix4AffineInverseSse( m.mVals, mVals );
+            return;
+        }
+#endif
+        // Read everything first so that m may be this matrix.
+        const T m00 = m.mVals[0], m01 = m.mVals[1], m02 = m.mVals[2];
+        const T m10 = m.mVals[4], m11 = m.mVals[5], m12 = m.mVals[6];
+        const T m20 = m.mVals[8], m21 = m.mVals[9], m22 = m.mVals[10];
+        const T t0 = m.mVals[12], t1 = m.mVals[13], t2 = m.mVals[14];
+
+        const T c00 = m11 * m22 - m12 * m21;
+        const T c10 = m12 * m20 - m10 * m22;
+        const T c20 = m10 * m21 - m11 * m20;
+
+        // For an affine matrix this is Determinant().
+        const T d = 1 / ( m00 * c00 + m01 * c10 + m02 * c20 );
+
+        mVals[0]  = c00 * d;
+        mVals[1]  = ( m02 * m21 - m01 * m22 ) * d;
+        mVals[2]  = ( m01 * m12 - m02 * m11 ) * d;
+        mVals[3]  = 0;
+
+        mVals[4]  = c10 * d;
+        mVals[5]  = ( m00 * m22 - m02 * m20 ) * d;
+        mVals[6]  = ( m02 * m10 - m00 * m12 ) * d;
+        mVals[7]  = 0;
+
+        mVals[8]  = c20 * d;
+        mVals[9]  = ( m01 * m20 - m00 * m21 ) * d;
+        mVals[10] = ( m00 * m11 - m01 * m10 ) * d;
+        mVals[11] = 0;
+
+        mVals[12] = -( t0 * mVals[0] + t1 * mVals[4] + t2 * mVals[8] );
+        mVals[13] = -( t0 * mVals[1] + t1 * mVals[5] + t2 * mVals[9] );
+        mVals[14] = -( t0 * mVals[2] + t1 * mVals[6] + t2 * mVals[10] );
+        mVals[15] = 1;
+    }
+
+    template<typename T>
+    inline void cMatrix4<T>::InvertRigid()
+    {
+        SetToRigidInverse( *this );
+    }
+
+    template<typename T>
+    inline cMatrix4<T> cMatrix4<T>::RigidInverse() const
+    {
+        cMatrix4 m;
+        m.SetToRigidInverse( *this );
+        return m;
+    }
+
+    template<typename T>
+    inline void cMatrix4<T>::SetToRigidInverse( const cMatrix4<T>& m )
     {
-        T d = 1 / m.Determinant();
+        // Read everything first so that m may be this matrix.
+        const T r00 = m.mVals[0], r01 = m.mVals[1], r02 = m.mVals[2];
+        const T r10 = m.mVals[4], r11 = m.mVals[5], r12 = m.mVals[6];
+        const T r20 = m.mVals[8], r21 = m.mVals[9], r22 = m.mVals[10];
+        const T t0 = m.mVals[12], t1 = m.mVals[13], t2 = m.mVals[14];
 
-        mVals[0]  = ( m.Value( 1, 1 ) * m.Value( 2, 2 ) - m.Value( 1, 2 ) * m.Value( 2, 1 ) ) * d;
-        mVals[1]  = ( m.Value( 0, 2 ) * m.Value( 2, 1 ) - m.Value( 0, 1 ) * m.Value( 2, 2 ) ) * d;
-        mVals[2]  = ( m.Value( 0, 1 ) * m.Value( 1, 2 ) - m.Value( 0, 2 ) * m.Value( 1, 1 ) ) * d;
+        mVals[0]  = r00;
+        mVals[1]  = r10;
+        mVals[2]  = r20;
         mVals[3]  = 0;
 
-        mVals[4]  = ( m.Value( 1, 2 ) * m.Value( 2, 0 ) - m.Value( 1, 0 ) * m.Value( 2, 2 ) ) * d;
-        mVals[5]  = ( m.Value( 0, 0 ) * m.Value( 2, 2 ) - m.Value( 0, 2 ) * m.Value( 2, 0 ) ) * d;
-        mVals[6]  = ( m.Value( 0, 2 ) * m.Value( 1, 0 ) - m.Value( 0, 0 ) * m.Value( 1, 2 ) ) * d;
+        mVals[4]  = r01;
+        mVals[5]  = r11;
+        mVals[6]  = r21;
         mVals[7]  = 0;
 
-        mVals[8]  = ( m.Value( 1, 0 ) * m.Value( 2, 1 ) - m.Value( 1, 1 ) * m.Value( 2, 0 ) ) * d;
-        mVals[9]  = ( m.Value( 0, 1 ) * m.Value( 2, 0 ) - m.Value( 0, 0 ) * m.Value( 2, 1 ) ) * d;
-        mVals[10] = ( m.Value( 0, 0 ) * m.Value( 1, 1 ) - m.Value( 0, 1 ) * m.Value( 1, 0 ) ) * d;
+        mVals[8]  = r02;
+        mVals[9]  = r12;
+        mVals[10] = r22;
         mVals[11] = 0;
 
-        mVals[12] = -( m.Value( 3, 0 ) * mVals[0] + m.Value( 3, 1 ) * mVals[4] + m.Value( 3, 2 ) * mVals[8] );
-        mVals[13] = -( m.Value( 3, 0 ) * mVals[1] + m.Value( 3, 1 ) * mVals[5] + m.Value( 3, 2 ) * mVals[9] );
-        mVals[14] = -( m.Value( 3, 0 ) * mVals[2] + m.Value( 3, 1 ) * mVals[6] + m.Value( 3, 2 ) * mVals[10] );
+        mVals[12] = -( t0 * r00 + t1 * r01 + t2 * r02 );
+        mVals[13] = -( t0 * r10 + t1 * r11 + t2 * r12 );
+        mVals[14] = -( t0 * r20 + t1 * r21 + t2 * r22 );
         mVals[15] = 1;
     }
 
     template<typename T>
-    inline cMatrix4<T> cMatrix4<T>::Transposed()
+    inline cMatrix4<T> cMatrix4<T>::Transposed() const
     {
         cMatrix4<T> ret;
         ret.SetToTranspose( *this );
@@ -366,8 +497,19 @@ namespace Core
     }
 
     template<typename T>
-    inline void cMatrix4<T>::SetToTranspose( const cMatrix4<T> m )
+    inline void cMatrix4<T>::SetToTranspose( const cMatrix4<T>& m )
     {
+        if( &m == this )
+        {
+            std::swap( mVals[1], mVals[4] );
+            std::swap( mVals[2], mVals[8] );
+            std::swap( mVals[3], mVals[12] );
+            std::swap( mVals[6], mVals[9] );
+            std::swap( mVals[7], mVals[13] );
+            std::swap( mVals[11], mVals[14] );
+            return;
+        }
+
         mVals[0]  = m.Value( 0, 0 );
         mVals[1]  = m.Value( 1, 0 );
         mVals[2]  = m.Value( 2, 0 );
@@ -387,15 +529,31 @@ namespace Core
     }
 
     template<typename T>
-    inline void cMatrix4<T>::SetToProduct( const cMatrix4<T> m1, const cMatrix4<T> m2 )
+    inline void cMatrix4<T>::SetToProduct( const cMatrix4<T>& m1, const cMatrix4<T>& m2 )
     {
-        const T *v1 = m1.Data(), *v2 = m2.Data();
+#if defined(CORE_MATRIX4_SSE)
+        if constexpr( std::is_same<T, float>::value )
+        {
+            Detail::Matrix4ProductSse( m1.mVals, m2.mVals, mVals );
+            return;
+        }
+#endif
+        // Each output row only reads the same row of m1, loaded before it is written, so m1 may be this
+        // matrix. m2 is read throughout and is copied aside if it is.
+        T copy[16];
+        const T* v2 = m2.mVals;
+        if( &m2 == this )
+        {
+            ::memcpy( copy, m2.mVals, sizeof( copy ) );
+            v2 = copy;
+        }
 
-        for( int row = 0; row < 4; row++ )
+        for( int row = 0; row < 16; row += 4 )
         {
+            const T a0 = m1.mVals[row], a1 = m1.mVals[row + 1], a2 = m1.mVals[row + 2], a3 = m1.mVals[row + 3];
             for( int col = 0; col < 4; col++ )
             {
-                mVals[row * 4 + col] = v1[row * 4] * v2[col] + v1[row * 4 + 1] * v2[col + 4] + v1[row * 4 + 2] * v2[col + 8] + v1[row * 4 + 3] * v2[col + 12];
+                mVals[row + col] = a0 * v2[col] + a1 * v2[col + 4] + a2 * v2[col + 8] + a3 * v2[col + 12];
             }
         }
     }
@@ -614,5 +772,3 @@ namespace Core
 
 }
 
-#endif // __PLATFORM__LINUX__
-
@@ -15,7 +15,7 @@
 
 #ifdef __PLATFORM__LINUX__
 #define sprintf_s snprintf
-#define byte unsigned char
+typedef unsigned char byte;
 #endif
 
 namespace Core
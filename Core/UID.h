@@ -125,7 +125,7 @@ namespace Core
 #endif // !defined(__PLATFORM__LINUX__)
 }
 
-#if _MSC_VER > 1600 || defined(__PLATFORM__LINUX)
+#if _MSC_VER > 1600 || defined(__PLATFORM__LINUX__)
 namespace std
 {
     // Hash template specialization for cUID. Allows it to be used as a key for things like std::unordered_set.
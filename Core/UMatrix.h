@@ -198,7 +198,7 @@ namespace Core
         template<class V>
         bool HasU( const V& u ) const
         {
-            return UIndex( u ) != -1;
+            return UIndex( u ) != size_t( -1 );
         }
         void BuildIndex()
         {
@@ -498,6 +498,7 @@ namespace Core
         cMat() : mSize( 0 ) { }
         cMat( cMatrix<T>& mat ) : mSize( mat.size() ), mRowOffsets( mat.mRowOffsets ), mData( mat.mData ) { }
         cMat( const cMatrix<typename std::remove_const<T>::type>& mat ) : mSize( mat.size() ), mRowOffsets( mat.mRowOffsets ), mData( mat.mData ) { }
+        cMat( cVec<c_int> rowOffsets, cVec<T> data ) : mSize( rowOffsets.empty() ? 0 : rowOffsets.size() - 1 ), mRowOffsets( rowOffsets ), mData( data ) { } // e.g. views into a mapped file
 
         size_t size() const { return mSize; }
 
@@ -591,8 +592,8 @@ namespace Core
             mUData.BuildIndex();
         }
 
-        const cVec<const T> URow( const U& u ) const { size_t i = mUData.UIndex( u ); return i != -1 ? cMatrix<T>::operator[]( i ) : cVec<const T>(); }
-        cVec<T> EditURow( const U& u ) { UpdateHash(); size_t i = mUData.UIndex( u ); return i != -1 ? cMatrix<T>::operator[]( i ) : cVec<T>(); }
+        const cVec<const T> URow( const U& u ) const { size_t i = mUData.UIndex( u ); return i != size_t( -1 ) ? cMatrix<T>::operator[]( i ) : cVec<const T>(); }
+        cVec<T> EditURow( const U& u ) { UpdateHash(); size_t i = mUData.UIndex( u ); return i != size_t( -1 ) ? cMatrix<T>::operator[]( i ) : cVec<T>(); }
 
         size_t U2Index( const U& u ) const { return mUData.UIndex( u ); }
         const U& Index2U( size_t i ) const { return mUData[i]; }
@@ -4,11 +4,11 @@
 #pragma once
 
 // System includes
+#include <cfloat>
 #include <iostream>
 
 // Local includes
 #include "Core/BuildConfig.h"
-#if !defined(__PLATFORM__LINUX__)
 
 namespace Core
 {
@@ -347,7 +347,5 @@ namespace Core
         v.SetValues( x, y );
         return is;
     }
-}
 #endif // No stream operators for gcc.
-
-#endif // __PLATFORM__LINUX__
+}
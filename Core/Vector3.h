@@ -4,6 +4,7 @@
 #pragma once
 
 // System includes
+#include <cmath>
 #include <cstring> // for memcpy
 #include <iostream>
 #include <limits>
@@ -198,7 +198,7 @@ namespace Core
         template<typename U>
         cVector4<U> ConvertToType() const
         {
-            return cVector3<U>( (U) mVals[0], (U) mVals[1], (U) mVals[2], (U) mVals[3] );
+            return cVector4<U>( (U) mVals[0], (U) mVals[1], (U) mVals[2], (U) mVals[3] );
         }
 
         //====================================================================================
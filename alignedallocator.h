@@ -0,0 +1,48 @@
+//======================================================================================================
+// Aligned allocator: std::vector storage starting on a SIMD-register or cache-line boundary
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+#include <new>
+
+namespace Capture
+{
+    /// <summary>Alignment for columns the batch kernels stream through: one cache line, which is also
+    /// the widest register (AVX-512), so no vector load ever straddles two lines.</summary>
+    constexpr size_t kSimdAlignment = 64;
+
+    template<typename T, size_t Alignment = kSimdAlignment>
+    class cAlignedAllocator
+    {
+    public:
+        using value_type = T;
+
+        template<typename U>
+        struct rebind
+        {
+            using other = cAlignedAllocator<U, Alignment>;
+        };
+
+        cAlignedAllocator() = default;
+
+        template<typename U>
+        cAlignedAllocator( const cAlignedAllocator<U, Alignment>& ) { }
+
+        T* allocate( size_t count )
+        {
+            return static_cast<T*>( ::operator new( count * sizeof( T ), std::align_val_t( Alignment ) ) );
+        }
+
+        void deallocate( T* p, size_t )
+        {
+            ::operator delete( p, std::align_val_t( Alignment ) );
+        }
+
+        template<typename U>
+        bool operator==( const cAlignedAllocator<U, Alignment>& ) const { return true; }
+
+        template<typename U>
+        bool operator!=( const cAlignedAllocator<U, Alignment>& ) const { return false; }
+    };
+}
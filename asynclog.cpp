@@ -0,0 +1,603 @@
+//======================================================================================================
+// Asynchronous logging: binary records queued per thread, formatted and written by a background flusher
+//======================================================================================================
+#include "asynclog.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hostclock.h"
+#include "spscring.h"
+#include "threadregistry.h"
+
+namespace Capture
+{
+    namespace
+    {
+        // 256 KB per logging thread: a few seconds of per-frame messages if the flusher stalls.
+        const size_t kQueueRecords = 1024;
+
+        /// <summary>The queue of one thread.</summary>
+        struct sLogThread
+        {
+            sLogThread( int index ) : Index( index ), Queue( kQueueRecords ) { }
+
+            int Index;
+            cSpscRing<sLogRecord> Queue;
+            std::atomic<unsigned long long> Dropped{ 0 };   // Written by the owning thread only
+            unsigned long long DropsReported = 0;           // Flusher only
+        };
+
+        using LogThreads = cThreadRegistry<sLogThread>;
+        using sPending = sDrainedItem<sLogRecord>;
+
+        // Flusher state. Drain() runs on the flusher thread, or on the caller once it is stopped.
+        std::mutex sDrainLock;
+        std::thread sFlusher;
+        std::atomic<bool> sRunning{ false };
+        std::atomic<unsigned long long> sPasses{ 0 };
+        std::atomic<unsigned long long> sWritten{ 0 };
+        std::atomic<unsigned long long> sTruncated{ 0 };
+        sAsyncLogConfig sConfig;
+        long long sStartNs = HostTimeNs();
+        std::map<std::string, FILE*> sFiles;
+
+        const char* LevelName( eLogLevel level )
+        {
+            switch( level )
+            {
+            case eLogLevel::Debug:   return "debug";
+            case eLogLevel::Info:    return "info";
+            case eLogLevel::Warning: return "warning";
+            case eLogLevel::Error:   return "error";
+            }
+            return "unknown";
+        }
+
+        void AppendUtf8( std::string& out, unsigned long code )
+        {
+            if( code < 0x80 )
+            {
+                out += (char) code;
+            }
+            else if( code < 0x800 )
+            {
+                out += (char) ( 0xc0 | ( code >> 6 ) );
+                out += (char) ( 0x80 | ( code & 0x3f ) );
+            }
+            else if( code < 0x10000 )
+            {
+                out += (char) ( 0xe0 | ( code >> 12 ) );
+                out += (char) ( 0x80 | ( ( code >> 6 ) & 0x3f ) );
+                out += (char) ( 0x80 | ( code & 0x3f ) );
+            }
+            else
+            {
+                out += (char) ( 0xf0 | ( code >> 18 ) );
+                out += (char) ( 0x80 | ( ( code >> 12 ) & 0x3f ) );
+                out += (char) ( 0x80 | ( ( code >> 6 ) & 0x3f ) );
+                out += (char) ( 0x80 | ( code & 0x3f ) );
+            }
+        }
+
+        /// <summary>Wide text to UTF-8, joining UTF-16 surrogate pairs where wchar_t is 16 bits.</summary>
+        void AppendWide( std::string& out, const wchar_t* text, size_t length )
+        {
+            for( size_t i = 0; i < length; ++i )
+            {
+                unsigned long code = (unsigned long) text[i];
+                if( code >= 0xd800 && code < 0xdc00 && i + 1 < length && (unsigned long) text[i + 1] >= 0xdc00 && (unsigned long) text[i + 1] < 0xe000 )
+                {
+                    code = 0x10000 + ( ( code - 0xd800 ) << 10 ) + ( (unsigned long) text[i + 1] - 0xdc00 );
+                    ++i;
+                }
+                AppendUtf8( out, code );
+            }
+        }
+
+        /// <summary>One decoded argument.</summary>
+        struct sLogArg
+        {
+            eLogArg Type;
+            int Bytes;                  // Width of a scalar argument as passed
+            long long Signed;
+            unsigned long long Unsigned;
+            double Double;
+            const void* Pointer;
+            std::string Text;
+
+            long long AsSigned() const
+            {
+                switch( Type )
+                {
+                case eLogArg::Signed:   return Signed;
+                case eLogArg::Unsigned: return (long long) Unsigned;
+                case eLogArg::Double:   return (long long) Double;
+                default:                return 0;
+                }
+            }
+
+            /// <summary>The argument's own bits, so a negative int prints as 32 bits, not 64.</summary>
+            unsigned long long AsUnsigned() const
+            {
+                switch( Type )
+                {
+                case eLogArg::Signed:   return ( Bytes > 0 && Bytes < 8 ? (unsigned long long) Signed & ( ( 1ull << ( 8 * Bytes ) ) - 1 ) : (unsigned long long) Signed );
+                case eLogArg::Unsigned: return Unsigned;
+                case eLogArg::Double:   return (unsigned long long) (long long) Double;
+                default:                return 0;
+                }
+            }
+
+            double AsDouble() const
+            {
+                switch( Type )
+                {
+                case eLogArg::Signed:   return (double) Signed;
+                case eLogArg::Unsigned: return (double) Unsigned;
+                case eLogArg::Double:   return Double;
+                default:                return 0.0;
+                }
+            }
+        };
+
+        /// <summary>Reads the arguments of a record back in order.</summary>
+        class cArgReader
+        {
+        public:
+            explicit cArgReader( const sLogRecord& record ) : mRecord( record ) { }
+
+            bool Next( sLogArg& arg )
+            {
+                if( mRead == mRecord.ArgCount )
+                {
+                    return false;
+                }
+                ++mRead;
+
+                const unsigned char* at = mRecord.Args + mPosition;
+                arg.Type = (eLogArg) at[0];
+                switch( arg.Type )
+                {
+                case eLogArg::Signed:   arg.Bytes = at[1]; memcpy( &arg.Signed, at + 2, sizeof( long long ) ); mPosition += 2 + sizeof( long long ); break;
+                case eLogArg::Unsigned: arg.Bytes = at[1]; memcpy( &arg.Unsigned, at + 2, sizeof( unsigned long long ) ); mPosition += 2 + sizeof( unsigned long long ); break;
+                case eLogArg::Double:   arg.Bytes = at[1]; memcpy( &arg.Double, at + 2, sizeof( double ) ); mPosition += 2 + sizeof( double ); break;
+                case eLogArg::Pointer:  arg.Bytes = at[1]; memcpy( &arg.Pointer, at + 2, sizeof( const void* ) ); mPosition += 2 + sizeof( const void* ); break;
+                case eLogArg::String:
+                case eLogArg::WideString:
+                {
+                    unsigned short length;
+                    memcpy( &length, at + 1, sizeof( length ) );
+                    arg.Text.clear();
+                    if( arg.Type == eLogArg::String )
+                    {
+                        arg.Text.assign( (const char*) ( at + 3 ), length );
+                        mPosition += 3 + length;
+                    }
+                    else
+                    {
+                        std::vector<wchar_t> wide( length );
+                        memcpy( wide.data(), at + 3, length * sizeof( wchar_t ) );
+                        AppendWide( arg.Text, wide.data(), length );
+                        mPosition += 3 + length * sizeof( wchar_t );
+                    }
+                    break;
+                }
+                }
+                return true;
+            }
+
+        private:
+            const sLogRecord& mRecord;
+            size_t mPosition = 0;
+            int mRead = 0;
+        };
+
+        template<typename T>
+        void AppendFormatted( std::string& out, const std::string& spec, T value )
+        {
+            char buffer[256];
+            const int length = snprintf( buffer, sizeof( buffer ), spec.c_str(), value );
+            if( length < 0 )
+            {
+                return;
+            }
+            if( length < (int) sizeof( buffer ) )
+            {
+                out.append( buffer, length );
+                return;
+            }
+            std::vector<char> large( length + 1 );
+            snprintf( large.data(), large.size(), spec.c_str(), value );
+            out.append( large.data(), length );
+        }
+
+        /// <summary>
+        /// printf formatting from the stored arguments. Each conversion is re-issued to snprintf with the
+        /// length modifier that matches the stored type, so a wrong modifier at the call site (or MSVC's
+        /// I64) prints the value instead of reading garbage; a conversion without an argument is copied out.
+        /// </summary>
+        void FormatText( const char* fmt, cArgReader& args, std::string& out )
+        {
+            sLogArg arg;
+            std::string spec;
+
+            for( const char* p = fmt; *p; )
+            {
+                if( *p != '%' )
+                {
+                    const char* next = strchr( p, '%' );
+                    const size_t length = next ? size_t( next - p ) : strlen( p );
+                    out.append( p, length );
+                    p += length;
+                    continue;
+                }
+
+                const char* start = p++;
+                if( *p == '%' )
+                {
+                    out += '%';
+                    ++p;
+                    continue;
+                }
+
+                spec.assign( 1, '%' );
+                bool missing = false;
+                while( *p && strchr( "-+ #0", *p ) )
+                {
+                    spec += *p++;
+                }
+                for( int part = 0; part < 2; ++part )
+                {
+                    if( part == 1 )
+                    {
+                        if( *p != '.' )
+                        {
+                            break;
+                        }
+                        spec += *p++;
+                    }
+                    if( *p == '*' )
+                    {
+                        ++p;
+                        missing |= !args.Next( arg );
+                        spec += std::to_string( missing ? 0 : arg.AsSigned() );
+                    }
+                    while( *p >= '0' && *p <= '9' )
+                    {
+                        spec += *p++;
+                    }
+                }
+                // Only h and hh change what is printed: they cut an unsigned conversion to short or char.
+                const int lengthBytes = ( p[0] == 'h' ? ( p[1] == 'h' ? 1 : 2 ) : 0 );
+                while( *p && strchr( "hlLqjztI", *p ) )
+                {
+                    p += ( p[0] == 'I' && ( ( p[1] == '6' && p[2] == '4' ) || ( p[1] == '3' && p[2] == '2' ) ) ) ? 3 : 1;
+                }
+
+                const char conversion = *p;
+                if( conversion == 0 || missing || !args.Next( arg ) )
+                {
+                    out.append( start, conversion ? p + 1 - start : p - start );
+                    p += conversion ? 1 : 0;
+                    continue;
+                }
+                ++p;
+
+                switch( conversion )
+                {
+                case 'd':
+                case 'i':
+                    AppendFormatted( out, spec + "lld", arg.AsSigned() );
+                    break;
+                case 'u':
+                case 'o':
+                case 'x':
+                case 'X':
+                {
+                    unsigned long long value = arg.AsUnsigned();
+                    if( lengthBytes > 0 )
+                    {
+                        value &= ( 1ull << ( 8 * lengthBytes ) ) - 1;
+                    }
+                    AppendFormatted( out, spec + "ll" + conversion, value );
+                    break;
+                }
+                case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                    AppendFormatted( out, spec + conversion, arg.AsDouble() );
+                    break;
+                case 'c':
+                case 'C':
+                {
+                    std::string character;
+                    const long long code = arg.AsSigned();
+                    AppendUtf8( character, (unsigned long) ( code < 0 ? code & 0xff : code ) );
+                    AppendFormatted( out, spec + "s", character.c_str() );
+                    break;
+                }
+                case 's':
+                case 'S':
+                    AppendFormatted( out, spec + "s", arg.Type == eLogArg::String || arg.Type == eLogArg::WideString ? arg.Text.c_str() : "(not a string)" );
+                    break;
+                case 'p':
+                    AppendFormatted( out, spec + "p", arg.Type == eLogArg::Pointer ? arg.Pointer : nullptr );
+                    break;
+                case 'n':
+                    break;
+                default:
+                    out.append( start, p - start );
+                    break;
+                }
+            }
+        }
+
+        FILE* LogFile( const std::string& name )
+        {
+            auto found = sFiles.find( name );
+            if( found == sFiles.end() )
+            {
+                found = sFiles.emplace( name, fopen( name.c_str(), "a" ) ).first;
+            }
+            return found->second;
+        }
+
+        void AppendPrefix( std::string& out, const sPending& pending )
+        {
+            char prefix[96];
+            const sLogRecord& record = *pending.Value;
+            snprintf( prefix, sizeof( prefix ), "%12.6f T%-2d %-7s %-13s ", ( record.HostTimeNs - sStartNs ) / 1e9, pending.Thread,
+                LevelName( (eLogLevel) record.Level ), Core::cDebugSystem::SystemName( (Core::cDebugSystem::eDebugSystemName) record.System ) );
+            out += prefix;
+        }
+
+        /// <summary>Write everything queued, in time order across threads.</summary>
+        void Drain()
+        {
+            std::lock_guard<std::mutex> drainLock( sDrainLock );
+
+            std::vector<sLogThread*> threads;
+            LogThreads::Snapshot( threads );
+            static cQueueDrain<sLogRecord>& sDrain = *new cQueueDrain<sLogRecord>();
+            const std::vector<sPending>& order = sDrain.Collect( threads, []( const sLogRecord& record ) { return record.HostTimeNs; } );
+
+            std::string format, text, line;
+            bool console = false;
+            for( const sPending& pending : order )
+            {
+                const sLogRecord& record = *pending.Value;
+                cArgReader args( record );
+
+                std::string filename;
+                if( record.Flags & sLogRecord::kToFile )
+                {
+                    sLogArg arg;
+                    args.Next( arg );
+                    filename = arg.Text;
+                }
+
+                const char* fmt = (const char*) record.Format;
+                if( record.Flags & sLogRecord::kWideFormat )
+                {
+                    const wchar_t* wide = (const wchar_t*) record.Format;
+                    format.clear();
+                    AppendWide( format, wide, wcslen( wide ) );
+                    fmt = format.c_str();
+                }
+
+                text.clear();
+                FormatText( fmt, args, text );
+                if( record.Flags & sLogRecord::kTruncated )
+                {
+                    const size_t end = text.find_last_not_of( "\r\n" ) + 1;
+                    text.insert( end, " [truncated]" );
+                    sTruncated.fetch_add( 1, std::memory_order_relaxed );
+                }
+
+                line.clear();
+                if( ( record.Flags & sLogRecord::kToFile ) || sConfig.ConsolePrefix )
+                {
+                    AppendPrefix( line, pending );
+                }
+                line += text;
+
+                if( record.Flags & sLogRecord::kToFile )
+                {
+                    if( line.empty() || line.back() != '\n' )
+                    {
+                        line += '\n';
+                    }
+                    FILE* file = LogFile( filename );
+                    if( file )
+                    {
+                        fwrite( line.data(), 1, line.size(), file );
+                    }
+                }
+                else
+                {
+                    fwrite( line.data(), 1, line.size(), stdout );
+                    console = true;
+                }
+            }
+            sWritten.fetch_add( order.size(), std::memory_order_relaxed );
+
+            for( sLogThread* thread : threads )
+            {
+                const unsigned long long dropped = thread->Dropped.load( std::memory_order_relaxed );
+                if( dropped != thread->DropsReported )
+                {
+                    fprintf( stdout, "\nLog: thread %d dropped %llu messages (queue full)\n", thread->Index, dropped - thread->DropsReported );
+                    thread->DropsReported = dropped;
+                    console = true;
+                }
+            }
+
+            if( console )
+            {
+                fflush( stdout );
+            }
+            if( !order.empty() )
+            {
+                for( auto& file : sFiles )
+                {
+                    if( file.second )
+                    {
+                        fflush( file.second );
+                    }
+                }
+            }
+            sPasses.fetch_add( 1, std::memory_order_release );
+        }
+
+        void FlusherLoop()
+        {
+            while( sRunning.load( std::memory_order_acquire ) )
+            {
+                const unsigned long long written = sWritten.load( std::memory_order_relaxed );
+                Drain();
+                if( sWritten.load( std::memory_order_relaxed ) == written )
+                {
+                    std::this_thread::sleep_for( std::chrono::milliseconds( sConfig.FlushIntervalMs ) );
+                }
+            }
+        }
+
+        sStopAtExit sStopLog{ &cAsyncLog::Stop };
+    }
+
+    std::atomic<unsigned char> cAsyncLog::sLevels[Core::cDebugSystem::DebugSystemCount];
+
+    //==================================================================================================
+    // Producer side
+    //==================================================================================================
+
+    void cAsyncLog::cArgWriter::PutString( eLogArg type, const void* chars, size_t length, size_t unit )
+    {
+        if( !Reserve( 3 + unit ) )
+        {
+            return;
+        }
+
+        // Strings are cut to what is left rather than dropped, and the record is marked truncated.
+        const size_t room = ( sizeof( mRecord.Args ) - mRecord.Used - 3 ) / unit;
+        if( length > room )
+        {
+            length = room;
+            mRecord.Flags |= sLogRecord::kTruncated;
+        }
+
+        const unsigned short count = (unsigned short) length;
+        mRecord.Args[mRecord.Used] = (unsigned char) type;
+        memcpy( mRecord.Args + mRecord.Used + 1, &count, sizeof( count ) );
+        memcpy( mRecord.Args + mRecord.Used + 3, chars, length * unit );
+        mRecord.Used += (unsigned short) ( 3 + length * unit );
+        ++mRecord.ArgCount;
+    }
+
+    bool cAsyncLog::cArgWriter::Reserve( size_t bytes )
+    {
+        if( ( mRecord.Flags & sLogRecord::kTruncated ) == 0 && mRecord.Used + bytes <= sizeof( mRecord.Args ) )
+        {
+            return true;
+        }
+        mRecord.Flags |= sLogRecord::kTruncated;
+        return false;
+    }
+
+    sLogRecord* cAsyncLog::BeginRecord()
+    {
+        sLogThread& thread = LogThreads::Local();
+        sLogRecord* record = thread.Queue.BeginWrite();
+        if( record == nullptr )
+        {
+            thread.Dropped.store( thread.Dropped.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            return nullptr;
+        }
+        record->HostTimeNs = HostTimeNs();
+        return record;
+    }
+
+    void cAsyncLog::Publish()
+    {
+        LogThreads::Local().Queue.Publish();
+    }
+
+    //==================================================================================================
+    // Control
+    //==================================================================================================
+
+    void cAsyncLog::Start( const sAsyncLogConfig& config )
+    {
+        if( sRunning.exchange( true ) )
+        {
+            return;
+        }
+        sConfig = config;
+        sFlusher = std::thread( &FlusherLoop );
+    }
+
+    void cAsyncLog::Stop()
+    {
+        if( sRunning.exchange( false ) )
+        {
+            sFlusher.join();
+        }
+        Drain();
+
+        std::lock_guard<std::mutex> drainLock( sDrainLock );
+        for( auto& file : sFiles )
+        {
+            if( file.second )
+            {
+                fclose( file.second );
+            }
+        }
+        sFiles.clear();
+    }
+
+    void cAsyncLog::Flush()
+    {
+        if( !sRunning.load( std::memory_order_acquire ) )
+        {
+            Drain();
+            return;
+        }
+
+        // The pass running now may have started before our records were queued; the one after cannot.
+        const unsigned long long target = sPasses.load( std::memory_order_acquire ) + 2;
+        while( sRunning.load( std::memory_order_acquire ) && sPasses.load( std::memory_order_acquire ) < target )
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+        }
+    }
+
+    void cAsyncLog::SetLevel( Core::cDebugSystem::eDebugSystemName system, eLogLevel level )
+    {
+        sLevels[system].store( (unsigned char) level, std::memory_order_relaxed );
+    }
+
+    eLogLevel cAsyncLog::Level( Core::cDebugSystem::eDebugSystemName system )
+    {
+        return (eLogLevel) sLevels[system].load( std::memory_order_relaxed );
+    }
+
+    sAsyncLogStats cAsyncLog::Stats()
+    {
+        sAsyncLogStats stats;
+        stats.Written = sWritten.load( std::memory_order_relaxed );
+        stats.Truncated = sTruncated.load( std::memory_order_relaxed );
+        stats.Dropped = 0;
+
+        std::lock_guard<std::mutex> lock( LogThreads::Lock() );
+        for( const sLogThread* thread : LogThreads::Slots() )
+        {
+            stats.Dropped += thread->Dropped.load( std::memory_order_relaxed );
+        }
+        stats.Threads = (int) LogThreads::Slots().size();
+        return stats;
+    }
+}
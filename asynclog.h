@@ -0,0 +1,236 @@
+//======================================================================================================
+// Asynchronous logging: binary records queued per thread, formatted and written by a background flusher
+//======================================================================================================
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <cwchar>
+#include <type_traits>
+
+#include "Core/DebugSystem.h"
+
+// Set to 0 to leave OUTPUT and LOGOUTPUT to Core::cDebugSystem.
+#ifndef CAPTURE_ASYNC_LOG
+#define CAPTURE_ASYNC_LOG 1
+#endif
+
+namespace Capture
+{
+    enum class eLogLevel : unsigned char
+    {
+        Debug,      // OUTPUT
+        Info,       // LOGOUTPUT
+        Warning,
+        Error
+    };
+
+    enum class eLogArg : unsigned char
+    {
+        Signed,
+        Unsigned,
+        Double,
+        Pointer,
+        String,     // Length-prefixed copy of the characters
+        WideString  // Same, in wchar_t units
+    };
+
+    /// <summary>
+    /// One queued message: the format pointer and the arguments as typed binary values. The format is
+    /// not copied, so it must be a string literal (as every OUTPUT call site has); string arguments are.
+    /// </summary>
+    struct sLogRecord
+    {
+        static constexpr int kSize = 256;
+        static constexpr unsigned char kWideFormat = 1 << 0;
+        static constexpr unsigned char kToFile = 1 << 1;     // The first argument is the file name
+        static constexpr unsigned char kTruncated = 1 << 2;  // Arguments did not all fit
+
+        long long HostTimeNs;
+        const void* Format;
+        unsigned char System;
+        unsigned char Level;
+        unsigned char Flags;
+        unsigned char ArgCount;
+        unsigned short Used;
+        unsigned char Args[kSize - 22];
+    };
+
+    struct sAsyncLogConfig
+    {
+        int FlushIntervalMs = 5;    // Flusher sleep when every queue is empty
+        bool ConsolePrefix = false; // Prefix console lines like file lines; off keeps OUTPUT text as is
+    };
+
+    struct sAsyncLogStats
+    {
+        unsigned long long Written;     // Records formatted and written
+        unsigned long long Dropped;     // Records lost because their thread's queue was full
+        unsigned long long Truncated;   // Records whose arguments did not all fit
+        int Threads;                    // Threads that have logged
+    };
+
+    /// <summary>
+    /// Backend for OUTPUT and LOGOUTPUT. A call checks the system's visibility and level, copies its
+    /// arguments into a fixed-size record in the calling thread's own SPSC queue, and returns: no lock,
+    /// no allocation after a thread's first message, no formatting and no I/O. When the queue is full
+    /// the record is dropped and counted, so logging never blocks the capture threads. The flusher thread
+    /// drains every queue, orders the records by time, formats them and writes OUTPUT text to stdout and
+    /// LOGOUTPUT lines, prefixed with time, thread, level and system, to their files.
+    ///
+    /// Core::cDebugSystem::SystemVisibility switches a system on or off at run time; SetLevel() sets the
+    /// lowest level it reports.
+    /// </summary>
+    class cAsyncLog
+    {
+    public:
+        static void Start( const sAsyncLogConfig& config = sAsyncLogConfig() );
+
+        /// <summary>Write everything queued, stop the flusher and close the files.</summary>
+        static void Stop();
+
+        /// <summary>Wait until everything queued so far is written. Not for the capture threads.</summary>
+        static void Flush();
+
+        static void SetLevel( Core::cDebugSystem::eDebugSystemName system, eLogLevel level );
+        static eLogLevel Level( Core::cDebugSystem::eDebugSystemName system );
+
+        static bool Enabled( Core::cDebugSystem::eDebugSystemName system, eLogLevel level )
+        {
+            return Core::cDebugSystem::SystemVisibility[system] && (unsigned char) level >= sLevels[system].load( std::memory_order_relaxed );
+        }
+
+        static sAsyncLogStats Stats();
+
+        template<typename... Args>
+        static void Report( Core::cDebugSystem::eDebugSystemName system, eLogLevel level, const char* fmt, const Args&... args )
+        {
+            if( Enabled( system, level ) )
+            {
+                Enqueue( system, level, 0, fmt, nullptr, args... );
+            }
+        }
+
+        template<typename... Args>
+        static void Report( Core::cDebugSystem::eDebugSystemName system, eLogLevel level, const wchar_t* fmt, const Args&... args )
+        {
+            if( Enabled( system, level ) )
+            {
+                Enqueue( system, level, sLogRecord::kWideFormat, fmt, nullptr, args... );
+            }
+        }
+
+        // The cDebugSystem::ReportDebug() and ReportLog() signatures, for the macros.
+        template<typename... Args>
+        static void Output( Core::cDebugSystem::eDebugSystemName system, const char* fmt, const Args&... args ) { Report( system, eLogLevel::Debug, fmt, args... ); }
+
+        template<typename... Args>
+        static void Output( Core::cDebugSystem::eDebugSystemName system, const wchar_t* fmt, const Args&... args ) { Report( system, eLogLevel::Debug, fmt, args... ); }
+
+        template<typename... Args>
+        static void Output( const char* fmt, const Args&... args ) { Report( Core::cDebugSystem::General, eLogLevel::Debug, fmt, args... ); }
+
+        template<typename... Args>
+        static void Output( const wchar_t* fmt, const Args&... args ) { Report( Core::cDebugSystem::General, eLogLevel::Debug, fmt, args... ); }
+
+        template<typename... Args>
+        static void Log( Core::cDebugSystem::eDebugSystemName system, const char* filename, const char* fmt, const Args&... args )
+        {
+            if( Enabled( system, eLogLevel::Info ) )
+            {
+                Enqueue( system, eLogLevel::Info, sLogRecord::kToFile, fmt, filename, args... );
+            }
+        }
+
+    private:
+        /// <summary>Appends typed arguments to a record, marking it truncated at the first one that does not fit.</summary>
+        class cArgWriter
+        {
+        public:
+            explicit cArgWriter( sLogRecord& record ) : mRecord( record ) { }
+
+            template<typename T>
+            typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type Put( T value ) { PutValue( eLogArg::Signed, (long long) value, Promoted( sizeof( T ) ) ); }
+
+            template<typename T>
+            typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type Put( T value ) { PutValue( eLogArg::Unsigned, (unsigned long long) value, Promoted( sizeof( T ) ) ); }
+
+            template<typename T>
+            typename std::enable_if<std::is_enum<T>::value>::type Put( T value ) { PutValue( eLogArg::Signed, (long long) value, Promoted( sizeof( T ) ) ); }
+
+            template<typename T>
+            typename std::enable_if<std::is_floating_point<T>::value>::type Put( T value ) { PutValue( eLogArg::Double, (double) value ); }
+
+            void Put( const char* value ) { PutString( eLogArg::String, value ? value : "(null)", value ? strlen( value ) : 6, 1 ); }
+            void Put( char* value ) { Put( (const char*) value ); }
+            void Put( const wchar_t* value ) { PutString( eLogArg::WideString, value ? value : L"(null)", value ? wcslen( value ) : 6, sizeof( wchar_t ) ); }
+            void Put( wchar_t* value ) { Put( (const wchar_t*) value ); }
+
+            template<typename T>
+            void Put( T* value ) { PutValue( eLogArg::Pointer, (const void*) value ); }
+
+        private:
+            /// <summary>Width of an integer after the default argument promotions, as printf would see it.</summary>
+            static constexpr size_t Promoted( size_t bytes ) { return bytes < sizeof( int ) ? sizeof( int ) : bytes; }
+
+            /// <summary>Stored as type, the byte width of the argument as passed, then value. Integers are
+            /// widened to 64 bits; the width lets %u/%x/%o print a negative int as the int it was.</summary>
+            template<typename T>
+            void PutValue( eLogArg type, T value, size_t width = sizeof( T ) )
+            {
+                if( !Reserve( 2 + sizeof( T ) ) )
+                {
+                    return;
+                }
+                mRecord.Args[mRecord.Used] = (unsigned char) type;
+                mRecord.Args[mRecord.Used + 1] = (unsigned char) width;
+                memcpy( mRecord.Args + mRecord.Used + 2, &value, sizeof( T ) );
+                mRecord.Used += (unsigned short) ( 2 + sizeof( T ) );
+                ++mRecord.ArgCount;
+            }
+
+            void PutString( eLogArg type, const void* chars, size_t length, size_t unit );
+            bool Reserve( size_t bytes );
+
+            sLogRecord& mRecord;
+        };
+
+        static sLogRecord* BeginRecord();
+        static void Publish();
+
+        template<typename Char, typename... Args>
+        static void Enqueue( Core::cDebugSystem::eDebugSystemName system, eLogLevel level, unsigned char flags, const Char* fmt, const char* filename, const Args&... args )
+        {
+            sLogRecord* record = BeginRecord();
+            if( record == nullptr )
+            {
+                return;
+            }
+            record->Format = fmt;
+            record->System = (unsigned char) system;
+            record->Level = (unsigned char) level;
+            record->Flags = flags;
+            record->ArgCount = 0;
+            record->Used = 0;
+
+            cArgWriter writer( *record );
+            if( flags & sLogRecord::kToFile )
+            {
+                writer.Put( filename );
+            }
+            int expand[] = { 0, ( writer.Put( args ), 0 )... };
+            (void) expand;
+            Publish();
+        }
+
+        static std::atomic<unsigned char> sLevels[Core::cDebugSystem::DebugSystemCount];
+    };
+}
+
+#if CAPTURE_ASYNC_LOG
+// Route the Core debug macros through the queue, whichever of this header and Core/DebugSystem.h came first.
+#undef OUTPUT
+#undef LOGOUTPUT
+#define OUTPUT(...)         ::Capture::cAsyncLog::Output( __VA_ARGS__ )
+#define LOGOUTPUT(x,y,...)  ::Capture::cAsyncLog::Log( x, y, __VA_ARGS__ )
+#endif
@@ -0,0 +1,100 @@
+//======================================================================================================
+// Microbenchmark: cost of a log call on the calling thread, queued versus formatted and written in place
+//======================================================================================================
+#include <cstdio>
+
+#include "asynclog.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    const char* kLogFile = "bench_asynclog.log";
+
+    // What a message costs when its system is switched off: the visibility and level check.
+    void BM_LogDisabled( Bench::cState& state )
+    {
+        const bool visible = Core::cDebugSystem::SystemVisibility[Core::cDebugSystem::Frame];
+        Core::cDebugSystem::SystemVisibility[Core::cDebugSystem::Frame] = false;
+        int frame = 0;
+        while( state.KeepRunning() )
+        {
+            OUTPUT( Core::cDebugSystem::Frame, "\rFrame #%d: %d Markers", frame++, 40 );
+        }
+        Core::cDebugSystem::SystemVisibility[Core::cDebugSystem::Frame] = visible;
+        state.SetLabel( "system not visible" );
+    }
+    BENCHMARK( BM_LogDisabled );
+
+    // Queued with the flusher running. The loop pauses for the flusher every half queue, so every call
+    // takes the enqueue path rather than the (cheaper) drop path.
+    void BM_LogQueued( Bench::cState& state )
+    {
+        Core::cDebugSystem::SystemVisibility[Core::cDebugSystem::Pipeline] = true;
+        cAsyncLog::Start();
+        const sAsyncLogStats before = cAsyncLog::Stats();
+
+        int frame = 0;
+        while( state.KeepRunning() )
+        {
+            LOGOUTPUT( Core::cDebugSystem::Pipeline, kLogFile, "frame %d: %d markers, %s at %.4f s", frame, 40, "finger_lift", frame / 180.0 );
+            if( ++frame % 512 == 0 )
+            {
+                state.PauseTiming();
+                cAsyncLog::Flush();
+                state.ResumeTiming();
+            }
+        }
+
+        cAsyncLog::Stop();
+        const sAsyncLogStats after = cAsyncLog::Stats();
+        if( after.Dropped != before.Dropped )
+        {
+            state.SkipWithError( "records dropped" );
+        }
+        state.SetLabel( "LOGOUTPUT, 4 arguments" );
+        remove( kLogFile );
+    }
+    BENCHMARK( BM_LogQueued );
+
+    // Full queue: the record is counted and dropped, which is what a stalled flusher costs the caller.
+    void BM_LogQueueFull( Bench::cState& state )
+    {
+        Core::cDebugSystem::SystemVisibility[Core::cDebugSystem::Pipeline] = true;
+        int frame = 0;
+        while( state.KeepRunning() )
+        {
+            LOGOUTPUT( Core::cDebugSystem::Pipeline, kLogFile, "frame %d: %d markers, %s at %.4f s", frame, 40, "finger_lift", frame / 180.0 );
+            ++frame;
+        }
+        cAsyncLog::Stop();
+        state.SetLabel( "flusher stopped" );
+        remove( kLogFile );
+    }
+    BENCHMARK( BM_LogQueueFull );
+
+    // The same line formatted and written on the calling thread.
+    void BM_LogInPlace( Bench::cState& state )
+    {
+        FILE* file = fopen( kLogFile, "w" );
+        if( !file )
+        {
+            state.SkipWithError( "cannot create the log file" );
+            return;
+        }
+        int frame = 0;
+        while( state.KeepRunning() )
+        {
+            fprintf( file, "frame %d: %d markers, %s at %.4f s\n", frame, 40, "finger_lift", frame / 180.0 );
+            ++frame;
+        }
+        fclose( file );
+        remove( kLogFile );
+        state.SetLabel( "fprintf" );
+    }
+    BENCHMARK( BM_LogInPlace );
+}
+
+BENCHMARK_MAIN()
@@ -0,0 +1,113 @@
+//======================================================================================================
+// Microbenchmark: per-index marker readout versus cFrameSnapshot
+//======================================================================================================
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "MotiveAPI.h"
+#include "framesnapshot.h"
+
+#include "benchharness.h"
+
+using namespace MotiveAPI;
+
+namespace
+{
+    /// <summary>Polling needs no callbacks, but the simulator only starts the take once a listener is attached.</summary>
+    class cIdleListener : public cAPIListener
+    {
+    public:
+        void FrameAvailable() override {}
+        void CameraConnected( int /*serialNumber*/ ) override {}
+        void CameraDisconnected( int /*serialNumber*/ ) override {}
+    };
+
+    // Both paths read the same (current) frame over and over, so the timings compare API call
+    // overhead rather than camera delivery.
+    bool EnsureFrame()
+    {
+        static bool sReady = false;
+        static bool sTried = false;
+
+        if( sTried )
+        {
+            return sReady;
+        }
+        sTried = true;
+
+        if( !IsInitialized() && Initialize() != kApiResult_Success )
+        {
+            return false;
+        }
+
+        static cIdleListener sListener;
+        AttachListener( &sListener );
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+        while( std::chrono::steady_clock::now() < deadline )
+        {
+            if( Update() == kApiResult_Success && MarkerCount() > 0 )
+            {
+                sReady = true;
+                break;
+            }
+            std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+        }
+        return sReady;
+    }
+
+    // The path markers.cpp used before the snapshot: four exported calls per marker.
+    void BM_PerIndexMarkers( Bench::cState& state )
+    {
+        if( !EnsureFrame() )
+        {
+            state.SkipWithError( "no frame with markers available" );
+            return;
+        }
+
+        const int count = MarkerCount();
+        std::vector<float> x( count ), y( count ), z( count ), residual( count );
+        std::vector<unsigned long long> idHigh( count ), idLow( count );
+        std::vector<int> rays( count );
+
+        while( state.KeepRunning() )
+        {
+            const int n = MarkerCount();
+            for( int i = 0; i < n; ++i )
+            {
+                MarkerXYZ( i, x[i], y[i], z[i] );
+                Core::cUID id = MarkerID( i );
+                idHigh[i] = id.HighBits();
+                idLow[i] = id.LowBits();
+                residual[i] = MarkerResidual( i );
+                rays[i] = MarkerContributingRaysCount( i );
+            }
+            Bench::DoNotOptimize( x[0] );
+        }
+        state.SetItemsPerIteration( count );
+    }
+    BENCHMARK( BM_PerIndexMarkers );
+
+    void BM_FrameSnapshot( Bench::cState& state )
+    {
+        if( !EnsureFrame() )
+        {
+            state.SkipWithError( "no frame with markers available" );
+            return;
+        }
+
+        Capture::cFrameSnapshot snapshot;
+        snapshot.SetCaptureRays( state.Range() != 0 );
+
+        while( state.KeepRunning() )
+        {
+            Bench::DoNotOptimize( snapshot.Capture() );
+        }
+        state.SetItemsPerIteration( snapshot.Size() );
+        state.SetLabel( state.Range() ? "with rays" : "" );
+    }
+    BENCHMARK( BM_FrameSnapshot )->Arg( 0 )->Arg( 1 );
+}
+
+BENCHMARK_MAIN()
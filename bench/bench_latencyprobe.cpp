@@ -0,0 +1,74 @@
+//======================================================================================================
+// Microbenchmark: cost of one latency probe, against reading the host clock alone
+//======================================================================================================
+#include "hostclock.h"
+#include "latencyprobe.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    // The floor: every timed probe reads the clock at least once.
+    void BM_HostTimeNs( Bench::cState& state )
+    {
+        while( state.KeepRunning() )
+        {
+            Bench::DoNotOptimize( HostTimeNs() );
+        }
+        state.SetLabel( "steady_clock::now()" );
+    }
+    BENCHMARK( BM_HostTimeNs );
+
+    // Values spread over a few hundred buckets, like real stage times, so the writes do not all hit one line.
+    void BM_HistogramRecord( Bench::cState& state )
+    {
+        static cLatencyHistogram sHistogram;
+        long long ns = 1000;
+        while( state.KeepRunning() )
+        {
+            sHistogram.Record( ns );
+            ns = ( ns * 1103515245 + 12345 ) & 0xfffff;
+        }
+        Bench::DoNotOptimize( sHistogram.Count() );
+        state.SetLabel( "bucket update only" );
+    }
+    BENCHMARK( BM_HistogramRecord );
+
+    void BM_RecordLatency( Bench::cState& state )
+    {
+        long long ns = 1000;
+        while( state.KeepRunning() )
+        {
+            LATENCY_VALUE( Filter, ns );
+            ns = ( ns * 1103515245 + 12345 ) & 0xfffff;
+        }
+        state.SetLabel( "LATENCY_VALUE: thread lookup and bucket update" );
+    }
+    BENCHMARK( BM_RecordLatency );
+
+    void BM_LatencySince( Bench::cState& state )
+    {
+        const long long start = HostTimeNs();
+        while( state.KeepRunning() )
+        {
+            LATENCY_SINCE( Decision, start );
+        }
+        Bench::DoNotOptimize( start );
+        state.SetLabel( "LATENCY_SINCE: one clock read" );
+    }
+    BENCHMARK( BM_LatencySince );
+
+    void BM_LatencyScope( Bench::cState& state )
+    {
+        while( state.KeepRunning() )
+        {
+            LATENCY_SCOPE( Filter );
+        }
+        state.SetLabel( "LATENCY_SCOPE: two clock reads" );
+    }
+    BENCHMARK( BM_LatencyScope );
+}
+
+BENCHMARK_MAIN()
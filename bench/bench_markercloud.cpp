@@ -0,0 +1,132 @@
+//======================================================================================================
+// Benchmark: pipeline stages against marker count and frame rate, on synthetic marker clouds
+//======================================================================================================
+#include <memory>
+#include <vector>
+
+#include "captureengine.h"
+#include "markercloud.h"
+#include "markerfilter.h"
+#include "markerwire.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    /// <summary>One second of frames from a two-hand cloud, generated before timing and replayed in a loop.</summary>
+    struct sCloudFrames
+    {
+        int Count;
+        std::unique_ptr<sFrameRecord[]> Frames;
+        std::vector<std::vector<Core::cMarker>> Markers;
+
+        sCloudFrames( int markers, double frameRate ) : Count( (int) frameRate ), Frames( new sFrameRecord[(int) frameRate]() )
+        {
+            sMarkerCloudConfig config;
+            config.Markers = markers;
+            config.Bodies = 2;
+            config.FrameRate = frameRate;
+
+            cMarkerCloud cloud( config );
+            for( int f = 0; f < Count; ++f )
+            {
+                cloud.Next( Frames[f] );
+            }
+            cloud.Reset();
+            Markers.resize( Count );
+            for( int f = 0; f < Count; ++f )
+            {
+                cloud.Next( Markers[f] );
+            }
+        }
+    };
+
+    std::string RateLabel( double frameRate )
+    {
+        return std::to_string( (int) frameRate ) + " Hz";
+    }
+
+    void RunGenerate( Bench::cState& state, double frameRate )
+    {
+        sMarkerCloudConfig config;
+        config.Markers = (int) state.Range();
+        config.Bodies = 2;
+        config.FrameRate = frameRate;
+        cMarkerCloud cloud( config );
+
+        std::unique_ptr<sFrameRecord> frame( new sFrameRecord() );
+        while( state.KeepRunning() )
+        {
+            cloud.Next( *frame );
+            Bench::DoNotOptimize( frame->X[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+        state.SetLabel( RateLabel( frameRate ) );
+    }
+
+    // The consumer hand-off: what every SPSC ring push copies.
+    void RunRecordCopy( Bench::cState& state, double frameRate )
+    {
+        const sCloudFrames frames( (int) state.Range(), frameRate );
+        std::unique_ptr<sFrameRecord> out( new sFrameRecord() );
+        int f = 0;
+        while( state.KeepRunning() )
+        {
+            out->CopyFrom( frames.Frames[f] );
+            Bench::DoNotOptimize( out->X[0] );
+            f = ( f + 1 ) % frames.Count;
+        }
+        state.SetItemsPerIteration( state.Range() );
+        state.SetLabel( RateLabel( frameRate ) );
+    }
+
+    void RunFilterBank( Bench::cState& state, double frameRate )
+    {
+        const sCloudFrames frames( (int) state.Range(), frameRate );
+        sMarkerFilterConfig config;
+        config.SampleRate = frameRate;
+        config.MaxMarkers = kMaxFrameMarkers * 4;     // Room for the unlabeled IDs that come and go
+        cMarkerFilterBank bank( config );
+
+        std::unique_ptr<sFrameRecord> out( new sFrameRecord() );
+        int f = 0;
+        while( state.KeepRunning() )
+        {
+            bank.Process( frames.Frames[f], out->X, out->Y, out->Z );
+            Bench::DoNotOptimize( out->X[0] );
+            f = ( f + 1 ) % frames.Count;
+        }
+        state.SetItemsPerIteration( state.Range() );
+        state.SetLabel( RateLabel( frameRate ) );
+    }
+
+    void RunMarkerWire( Bench::cState& state, double frameRate )
+    {
+        const sCloudFrames frames( (int) state.Range(), frameRate );
+        std::vector<unsigned char> buffer( MarkerWireBytes<float>( (size_t) state.Range() ) );
+        int f = 0;
+        while( state.KeepRunning() )
+        {
+            const std::vector<Core::cMarker>& markers = frames.Markers[f];
+            Bench::DoNotOptimize( WriteMarkers( markers.data(), markers.size(), buffer.data(), buffer.size() ) );
+            f = ( f + 1 ) % frames.Count;
+        }
+        state.SetItemsPerIteration( state.Range() );
+        state.SetLabel( RateLabel( frameRate ) );
+    }
+
+    void BM_CloudGenerate240( Bench::cState& state ) { RunGenerate( state, 240.0 ); }
+    BENCHMARK( BM_CloudGenerate240 )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+    void BM_CloudRecordCopy240( Bench::cState& state ) { RunRecordCopy( state, 240.0 ); }
+    BENCHMARK( BM_CloudRecordCopy240 )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+    void BM_CloudFilterBank240( Bench::cState& state ) { RunFilterBank( state, 240.0 ); }
+    BENCHMARK( BM_CloudFilterBank240 )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+    void BM_CloudFilterBank360( Bench::cState& state ) { RunFilterBank( state, 360.0 ); }
+    BENCHMARK( BM_CloudFilterBank360 )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+    void BM_CloudMarkerWire240( Bench::cState& state ) { RunMarkerWire( state, 240.0 ); }
+    BENCHMARK( BM_CloudMarkerWire240 )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+}
+
+BENCHMARK_MAIN()
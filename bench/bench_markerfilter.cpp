@@ -0,0 +1,122 @@
+//======================================================================================================
+// Microbenchmark: cMarkerFilterBank per marker per frame, against one cBiquad set per marker in a map
+//======================================================================================================
+#include <cmath>
+#include <memory>
+#include <unordered_map>
+
+#include "Core/UID.h"
+#include "captureengine.h"
+#include "causalfilter.h"
+#include "markerfilter.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    /// <summary>A run of labeled frames at 180 Hz: markers wander and jitter by a millimeter, and every
+    /// 64 frames two markers swap places, so the bank leaves its unchanged-order fast path now and then.</summary>
+    struct sFrames
+    {
+        static const int kFrames = 64;
+        std::unique_ptr<sFrameRecord[]> Frames;
+
+        explicit sFrames( int markers ) : Frames( new sFrameRecord[kFrames]() )
+        {
+            for( int f = 0; f < kFrames; ++f )
+            {
+                sFrameRecord& frame = Frames[f];
+                frame.FrameID = f;
+                frame.TimeStamp = f / 180.0;
+                frame.MarkerCount = markers;
+                for( int i = 0; i < markers; ++i )
+                {
+                    const int id = ( f == 5 && i < 2 ) ? 1 - i : i;
+                    frame.IDHigh[i] = 0x5eed;
+                    frame.IDLow[i] = (unsigned long long) id;
+                    frame.X[i] = 0.01f * id + 0.2f * std::sin( 0.03f * f + id ) + 0.001f * std::sin( 7.1f * f * ( id + 1 ) );
+                    frame.Y[i] = 1.0f + 0.001f * std::cos( 5.3f * f + id );
+                    frame.Z[i] = 0.1f * std::cos( 0.02f * f ) + 0.001f * std::sin( 3.7f * f - id );
+                }
+            }
+        }
+    };
+
+    void RunBank( Bench::cState& state, eMarkerFilter type, int order, const char* label )
+    {
+        const sFrames frames( (int) state.Range() );
+        sMarkerFilterConfig config;
+        config.Type = type;
+        config.Order = order;
+        cMarkerFilterBank bank( config );
+
+        std::unique_ptr<sFrameRecord> out( new sFrameRecord() );
+        int f = 0;
+        while( state.KeepRunning() )
+        {
+            bank.Process( frames.Frames[f], out->X, out->Y, out->Z );
+            Bench::DoNotOptimize( out->X[0] );
+            f = ( f + 1 ) % sFrames::kFrames;
+        }
+
+        if( bank.Untracked() != 0 )
+        {
+            state.SkipWithError( "markers passed through unfiltered" );
+        }
+        state.SetItemsPerIteration( state.Range() );
+        state.SetLabel( label );
+    }
+
+    void BM_FilterBankButterworth2( Bench::cState& state ) { RunBank( state, eMarkerFilter::Butterworth, 2, "Butterworth 2nd order" ); }
+    BENCHMARK( BM_FilterBankButterworth2 )->Arg( 8 )->Arg( 40 )->Arg( 200 );
+    void BM_FilterBankButterworth4( Bench::cState& state ) { RunBank( state, eMarkerFilter::Butterworth, 4, "Butterworth 4th order" ); }
+    BENCHMARK( BM_FilterBankButterworth4 )->Arg( 8 )->Arg( 40 )->Arg( 200 );
+    void BM_FilterBankCriticallyDamped( Bench::cState& state ) { RunBank( state, eMarkerFilter::CriticallyDamped, 2, "critically damped" ); }
+    BENCHMARK( BM_FilterBankCriticallyDamped )->Arg( 8 )->Arg( 40 )->Arg( 200 );
+    void BM_FilterBankOneEuro( Bench::cState& state ) { RunBank( state, eMarkerFilter::OneEuro, 2, "one-euro" ); }
+    BENCHMARK( BM_FilterBankOneEuro )->Arg( 8 )->Arg( 40 )->Arg( 200 );
+
+    // The straightforward alternative: three cBiquad objects per marker, found by cUID in a hash map.
+    void BM_BiquadMap( Bench::cState& state )
+    {
+        const sFrames frames( (int) state.Range() );
+        const sBiquadCoefficients lowPass = ButterworthLowPass( 10.0, 180.0 );
+        std::unordered_map<Core::cUID, cBiquad[3]> filters;
+
+        std::unique_ptr<sFrameRecord> out( new sFrameRecord() );
+        int f = 0;
+        while( state.KeepRunning() )
+        {
+            const sFrameRecord& frame = frames.Frames[f];
+            for( int i = 0; i < frame.MarkerCount; ++i )
+            {
+                const Core::cUID id( frame.IDHigh[i], frame.IDLow[i] );
+                auto found = filters.find( id );
+                if( found == filters.end() )
+                {
+                    found = filters.try_emplace( id ).first;
+                    for( cBiquad& filter : found->second )
+                    {
+                        filter.SetCoefficients( lowPass );
+                    }
+                    out->X[i] = (float) found->second[0].Prime( frame.X[i] );
+                    out->Y[i] = (float) found->second[1].Prime( frame.Y[i] );
+                    out->Z[i] = (float) found->second[2].Prime( frame.Z[i] );
+                    continue;
+                }
+                out->X[i] = (float) found->second[0].Process( frame.X[i] );
+                out->Y[i] = (float) found->second[1].Process( frame.Y[i] );
+                out->Z[i] = (float) found->second[2].Process( frame.Z[i] );
+            }
+            Bench::DoNotOptimize( out->X[0] );
+            f = ( f + 1 ) % sFrames::kFrames;
+        }
+        state.SetItemsPerIteration( state.Range() );
+        state.SetLabel( "Butterworth 2nd order" );
+    }
+    BENCHMARK( BM_BiquadMap )->Arg( 8 )->Arg( 40 )->Arg( 200 );
+}
+
+BENCHMARK_MAIN()
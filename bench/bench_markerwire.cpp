@@ -0,0 +1,230 @@
+//======================================================================================================
+// Microbenchmark: cTMarker stream operators versus the packed marker wire layout
+//======================================================================================================
+#include <cstring>
+#include <ostream>
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+#include "markerwire.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    /// <summary>Fixed memory stream buffer, rewound every iteration so the stream never reallocates.</summary>
+    class cMemoryStreamBuf : public std::streambuf
+    {
+    public:
+        explicit cMemoryStreamBuf( size_t bytes ) : mData( bytes ) { Rewind(); }
+
+        void Rewind()
+        {
+            setp( mData.data(), mData.data() + mData.size() );
+            setg( mData.data(), mData.data(), mData.data() + mData.size() );
+        }
+
+    private:
+        std::vector<char> mData;
+    };
+
+    std::vector<Core::cMarker> MakeFrame( int count )
+    {
+        std::vector<Core::cMarker> markers( count );
+        for( int i = 0; i < count; ++i )
+        {
+            Core::cMarker& marker = markers[i];
+            marker.SetPosition( 0.1f * i, 1.0f + 0.01f * i, -0.5f * i );
+            marker.ID = Core::cUID( 0x1000 + i, 0xABCDEF00ull + i );
+            marker.Label = Core::cLabel( Core::cUID( 7, 9 ), i + 1 );
+            marker.Size = 0.014f;
+            marker.Residual = 0.2f + 0.001f * i;
+            marker.Flags = (unsigned short) ( i & 0x3FF );
+            marker.Synthetic = ( i % 7 == 0 );
+        }
+        return markers;
+    }
+
+    // The write sequence of Core's operator<< for cTMarker, which is compiled out under
+    // __PLATFORM__LINUX__; on Windows the benchmark calls the operator itself.
+    void StreamOut( std::ostream& os, const Core::cMarker& v )
+    {
+#if !defined(__PLATFORM__LINUX__)
+        os << v;
+#else
+        Core::cUID::uint64 highBits = v.ID.HighBits();
+        Core::cUID::uint64 lowBits = v.ID.LowBits();
+        Core::cUID::uint64 labelHigh = v.Label.EntityID().HighBits();
+        Core::cUID::uint64 labelLow = v.Label.EntityID().LowBits();
+        unsigned int memberId = v.Label.MemberID();
+
+        os.write( (char*) &v.X, sizeof( float ) );
+        os.write( (char*) &v.Y, sizeof( float ) );
+        os.write( (char*) &v.Z, sizeof( float ) );
+        os.write( (char*) &highBits, sizeof( highBits ) );
+        os.write( (char*) &lowBits, sizeof( lowBits ) );
+        os.write( (char*) &v.ActiveID, sizeof( unsigned int ) );
+        os.write( (char*) &v.Size, sizeof( float ) );
+        os.write( (char*) &labelHigh, sizeof( labelHigh ) );
+        os.write( (char*) &labelLow, sizeof( labelLow ) );
+        os.write( (char*) &memberId, sizeof( memberId ) );
+        os.write( (char*) &v.Selected, sizeof( bool ) );
+        os.write( (char*) &v.Residual, sizeof( float ) );
+        os.write( (char*) &v.Synthetic, sizeof( bool ) );
+        os.write( (char*) &v.Flags, sizeof( short ) );
+#endif
+    }
+
+    void StreamIn( std::istream& is, Core::cMarker& v )
+    {
+#if !defined(__PLATFORM__LINUX__)
+        is >> v;
+#else
+        Core::cUID::uint64 highBits, lowBits, labelHigh, labelLow;
+        unsigned int memberId;
+
+        is.read( (char*) &v.X, sizeof( float ) );
+        is.read( (char*) &v.Y, sizeof( float ) );
+        is.read( (char*) &v.Z, sizeof( float ) );
+        is.read( (char*) &highBits, sizeof( highBits ) );
+        is.read( (char*) &lowBits, sizeof( lowBits ) );
+        is.read( (char*) &v.ActiveID, sizeof( unsigned int ) );
+        is.read( (char*) &v.Size, sizeof( float ) );
+        is.read( (char*) &labelHigh, sizeof( labelHigh ) );
+        is.read( (char*) &labelLow, sizeof( labelLow ) );
+        is.read( (char*) &memberId, sizeof( memberId ) );
+        is.read( (char*) &v.Selected, sizeof( bool ) );
+        is.read( (char*) &v.Residual, sizeof( float ) );
+        is.read( (char*) &v.Synthetic, sizeof( bool ) );
+        is.read( (char*) &v.Flags, sizeof( short ) );
+
+        v.ID = Core::cUID( highBits, lowBits );
+        v.Label = Core::cLabel( Core::cUID( labelHigh, labelLow ), memberId );
+#endif
+    }
+
+    bool SameMarkers( const std::vector<Core::cMarker>& a, const std::vector<Core::cMarker>& b )
+    {
+        if( a.size() != b.size() )
+        {
+            return false;
+        }
+        for( size_t i = 0; i < a.size(); ++i )
+        {
+            if( a[i].ID != b[i].ID || a[i].Label != b[i].Label || a[i].X != b[i].X || a[i].Y != b[i].Y
+                || a[i].Z != b[i].Z || a[i].Size != b[i].Size || a[i].Residual != b[i].Residual
+                || a[i].ActiveID != b[i].ActiveID || a[i].Flags != b[i].Flags
+                || a[i].Selected != b[i].Selected || a[i].Synthetic != b[i].Synthetic )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void BM_StreamOperatorWrite( Bench::cState& state )
+    {
+        const std::vector<Core::cMarker> frame = MakeFrame( (int) state.Range() );
+        cMemoryStreamBuf buffer( frame.size() * 128 );
+        std::ostream os( &buffer );
+
+        while( state.KeepRunning() )
+        {
+            buffer.Rewind();
+            for( const Core::cMarker& marker : frame )
+            {
+                StreamOut( os, marker );
+            }
+            Bench::DoNotOptimize( os.good() );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_StreamOperatorWrite )->Arg( 16 )->Arg( 256 );
+
+    void BM_StreamOperatorRead( Bench::cState& state )
+    {
+        const std::vector<Core::cMarker> frame = MakeFrame( (int) state.Range() );
+        cMemoryStreamBuf buffer( frame.size() * 128 );
+        std::ostream os( &buffer );
+        std::istream is( &buffer );
+        for( const Core::cMarker& marker : frame )
+        {
+            StreamOut( os, marker );
+        }
+
+        std::vector<Core::cMarker> markers( frame.size() );
+        while( state.KeepRunning() )
+        {
+            buffer.Rewind();
+            for( Core::cMarker& marker : markers )
+            {
+                StreamIn( is, marker );
+            }
+            Bench::DoNotOptimize( markers[0].X );
+        }
+        if( !SameMarkers( frame, markers ) )
+        {
+            state.SkipWithError( "stream round trip mismatch" );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_StreamOperatorRead )->Arg( 16 )->Arg( 256 );
+
+    void BM_WriteMarkers( Bench::cState& state )
+    {
+        const std::vector<Core::cMarker> frame = MakeFrame( (int) state.Range() );
+        std::vector<unsigned char> buffer( MarkerWireBytes<float>( frame.size() ) );
+
+        while( state.KeepRunning() )
+        {
+            Bench::DoNotOptimize( WriteMarkers( frame.data(), frame.size(), buffer.data(), buffer.size() ) );
+        }
+        state.SetItemsPerIteration( state.Range() );
+        state.SetLabel( Detail::MarkerMatchesWire<float>() ? "memcpy" : "packed" );
+    }
+    BENCHMARK( BM_WriteMarkers )->Arg( 16 )->Arg( 256 );
+
+    void BM_ReadMarkers( Bench::cState& state )
+    {
+        const std::vector<Core::cMarker> frame = MakeFrame( (int) state.Range() );
+        std::vector<unsigned char> buffer( MarkerWireBytes<float>( frame.size() ) );
+        WriteMarkers( frame.data(), frame.size(), buffer.data(), buffer.size() );
+
+        std::vector<Core::cMarker> markers( frame.size() );
+        size_t count = 0;
+        while( state.KeepRunning() )
+        {
+            ReadMarkers( buffer.data(), buffer.size(), markers.data(), markers.size(), count );
+            Bench::DoNotOptimize( markers[0].X );
+        }
+        if( count != frame.size() || !SameMarkers( frame, markers ) )
+        {
+            state.SkipWithError( "wire round trip mismatch" );
+        }
+        state.SetItemsPerIteration( state.Range() );
+        state.SetLabel( Detail::MarkerMatchesWire<float>() ? "memcpy" : "packed" );
+    }
+    BENCHMARK( BM_ReadMarkers )->Arg( 16 )->Arg( 256 );
+
+    // One ostream::write per frame through the stream overload, for code that already holds a stream.
+    void BM_WriteMarkersStream( Bench::cState& state )
+    {
+        const std::vector<Core::cMarker> frame = MakeFrame( (int) state.Range() );
+        cMemoryStreamBuf buffer( MarkerWireBytes<float>( frame.size() ) );
+        std::ostream os( &buffer );
+        std::vector<unsigned char> scratch;
+
+        while( state.KeepRunning() )
+        {
+            buffer.Rewind();
+            Bench::DoNotOptimize( WriteMarkers( os, frame.data(), frame.size(), scratch ) );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_WriteMarkersStream )->Arg( 16 )->Arg( 256 );
+}
+
+BENCHMARK_MAIN()
@@ -0,0 +1,235 @@
+//======================================================================================================
+// Microbenchmark: cMatrix4 products and inverses, by value versus the in-place kernels
+//======================================================================================================
+#include <cmath>
+#include <vector>
+
+#include "Core/Vector3.h"
+#include "Core/Quaternion.h"
+#include "Core/Matrix4.h"
+
+#include "benchharness.h"
+
+namespace
+{
+    using cMat = Core::cMatrix4f;
+
+    // Rigid-body poses, as RigidBodyTransform() produces them, and the same poses with a scale folded in.
+    struct sPoses
+    {
+        std::vector<cMat> Rigid, Scaled;
+
+        explicit sPoses( size_t count )
+        {
+            Rigid.reserve( count );
+            Scaled.reserve( count );
+            for( size_t i = 0; i < count; ++i )
+            {
+                Core::cQuaternion<float, true> q( std::sin( 0.1f * i ), std::cos( 0.37f * i ), 0.5f, 1.0f );
+                const Core::cVector3f t( 0.01f * ( i % 97 ), 1.2f, -0.003f * ( i % 31 ) );
+                Rigid.emplace_back( q, t );
+
+                cMat scaled;
+                scaled.ScaleRotateTranslate( Core::cVector3f( 1.0f + 0.001f * i, 0.9f, 1.1f ), q, t );
+                Scaled.push_back( scaled );
+            }
+        }
+    };
+
+    // SetToProduct(), SetToInverse() and operator* as they were before the in-place kernels: operands
+    // passed by value and the product built in a copy of the left-hand side.
+    void LegacySetToProduct( cMat& out, const cMat m1, const cMat m2 )
+    {
+        const float *v1 = m1.Data(), *v2 = m2.Data();
+        float v[16];
+        for( int row = 0; row < 4; row++ )
+        {
+            for( int col = 0; col < 4; col++ )
+            {
+                v[row * 4 + col] = v1[row * 4] * v2[col] + v1[row * 4 + 1] * v2[col + 4] + v1[row * 4 + 2] * v2[col + 8] + v1[row * 4 + 3] * v2[col + 12];
+            }
+        }
+        out.SetValues( v );
+    }
+
+    cMat LegacyProduct( const cMat& lhs, const cMat& rhs )
+    {
+        cMat result( lhs );
+        LegacySetToProduct( result, result, rhs );
+        return result;
+    }
+
+    void LegacySetToInverse( cMat& out, const cMat m )
+    {
+        const float d = 1 / m.Determinant();
+
+        out.SetValue( 0, 0, ( m.Value( 1, 1 ) * m.Value( 2, 2 ) - m.Value( 1, 2 ) * m.Value( 2, 1 ) ) * d );
+        out.SetValue( 0, 1, ( m.Value( 0, 2 ) * m.Value( 2, 1 ) - m.Value( 0, 1 ) * m.Value( 2, 2 ) ) * d );
+        out.SetValue( 0, 2, ( m.Value( 0, 1 ) * m.Value( 1, 2 ) - m.Value( 0, 2 ) * m.Value( 1, 1 ) ) * d );
+        out.SetValue( 0, 3, 0 );
+        out.SetValue( 1, 0, ( m.Value( 1, 2 ) * m.Value( 2, 0 ) - m.Value( 1, 0 ) * m.Value( 2, 2 ) ) * d );
+        out.SetValue( 1, 1, ( m.Value( 0, 0 ) * m.Value( 2, 2 ) - m.Value( 0, 2 ) * m.Value( 2, 0 ) ) * d );
+        out.SetValue( 1, 2, ( m.Value( 0, 2 ) * m.Value( 1, 0 ) - m.Value( 0, 0 ) * m.Value( 1, 2 ) ) * d );
+        out.SetValue( 1, 3, 0 );
+        out.SetValue( 2, 0, ( m.Value( 1, 0 ) * m.Value( 2, 1 ) - m.Value( 1, 1 ) * m.Value( 2, 0 ) ) * d );
+        out.SetValue( 2, 1, ( m.Value( 0, 1 ) * m.Value( 2, 0 ) - m.Value( 0, 0 ) * m.Value( 2, 1 ) ) * d );
+        out.SetValue( 2, 2, ( m.Value( 0, 0 ) * m.Value( 1, 1 ) - m.Value( 0, 1 ) * m.Value( 1, 0 ) ) * d );
+        out.SetValue( 2, 3, 0 );
+        for( int col = 0; col < 3; ++col )
+        {
+            out.SetValue( 3, col, -( m.Value( 3, 0 ) * out.Value( 0, col ) + m.Value( 3, 1 ) * out.Value( 1, col ) + m.Value( 3, 2 ) * out.Value( 2, col ) ) );
+        }
+        out.SetValue( 3, 3, 1 );
+    }
+
+    bool Matches( const cMat& a, const cMat& b, float tolerance )
+    {
+        for( int i = 0; i < 16; ++i )
+        {
+            if( std::fabs( a.Data()[i] - b.Data()[i] ) > tolerance )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //==================================================================================================
+    // Products: each scaled pose composed with a rigid one
+    //==================================================================================================
+
+    void BM_ProductLegacy( Bench::cState& state )
+    {
+        const sPoses poses( (size_t) state.Range() );
+        float sum = 0;
+
+        while( state.KeepRunning() )
+        {
+            for( size_t i = 0; i < poses.Rigid.size(); ++i )
+            {
+                const cMat product = LegacyProduct( poses.Scaled[i], poses.Rigid[i] );
+                sum += product.Value( 3, 0 );
+            }
+            Bench::DoNotOptimize( sum );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_ProductLegacy )->Arg( 1024 );
+
+    void BM_ProductOperator( Bench::cState& state )
+    {
+        const sPoses poses( (size_t) state.Range() );
+        float sum = 0;
+
+        while( state.KeepRunning() )
+        {
+            for( size_t i = 0; i < poses.Rigid.size(); ++i )
+            {
+                const cMat product = poses.Scaled[i] * poses.Rigid[i];
+                sum += product.Value( 3, 0 );
+            }
+            Bench::DoNotOptimize( sum );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_ProductOperator )->Arg( 1024 );
+
+    void BM_ProductInPlace( Bench::cState& state )
+    {
+        const sPoses poses( (size_t) state.Range() );
+        cMat product;
+        float sum = 0;
+
+        while( state.KeepRunning() )
+        {
+            for( size_t i = 0; i < poses.Rigid.size(); ++i )
+            {
+                product.SetToProduct( poses.Scaled[i], poses.Rigid[i] );
+                sum += product.Value( 3, 0 );
+            }
+            Bench::DoNotOptimize( sum );
+        }
+
+        if( !Matches( product, LegacyProduct( poses.Scaled.back(), poses.Rigid.back() ), 0 ) )
+        {
+            state.SkipWithError( "in-place product differs from the legacy product" );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_ProductInPlace )->Arg( 1024 );
+
+    //==================================================================================================
+    // Inverses
+    //==================================================================================================
+
+    void BM_InverseLegacy( Bench::cState& state )
+    {
+        const sPoses poses( (size_t) state.Range() );
+        cMat inverse;
+        float sum = 0;
+
+        while( state.KeepRunning() )
+        {
+            for( const cMat& pose : poses.Scaled )
+            {
+                LegacySetToInverse( inverse, pose );
+                sum += inverse.Value( 3, 0 );
+            }
+            Bench::DoNotOptimize( sum );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_InverseLegacy )->Arg( 1024 );
+
+    void BM_InverseInPlace( Bench::cState& state )
+    {
+        const sPoses poses( (size_t) state.Range() );
+        cMat inverse, expected;
+        float sum = 0;
+
+        while( state.KeepRunning() )
+        {
+            for( const cMat& pose : poses.Scaled )
+            {
+                inverse.SetToInverse( pose );
+                sum += inverse.Value( 3, 0 );
+            }
+            Bench::DoNotOptimize( sum );
+        }
+
+        LegacySetToInverse( expected, poses.Scaled.back() );
+        if( !Matches( inverse, expected, 1e-5f ) )
+        {
+            state.SkipWithError( "in-place inverse differs from the legacy inverse" );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_InverseInPlace )->Arg( 1024 );
+
+    void BM_RigidInverse( Bench::cState& state )
+    {
+        const sPoses poses( (size_t) state.Range() );
+        cMat inverse, expected;
+        float sum = 0;
+
+        while( state.KeepRunning() )
+        {
+            for( const cMat& pose : poses.Rigid )
+            {
+                inverse.SetToRigidInverse( pose );
+                sum += inverse.Value( 3, 0 );
+            }
+            Bench::DoNotOptimize( sum );
+        }
+
+        LegacySetToInverse( expected, poses.Rigid.back() );
+        if( !Matches( inverse, expected, 1e-5f ) )
+        {
+            state.SkipWithError( "rigid inverse differs from the general inverse" );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_RigidInverse )->Arg( 1024 );
+}
+
+BENCHMARK_MAIN()
@@ -0,0 +1,278 @@
+//======================================================================================================
+// Benchmark: the capture-to-decision path, inline and through the capture engine, on simulated inputs
+//======================================================================================================
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MotiveAPI.h"
+#include "captureengine.h"
+#include "gogglestrigger.h"
+#include "graspkinematics.h"
+#include "markercloud.h"
+#include "markerfilter.h"
+#include "recording.h"
+#include "sim/labjacksim.h"
+#include "sim/motivesim.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    const double kFrameRate = 240.0;
+    const int kLoopFrames = 1200;       // Five seconds of cloud, replayed in a loop
+
+    sMarkerCloudConfig CloudConfig( int markers )
+    {
+        sMarkerCloudConfig config;
+        config.Markers = markers;
+        config.Bodies = 2;
+        config.FrameRate = kFrameRate;
+        config.UnlabeledFraction = 0;   // Every marker keeps one ID, so a recording can hold the whole take
+        return config;
+    }
+
+    /// <summary>
+    /// Thumb, index and wrist: the first three markers of the first body. The wrist's speed drives the
+    /// goggles, as in markers.cpp when a wrist marker is given.
+    /// </summary>
+    sGraspMarkers FirstHand( int markers )
+    {
+        cMarkerCloud cloud( CloudConfig( markers ) );
+        std::vector<Core::cMarker> frame;
+        cloud.Next( frame );
+
+        std::vector<Core::cUID> hand;
+        for( const Core::cMarker& marker : frame )
+        {
+            if( hand.size() < 3 && ( hand.empty() || marker.ID.HighBits() == hand[0].HighBits() ) )
+            {
+                hand.push_back( marker.ID );
+            }
+        }
+        hand.resize( 3 );
+        return sGraspMarkers{ hand[0], hand[1], hand[2] };
+    }
+
+    /// <summary>The emulated U3 with an instant bus, so a goggles switch costs the driver path only.</summary>
+    LJ_HANDLE OpenInstantLabJack()
+    {
+        sLabJackSimConfig sim;
+        sim.CommandLatencyUs = 0;
+        sim.CommandJitterUs = 0;
+        ConfigureLabJackSim( sim );
+
+        LJ_HANDLE handle = 0;
+        return ( OpenLabJack( LJ_dtU3, LJ_ctUSB, "1", 1, &handle ) == LJE_NOERROR ? handle : 0 );
+    }
+
+    /// <summary>What markers.cpp's TrialLogic() runs on each frame: filter bank, goggles trigger, grasp kinematics.</summary>
+    class cDecisionPath
+    {
+    public:
+        cDecisionPath( LJ_HANDLE handle, const sGraspMarkers& hand )
+            : mFilters( FilterConfig() ), mTrigger( handle, TriggerConfig( hand ) ), mGrasp( hand, GraspConfig() ), mFiltered( new sFrameRecord() )
+        {
+        }
+
+        void Process( const sFrameRecord& frame )
+        {
+            mFilters.Process( frame, mFiltered->X, mFiltered->Y, mFiltered->Z );
+            if( !mTrigger.Armed() )
+            {
+                mTrigger.Arm();     // A new trial as soon as the last one ended
+            }
+            mTrigger.ProcessFrame( frame, mFilters, [this]( const sTriggerRecord& ) { ++mSwitches; } );
+            mGrasp.Process( frame, nullptr, [this]( const sPeakAperture& ) { ++mPeaks; } );
+        }
+
+        unsigned long long Switches() const { return mSwitches; }
+        unsigned long long Peaks() const { return mPeaks; }
+
+    private:
+        static sMarkerFilterConfig FilterConfig()
+        {
+            sMarkerFilterConfig config;
+            config.Type = eMarkerFilter::CriticallyDamped;
+            config.SampleRate = kFrameRate;
+            config.MaxMarkers = kMaxFrameMarkers;
+            return config;
+        }
+
+        static sGogglesTriggerConfig TriggerConfig( const sGraspMarkers& hand )
+        {
+            sGogglesTriggerConfig config;
+            config.Marker = hand.Wrist;
+            config.OffsetState = eGogglesState::Transparent;
+            return config;
+        }
+
+        static sGraspKinematicsConfig GraspConfig()
+        {
+            sGraspKinematicsConfig config;
+            config.FrameRate = kFrameRate;
+            return config;
+        }
+
+        cMarkerFilterBank mFilters;
+        cGogglesTrigger mTrigger;
+        cGraspKinematics mGrasp;
+        std::unique_ptr<sFrameRecord> mFiltered;
+        unsigned long long mSwitches = 0;
+        unsigned long long mPeaks = 0;
+    };
+
+    std::string DecisionLabel( const cDecisionPath& path, long long frames )
+    {
+        char label[96];
+        snprintf( label, sizeof( label ), "%.1f switches, %.1f peaks per 1000 frames", 1000.0 * path.Switches() / frames,
+            1000.0 * path.Peaks() / frames );
+        return label;
+    }
+
+    void BM_DecisionPath( Bench::cState& state )
+    {
+        const int markers = (int) state.Range();
+        const LJ_HANDLE handle = OpenInstantLabJack();
+        if( !handle )
+        {
+            state.SkipWithError( "the LabJack emulator did not open" );
+            return;
+        }
+
+        std::unique_ptr<sFrameRecord[]> frames( new sFrameRecord[kLoopFrames]() );
+        cMarkerCloud cloud( CloudConfig( markers ) );
+        for( int f = 0; f < kLoopFrames; ++f )
+        {
+            cloud.Next( frames[f] );
+        }
+
+        cDecisionPath path( handle, FirstHand( markers ) );
+        int f = 0;
+        while( state.KeepRunning() )
+        {
+            path.Process( frames[f] );
+            f = ( f + 1 ) % kLoopFrames;
+        }
+        Close();
+        state.SetItemsPerIteration( markers );
+        state.SetLabel( DecisionLabel( path, state.Iterations() ) );
+    }
+    BENCHMARK( BM_DecisionPath )->Arg( 20 )->Arg( 100 )->Arg( 300 );
+
+    /// <summary>A recording of the cloud for the Motive simulator to replay, written once per size and removed at exit.</summary>
+    struct sCloudRecording
+    {
+        std::string Path;
+
+        explicit sCloudRecording( int markers )
+        {
+            const std::string path = ( std::filesystem::temp_directory_path() / ( "bench_pipeline_" + std::to_string( markers ) + ".mkrc" ) ).string();
+            sRecordingConfig config;
+            config.MaxMarkers = markers;
+            config.ChunkBuffers = kLoopFrames / config.ChunkFrames + 1;  // Never wait on the writer thread
+            cRecordingWriter writer;
+            if( !writer.Open( path.c_str(), config ) )
+            {
+                return;
+            }
+            cMarkerCloud cloud( CloudConfig( markers ) );
+            std::unique_ptr<sFrameRecord> frame( new sFrameRecord() );
+            bool complete = true;
+            for( int f = 0; f < kLoopFrames; ++f )
+            {
+                cloud.Next( *frame );
+                complete = writer.Append( *frame ) && complete;
+            }
+            if( writer.Close() && complete )
+            {
+                Path = path;
+            }
+        }
+
+        ~sCloudRecording()
+        {
+            if( !Path.empty() )
+            {
+                remove( Path.c_str() );
+            }
+        }
+    };
+
+    const sCloudRecording& Recording( int markers )
+    {
+        static std::map<int, std::unique_ptr<sCloudRecording>> sRecordings;
+        std::unique_ptr<sCloudRecording>& recording = sRecordings[markers];
+        if( !recording )
+        {
+            recording.reset( new sCloudRecording( markers ) );
+        }
+        return *recording;
+    }
+
+    // The whole path at the simulator's max speed: FrameAvailable(), Update() and the readout on the
+    // acquisition thread, the ring hand-off, then the decision path on the consumer thread. An iteration
+    // is one frame through the decision path, so the time is the pipeline's frame period at saturation.
+    void BM_EngineReplay( Bench::cState& state )
+    {
+        const int markers = (int) state.Range();
+        const sCloudRecording& recording = Recording( markers );
+        if( recording.Path.empty() )
+        {
+            state.SkipWithError( "cannot write the recording to the temporary directory" );
+            return;
+        }
+        const LJ_HANDLE handle = OpenInstantLabJack();
+
+        sMotiveSimConfig sim;
+        sim.TakePath = recording.Path;
+        sim.Speed = 0;
+        sim.Loop = true;
+        ConfigureMotiveSim( sim );
+        if( !handle || MotiveAPI::Initialize() != MotiveAPI::kApiResult_Success )
+        {
+            state.SkipWithError( handle ? MotiveSimError().c_str() : "the LabJack emulator did not open" );
+            return;
+        }
+
+        cDecisionPath path( handle, FirstHand( markers ) );
+        std::atomic<long long> decided{ 0 };
+        cCaptureEngine engine;
+        engine.AddConsumer( "decision", [&path, &decided]( const sFrameRecord& frame ) {
+            path.Process( frame );
+            decided.fetch_add( 1, std::memory_order_release );
+        } );
+        engine.Start();
+
+        long long waitFor = 1;
+        while( state.KeepRunning() )
+        {
+            while( decided.load( std::memory_order_acquire ) < waitFor )
+            {
+                std::this_thread::yield();
+            }
+            ++waitFor;
+        }
+
+        engine.Stop();
+        MotiveAPI::Shutdown();
+        Close();
+
+        const sCaptureStats stats = engine.Stats();
+        char label[96];
+        snprintf( label, sizeof( label ), "%.1f%% of acquired frames dropped at the ring",
+            stats.Acquired ? 100.0 * stats.Consumers[0].Overruns / stats.Acquired : 0.0 );
+        state.SetItemsPerIteration( markers );
+        state.SetLabel( label );
+    }
+    BENCHMARK( BM_EngineReplay )->Arg( 20 )->Arg( 100 )->Arg( 300 );
+}
+
+BENCHMARK_MAIN()
@@ -0,0 +1,389 @@
+//======================================================================================================
+// Microbenchmark: cQuaternion methods one at a time versus the structure-of-arrays batch kernels
+//======================================================================================================
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Core/Vector3.h"
+#include "Core/Quaternion.h"
+#include "cpufeatures.h"
+#include "quaternionbatch.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    using cQuat = Core::cQuaternion<float, false>;
+
+    const size_t kCheckPairs = 4096;
+
+    /// <summary>A noisy orientation track and its one-frame-later neighbour, in both layouts.</summary>
+    struct sTrack
+    {
+        std::vector<cQuat> From, To;
+        std::vector<float> AX, AY, AZ, AW, BX, BY, BZ, BW, T;
+        std::vector<float> VX, VY, VZ;
+
+        explicit sTrack( size_t count )
+            : AX( count ), AY( count ), AZ( count ), AW( count ), BX( count ), BY( count ), BZ( count ), BW( count ),
+              T( count ), VX( count ), VY( count ), VZ( count )
+        {
+            std::mt19937 rng( 12345 );
+            std::normal_distribution<float> noise;
+            std::uniform_real_distribution<float> unit( 0.0f, 1.0f );
+
+            for( size_t i = 0; i < count; ++i )
+            {
+                cQuat a( noise( rng ), noise( rng ), noise( rng ), noise( rng ) );
+                a.Normalize();
+                cQuat b( a.X() + 0.05f * noise( rng ), a.Y() + 0.05f * noise( rng ), a.Z() + 0.05f * noise( rng ), a.W() + 0.05f * noise( rng ) );
+                b.Normalize();
+
+                From.push_back( a );
+                To.push_back( b );
+                AX[i] = a.X(); AY[i] = a.Y(); AZ[i] = a.Z(); AW[i] = a.W();
+                BX[i] = b.X(); BY[i] = b.Y(); BZ[i] = b.Z(); BW[i] = b.W();
+                T[i] = unit( rng );
+                VX[i] = noise( rng ); VY[i] = noise( rng ); VZ[i] = noise( rng );
+            }
+        }
+
+        sQuaternionArrays<const float> A() const { return sQuaternionArrays<const float>( AX.data(), AY.data(), AZ.data(), AW.data() ); }
+        sQuaternionArrays<const float> B() const { return sQuaternionArrays<const float>( BX.data(), BY.data(), BZ.data(), BW.data() ); }
+    };
+
+    struct sOutput
+    {
+        std::vector<float> X, Y, Z, W;
+
+        explicit sOutput( size_t count ) : X( count ), Y( count ), Z( count ), W( count ) { }
+
+        sQuaternionArrays<float> Quaternions() { return sQuaternionArrays<float>( X.data(), Y.data(), Z.data(), W.data() ); }
+        sVectorArrays<float> Vectors() { return sVectorArrays<float>( X.data(), Y.data(), Z.data() ); }
+    };
+
+    /// <summary>
+    /// Independent random pairs, so the angle between them spans [0, pi] and half the dots are negative,
+    /// with every eighth pair an edge case: equal, negated, a half turn apart, or almost negated. t runs
+    /// over [-1, 2], the extrapolation range the batch slerp is specified for. Rotations take quaternions
+    /// of random length.
+    /// </summary>
+    template<typename T>
+    struct sWidePairs
+    {
+        using cQ = Core::cQuaternion<T, false>;
+
+        std::vector<cQ> From, To, Rotation;
+        std::vector<T> AX, AY, AZ, AW, BX, BY, BZ, BW, RX, RY, RZ, RW, T01, VX, VY, VZ;
+
+        explicit sWidePairs( size_t count )
+            : AX( count ), AY( count ), AZ( count ), AW( count ), BX( count ), BY( count ), BZ( count ), BW( count ),
+              RX( count ), RY( count ), RZ( count ), RW( count ), T01( count ), VX( count ), VY( count ), VZ( count )
+        {
+            std::mt19937 rng( 777 );
+            std::normal_distribution<T> noise;
+            std::uniform_real_distribution<T> extrapolate( T( -1 ), T( 2 ) );
+            std::uniform_real_distribution<T> length( T( 0.25 ), T( 4 ) );
+
+            for( size_t i = 0; i < count; ++i )
+            {
+                cQ a( noise( rng ), noise( rng ), noise( rng ), noise( rng ) );
+                a.Normalize();
+                cQ b( noise( rng ), noise( rng ), noise( rng ), noise( rng ) );
+                switch( i % 32 )
+                {
+                case 0: b = a; break;
+                case 8: b = cQ( -a.X(), -a.Y(), -a.Z(), -a.W() ); break;
+                case 16: b = cQ( -a.Y(), a.X(), -a.W(), a.Z() ); break;     // Orthogonal: a half turn apart
+                case 24: b = cQ( -a.X() + T( 1e-3 ) * noise( rng ), -a.Y(), -a.Z(), -a.W() ); break;
+                default: break;
+                }
+                b.Normalize();
+
+                cQ r( noise( rng ), noise( rng ), noise( rng ), noise( rng ) );
+                r.Normalize();
+                r.Scale( length( rng ) );
+
+                From.push_back( a );
+                To.push_back( b );
+                Rotation.push_back( r );
+                AX[i] = a.X(); AY[i] = a.Y(); AZ[i] = a.Z(); AW[i] = a.W();
+                BX[i] = b.X(); BY[i] = b.Y(); BZ[i] = b.Z(); BW[i] = b.W();
+                RX[i] = r.X(); RY[i] = r.Y(); RZ[i] = r.Z(); RW[i] = r.W();
+                T01[i] = extrapolate( rng );
+                VX[i] = noise( rng ); VY[i] = noise( rng ); VZ[i] = noise( rng );
+            }
+        }
+
+        size_t Size() const { return From.size(); }
+        sQuaternionArrays<const T> A() const { return sQuaternionArrays<const T>( AX.data(), AY.data(), AZ.data(), AW.data() ); }
+        sQuaternionArrays<const T> B() const { return sQuaternionArrays<const T>( BX.data(), BY.data(), BZ.data(), BW.data() ); }
+        sQuaternionArrays<const T> R() const { return sQuaternionArrays<const T>( RX.data(), RY.data(), RZ.data(), RW.data() ); }
+        sVectorArrays<const T> V() const { return sVectorArrays<const T>( VX.data(), VY.data(), VZ.data() ); }
+    };
+
+    template<typename T>
+    bool Near( T expected, T actual )
+    {
+        return std::fabs( expected - actual ) <= kQuaternionBatchTolerance<T>;
+    }
+
+    template<typename T>
+    bool NearQuaternion( const Core::cQuaternion<T, false>& expected, T x, T y, T z, T w )
+    {
+        return Near( expected.X(), x ) && Near( expected.Y(), y ) && Near( expected.Z(), z ) && Near( expected.W(), w );
+    }
+
+    /// <summary>Every batch kernel at the selected level against the cQuaternion methods, in one precision.</summary>
+    template<typename T>
+    const char* CheckKernels( size_t count )
+    {
+        const sWidePairs<T> pairs( count );
+        std::vector<T> x( count ), y( count ), z( count ), w( count );
+        const sQuaternionArrays<T> out( x.data(), y.data(), z.data(), w.data() );
+
+        SlerpQuaternions( pairs.A(), pairs.B(), pairs.T01.data(), out, count );
+        for( size_t i = 0; i < count; ++i )
+        {
+            if( !NearQuaternion( Core::cQuaternion<T, false>::Slerp( pairs.From[i], pairs.To[i], pairs.T01[i] ), x[i], y[i], z[i], w[i] ) )
+            {
+                return "batch slerp outside tolerance";
+            }
+        }
+
+        RotateVectors( pairs.R(), pairs.V(), sVectorArrays<T>( x.data(), y.data(), z.data() ), count );
+        for( size_t i = 0; i < count; ++i )
+        {
+            const Core::cVector3<T> expected = pairs.Rotation[i].Rotate( Core::cVector3<T>( pairs.VX[i], pairs.VY[i], pairs.VZ[i] ) );
+            if( !Near( expected[0], x[i] ) || !Near( expected[1], y[i] ) || !Near( expected[2], z[i] ) )
+            {
+                return "batch rotate outside tolerance";
+            }
+        }
+
+        QuaternionAngles( pairs.A(), pairs.B(), x.data(), count );
+        for( size_t i = 0; i < count; ++i )
+        {
+            if( !Near( pairs.From[i].AngleTo( pairs.To[i] ), x[i] ) )
+            {
+                return "batch angle outside tolerance";
+            }
+        }
+
+        x = pairs.RX; y = pairs.RY; z = pairs.RZ; w = pairs.RW;
+        x[0] = y[0] = z[0] = w[0] = 0;     // A zero quaternion becomes the identity
+        NormalizeQuaternions( out, count );
+        for( size_t i = 0; i < count; ++i )
+        {
+            Core::cQuaternion<T, false> expected = ( i == 0 ? Core::cQuaternion<T, false>( 0, 0, 0, 0 ) : pairs.Rotation[i] );
+            expected.Normalize();
+            if( !NearQuaternion( expected, x[i], y[i], z[i], w[i] ) )
+            {
+                return "batch normalize outside tolerance";
+            }
+        }
+        return nullptr;
+    }
+
+    bool SelectLevel( Bench::cState& state, eSimdLevel level )
+    {
+        if( level > DetectedSimdLevel() )
+        {
+            state.SkipWithError( "instruction set not available" );
+            return false;
+        }
+        SetSimdLevelLimit( level );
+        state.SetLabel( SimdLevelName( level ) );
+
+        // Every kernel, both precisions: the timed kernel may share its level with a broken neighbour.
+        const char* error = CheckKernels<float>( kCheckPairs );
+        if( error == nullptr )
+        {
+            error = CheckKernels<double>( kCheckPairs );
+        }
+        if( error != nullptr )
+        {
+            state.SkipWithError( error );
+            return false;
+        }
+        return true;
+    }
+
+    //==================================================================================================
+    // Slerp
+    //==================================================================================================
+
+    void BM_SlerpScalarMethod( Bench::cState& state )
+    {
+        const sTrack track( (size_t) state.Range() );
+        std::vector<cQuat> out( track.From.size() );
+
+        while( state.KeepRunning() )
+        {
+            for( size_t i = 0; i < out.size(); ++i )
+            {
+                out[i] = cQuat::Slerp( track.From[i], track.To[i], track.T[i] );
+            }
+            Bench::DoNotOptimize( out[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_SlerpScalarMethod )->Arg( 4096 );
+
+    void RunSlerp( Bench::cState& state, eSimdLevel level )
+    {
+        if( !SelectLevel( state, level ) )
+        {
+            return;
+        }
+
+        const sTrack track( (size_t) state.Range() );
+        sOutput out( track.T.size() );
+
+        while( state.KeepRunning() )
+        {
+            SlerpQuaternions( track.A(), track.B(), track.T.data(), out.Quaternions(), track.T.size() );
+            Bench::DoNotOptimize( out.X[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+
+    void BM_SlerpBatchScalar( Bench::cState& state ) { RunSlerp( state, eSimdLevel::Scalar ); }
+    BENCHMARK( BM_SlerpBatchScalar )->Arg( 4096 );
+    void BM_SlerpBatchSse2( Bench::cState& state ) { RunSlerp( state, eSimdLevel::SSE2 ); }
+    BENCHMARK( BM_SlerpBatchSse2 )->Arg( 4096 );
+    void BM_SlerpBatchAvx( Bench::cState& state ) { RunSlerp( state, eSimdLevel::AVX ); }
+    BENCHMARK( BM_SlerpBatchAvx )->Arg( 4096 );
+
+    //==================================================================================================
+    // Rotate
+    //==================================================================================================
+
+    void BM_RotateScalarMethod( Bench::cState& state )
+    {
+        const sTrack track( (size_t) state.Range() );
+        std::vector<Core::cVector3<float>> out( track.From.size() );
+
+        while( state.KeepRunning() )
+        {
+            for( size_t i = 0; i < out.size(); ++i )
+            {
+                out[i] = track.From[i].Rotate( Core::cVector3<float>( track.VX[i], track.VY[i], track.VZ[i] ) );
+            }
+            Bench::DoNotOptimize( out[0][0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_RotateScalarMethod )->Arg( 4096 );
+
+    void RunRotate( Bench::cState& state, eSimdLevel level )
+    {
+        if( !SelectLevel( state, level ) )
+        {
+            return;
+        }
+
+        const sTrack track( (size_t) state.Range() );
+        sOutput out( track.T.size() );
+        const sVectorArrays<const float> vectors( track.VX.data(), track.VY.data(), track.VZ.data() );
+
+        while( state.KeepRunning() )
+        {
+            RotateVectors( track.A(), vectors, out.Vectors(), track.T.size() );
+            Bench::DoNotOptimize( out.X[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+
+    void BM_RotateBatchScalar( Bench::cState& state ) { RunRotate( state, eSimdLevel::Scalar ); }
+    BENCHMARK( BM_RotateBatchScalar )->Arg( 4096 );
+    void BM_RotateBatchSse2( Bench::cState& state ) { RunRotate( state, eSimdLevel::SSE2 ); }
+    BENCHMARK( BM_RotateBatchSse2 )->Arg( 4096 );
+    void BM_RotateBatchAvx( Bench::cState& state ) { RunRotate( state, eSimdLevel::AVX ); }
+    BENCHMARK( BM_RotateBatchAvx )->Arg( 4096 );
+
+    //==================================================================================================
+    // AngleTo and Normalize
+    //==================================================================================================
+
+    void BM_AngleToScalarMethod( Bench::cState& state )
+    {
+        const sTrack track( (size_t) state.Range() );
+        std::vector<float> out( track.From.size() );
+
+        while( state.KeepRunning() )
+        {
+            for( size_t i = 0; i < out.size(); ++i )
+            {
+                out[i] = track.From[i].AngleTo( track.To[i] );
+            }
+            Bench::DoNotOptimize( out[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_AngleToScalarMethod )->Arg( 4096 );
+
+    void RunAngles( Bench::cState& state, eSimdLevel level )
+    {
+        if( !SelectLevel( state, level ) )
+        {
+            return;
+        }
+
+        const sTrack track( (size_t) state.Range() );
+        std::vector<float> out( track.T.size() );
+
+        while( state.KeepRunning() )
+        {
+            QuaternionAngles( track.A(), track.B(), out.data(), out.size() );
+            Bench::DoNotOptimize( out[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+
+    void BM_AnglesBatchScalar( Bench::cState& state ) { RunAngles( state, eSimdLevel::Scalar ); }
+    BENCHMARK( BM_AnglesBatchScalar )->Arg( 4096 );
+    void BM_AnglesBatchAvx( Bench::cState& state ) { RunAngles( state, eSimdLevel::AVX ); }
+    BENCHMARK( BM_AnglesBatchAvx )->Arg( 4096 );
+
+    void BM_NormalizeScalarMethod( Bench::cState& state )
+    {
+        const sTrack track( (size_t) state.Range() );
+        std::vector<cQuat> work( track.To );
+
+        while( state.KeepRunning() )
+        {
+            for( cQuat& q : work )
+            {
+                q.Normalize();
+            }
+            Bench::DoNotOptimize( work[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_NormalizeScalarMethod )->Arg( 4096 );
+
+    void BM_NormalizeBatchAvx( Bench::cState& state )
+    {
+        if( !SelectLevel( state, eSimdLevel::AVX ) )
+        {
+            return;
+        }
+
+        sTrack track( (size_t) state.Range() );
+        const sQuaternionArrays<float> work( track.BX.data(), track.BY.data(), track.BZ.data(), track.BW.data() );
+
+        while( state.KeepRunning() )
+        {
+            NormalizeQuaternions( work, track.T.size() );
+            Bench::DoNotOptimize( track.BX[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_NormalizeBatchAvx )->Arg( 4096 );
+}
+
+BENCHMARK_MAIN()
@@ -0,0 +1,203 @@
+//======================================================================================================
+// Benchmark: Motive take CSV parsing, whole files and single rows, on takes written from a synthetic cloud
+//======================================================================================================
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Core/Marker.h"
+#include "Core/UID.h"
+#include "markercloud.h"
+#include "takecsv.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    const int kTakeFrames = 2400;       // Ten seconds at 240 Hz
+
+    /// <summary>
+    /// A take exported the way Motive writes it: metadata line, the four header rows, then one row per
+    /// frame in millimeters with empty fields while a marker is occluded. Removed again on destruction.
+    /// </summary>
+    struct sTakeFile
+    {
+        std::string Path;
+        int Columns = 0;                    // Data columns after Frame and Time
+        long long Bytes = 0;
+        std::vector<std::string> Rows;      // The data rows, without line ends
+
+        explicit sTakeFile( int markers )
+        {
+            sMarkerCloudConfig config;
+            config.Markers = markers;
+            config.Bodies = 2;
+            config.UnlabeledFraction = 0;   // Columns are per marker ID for the whole take
+            config.ReportOccluded = false;
+            cMarkerCloud cloud( config );
+
+            std::vector<std::vector<Core::cMarker>> frames( kTakeFrames );
+            std::unordered_map<Core::cUID, int> columns;
+            std::vector<Core::cUID> ids;
+            for( std::vector<Core::cMarker>& frame : frames )
+            {
+                cloud.Next( frame );
+                for( const Core::cMarker& marker : frame )
+                {
+                    if( columns.emplace( marker.ID, (int) ids.size() ).second )
+                    {
+                        ids.push_back( marker.ID );
+                    }
+                }
+            }
+            Columns = 3 * (int) ids.size();
+
+            std::string header = "Format Version,1.24,Take Name,bench,Capture Frame Rate,240.000000,Export Frame Rate,240.000000,"
+                                 "Capture Start Frame,0,Total Frames in Take," + std::to_string( kTakeFrames ) +
+                                 ",Rotation Type,Quaternion,Length Units,Millimeters,Coordinate Space,Global\r\n\r\n";
+            std::string type = ",Type", name = ",Name", id = ",ID", category = ",", axis = "Frame,Time (Seconds)";
+            for( size_t m = 0; m < ids.size(); ++m )
+            {
+                char hex[40];
+                snprintf( hex, sizeof( hex ), "\"%llX%016llX\"", (unsigned long long) ids[m].HighBits(), (unsigned long long) ids[m].LowBits() );
+                for( const char* xyz : { "X", "Y", "Z" } )
+                {
+                    type += ",Marker";
+                    name += ",Marker " + std::to_string( m + 1 );
+                    id += std::string( "," ) + hex;
+                    category += ",Position";
+                    axis += std::string( "," ) + xyz;
+                }
+            }
+            header += type + "\r\n" + name + "\r\n" + id + "\r\n" + category + "\r\n" + axis + "\r\n";
+
+            std::vector<float> values( Columns );
+            Rows.resize( kTakeFrames );
+            for( int f = 0; f < kTakeFrames; ++f )
+            {
+                std::fill( values.begin(), values.end(), NAN );
+                for( const Core::cMarker& marker : frames[f] )
+                {
+                    float* xyz = &values[3 * columns[marker.ID]];
+                    xyz[0] = marker.X * 1000;
+                    xyz[1] = marker.Y * 1000;
+                    xyz[2] = marker.Z * 1000;
+                }
+                char field[32];
+                snprintf( field, sizeof( field ), "%d,%f", f, f / 240.0 );
+                std::string& row = Rows[f];
+                row = field;
+                for( float v : values )
+                {
+                    if( std::isnan( v ) )
+                    {
+                        row += ",";
+                        continue;
+                    }
+                    snprintf( field, sizeof( field ), ",%f", v );
+                    row += field;
+                }
+            }
+
+            Path = ( std::filesystem::temp_directory_path() / ( "bench_take_" + std::to_string( markers ) + ".csv" ) ).string();
+            FILE* file = fopen( Path.c_str(), "wb" );
+            if( !file )
+            {
+                Path.clear();
+                return;
+            }
+            fwrite( header.data(), 1, header.size(), file );
+            Bytes = (long long) header.size();
+            for( const std::string& row : Rows )
+            {
+                fwrite( row.data(), 1, row.size(), file );
+                fwrite( "\r\n", 1, 2, file );
+                Bytes += (long long) row.size() + 2;
+            }
+            fclose( file );
+        }
+
+        ~sTakeFile()
+        {
+            if( !Path.empty() )
+            {
+                remove( Path.c_str() );
+            }
+        }
+    };
+
+    /// <summary>Writing a take costs far more than reading it, so each size is written once per process.</summary>
+    const sTakeFile& Take( int markers )
+    {
+        static std::map<int, std::unique_ptr<sTakeFile>> sTakes;
+        std::unique_ptr<sTakeFile>& take = sTakes[markers];
+        if( !take )
+        {
+            take.reset( new sTakeFile( markers ) );
+        }
+        return *take;
+    }
+
+    std::string SizeLabel( const sTakeFile& take )
+    {
+        char label[64];
+        snprintf( label, sizeof( label ), "%.1f MB, %d columns", take.Bytes / 1e6, take.Columns );
+        return label;
+    }
+
+    void RunLoad( Bench::cState& state, int threads )
+    {
+        const sTakeFile& take = Take( (int) state.Range() );
+        if( take.Path.empty() )
+        {
+            state.SkipWithError( "cannot write the take to the temporary directory" );
+            return;
+        }
+        sTakeLoadOptions options;
+        options.Threads = threads;
+        while( state.KeepRunning() )
+        {
+            cTakeCsv csv;
+            if( !csv.Load( take.Path.c_str(), options ) || csv.RowCount() != kTakeFrames || csv.MalformedRows() != 0 )
+            {
+                state.SkipWithError( "the take did not load back" );
+                return;
+            }
+            Bench::DoNotOptimize( csv.MarkerCount() );
+        }
+        state.SetItemsPerIteration( kTakeFrames );
+        state.SetLabel( SizeLabel( take ) );
+    }
+
+    void BM_TakeLoad( Bench::cState& state ) { RunLoad( state, 1 ); }
+    BENCHMARK( BM_TakeLoad )->Arg( 30 )->Arg( 100 )->Arg( 300 );
+    void BM_TakeLoadThreads( Bench::cState& state ) { RunLoad( state, 0 ); }
+    BENCHMARK( BM_TakeLoadThreads )->Arg( 30 )->Arg( 100 )->Arg( 300 );
+
+    void BM_TakeParseRow( Bench::cState& state )
+    {
+        const sTakeFile& take = Take( (int) state.Range() );
+        std::vector<float> values( take.Columns );
+        size_t r = 0;
+        while( state.KeepRunning() )
+        {
+            const std::string& row = take.Rows[r];
+            long long frame;
+            double time;
+            Bench::DoNotOptimize( ParseTakeRow( row.data(), row.data() + row.size(), take.Columns, frame, time, values.data() ) );
+            r = ( r + 1 ) % take.Rows.size();
+        }
+        state.SetItemsPerIteration( take.Columns );
+        state.SetLabel( "per field" );
+    }
+    BENCHMARK( BM_TakeParseRow )->Arg( 30 )->Arg( 100 )->Arg( 300 );
+}
+
+BENCHMARK_MAIN()
@@ -0,0 +1,79 @@
+//======================================================================================================
+// Microbenchmark: cost of a tracepoint with its system switched off and on
+//======================================================================================================
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+#include "tracepoint.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    // What release builds pay everywhere by default: a relaxed load and a branch.
+    void BM_TraceScopeDisabled( Bench::cState& state )
+    {
+        cTrace::Enable( Core::cDebugSystem::Pipeline, false );
+        while( state.KeepRunning() )
+        {
+            TRACE_SCOPE( Pipeline, "disabled" );
+        }
+        state.SetLabel( "system not selected" );
+    }
+    BENCHMARK( BM_TraceScopeDisabled );
+
+    void BM_TraceCounterDisabled( Bench::cState& state )
+    {
+        cTrace::Enable( Core::cDebugSystem::Frame, false );
+        int markers = 0;
+        while( state.KeepRunning() )
+        {
+            TRACE_COUNTER( Frame, "markers", markers++ );
+        }
+        state.SetLabel( "system not selected" );
+    }
+    BENCHMARK( BM_TraceCounterDisabled );
+
+    // Selected, with the writer running. The loop gives the writer time every half queue, so no event is
+    // dropped; the events go to a scratch trace file.
+    void BM_TraceScopeEnabled( Bench::cState& state )
+    {
+        const char* output = getenv( "CAPTURE_TRACE_OUTPUT" );
+        if( output == nullptr )
+        {
+            state.SkipWithError( "set CAPTURE_TRACE_OUTPUT to a scratch file to run" );
+            return;
+        }
+        cTrace::Start();
+        cTrace::Enable( Core::cDebugSystem::Pipeline, true );
+        const sTraceStats before = cTrace::Stats();
+
+        int events = 0;
+        while( state.KeepRunning() )
+        {
+            {
+                TRACE_SCOPE( Pipeline, "enabled" );
+            }
+            if( ++events % 2048 == 0 )
+            {
+                state.PauseTiming();
+                std::this_thread::sleep_for( std::chrono::milliseconds( 30 ) );
+                state.ResumeTiming();
+            }
+        }
+
+        cTrace::Enable( Core::cDebugSystem::Pipeline, false );
+        cTrace::Stop();
+        if( cTrace::Stats().Dropped != before.Dropped )
+        {
+            state.SkipWithError( "events dropped" );
+        }
+        state.SetLabel( "two clock reads and a queued event" );
+    }
+    BENCHMARK( BM_TraceScopeEnabled );
+}
+
+BENCHMARK_MAIN()
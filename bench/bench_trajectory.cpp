@@ -0,0 +1,155 @@
+//======================================================================================================
+// Microbenchmark: std::vector<cVector3f> loops versus cTrajectory3 and the vector batch kernels
+//======================================================================================================
+#include <cmath>
+#include <vector>
+
+#include "Core/Vector3.h"
+#include "cpufeatures.h"
+#include "trajectory.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    /// <summary>A wrist-marker-like path sampled at 240 Hz, in both layouts.</summary>
+    struct sPath
+    {
+        std::vector<Core::cVector3f> Points;
+        cTrajectory3f Trajectory;
+
+        explicit sPath( size_t count )
+        {
+            Points.reserve( count );
+            for( size_t i = 0; i < count; ++i )
+            {
+                const float t = i / 240.0f;
+                Points.emplace_back( 0.3f * std::sin( 2.1f * t ), 0.9f + 0.05f * std::cos( 5.3f * t ), 0.2f * t );
+            }
+            Trajectory.Assign( Points.data(), Points.size() );
+        }
+    };
+
+    bool SelectLevel( Bench::cState& state, eSimdLevel level )
+    {
+        if( level > DetectedSimdLevel() )
+        {
+            state.SkipWithError( "instruction set not available" );
+            return false;
+        }
+        SetSimdLevelLimit( level );
+        state.SetLabel( SimdLevelName( level ) );
+        return true;
+    }
+
+    //==================================================================================================
+    // Frame-to-frame distance, the core of a speed profile
+    //==================================================================================================
+
+    void BM_StepDistanceVectors( Bench::cState& state )
+    {
+        const sPath path( (size_t) state.Range() );
+        std::vector<float> steps( path.Points.size() - 1 );
+
+        while( state.KeepRunning() )
+        {
+            for( size_t i = 0; i < steps.size(); ++i )
+            {
+                steps[i] = path.Points[i].Distance( path.Points[i + 1] );
+            }
+            Bench::DoNotOptimize( steps[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_StepDistanceVectors )->Arg( 4096 );
+
+    void RunStepDistance( Bench::cState& state, eSimdLevel level )
+    {
+        if( !SelectLevel( state, level ) )
+        {
+            return;
+        }
+
+        const sPath path( (size_t) state.Range() );
+        std::vector<float> steps( path.Points.size() - 1 );
+
+        while( state.KeepRunning() )
+        {
+            VectorDistances( path.Trajectory.Columns(), path.Trajectory.Columns( 1 ), steps.data(), steps.size() );
+            Bench::DoNotOptimize( steps[0] );
+        }
+
+        for( size_t i = 0; i < steps.size(); ++i )
+        {
+            if( steps[i] != path.Points[i].Distance( path.Points[i + 1] ) )
+            {
+                state.SkipWithError( "batch distance differs from cVector3::Distance()" );
+                break;
+            }
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+
+    void BM_StepDistanceScalar( Bench::cState& state ) { RunStepDistance( state, eSimdLevel::Scalar ); }
+    BENCHMARK( BM_StepDistanceScalar )->Arg( 4096 );
+    void BM_StepDistanceSse2( Bench::cState& state ) { RunStepDistance( state, eSimdLevel::SSE2 ); }
+    BENCHMARK( BM_StepDistanceSse2 )->Arg( 4096 );
+    void BM_StepDistanceAvx( Bench::cState& state ) { RunStepDistance( state, eSimdLevel::AVX ); }
+    BENCHMARK( BM_StepDistanceAvx )->Arg( 4096 );
+    void BM_StepDistanceAvx512( Bench::cState& state ) { RunStepDistance( state, eSimdLevel::AVX512 ); }
+    BENCHMARK( BM_StepDistanceAvx512 )->Arg( 4096 );
+
+    //==================================================================================================
+    // Normalize and cross, e.g. a segment direction and a plane normal per frame
+    //==================================================================================================
+
+    void BM_NormalizeCrossVectors( Bench::cState& state )
+    {
+        const sPath path( (size_t) state.Range() );
+        std::vector<Core::cVector3f> out( path.Points.size() - 1 );
+
+        while( state.KeepRunning() )
+        {
+            for( size_t i = 0; i < out.size(); ++i )
+            {
+                out[i] = path.Points[i].Cross( path.Points[i + 1] );
+                out[i].Normalize();
+            }
+            Bench::DoNotOptimize( out[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_NormalizeCrossVectors )->Arg( 4096 );
+
+    void RunNormalizeCross( Bench::cState& state, eSimdLevel level )
+    {
+        if( !SelectLevel( state, level ) )
+        {
+            return;
+        }
+
+        const sPath path( (size_t) state.Range() );
+        cTrajectory3f out( path.Points.size() - 1 );
+
+        while( state.KeepRunning() )
+        {
+            CrossVectors( path.Trajectory.Columns(), path.Trajectory.Columns( 1 ), out.Columns(), out.Size() );
+            out.Normalize();
+            Bench::DoNotOptimize( out.X()[0] );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+
+    void BM_NormalizeCrossScalar( Bench::cState& state ) { RunNormalizeCross( state, eSimdLevel::Scalar ); }
+    BENCHMARK( BM_NormalizeCrossScalar )->Arg( 4096 );
+    void BM_NormalizeCrossSse2( Bench::cState& state ) { RunNormalizeCross( state, eSimdLevel::SSE2 ); }
+    BENCHMARK( BM_NormalizeCrossSse2 )->Arg( 4096 );
+    void BM_NormalizeCrossAvx( Bench::cState& state ) { RunNormalizeCross( state, eSimdLevel::AVX ); }
+    BENCHMARK( BM_NormalizeCrossAvx )->Arg( 4096 );
+    void BM_NormalizeCrossAvx512( Bench::cState& state ) { RunNormalizeCross( state, eSimdLevel::AVX512 ); }
+    BENCHMARK( BM_NormalizeCrossAvx512 )->Arg( 4096 );
+}
+
+BENCHMARK_MAIN()
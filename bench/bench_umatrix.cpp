@@ -0,0 +1,296 @@
+//======================================================================================================
+// Benchmark: cMatrix / cUMatrix sparse operations on a marker neighbour graph from a synthetic cloud,
+// and its Save / Load through binaryio.h
+//======================================================================================================
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Core/Marker.h"
+#include "Core/UID.h"
+#include "Core/UMatrix.h"
+#include "binaryio.h"
+#include "markercloud.h"
+
+#include "benchharness.h"
+
+using namespace Capture;
+
+namespace
+{
+    using cNeighbours = Core::cUMatrix<Core::cUID, Core::sIndexFloat>;
+
+    const float kNeighbourRadius = 0.03f;   // Meters; a few markers of the same hand
+    const size_t kMaxNeighbours = 8;
+
+    /// <summary>One frame of a two-hand cloud, with every marker's row of neighbours within kNeighbourRadius.</summary>
+    struct sGraphFrame
+    {
+        std::vector<Core::cMarker> Markers;
+        cNeighbours Graph;
+
+        explicit sGraphFrame( int markers )
+        {
+            sMarkerCloudConfig config;
+            config.Markers = markers;
+            config.Bodies = 2;
+            cMarkerCloud cloud( config );
+            cloud.Next( Markers );
+            Build( Markers, Graph );
+        }
+
+        /// <summary>Rows in marker order keyed by ID, each sorted nearest first and clipped to kMaxNeighbours.</summary>
+        static void Build( const std::vector<Core::cMarker>& markers, cNeighbours& graph )
+        {
+            graph.clear();
+            const float limit = kNeighbourRadius * kNeighbourRadius;
+            for( size_t i = 0; i < markers.size(); ++i )
+            {
+                graph.AddU( markers[i].ID );
+                for( size_t j = 0; j < markers.size(); ++j )
+                {
+                    const float dx = markers[i].X - markers[j].X;
+                    const float dy = markers[i].Y - markers[j].Y;
+                    const float dz = markers[i].Z - markers[j].Z;
+                    const float d2 = dx * dx + dy * dy + dz * dz;
+                    if( j != i && d2 < limit )
+                    {
+                        graph.AddRowItem( Core::sIndexFloat( (int) j, d2 ) );
+                    }
+                }
+                graph.EndRow();
+            }
+            graph.BuildUIndex();
+            graph.SortColumns();
+            graph.ClipRows( kMaxNeighbours );
+        }
+    };
+
+    void BM_UMatrixBuild( Bench::cState& state )
+    {
+        const sGraphFrame frame( (int) state.Range() );
+        cNeighbours graph;
+        while( state.KeepRunning() )
+        {
+            sGraphFrame::Build( frame.Markers, graph );
+            Bench::DoNotOptimize( graph.FlatData().size() );
+        }
+        state.SetItemsPerIteration( state.Range() );
+        state.SetLabel( "pairs, BuildUIndex, SortColumns, ClipRows" );
+    }
+    BENCHMARK( BM_UMatrixBuild )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+
+    void BM_UMatrixURow( Bench::cState& state )
+    {
+        const sGraphFrame frame( (int) state.Range() );
+        while( state.KeepRunning() )
+        {
+            float sum = 0;
+            for( const Core::cMarker& marker : frame.Markers )
+            {
+                const Core::cVec<const Core::sIndexFloat> row = frame.Graph.URow( marker.ID );
+                if( !row.empty() )
+                {
+                    sum += row[0].data;
+                }
+            }
+            Bench::DoNotOptimize( sum );
+        }
+        state.SetItemsPerIteration( state.Range() );
+    }
+    BENCHMARK( BM_UMatrixURow )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+
+    void BM_UMatrixTranspose( Bench::cState& state )
+    {
+        const sGraphFrame frame( (int) state.Range() );
+        Core::cMatrix<Core::sIndexFloat> transpose;
+        while( state.KeepRunning() )
+        {
+            transpose.MakeTranspose( frame.Graph, frame.Markers.size() );
+            Bench::DoNotOptimize( transpose.FlatData().size() );
+        }
+        state.SetItemsPerIteration( (long long) frame.Graph.FlatData().size() );
+        state.SetLabel( "per entry" );
+    }
+    BENCHMARK( BM_UMatrixTranspose )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+
+    void BM_UMatrixMakeRef( Bench::cState& state )
+    {
+        const sGraphFrame frame( (int) state.Range() );
+        Core::cMatrix<int> reference;
+        while( state.KeepRunning() )
+        {
+            reference.MakeRef( frame.Graph.FlatData(), frame.Markers.size() );
+            Bench::DoNotOptimize( reference.FlatData().size() );
+        }
+        state.SetItemsPerIteration( (long long) frame.Graph.FlatData().size() );
+        state.SetLabel( "per entry" );
+    }
+    BENCHMARK( BM_UMatrixMakeRef )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+
+    // One body's rows: markers are dealt to the two bodies round robin, so every other one.
+    void BM_UMatrixCopySubset( Bench::cState& state )
+    {
+        const sGraphFrame frame( (int) state.Range() );
+        std::vector<Core::cUID> subset;
+        for( size_t i = 0; i < frame.Markers.size(); i += 2 )
+        {
+            subset.push_back( frame.Markers[i].ID );
+        }
+        cNeighbours copy;
+        while( state.KeepRunning() )
+        {
+            copy.clear();
+            frame.Graph.CopySubset( copy, subset );
+            Bench::DoNotOptimize( copy.FlatData().size() );
+        }
+        state.SetItemsPerIteration( (long long) subset.size() );
+    }
+    BENCHMARK( BM_UMatrixCopySubset )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+
+    //==================================================================================================
+    // Save / Load through binaryio.h: the graph is written laid out as SaveMatrixAligned() does it, then
+    // its row keys. Every run first checks that Load() and LoadMatrixView() both give the graph back.
+    //==================================================================================================
+
+    template<class A, class B>
+    bool SameRows( const A& a, const B& b )
+    {
+        if( a.size() != b.size() )
+        {
+            return false;
+        }
+        for( size_t i = 0; i < a.size(); ++i )
+        {
+            const Core::cVec<const Core::sIndexFloat> rowA = a[i];
+            const Core::cVec<const Core::sIndexFloat> rowB = b[i];
+            if( rowA.size() != rowB.size() || !std::equal( rowA.begin(), rowA.end(), rowB.begin() ) )
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool SameKeys( const Core::cVec<const Core::cUID>& a, const Core::cVec<const Core::cUID>& b )
+    {
+        return a.size() == b.size() && std::equal( a.begin(), a.end(), b.begin() );
+    }
+
+    bool LoadGraph( const std::string& path, cNeighbours& graph )
+    {
+        cMmapReader reader;
+        if( !reader.Open( path.c_str() ) )
+        {
+            return false;
+        }
+        reader.Pad( alignof( int ), kMatrixRowOffsetsAhead );
+        return graph.Load( reader ) && !reader.Failed();
+    }
+
+    /// <summary>The view lives in reader, which must stay open while it is used.</summary>
+    bool LoadGraphView( cMmapReader& reader, const std::string& path, sMatrixView<Core::sIndexFloat>& view,
+                        std::vector<Core::cUID>& keyStorage, Core::cVec<const Core::cUID>& keys )
+    {
+        if( !reader.Open( path.c_str() ) || !LoadMatrixView( reader, view ) )
+        {
+            return false;
+        }
+        keys = reader.ReadVectorView( keyStorage );
+        return !reader.Failed();
+    }
+
+    /// <summary>Saved graph of a frame, checked to load back both ways. Error is set when it does not.</summary>
+    struct sSavedGraph
+    {
+        sGraphFrame Frame;
+        std::string Path;
+        const char* Error = nullptr;
+
+        explicit sSavedGraph( int markers )
+            : Frame( markers ),
+              Path( ( std::filesystem::temp_directory_path() / ( "bench_umatrix_" + std::to_string( markers ) + ".bin" ) ).string() )
+        {
+            cFileWriter writer;
+            if( !writer.Open( Path.c_str() ) )
+            {
+                Error = "cannot write the graph to the temporary directory";
+                return;
+            }
+            writer.Pad( alignof( int ), kMatrixRowOffsetsAhead );
+            Frame.Graph.Save( writer );
+            if( !writer.Close() )
+            {
+                Error = "cannot write the graph to the temporary directory";
+                return;
+            }
+
+            cNeighbours loaded;
+            if( !LoadGraph( Path, loaded ) || !SameRows( Frame.Graph, loaded ) || !SameKeys( Frame.Graph.GetIndex2U(), loaded.GetIndex2U() ) )
+            {
+                Error = "Load() round trip mismatch";
+                return;
+            }
+
+            cMmapReader reader;
+            sMatrixView<Core::sIndexFloat> view;
+            std::vector<Core::cUID> keyStorage;
+            Core::cVec<const Core::cUID> keys;
+            if( !LoadGraphView( reader, Path, view, keyStorage, keys ) || !SameRows( Frame.Graph, view.Matrix )
+                || !SameKeys( Frame.Graph.GetIndex2U(), keys ) )
+            {
+                Error = "LoadMatrixView() round trip mismatch";
+            }
+        }
+
+        ~sSavedGraph()
+        {
+            std::error_code ignored;
+            std::filesystem::remove( Path, ignored );
+        }
+    };
+
+    void BM_UMatrixLoad( Bench::cState& state )
+    {
+        const sSavedGraph saved( (int) state.Range() );
+        if( saved.Error != nullptr )
+        {
+            state.SkipWithError( saved.Error );
+            return;
+        }
+        cNeighbours graph;
+        while( state.KeepRunning() )
+        {
+            LoadGraph( saved.Path, graph );
+            Bench::DoNotOptimize( graph.FlatData().size() );
+        }
+        state.SetItemsPerIteration( (long long) saved.Frame.Graph.FlatData().size() );
+        state.SetLabel( "per entry, copied" );
+    }
+    BENCHMARK( BM_UMatrixLoad )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+
+    void BM_UMatrixLoadView( Bench::cState& state )
+    {
+        const sSavedGraph saved( (int) state.Range() );
+        if( saved.Error != nullptr )
+        {
+            state.SkipWithError( saved.Error );
+            return;
+        }
+        sMatrixView<Core::sIndexFloat> view;
+        std::vector<Core::cUID> keyStorage;
+        while( state.KeepRunning() )
+        {
+            cMmapReader reader;
+            Core::cVec<const Core::cUID> keys;
+            LoadGraphView( reader, saved.Path, view, keyStorage, keys );
+            Bench::DoNotOptimize( view.Matrix.size() + keys.size() );
+        }
+        state.SetItemsPerIteration( (long long) saved.Frame.Graph.FlatData().size() );
+        state.SetLabel( "per entry, mapped" );
+    }
+    BENCHMARK( BM_UMatrixLoadView )->Arg( 100 )->Arg( 300 )->Arg( 1000 );
+}
+
+BENCHMARK_MAIN()
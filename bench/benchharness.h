@@ -0,0 +1,414 @@
+//======================================================================================================
+// Minimal Google-Benchmark-style harness for the capture pipeline microbenchmarks
+//======================================================================================================
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace Bench
+{
+    /// <summary>Keeps the compiler from optimizing away a value computed inside a benchmark loop.</summary>
+    template<typename T>
+    inline void DoNotOptimize( const T& value )
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        asm volatile( "" : : "r,m"( value ) : "memory" );
+#else
+        static volatile const void* sSink;
+        sSink = &value;
+#endif
+    }
+
+    /// <summary>Per-run state handed to a benchmark function. Loop with <code>while( state.KeepRunning() )</code>.</summary>
+    class cState
+    {
+    public:
+        cState( long long iterations, long long arg ) : mMaxIterations( iterations ), mArg( arg ) { }
+
+        bool KeepRunning()
+        {
+            if( mIterations == 0 )
+            {
+                mStart = std::chrono::steady_clock::now();
+            }
+            if( mIterations < mMaxIterations )
+            {
+                ++mIterations;
+                return true;
+            }
+            mStop = std::chrono::steady_clock::now();
+            return false;
+        }
+
+        /// <summary>The argument registered with Arg(), or zero.</summary>
+        long long Range() const { return mArg; }
+
+        long long Iterations() const { return mIterations; }
+
+        /// <summary>Number of items (markers, points, bytes...) processed per iteration, for per-item timing.</summary>
+        void SetItemsPerIteration( long long items ) { mItemsPerIteration = items; }
+        long long ItemsPerIteration() const { return mItemsPerIteration; }
+
+        void SetLabel( const std::string& label ) { mLabel = label; }
+        const std::string& Label() const { return mLabel; }
+
+        /// <summary>Mark the run as skipped (e.g. no frame data available).</summary>
+        void SkipWithError( const char* message ) { mError = message; mMaxIterations = 0; }
+        const std::string& Error() const { return mError; }
+
+        /// <summary>Leave setup or cleanup inside the loop out of the timing (each pair costs two clock reads).</summary>
+        void PauseTiming() { mPauseStart = std::chrono::steady_clock::now(); }
+        void ResumeTiming() { mPaused += std::chrono::steady_clock::now() - mPauseStart; }
+
+        double ElapsedSeconds() const { return std::chrono::duration<double>( mStop - mStart - mPaused ).count(); }
+
+    private:
+        long long mMaxIterations;
+        long long mIterations = 0;
+        long long mArg;
+        long long mItemsPerIteration = 0;
+        std::string mLabel;
+        std::string mError;
+        std::chrono::steady_clock::time_point mStart;
+        std::chrono::steady_clock::time_point mStop;
+        std::chrono::steady_clock::time_point mPauseStart;
+        std::chrono::steady_clock::duration mPaused{ 0 };
+    };
+
+    using BenchFunction = void( * )( cState& );
+
+    /// <summary>A registered benchmark and the arguments it should be run with.</summary>
+    class cBenchmark
+    {
+    public:
+        cBenchmark( const char* name, BenchFunction function ) : mName( name ), mFunction( function ) { }
+
+        cBenchmark* Arg( long long arg ) { mArgs.push_back( arg ); return this; }
+
+        const std::string& Name() const { return mName; }
+        BenchFunction Function() const { return mFunction; }
+        const std::vector<long long>& Args() const { return mArgs; }
+
+    private:
+        std::string mName;
+        BenchFunction mFunction;
+        std::vector<long long> mArgs;
+    };
+
+    inline std::vector<cBenchmark*>& Registry()
+    {
+        static std::vector<cBenchmark*> sRegistry;
+        return sRegistry;
+    }
+
+    inline cBenchmark* Register( const char* name, BenchFunction function )
+    {
+        cBenchmark* benchmark = new cBenchmark( name, function );
+        Registry().push_back( benchmark );
+        return benchmark;
+    }
+
+    /// <summary>Timing of one benchmark argument, as printed to the console and written to JSON.</summary>
+    struct sResult
+    {
+        std::string Name;               // "BM_Name" or "BM_Name/arg"
+        long long Iterations = 0;
+        double NsPerIteration = 0;      // Wall clock
+        long long ItemsPerIteration = 0;
+        std::string Label;
+        std::string Error;              // Set when the benchmark skipped itself
+        int Repetition = -1;            // Index among --benchmark_repetitions runs, or -1 without repetitions
+    };
+
+    /// <summary>Run one benchmark argument, growing the iteration count until the run lasts at least minSeconds.</summary>
+    inline sResult RunOne( const cBenchmark& benchmark, long long arg, bool hasArg, double minSeconds )
+    {
+        sResult result;
+        result.Name = benchmark.Name();
+        if( hasArg )
+        {
+            result.Name += "/" + std::to_string( arg );
+        }
+
+        long long iterations = 1;
+        for( ;; )
+        {
+            cState state( iterations, arg );
+            benchmark.Function()( state );
+
+            if( !state.Error().empty() )
+            {
+                result.Error = state.Error();
+                return result;
+            }
+
+            double elapsed = state.ElapsedSeconds();
+            if( elapsed >= minSeconds || iterations >= ( 1LL << 40 ) )
+            {
+                result.Iterations = state.Iterations();
+                result.NsPerIteration = elapsed * 1e9 / double( state.Iterations() );
+                result.ItemsPerIteration = state.ItemsPerIteration();
+                result.Label = state.Label();
+                return result;
+            }
+
+            // Aim a little past the target so the next run is usually the last.
+            double scale = ( elapsed > 0 ? 1.4 * minSeconds / elapsed : 10.0 );
+            scale = ( scale < 2.0 ? 2.0 : ( scale > 10.0 ? 10.0 : scale ) );
+            iterations = (long long) ( iterations * scale );
+        }
+    }
+
+    inline void PrintResult( const sResult& result )
+    {
+        if( !result.Error.empty() )
+        {
+            printf( "%-48s SKIPPED: %s\n", result.Name.c_str(), result.Error.c_str() );
+            return;
+        }
+        printf( "%-48s %14.1f ns %12lld iterations", result.Name.c_str(), result.NsPerIteration, result.Iterations );
+        if( result.ItemsPerIteration > 0 )
+        {
+            printf( " %10.2f ns/item", result.NsPerIteration / double( result.ItemsPerIteration ) );
+        }
+        if( !result.Label.empty() )
+        {
+            printf( " %s", result.Label.c_str() );
+        }
+        printf( "\n" );
+    }
+
+    inline std::string JsonString( const std::string& text )
+    {
+        std::string out = "\"";
+        for( char c : text )
+        {
+            if( c == '"' || c == '\\' )
+            {
+                out += '\\';
+                out += c;
+            }
+            else if( (unsigned char) c < 0x20 )
+            {
+                char escape[8];
+                snprintf( escape, sizeof( escape ), "\\u%04x", c );
+                out += escape;
+            }
+            else
+            {
+                out += c;
+            }
+        }
+        return out + "\"";
+    }
+
+    /// <summary>
+    /// Write results in Google Benchmark's JSON layout, so its compare.py and tools/benchcompare read them.
+    /// Only wall-clock time is measured; cpu_time repeats real_time. Repetitions are written one entry each,
+    /// with their repetition_index, as Google Benchmark does.
+    /// </summary>
+    inline void WriteJson( FILE* out, const std::vector<sResult>& results, const char* executable )
+    {
+        char date[64] = "";
+        const time_t now = time( nullptr );
+        const tm* local = localtime( &now );
+        if( local )
+        {
+            strftime( date, sizeof( date ), "%Y-%m-%dT%H:%M:%S", local );
+        }
+#if defined(_MSC_VER)
+        const std::string compiler = "MSVC " + std::to_string( _MSC_VER );
+#elif defined(__VERSION__)
+        const std::string compiler = __VERSION__;
+#else
+        const std::string compiler = "unknown";
+#endif
+#ifdef NDEBUG
+        const char* buildType = "release";
+#else
+        const char* buildType = "debug";
+#endif
+
+        fprintf( out, "{\n  \"context\": {\n" );
+        fprintf( out, "    \"date\": %s,\n", JsonString( date ).c_str() );
+        fprintf( out, "    \"executable\": %s,\n", JsonString( executable ).c_str() );
+        fprintf( out, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency() );
+        fprintf( out, "    \"compiler\": %s,\n", JsonString( compiler ).c_str() );
+        fprintf( out, "    \"library_build_type\": \"%s\"\n  },\n", buildType );
+        fprintf( out, "  \"benchmarks\": [" );
+        for( size_t i = 0; i < results.size(); ++i )
+        {
+            const sResult& result = results[i];
+            fprintf( out, "%s\n    {\n      \"name\": %s,\n      \"run_name\": %s,\n      \"run_type\": \"iteration\",\n",
+                i ? "," : "", JsonString( result.Name ).c_str(), JsonString( result.Name ).c_str() );
+            if( !result.Error.empty() )
+            {
+                fprintf( out, "      \"error_occurred\": true,\n      \"error_message\": %s\n    }", JsonString( result.Error ).c_str() );
+                continue;
+            }
+            if( result.Repetition >= 0 )
+            {
+                fprintf( out, "      \"repetition_index\": %d,\n", result.Repetition );
+            }
+            fprintf( out, "      \"iterations\": %lld,\n      \"real_time\": %.4f,\n      \"cpu_time\": %.4f,\n      \"time_unit\": \"ns\"",
+                result.Iterations, result.NsPerIteration, result.NsPerIteration );
+            if( result.ItemsPerIteration > 0 && result.NsPerIteration > 0 )
+            {
+                fprintf( out, ",\n      \"items_per_second\": %.6g", result.ItemsPerIteration * 1e9 / result.NsPerIteration );
+            }
+            if( !result.Label.empty() )
+            {
+                fprintf( out, ",\n      \"label\": %s", JsonString( result.Label ).c_str() );
+            }
+            fprintf( out, "\n    }" );
+        }
+        fprintf( out, "\n  ]\n}\n" );
+    }
+
+    /// <summary>
+    /// Run every registered benchmark whose name contains the filter. Takes a subset of Google Benchmark's flags:
+    ///   [filter] | --benchmark_filter=text    substring of "BM_Name/arg" (not a regex)
+    ///   --benchmark_min_time=seconds          per run, default 0.25
+    ///   --benchmark_repetitions=n             run each n times; print the median, write every repetition
+    ///   --benchmark_format=console|json       what goes to stdout
+    ///   --benchmark_out=file                  also write JSON to file
+    ///   --benchmark_list_tests                print the names and exit
+    /// </summary>
+    inline int RunAll( int argc, char* argv[] )
+    {
+        std::string filter;
+        double minSeconds = 0.25;
+        int repetitions = 1;
+        bool json = false;
+        bool list = false;
+        std::string outPath;
+
+        for( int i = 1; i < argc; ++i )
+        {
+            const std::string arg = argv[i];
+            auto value = [&arg]( const char* flag ) -> const char*
+            {
+                const size_t length = strlen( flag );
+                return ( arg.compare( 0, length, flag ) == 0 ? arg.c_str() + length : nullptr );
+            };
+            const char* v;
+            if( ( v = value( "--benchmark_filter=" ) ) )
+            {
+                filter = v;
+            }
+            else if( ( v = value( "--benchmark_min_time=" ) ) )
+            {
+                minSeconds = atof( v );     // Google's "0.5s" form parses too
+            }
+            else if( ( v = value( "--benchmark_repetitions=" ) ) )
+            {
+                repetitions = ( atoi( v ) > 1 ? atoi( v ) : 1 );
+            }
+            else if( ( v = value( "--benchmark_format=" ) ) && ( !strcmp( v, "json" ) || !strcmp( v, "console" ) ) )
+            {
+                json = !strcmp( v, "json" );
+            }
+            else if( ( v = value( "--benchmark_out=" ) ) )
+            {
+                outPath = v;
+            }
+            else if( arg == "--benchmark_list_tests" || arg == "--benchmark_list_tests=true" )
+            {
+                list = true;
+            }
+            else if( arg[0] != '-' && filter.empty() )
+            {
+                filter = arg;
+            }
+            else
+            {
+                fprintf( stderr, "%s: unknown argument %s\n", argv[0], arg.c_str() );
+                return 2;
+            }
+        }
+
+        std::vector<sResult> results;   // Written: every repetition
+        for( const cBenchmark* benchmark : Registry() )
+        {
+            std::vector<std::pair<long long, bool>> runs;
+            if( benchmark->Args().empty() )
+            {
+                runs.emplace_back( 0, false );
+            }
+            for( long long arg : benchmark->Args() )
+            {
+                runs.emplace_back( arg, true );
+            }
+
+            for( const auto& run : runs )
+            {
+                const std::string name = benchmark->Name() + ( run.second ? "/" + std::to_string( run.first ) : "" );
+                if( !filter.empty() && name.find( filter ) == std::string::npos )
+                {
+                    continue;
+                }
+                if( list )
+                {
+                    printf( "%s\n", name.c_str() );
+                    continue;
+                }
+
+                std::vector<sResult> repeats;
+                for( int r = 0; r < repetitions; ++r )
+                {
+                    repeats.push_back( RunOne( *benchmark, run.first, run.second, minSeconds ) );
+                    repeats.back().Repetition = ( repetitions > 1 ? r : -1 );
+                    if( !repeats.back().Error.empty() )
+                    {
+                        // A skip stands for the whole benchmark, not for one repetition of it.
+                        repeats.erase( repeats.begin(), repeats.end() - 1 );
+                        break;
+                    }
+                }
+                results.insert( results.end(), repeats.begin(), repeats.end() );
+                if( !json )
+                {
+                    std::sort( repeats.begin(), repeats.end(), []( const sResult& a, const sResult& b ) { return a.NsPerIteration < b.NsPerIteration; } );
+                    PrintResult( repeats[repeats.size() / 2] );
+                    fflush( stdout );
+                }
+            }
+        }
+
+        if( json && !list )
+        {
+            WriteJson( stdout, results, argv[0] );
+        }
+        if( !outPath.empty() && !list )
+        {
+            FILE* out = fopen( outPath.c_str(), "w" );
+            if( !out )
+            {
+                fprintf( stderr, "%s: cannot write %s\n", argv[0], outPath.c_str() );
+                return 1;
+            }
+            WriteJson( out, results, argv[0] );
+            fclose( out );
+        }
+        return 0;
+    }
+}
+
+#define BENCH_CONCAT_( a, b ) a##b
+#define BENCH_CONCAT( a, b ) BENCH_CONCAT_( a, b )
+
+/// <summary>Register a benchmark function. Chain ->Arg(n) to run it with several arguments.</summary>
+#define BENCHMARK( fn ) \
+    static Bench::cBenchmark* BENCH_CONCAT( sBenchmark_, __LINE__ ) = Bench::Register( #fn, fn )
+
+#define BENCHMARK_MAIN() \
+    int main( int argc, char* argv[] ) { return Bench::RunAll( argc, argv ); }
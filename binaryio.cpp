@@ -0,0 +1,212 @@
+//======================================================================================================
+// Binary I/O: buffered file writer and memory-mapped reader for Core's Save/Load templates
+//======================================================================================================
+#include "binaryio.h"
+
+#include <cstdint>
+
+namespace Capture
+{
+    namespace
+    {
+        size_t PaddingBytes( unsigned long long position, size_t alignment, size_t ahead )
+        {
+            if( alignment <= 1 )
+            {
+                return 0;
+            }
+            const size_t misalignment = (size_t) ( ( position + ahead ) % alignment );
+            return ( misalignment == 0 ? 0 : alignment - misalignment );
+        }
+    }
+
+    //==================================================================================================
+    // cFileWriter
+    //==================================================================================================
+
+    cFileWriter::~cFileWriter()
+    {
+        Close();
+    }
+
+    bool cFileWriter::Open( const char* path, size_t bufferBytes )
+    {
+        Close();
+
+        mFile = fopen( path, "wb" );
+        if( mFile == nullptr )
+        {
+            return false;
+        }
+
+        // This class is the buffer; a second one inside the CRT would only add a copy.
+        setvbuf( mFile, nullptr, _IONBF, 0 );
+
+        mCapacity = ( bufferBytes < 4096 ? 4096 : bufferBytes );
+        mBuffer.reset( new unsigned char[mCapacity] );
+        mUsed = 0;
+        mFlushed = 0;
+        mFailed = false;
+        return true;
+    }
+
+    bool cFileWriter::Close()
+    {
+        if( mFile == nullptr )
+        {
+            return !mFailed;
+        }
+
+        Flush();
+        if( fclose( mFile ) != 0 )
+        {
+            mFailed = true;
+        }
+        mFile = nullptr;
+        mBuffer.reset();
+        mCapacity = 0;
+        return !mFailed;
+    }
+
+    bool cFileWriter::Flush()
+    {
+        if( mUsed > 0 )
+        {
+            if( mFile == nullptr || fwrite( mBuffer.get(), 1, mUsed, mFile ) != mUsed )
+            {
+                mFailed = true;
+            }
+            mFlushed += mUsed;
+            mUsed = 0;
+        }
+        return !mFailed;
+    }
+
+    void cFileWriter::WriteLarge( const unsigned char* data, size_t bytes )
+    {
+        if( mFile == nullptr )
+        {
+            mFailed = true;
+            return;
+        }
+
+        // Top up the buffer so every write to the file is a whole block, until the rest is a block or more.
+        const size_t fill = mCapacity - mUsed;
+        memcpy( mBuffer.get() + mUsed, data, fill );
+        mUsed = mCapacity;
+        data += fill;
+        bytes -= fill;
+        Flush();
+
+        if( bytes >= mCapacity )
+        {
+            if( fwrite( data, 1, bytes, mFile ) != bytes )
+            {
+                mFailed = true;
+            }
+            mFlushed += bytes;
+            return;
+        }
+
+        memcpy( mBuffer.get(), data, bytes );
+        mUsed = bytes;
+    }
+
+    void cFileWriter::WriteWString( const std::wstring& value )
+    {
+        std::vector<uint16_t> units;
+        units.reserve( value.size() );
+        for( wchar_t c : value )
+        {
+            const uint32_t codePoint = (uint32_t) c;
+            if( codePoint > 0xFFFF )
+            {
+                units.push_back( (uint16_t) ( 0xD800 + ( ( codePoint - 0x10000 ) >> 10 ) ) );
+                units.push_back( (uint16_t) ( 0xDC00 + ( ( codePoint - 0x10000 ) & 0x3FF ) ) );
+            }
+            else
+            {
+                units.push_back( (uint16_t) codePoint );
+            }
+        }
+
+        WriteLongLong( (long long) units.size() );
+        if( !units.empty() )
+        {
+            WriteData( reinterpret_cast<const unsigned char*>( units.data() ), units.size() * sizeof( uint16_t ) );
+        }
+    }
+
+    void cFileWriter::Pad( size_t alignment, size_t ahead )
+    {
+        static const unsigned char kZeros[64] = {};
+        for( size_t padding = PaddingBytes( Tell(), alignment, ahead ); padding > 0; )
+        {
+            const size_t bytes = ( padding < sizeof( kZeros ) ? padding : sizeof( kZeros ) );
+            WriteData( kZeros, bytes );
+            padding -= bytes;
+        }
+    }
+
+    //==================================================================================================
+    // cMmapReader
+    //==================================================================================================
+
+    bool cMmapReader::Open( const char* path )
+    {
+        Close();
+        if( !mFile.Open( path ) )
+        {
+            return false;
+        }
+        mFile.AdviseSequential();
+        return true;
+    }
+
+    void cMmapReader::Close()
+    {
+        mFile.Close();
+        mOffset = 0;
+        mFailed = false;
+    }
+
+    std::wstring cMmapReader::ReadWString()
+    {
+        const long long count = ReadLongLong();
+        if( mFailed || count < 0 || (unsigned long long) count > ( mFile.Size() - mOffset ) / sizeof( uint16_t ) )
+        {
+            mFailed = true;
+            mOffset = mFile.Size();
+            return std::wstring();
+        }
+
+        const unsigned char* source = Take( (size_t) count * sizeof( uint16_t ) );
+        std::wstring value;
+        value.reserve( (size_t) count );
+        for( long long i = 0; i < count; ++i )
+        {
+            uint16_t unit;
+            memcpy( &unit, source + i * sizeof( uint16_t ), sizeof( unit ) );
+
+            // Windows keeps surrogate pairs as they are; 32-bit wchar_t joins them into one code point.
+            if( sizeof( wchar_t ) == 4 && unit >= 0xD800 && unit < 0xDC00 && i + 1 < count )
+            {
+                uint16_t low;
+                memcpy( &low, source + ( i + 1 ) * sizeof( uint16_t ), sizeof( low ) );
+                if( low >= 0xDC00 && low < 0xE000 )
+                {
+                    value.push_back( (wchar_t) ( 0x10000 + ( ( (uint32_t) unit - 0xD800 ) << 10 ) + ( low - 0xDC00 ) ) );
+                    ++i;
+                    continue;
+                }
+            }
+            value.push_back( (wchar_t) unit );
+        }
+        return value;
+    }
+
+    void cMmapReader::Pad( size_t alignment, size_t ahead )
+    {
+        Take( PaddingBytes( mOffset, alignment, ahead ) );
+    }
+}
@@ -0,0 +1,247 @@
+//======================================================================================================
+// Binary I/O: buffered file writer and memory-mapped reader for Core's Save/Load templates
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Core/UMatrix.h"
+#include "mappedfile.h"
+
+namespace Capture
+{
+    //==================================================================================================
+    // Both classes implement the writer/reader interface that Core::cMatrix, Core::cUMatrix and
+    // Core::cUIndex use in Save()/Load(): WriteByte/Int/LongLong/Data/WString and the matching Read
+    // calls. Values are stored in host byte order with no padding, exactly as Core's WriteVector lays
+    // them out. Wide strings are stored as a long long count of UTF-16 code units followed by the
+    // units, so files move between Windows (16-bit wchar_t) and Linux (32-bit wchar_t).
+    //==================================================================================================
+
+    /// <summary>
+    /// Writes through a large block buffer, so the many small WriteInt/WriteLongLong calls of a Save()
+    /// cost a memcpy each. Writes at least a block long go straight to the file.
+    /// </summary>
+    class cFileWriter
+    {
+    public:
+        static constexpr size_t kDefaultBufferBytes = 1 << 20;
+
+        cFileWriter() = default;
+        ~cFileWriter();
+
+        cFileWriter( const cFileWriter& ) = delete;
+        cFileWriter& operator=( const cFileWriter& ) = delete;
+
+        bool Open( const char* path, size_t bufferBytes = kDefaultBufferBytes );
+
+        /// <summary>Flush and close. Returns false if any write failed since Open().</summary>
+        bool Close();
+
+        bool IsOpen() const { return mFile != nullptr; }
+        bool Failed() const { return mFailed; }
+
+        /// <summary>Bytes written so far, including those still buffered.</summary>
+        unsigned long long Tell() const { return mFlushed + mUsed; }
+
+        void WriteByte( unsigned char value ) { WriteData( &value, sizeof( value ) ); }
+        void WriteInt( int value ) { WriteData( reinterpret_cast<const unsigned char*>( &value ), sizeof( value ) ); }
+        void WriteLongLong( long long value ) { WriteData( reinterpret_cast<const unsigned char*>( &value ), sizeof( value ) ); }
+        void WriteWString( const std::wstring& value );
+
+        void WriteData( const unsigned char* data, size_t bytes )
+        {
+            if( bytes <= mCapacity - mUsed )
+            {
+                memcpy( mBuffer.get() + mUsed, data, bytes );
+                mUsed += bytes;
+                return;
+            }
+            WriteLarge( data, bytes );
+        }
+
+        /// <summary>
+        /// Write zero bytes until Tell() + ahead is a multiple of alignment. A cMmapReader calling Pad() with
+        /// the same arguments at the same point skips them. Use it to place a vector's elements, which
+        /// follow ahead bytes of headers, where ReadVectorView() can alias them.
+        /// </summary>
+        void Pad( size_t alignment, size_t ahead = 0 );
+
+        /// <summary>Hand the buffered bytes to the OS.</summary>
+        bool Flush();
+
+    private:
+        void WriteLarge( const unsigned char* data, size_t bytes );
+
+        FILE* mFile = nullptr;
+        std::unique_ptr<unsigned char[]> mBuffer;
+        size_t mCapacity = 0;
+        size_t mUsed = 0;
+        unsigned long long mFlushed = 0;
+        bool mFailed = false;
+    };
+
+    /// <summary>
+    /// Reads a file through a read-only mapping. Scalars are a bounds check and a memcpy; ReadData copies
+    /// straight from the mapped pages. Reading past the end sets Failed(), returns zeros and stops the
+    /// cursor, so a truncated file never reads out of bounds.
+    /// </summary>
+    class cMmapReader
+    {
+    public:
+        bool Open( const char* path );
+        void Close();
+
+        bool IsOpen() const { return mFile.IsOpen(); }
+        bool Failed() const { return mFailed; }
+
+        unsigned long long Tell() const { return mOffset; }
+        size_t Size() const { return mFile.Size(); }
+        bool AtEnd() const { return mOffset >= mFile.Size(); }
+
+        unsigned char ReadByte() { return ReadScalar<unsigned char>(); }
+        int ReadInt() { return ReadScalar<int>(); }
+        long long ReadLongLong() { return ReadScalar<long long>(); }
+        std::wstring ReadWString();
+
+        void ReadData( unsigned char* data, size_t bytes )
+        {
+            const unsigned char* source = Take( bytes );
+            if( source != nullptr )
+            {
+                memcpy( data, source, bytes );
+            }
+            else
+            {
+                memset( data, 0, bytes );
+            }
+        }
+
+        /// <summary>Skip the padding cFileWriter::Pad() wrote with the same arguments.</summary>
+        void Pad( size_t alignment, size_t ahead = 0 );
+
+        /// <summary>
+        /// Read a vector written by Core::WriteVector without copying it. When the element type is trivially
+        /// copyable and the elements are suitably aligned in the mapping, the view points straight into
+        /// the file. Otherwise they are copied into storage and the view points there. Either way, the view
+        /// lives as long as the reader stays open and storage is untouched.
+        /// </summary>
+        template<typename VT>
+        Core::cVec<const VT> ReadVectorView( std::vector<VT>& storage )
+        {
+            static_assert( std::is_trivially_copyable<VT>::value, "Only trivially copyable elements can be viewed in place" );
+
+            const int elementBytes = ReadInt();
+            const long long count = ReadLongLong();
+            if( mFailed || elementBytes != (int) sizeof( VT ) || count < 0
+                || (unsigned long long) count > ( mFile.Size() - mOffset ) / sizeof( VT ) )
+            {
+                mFailed = true;
+                return Core::cVec<const VT>();
+            }
+            if( count == 0 )
+            {
+                return Core::cVec<const VT>();
+            }
+
+            const unsigned char* source = Take( (size_t) count * sizeof( VT ) );
+            if( reinterpret_cast<uintptr_t>( source ) % alignof( VT ) == 0 )
+            {
+                const VT* begin = reinterpret_cast<const VT*>( source );
+                return Core::cVec<const VT>( begin, begin + count );
+            }
+
+            storage.resize( (size_t) count );
+            memcpy( static_cast<void*>( storage.data() ), source, (size_t) count * sizeof( VT ) );
+            return Core::cVec<const VT>( storage.data(), storage.data() + count );
+        }
+
+    private:
+        template<typename T>
+        T ReadScalar()
+        {
+            T value;
+            ReadData( reinterpret_cast<unsigned char*>( &value ), sizeof( value ) );
+            return value;
+        }
+
+        const unsigned char* Take( size_t bytes )
+        {
+            if( mFailed || bytes > mFile.Size() - mOffset )
+            {
+                mFailed = true;
+                mOffset = mFile.Size();
+                return nullptr;
+            }
+            const unsigned char* source = mFile.Data() + mOffset;
+            mOffset += bytes;
+            return source;
+        }
+
+        cMappedFile mFile;
+        size_t mOffset = 0;
+        bool mFailed = false;
+    };
+
+    /// <summary>
+    /// A cMatrix loaded as views into a cMmapReader's mapping: the row offsets and the data are used in
+    /// place wherever alignment allows and copied into the storage vectors otherwise.
+    /// </summary>
+    template<class T>
+    struct sMatrixView
+    {
+        Core::cMat<const T> Matrix;
+        std::vector<int> RowOffsetStorage;
+        std::vector<T> DataStorage;
+    };
+
+    /// <summary>Bytes Core::cMatrix::Save() writes before the first row offset: revision, element size, count.</summary>
+    constexpr size_t kMatrixRowOffsetsAhead = sizeof( unsigned char ) + sizeof( int ) + sizeof( long long );
+
+    /// <summary>Save a matrix so that LoadMatrixView() can alias its row offsets, and its data when T needs
+    /// no more than int alignment. Load with LoadMatrixView(), or Pad() then cMatrix::Load().</summary>
+    template<class T>
+    void SaveMatrixAligned( cFileWriter& writer, const Core::cMatrix<T>& matrix )
+    {
+        writer.Pad( alignof( int ), kMatrixRowOffsetsAhead );
+        matrix.Save( writer );
+    }
+
+    /// <summary>Read a matrix written by SaveMatrixAligned() without copying where possible. Returns false
+    /// for an unknown revision or a truncated or inconsistent file.</summary>
+    template<class T>
+    bool LoadMatrixView( cMmapReader& reader, sMatrixView<T>& view )
+    {
+        reader.Pad( alignof( int ), kMatrixRowOffsetsAhead );
+        if( reader.ReadByte() != 5 )    // cMatrix::Save() revision
+        {
+            return false;
+        }
+
+        const Core::cVec<const int> rowOffsets = reader.ReadVectorView( view.RowOffsetStorage );
+        const Core::cVec<const T> data = reader.ReadVectorView( view.DataStorage );
+        if( reader.Failed() || rowOffsets.empty() || rowOffsets[0] != 0 || (size_t) rowOffsets.back() != data.size() )
+        {
+            return false;
+        }
+
+        // Rows must not run backwards; with the first at 0 and the last at the end, none leaves the data.
+        for( size_t row = 1; row < rowOffsets.size(); ++row )
+        {
+            if( rowOffsets[row] < rowOffsets[row - 1] )
+            {
+                return false;
+            }
+        }
+
+        view.Matrix = Core::cMat<const T>( rowOffsets, data );
+        return true;
+    }
+}
@@ -0,0 +1,448 @@
+//======================================================================================================
+// Capture engine: decouples Motive frame acquisition from logging and trial logic
+//======================================================================================================
+#include "captureengine.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+
+#include "Core/Platform.h"
+#include "tracepoint.h"
+
+#ifdef __PLATFORM__LINUX__
+#include <pthread.h>
+#include <sched.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+using namespace MotiveAPI;
+
+namespace
+{
+    // Spin briefly, then yield, then sleep. Keeps wake-up latency low right after a frame without
+    // burning a whole core between frames.
+    class cBackoff
+    {
+    public:
+        void Pause()
+        {
+            if( mCount < 64 )
+            {
+                ++mCount;
+            }
+            else if( mCount < 128 )
+            {
+                ++mCount;
+                std::this_thread::yield();
+            }
+            else
+            {
+                std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+            }
+        }
+
+        void Reset() { mCount = 0; }
+
+    private:
+        int mCount = 0;
+    };
+}
+
+namespace Capture
+{
+    bool PinCurrentThread( int core )
+    {
+        if( core < 0 )
+        {
+            return false;
+        }
+#ifdef __PLATFORM__LINUX__
+        cpu_set_t set;
+        CPU_ZERO( &set );
+        CPU_SET( core, &set );
+        return ( pthread_setaffinity_np( pthread_self(), sizeof( set ), &set ) == 0 );
+#else
+        HANDLE thread = GetCurrentThread();
+        if( SetThreadAffinityMask( thread, DWORD_PTR( 1 ) << core ) == 0 )
+        {
+            return false;
+        }
+        SetThreadPriority( thread, THREAD_PRIORITY_TIME_CRITICAL );
+        return true;
+#endif
+    }
+
+    namespace
+    {
+        template<typename T>
+        void CopyColumn( T* dst, const T* src, int count )
+        {
+            ::memcpy( dst, src, count * sizeof( T ) );
+        }
+    }
+
+    void sFrameRecord::CopyFrom( const sFrameRecord& other )
+    {
+        ::memcpy( this, &other, offsetof( sFrameRecord, Calibration ) );
+        Calibration.Quality = other.Calibration.Quality;
+        Calibration.CamerasLacking = other.Calibration.CamerasLacking;
+        CopyColumn( Calibration.CameraID, other.Calibration.CameraID, other.Calibration.Listed() );
+        CopyColumn( Calibration.Samples, other.Calibration.Samples, other.Calibration.Listed() );
+
+        const int count = other.MarkerCount;
+        CopyColumn( X, other.X, count );
+        CopyColumn( Y, other.Y, count );
+        CopyColumn( Z, other.Z, count );
+        CopyColumn( Residual, other.Residual, count );
+        CopyColumn( IDHigh, other.IDHigh, count );
+        CopyColumn( IDLow, other.IDLow, count );
+        CopyColumn( Flags, other.Flags, count );
+    }
+
+    void sFrameRecord::CopyFrom( const cFrameSnapshot& snapshot )
+    {
+        const int total = snapshot.Size();
+        const int count = ( total < kMaxFrameMarkers ? total : kMaxFrameMarkers );
+
+        TimeStamp = snapshot.TimeStamp();
+        FrameID = snapshot.FrameID();
+        TotalMarkers = total;
+        MarkerCount = count;
+
+        CopyColumn( X, snapshot.X(), count );
+        CopyColumn( Y, snapshot.Y(), count );
+        CopyColumn( Z, snapshot.Z(), count );
+        CopyColumn( Residual, snapshot.Residual(), count );
+        CopyColumn( IDHigh, snapshot.IDHigh(), count );
+        CopyColumn( IDLow, snapshot.IDLow(), count );
+        CopyColumn( Flags, snapshot.Flags(), count );
+    }
+
+    //==================================================================================================
+    // cFrameListener
+    //==================================================================================================
+
+    void cFrameListener::FrameAvailable()
+    {
+#if CAPTURE_LATENCY_PROBES
+        // Stored before the sequence is released, so the acquisition thread reads this notification's time.
+        mNotifyHostNs.store( HostTimeNs(), std::memory_order_relaxed );
+#endif
+        mSequence.fetch_add( 1, std::memory_order_release );
+    }
+
+    void cFrameListener::CameraConnected( int serialNumber )
+    {
+        mConnectionChanges.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    void cFrameListener::CameraDisconnected( int serialNumber )
+    {
+        mConnectionChanges.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    //==================================================================================================
+    // cCaptureEngine
+    //==================================================================================================
+
+    cCaptureEngine::cCaptureEngine( size_t ringCapacity )
+        : mRingCapacity( ringCapacity ), mScratch( new sFrameRecord() ), mSnapshot( kMaxFrameMarkers )
+    {
+    }
+
+    cCaptureEngine::~cCaptureEngine()
+    {
+        Stop();
+    }
+
+    void cCaptureEngine::AddConsumer( const char* name, FrameConsumer consumer )
+    {
+        if( Running() )
+        {
+            return;
+        }
+        mConsumers.emplace_back( new sConsumer( name, std::move( consumer ), mRingCapacity ) );
+    }
+
+    bool cCaptureEngine::Start()
+    {
+        if( Running() )
+        {
+            return false;
+        }
+
+        // Frames can be announced as soon as the listener is attached, before the acquisition thread runs;
+        // counting from here makes the first Update() pick them up instead of waiting for the next one.
+        const unsigned long long startSequence = mListener.Sequence();
+        mCalibrationState = -1;
+        AttachListener( &mListener );
+
+        {
+            std::lock_guard<std::mutex> lock( mCommandLock );
+            mRunning.store( true, std::memory_order_release );
+        }
+        mAcquiring.store( true, std::memory_order_release );
+
+        for( std::unique_ptr<sConsumer>& consumer : mConsumers )
+        {
+            sConsumer* c = consumer.get();
+            c->Thread = std::thread( [this, c]() { ConsumerLoop( *c ); } );
+        }
+        mAcquisitionThread = std::thread( [this, startSequence]() { AcquisitionLoop( startSequence ); } );
+
+        return true;
+    }
+
+    void cCaptureEngine::Stop()
+    {
+        if( !Running() )
+        {
+            return;
+        }
+
+        // Stop producing first so the consumers see a ring that only drains.
+        mAcquiring.store( false, std::memory_order_release );
+        if( mAcquisitionThread.joinable() )
+        {
+            mAcquisitionThread.join();
+        }
+
+        // Commands still queued run here, and later ones on their caller.
+        {
+            std::lock_guard<std::mutex> lock( mCommandLock );
+            mRunning.store( false, std::memory_order_release );
+        }
+        RunCommands();
+
+        for( std::unique_ptr<sConsumer>& consumer : mConsumers )
+        {
+            if( consumer->Thread.joinable() )
+            {
+                consumer->Thread.join();
+            }
+        }
+
+        DetachListener();
+    }
+
+    void cCaptureEngine::Post( ApiCommand command )
+    {
+        {
+            std::lock_guard<std::mutex> lock( mCommandLock );
+            if( Running() )
+            {
+                mCommands.push_back( std::move( command ) );
+                mCommandsPending.store( true, std::memory_order_release );
+                return;
+            }
+        }
+        std::lock_guard<std::mutex> execute( mExecuteLock );
+        command();
+    }
+
+    void cCaptureEngine::RunCommands()
+    {
+        std::lock_guard<std::mutex> execute( mExecuteLock );
+        {
+            std::lock_guard<std::mutex> lock( mCommandLock );
+            mRunningCommands.swap( mCommands );
+            mCommandsPending.store( false, std::memory_order_relaxed );
+        }
+        for( ApiCommand& command : mRunningCommands )
+        {
+            command();
+        }
+        mRunningCommands.clear();
+    }
+
+    void cCaptureEngine::FillRecord( sFrameRecord& record, unsigned long long sequence )
+    {
+        TRACE_SCOPE( Frame, "fill_record" );
+        record.Sequence = sequence;
+        record.HostTimeNs = HostTimeNs();
+        record.CalibrationState = (int) CalibrationState();
+        FillCalibration( record.Calibration, record.CalibrationState );
+
+        record.Timecode.Valid = false;
+        sTimecode timecode;
+        if( mCaptureTimecode && FrameTimeCode( timecode ) )
+        {
+            record.Timecode.Hours = timecode.hh;
+            record.Timecode.Minutes = timecode.mm;
+            record.Timecode.Seconds = timecode.ss;
+            record.Timecode.Frames = timecode.ff;
+            record.Timecode.SubFrame = timecode.subFrame;
+            record.Timecode.DropFrame = timecode.isDropFrame;
+            record.Timecode.Valid = true;
+        }
+
+        LATENCY_SCOPE( Snapshot );
+        mSnapshot.Capture();
+        record.CopyFrom( mSnapshot );
+
+        TRACE_COUNTER( Frame, "markers", record.TotalMarkers );
+        if( record.MarkerCount < record.TotalMarkers )
+        {
+            mTruncated.fetch_add( 1, std::memory_order_relaxed );
+        }
+    }
+
+    void cCaptureEngine::FillCalibration( sCalibrationProgress& progress, int state )
+    {
+        progress.Quality = -1;
+        progress.CamerasLacking = 0;
+        if( state == Wanding )
+        {
+            const std::vector<int> lacking = CalibrationCamerasLackingSamples();
+            progress.CamerasLacking = (int) lacking.size();
+            for( int i = 0; i < progress.Listed(); ++i )
+            {
+                progress.CameraID[i] = CameraID( lacking[i] );
+                progress.Samples[i] = CameraCalibrationSamples( lacking[i] );
+            }
+        }
+        else if( state >= PreparingSolver && state <= Complete && ( state != Complete || mCalibrationState != Complete ) )
+        {
+            // Once complete the quality no longer changes, so it is read on the first complete frame only.
+            progress.Quality = CurrentCalibrationQuality();
+        }
+        mCalibrationState = state;
+    }
+
+    void cCaptureEngine::AcquisitionLoop( unsigned long long startSequence )
+    {
+        PinCurrentThread( mAcquisitionCore );
+        SetLatencyThreadName( "acquisition" );
+        cTrace::SetThreadName( "acquisition" );
+
+        cBackoff backoff;
+        unsigned long long lastSequence = startSequence;
+
+        while( mAcquiring.load( std::memory_order_acquire ) )
+        {
+            if( mCommandsPending.load( std::memory_order_acquire ) )
+            {
+                TRACE_SCOPE( Frame, "api_commands" );
+                RunCommands();
+            }
+
+            const unsigned long long sequence = mListener.Sequence();
+            if( sequence == lastSequence )
+            {
+                backoff.Pause();
+                continue;
+            }
+            backoff.Reset();
+            LATENCY_SINCE( Wake, mListener.NotifyHostNs() );
+
+            LATENCY_START( updateStart );
+            eResult result;
+            {
+                TRACE_SCOPE( Frame, "update" );
+                result = Update();
+            }
+            LATENCY_SINCE( Update, updateStart );
+            if( result != kApiResult_Success )
+            {
+                mEmptyUpdates.fetch_add( 1, std::memory_order_relaxed );
+                lastSequence = sequence;
+                continue;
+            }
+
+            // Update() processes the latest frame, so any notifications beyond one since the last
+            // Update() are frames we never saw.
+            if( sequence - lastSequence > 1 )
+            {
+                mCoalesced.fetch_add( sequence - lastSequence - 1, std::memory_order_relaxed );
+            }
+            lastSequence = sequence;
+
+            FillRecord( *mScratch, sequence );
+            mAcquired.fetch_add( 1, std::memory_order_relaxed );
+
+            for( std::unique_ptr<sConsumer>& consumer : mConsumers )
+            {
+                sFrameRecord* slot = consumer->Ring.BeginWrite();
+                if( slot == nullptr )
+                {
+                    consumer->Overruns.fetch_add( 1, std::memory_order_relaxed );
+                    continue;
+                }
+                slot->CopyFrom( *mScratch );
+                consumer->Ring.Publish();
+            }
+        }
+    }
+
+    void cCaptureEngine::ConsumerLoop( sConsumer& consumer )
+    {
+        SetLatencyThreadName( consumer.Name.c_str() );
+        cTrace::SetThreadName( consumer.Name.c_str() );
+        cBackoff backoff;
+
+        for( ;; )
+        {
+            const sFrameRecord* record = consumer.Ring.BeginRead();
+            if( record == nullptr )
+            {
+                if( !mRunning.load( std::memory_order_acquire ) )
+                {
+                    break;
+                }
+                backoff.Pause();
+                continue;
+            }
+            backoff.Reset();
+
+            LATENCY_SINCE( Delivery, record->HostTimeNs );
+            {
+                TRACE_SCOPE( Pipeline, consumer.Name.c_str() );
+                consumer.Callback( *record );
+            }
+            consumer.Ring.Release();
+            consumer.Delivered.fetch_add( 1, std::memory_order_relaxed );
+        }
+    }
+
+    sCaptureStats cCaptureEngine::Stats() const
+    {
+        sCaptureStats stats;
+
+        stats.Notifications = mListener.Sequence();
+        stats.Acquired = mAcquired.load( std::memory_order_relaxed );
+        stats.EmptyUpdates = mEmptyUpdates.load( std::memory_order_relaxed );
+        stats.Coalesced = mCoalesced.load( std::memory_order_relaxed );
+        stats.Truncated = mTruncated.load( std::memory_order_relaxed );
+
+        for( const std::unique_ptr<sConsumer>& consumer : mConsumers )
+        {
+            sConsumerStats c;
+            c.Name = consumer->Name;
+            c.Delivered = consumer->Delivered.load( std::memory_order_relaxed );
+            c.Overruns = consumer->Overruns.load( std::memory_order_relaxed );
+            c.RingCapacity = consumer->Ring.Capacity();
+            stats.Consumers.push_back( c );
+        }
+
+        return stats;
+    }
+
+    void cCaptureEngine::ReportStats( FILE* out ) const
+    {
+        sCaptureStats stats = Stats();
+
+        fprintf( out, "Capture: %llu notifications, %llu frames acquired, %llu empty updates, %llu coalesced, %llu truncated\n",
+            stats.Notifications, stats.Acquired, stats.EmptyUpdates, stats.Coalesced, stats.Truncated );
+
+        for( const sConsumerStats& c : stats.Consumers )
+        {
+            double overrunRate = ( stats.Acquired ? 100.0 * c.Overruns / stats.Acquired : 0.0 );
+            fprintf( out, "  %-12s %llu delivered, %llu overruns (%.2f%%), ring %zu\n",
+                c.Name.c_str(), c.Delivered, c.Overruns, overrunRate, c.RingCapacity );
+        }
+    }
+}
@@ -0,0 +1,234 @@
+//======================================================================================================
+// Capture engine: decouples Motive frame acquisition from logging and trial logic
+//======================================================================================================
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MotiveAPI.h"
+#include "framesnapshot.h"
+#include "hostclock.h"
+#include "latencyprobe.h"
+#include "spscring.h"
+
+namespace Capture
+{
+    /// <summary>Most markers copied into a single frame record, enough for whole-hand sets on several participants.
+    /// Extra markers are counted but not copied.</summary>
+    constexpr int kMaxFrameMarkers = 1024;
+
+    /// <summary>SMPTE timecode of a frame as reported by FrameTimeCode().</summary>
+    struct sFrameTimecode
+    {
+        int Hours;
+        int Minutes;
+        int Seconds;
+        int Frames;
+        int SubFrame;
+        bool DropFrame;
+        bool Valid;      // False when timecode capture is off or no timecode source is attached
+    };
+
+    /// <summary>Most cameras listed in a frame's calibration progress. Extra cameras are counted but not listed.</summary>
+    constexpr int kMaxCalibrationCameras = 64;
+
+    /// <summary>Calibration progress read with the frame. Only filled while calibrating, so a calibrated
+    /// system pays for nothing beyond CalibrationState().</summary>
+    struct sCalibrationProgress
+    {
+        int Quality;                            // CurrentCalibrationQuality() while solving and on reaching Complete, else -1
+        int CamerasLacking;                     // While wanding: cameras still short of wand samples, else 0
+        int CameraID[kMaxCalibrationCameras];   // CameraID() of each camera lacking samples
+        int Samples[kMaxCalibrationCameras];    // CameraCalibrationSamples() of each camera lacking samples
+
+        int Listed() const { return ( CamerasLacking < kMaxCalibrationCameras ? CamerasLacking : kMaxCalibrationCameras ); }
+    };
+
+    /// <summary>Everything a consumer needs from one Motive frame, so consumers never call back into the API.
+    /// Markers are stored as structure-of-arrays columns; only the first MarkerCount entries are valid.</summary>
+    struct sFrameRecord
+    {
+        unsigned long long Sequence;  // Listener sequence number observed when Update() was called
+        long long HostTimeNs;         // Host steady clock when Update() returned, in nanoseconds
+        double TimeStamp;             // FrameTimeStamp(), seconds from startup
+        int FrameID;                  // FrameID()
+        int CalibrationState;         // MotiveAPI::eCalibrationState
+        int TotalMarkers;             // Markers read from the API
+        int MarkerCount;              // Markers actually copied (<= kMaxFrameMarkers)
+        sFrameTimecode Timecode;      // FrameTimeCode(), when enabled with SetCaptureTimecode()
+        sCalibrationProgress Calibration;
+
+        float X[kMaxFrameMarkers];                  // Position in meters
+        float Y[kMaxFrameMarkers];
+        float Z[kMaxFrameMarkers];
+        float Residual[kMaxFrameMarkers];           // Residual in mm/ray
+        unsigned long long IDHigh[kMaxFrameMarkers]; // cUID high bits
+        unsigned long long IDLow[kMaxFrameMarkers];  // cUID low bits
+        unsigned short Flags[kMaxFrameMarkers];     // Core::eMarkerFlags
+
+        /// <summary>Copies the header and only the used portion of each marker column.</summary>
+        void CopyFrom( const sFrameRecord& other );
+
+        /// <summary>Copies the markers of a captured snapshot, truncating to kMaxFrameMarkers.</summary>
+        void CopyFrom( const cFrameSnapshot& snapshot );
+    };
+
+    /// <summary>
+    /// Listener whose FrameAvailable() callback only bumps an atomic sequence number. All real work
+    /// happens on the acquisition thread, which watches the sequence to know when to call Update().
+    /// </summary>
+    class cFrameListener : public MotiveAPI::cAPIListener
+    {
+    public:
+        void FrameAvailable() override;
+        void CameraConnected( int serialNumber ) override;
+        void CameraDisconnected( int serialNumber ) override;
+
+        /// <summary>Number of FrameAvailable() notifications received so far.</summary>
+        unsigned long long Sequence() const { return mSequence.load( std::memory_order_acquire ); }
+
+        int ConnectionChanges() const { return mConnectionChanges.load( std::memory_order_relaxed ); }
+
+#if CAPTURE_LATENCY_PROBES
+        /// <summary>Host steady clock at the latest FrameAvailable() notification.</summary>
+        long long NotifyHostNs() const { return mNotifyHostNs.load( std::memory_order_relaxed ); }
+#endif
+
+    private:
+        std::atomic<unsigned long long> mSequence{ 0 };
+#if CAPTURE_LATENCY_PROBES
+        std::atomic<long long> mNotifyHostNs{ 0 };
+#endif
+        std::atomic<int> mConnectionChanges{ 0 };
+    };
+
+    /// <summary>Called on a consumer thread for every frame it receives.</summary>
+    using FrameConsumer = std::function<void( const sFrameRecord& )>;
+
+    /// <summary>A Motive API call queued for the acquisition thread.</summary>
+    using ApiCommand = std::function<void()>;
+
+    /// <summary>Counters for one consumer thread.</summary>
+    struct sConsumerStats
+    {
+        std::string Name;
+        unsigned long long Delivered;  // Frames processed by the consumer
+        unsigned long long Overruns;   // Frames dropped because the consumer's ring was full
+        size_t RingCapacity;
+    };
+
+    /// <summary>Counters for the acquisition thread.</summary>
+    struct sCaptureStats
+    {
+        unsigned long long Notifications;  // FrameAvailable() calls
+        unsigned long long Acquired;       // Successful Update() calls
+        unsigned long long EmptyUpdates;   // Update() returned kApiResult_NoFrameAvailable
+        unsigned long long Coalesced;      // Notifications skipped because Update() only processes the latest frame
+        unsigned long long Truncated;      // Frames with more than kMaxFrameMarkers markers
+        std::vector<sConsumerStats> Consumers;
+    };
+
+    /// <summary>
+    /// Owns a pinned acquisition thread that calls MotiveAPI::Update() and copies each frame into one
+    /// single-producer/single-consumer ring per consumer. Each consumer runs on its own thread, so a slow
+    /// consumer (console output, LabJack I/O) overruns its own ring instead of stalling acquisition.
+    /// </summary>
+    class cCaptureEngine
+    {
+    public:
+        explicit cCaptureEngine( size_t ringCapacity = 512 );
+        ~cCaptureEngine();
+
+        cCaptureEngine( const cCaptureEngine& ) = delete;
+        cCaptureEngine& operator=( const cCaptureEngine& ) = delete;
+
+        /// <summary>Register a consumer. Must be called before Start().</summary>
+        void AddConsumer( const char* name, FrameConsumer consumer );
+
+        /// <summary>Pin the acquisition thread to a CPU core. Pass -1 (the default) to leave it unpinned.</summary>
+        void SetAcquisitionCore( int core ) { mAcquisitionCore = core; }
+
+        /// <summary>Also read FrameTimeCode() for every frame. Must be called before Start().</summary>
+        void SetCaptureTimecode( bool enable ) { mCaptureTimecode = enable; }
+
+        /// <summary>Attach the listener and start the acquisition and consumer threads.</summary>
+        bool Start();
+
+        /// <summary>Stop acquisition, let the consumers drain their rings, and detach the listener.</summary>
+        void Stop();
+
+        bool Running() const { return mRunning.load( std::memory_order_acquire ); }
+
+        cFrameListener& Listener() { return mListener; }
+
+        /// <summary>
+        /// Run a Motive API call (StartRecording(), StopRecording(), ...) on the acquisition thread, between
+        /// two Update() calls: the API is not thread-safe, so consumers must never call it themselves.
+        /// Callable from any thread; commands run in the order they were posted, and on the caller when the
+        /// engine is not running.
+        /// </summary>
+        void Post( ApiCommand command );
+
+        /// <summary>Snapshot of the acquisition and per-consumer counters. Safe to call while running.</summary>
+        sCaptureStats Stats() const;
+
+        /// <summary>Print the counters, including how often each ring has overrun.</summary>
+        void ReportStats( FILE* out = stdout ) const;
+
+    private:
+        struct sConsumer
+        {
+            sConsumer( const char* name, FrameConsumer callback, size_t capacity )
+                : Name( name ), Callback( std::move( callback ) ), Ring( capacity ) { }
+
+            std::string Name;
+            FrameConsumer Callback;
+            cSpscRing<sFrameRecord> Ring;
+            std::thread Thread;
+            std::atomic<unsigned long long> Delivered{ 0 };
+            std::atomic<unsigned long long> Overruns{ 0 };
+        };
+
+        void AcquisitionLoop( unsigned long long startSequence );
+        void ConsumerLoop( sConsumer& consumer );
+        void FillRecord( sFrameRecord& record, unsigned long long sequence );
+        void FillCalibration( sCalibrationProgress& progress, int state );
+        void RunCommands();
+
+        cFrameListener mListener;
+        size_t mRingCapacity;
+        int mAcquisitionCore = -1;
+        bool mCaptureTimecode = false;
+        int mCalibrationState = -1;     // State of the last acquired frame, only touched by the acquisition thread
+        std::vector<std::unique_ptr<sConsumer>> mConsumers;
+        std::unique_ptr<sFrameRecord> mScratch;
+        cFrameSnapshot mSnapshot;
+        std::thread mAcquisitionThread;
+        std::atomic<bool> mRunning{ false };
+        std::atomic<bool> mAcquiring{ false };
+
+        // Posted commands. The flag lets the acquisition thread skip the locks when nothing is queued;
+        // mExecuteLock keeps a command run on its caller after Stop() from overlapping the last queued ones.
+        std::mutex mCommandLock;
+        std::mutex mExecuteLock;
+        std::vector<ApiCommand> mCommands;
+        std::vector<ApiCommand> mRunningCommands;   // Under mExecuteLock
+        std::atomic<bool> mCommandsPending{ false };
+
+        std::atomic<unsigned long long> mAcquired{ 0 };
+        std::atomic<unsigned long long> mEmptyUpdates{ 0 };
+        std::atomic<unsigned long long> mCoalesced{ 0 };
+        std::atomic<unsigned long long> mTruncated{ 0 };
+    };
+
+    /// <summary>Pin the calling thread to a CPU core and raise its scheduling priority where the platform allows.</summary>
+    bool PinCurrentThread( int core );
+}
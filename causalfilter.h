@@ -0,0 +1,96 @@
+//======================================================================================================
+// Causal filter: second-order IIR sections for smoothing marker data as it streams in
+//======================================================================================================
+#pragma once
+
+#include <cmath>
+
+namespace Capture
+{
+    /// <summary>Coefficients of y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2].</summary>
+    struct sBiquadCoefficients
+    {
+        double B0 = 1, B1 = 0, B2 = 0;
+        double A1 = 0, A2 = 0;
+    };
+
+    /// <summary>Second-order low-pass with quality factor q by the bilinear transform, with the cutoff
+    /// prewarped so the analog corner lands exactly on cutoffHz. The cutoff must be below sampleRateHz / 2.</summary>
+    inline sBiquadCoefficients LowPassBiquad( double cutoffHz, double sampleRateHz, double q )
+    {
+        const double k = std::tan( 3.14159265358979323846 * cutoffHz / sampleRateHz );
+        const double norm = 1 / ( 1 + k / q + k * k );
+
+        sBiquadCoefficients c;
+        c.B0 = k * k * norm;
+        c.B1 = 2 * c.B0;
+        c.B2 = c.B0;
+        c.A1 = 2 * ( k * k - 1 ) * norm;
+        c.A2 = ( 1 - k / q + k * k ) * norm;
+        return c;
+    }
+
+    /// <summary>Section 0 .. order / 2 - 1 of an even-order Butterworth low-pass; the sections in
+    /// cascade are -3 dB at cutoffHz. The default is the single section of a second-order filter.</summary>
+    inline sBiquadCoefficients ButterworthLowPass( double cutoffHz, double sampleRateHz, int order = 2, int section = 0 )
+    {
+        const double q = 0.5 / std::cos( 3.14159265358979323846 * ( 2 * section + 1 ) / ( 2 * order ) );
+        return LowPassBiquad( cutoffHz, sampleRateHz, q );
+    }
+
+    /// <summary>
+    /// Critically damped second-order low-pass (a double real pole, q = 1/2), -3 dB at cutoffHz. Its step
+    /// response rises without overshoot, so a threshold on the filtered signal is never crossed by ringing;
+    /// the price is a softer roll-off than the Butterworth of the same cutoff.
+    /// </summary>
+    inline sBiquadCoefficients CriticallyDampedLowPass( double cutoffHz, double sampleRateHz )
+    {
+        // |H|^2 = w^4 / ( W^2 + w^2 )^2 is halved at W = w sqrt( sqrt( 2 ) - 1 ), so the pole sits above the cutoff.
+        const double k = std::tan( 3.14159265358979323846 * cutoffHz / sampleRateHz ) / std::sqrt( 1.41421356237309504880 - 1 );
+        const double pole = ( 1 - k ) / ( 1 + k );
+
+        sBiquadCoefficients c;
+        c.B0 = k * k / ( ( 1 + k ) * ( 1 + k ) );
+        c.B1 = 2 * c.B0;
+        c.B2 = c.B0;
+        c.A1 = -2 * pole;
+        c.A2 = pole * pole;
+        return c;
+    }
+
+    /// <summary>
+    /// One biquad in transposed direct form II: two state values and five multiplies per sample, no
+    /// history buffer. Prime() settles the state on a constant input, so a filter started (or restarted
+    /// after a tracking gap) on a marker that is already away from the origin does not ring.
+    /// </summary>
+    class cBiquad
+    {
+    public:
+        cBiquad() = default;
+        explicit cBiquad( const sBiquadCoefficients& coefficients ) : mC( coefficients ) { }
+
+        void SetCoefficients( const sBiquadCoefficients& coefficients ) { mC = coefficients; }
+        const sBiquadCoefficients& Coefficients() const { return mC; }
+
+        double Process( double x )
+        {
+            const double y = mC.B0 * x + mS1;
+            mS1 = mC.B1 * x - mC.A1 * y + mS2;
+            mS2 = mC.B2 * x - mC.A2 * y;
+            return y;
+        }
+
+        /// <summary>Set the state as if x had been the input forever; returns x, the settled output.</summary>
+        double Prime( double x )
+        {
+            mS2 = ( mC.B2 - mC.A2 ) * x;
+            mS1 = ( mC.B1 - mC.A1 ) * x + mS2;
+            return x;
+        }
+
+    private:
+        sBiquadCoefficients mC;
+        double mS1 = 0;
+        double mS2 = 0;
+    };
+}
@@ -0,0 +1,292 @@
+//======================================================================================================
+// Clock synchronization: drift-tracking maps between the Motive, LabJack, host and wall clocks
+//======================================================================================================
+#include "clocksync.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "hostclock.h"
+
+namespace Capture
+{
+    //==================================================================================================
+    // cLinearFit
+    //==================================================================================================
+
+    cLinearFit::cLinearFit( double memory, int floorWindow )
+        : mForget( memory > 1.0 ? 1.0 - 1.0 / memory : 0.0 ), mFloorWindow( floorWindow > 0 ? floorWindow : 1 )
+    {
+    }
+
+    double cLinearFit::Add( double x, double y )
+    {
+        const double residual = ( Valid() ? y - Predict( x ) : 0.0 );
+
+        // Exponentially weighted mean and covariance (West's incremental update).
+        mWeight = mForget * mWeight + 1.0;
+        const double dx = x - mMeanX;
+        mMeanX += dx / mWeight;
+        mMeanY += ( y - mMeanY ) / mWeight;
+        mCovXX = mForget * mCovXX + dx * ( x - mMeanX );
+        mCovXY = mForget * mCovXY + dx * ( y - mMeanY );
+
+        if( mCovXX > 0 )
+        {
+            mSlope = mCovXY / mCovXX;
+        }
+        ++mCount;
+
+        // Two alternating windows, so the floor forgets old minimums without ever being empty.
+        if( mFloorCount == 0 || residual < mFloorCurrent )
+        {
+            mFloorCurrent = residual;
+        }
+        if( ++mFloorCount >= mFloorWindow )
+        {
+            mFloorPrevious = mFloorCurrent;
+            mHasFloorPrevious = true;
+            mFloorCount = 0;
+        }
+
+        return residual;
+    }
+
+    double cLinearFit::Floor() const
+    {
+        if( !mHasFloorPrevious )
+        {
+            return ( mFloorCount > 0 ? mFloorCurrent : 0.0 );
+        }
+        if( mFloorCount == 0 )
+        {
+            return mFloorPrevious;
+        }
+        return ( mFloorCurrent < mFloorPrevious ? mFloorCurrent : mFloorPrevious );
+    }
+
+    //==================================================================================================
+    // cJitterHistogram
+    //==================================================================================================
+
+    void cJitterHistogram::Record( double residualSeconds )
+    {
+        const double us = std::fabs( residualSeconds ) * 1e6;
+
+        int bucket = 0;
+        if( us >= 1.0 )
+        {
+            bucket = 1 + std::ilogb( us );
+            bucket = ( bucket < kBuckets ? bucket : kBuckets - 1 );
+        }
+        ++mBuckets[bucket];
+
+        if( mCount == 0 || residualSeconds < mMin ) mMin = residualSeconds;
+        if( mCount == 0 || residualSeconds > mMax ) mMax = residualSeconds;
+        mSumSquares += residualSeconds * residualSeconds;
+        ++mCount;
+    }
+
+    void cJitterHistogram::Reset()
+    {
+        *this = cJitterHistogram();
+    }
+
+    double cJitterHistogram::Rms() const
+    {
+        return ( mCount > 0 ? std::sqrt( mSumSquares / double( mCount ) ) : 0.0 );
+    }
+
+    void cJitterHistogram::Print( FILE* out, const char* name ) const
+    {
+        fprintf( out, "  %s: %llu samples, rms %.1f us, min %+.1f us, max %+.1f us\n",
+            name, mCount, Rms() * 1e6, mMin * 1e6, mMax * 1e6 );
+
+        for( int i = 0; i < kBuckets; ++i )
+        {
+            if( mBuckets[i] == 0 )
+            {
+                continue;
+            }
+            const double lower = ( i == 0 ? 0.0 : std::ldexp( 1.0, i - 1 ) );
+            const double upper = std::ldexp( 1.0, i );
+            const double percent = 100.0 * double( mBuckets[i] ) / double( mCount );
+
+            if( i == kBuckets - 1 )
+            {
+                fprintf( out, "    >= %8.0f us %12llu %6.2f%%\n", lower, mBuckets[i], percent );
+            }
+            else
+            {
+                fprintf( out, "    %8.0f-%-8.0f us %12llu %6.2f%%\n", lower, upper, mBuckets[i], percent );
+            }
+        }
+    }
+
+    //==================================================================================================
+    // cClockSync
+    //==================================================================================================
+
+    cClockSync::cClockSync( const sClockSyncConfig& config )
+        : mConfig( config ),
+          mStampToHost( config.FitMemory, config.FloorWindow ),
+          mStampToFrame( config.FitMemory, config.FloorWindow ),
+          mStampToTimecode( config.FitMemory, config.FloorWindow ),
+          mScanToHost( config.FitMemory, config.FloorWindow ),
+          mHostToWall( config.FitMemory, config.FloorWindow )
+    {
+    }
+
+    void cClockSync::ObserveFrame( const sFrameRecord& frame )
+    {
+        const double residual = mStampToHost.Add( frame.TimeStamp, double( frame.HostTimeNs ) );
+        if( mStampToHost.Count() > 2 )
+        {
+            mFrameJitter.Record( residual * 1e-9 );
+        }
+
+        mStampToFrame.Add( frame.TimeStamp, double( frame.FrameID ) );
+
+        if( frame.Timecode.Valid )
+        {
+            const double timecodeResidual = mStampToTimecode.Add( frame.TimeStamp, TimecodeSeconds( frame.Timecode ) );
+            if( mStampToTimecode.Count() > 2 )
+            {
+                mTimecodeJitter.Record( timecodeResidual );
+            }
+        }
+
+        // Both clocks are read back to back, so this pair has no transfer latency to remove.
+        const long long hostNs = HostTimeNs();
+        const long long wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch() ).count();
+        if( mHostToWall.Count() == 0 )
+        {
+            mHostOriginNs = hostNs;
+            mWallOriginNs = wallNs;
+        }
+        mHostToWall.Add( double( hostNs - mHostOriginNs ), double( wallNs - mWallOriginNs ) );
+    }
+
+    void cClockSync::ObserveScan( unsigned long long scanIndex, long long hostTimeNs )
+    {
+        const double residual = mScanToHost.Add( double( scanIndex ), double( hostTimeNs ) );
+        if( mScanToHost.Count() > 2 )
+        {
+            mScanJitter.Record( residual * 1e-9 );
+        }
+    }
+
+    double cClockSync::TimeStampToHostNs( double timeStamp ) const
+    {
+        return mStampToHost.Predict( timeStamp ) + mStampToHost.Floor();
+    }
+
+    double cClockSync::HostNsToStamp( double hostTimeNs ) const
+    {
+        return mStampToHost.Inverse( hostTimeNs - mStampToHost.Floor() );
+    }
+
+    long long cClockSync::ScanToHostNs( unsigned long long scanIndex ) const
+    {
+        return (long long) ( mScanToHost.Predict( double( scanIndex ) ) + mScanToHost.Floor() );
+    }
+
+    bool cClockSync::HostToFrameTime( long long hostTimeNs, sFrameTime& time ) const
+    {
+        if( !FrameClockValid() )
+        {
+            return false;
+        }
+
+        time.TimeStamp = HostNsToStamp( double( hostTimeNs ) );
+        time.FrameIndex = mStampToFrame.Predict( time.TimeStamp );
+        return true;
+    }
+
+    bool cClockSync::ScanToFrameTime( unsigned long long scanIndex, sFrameTime& time ) const
+    {
+        return ScanClockValid() && HostToFrameTime( ScanToHostNs( scanIndex ), time );
+    }
+
+    bool cClockSync::WallToFrameTime( double epochSeconds, sFrameTime& time ) const
+    {
+        if( !mHostToWall.Valid() )
+        {
+            return false;
+        }
+
+        const double wallNs = ( epochSeconds - double( mWallOriginNs ) * 1e-9 ) * 1e9;
+        const long long hostNs = mHostOriginNs + (long long) mHostToWall.Inverse( wallNs );
+        return HostToFrameTime( hostNs, time );
+    }
+
+    double cClockSync::HostToWallSeconds( long long hostTimeNs ) const
+    {
+        const double wallNs = mHostToWall.Predict( double( hostTimeNs - mHostOriginNs ) );
+        return double( mWallOriginNs + (long long) wallNs ) * 1e-9;
+    }
+
+    double cClockSync::TimecodeSeconds( const sFrameTimecode& timecode ) const
+    {
+        const int wholeSeconds = ( timecode.Hours * 60 + timecode.Minutes ) * 60 + timecode.Seconds;
+
+        if( !timecode.DropFrame )
+        {
+            return wholeSeconds + timecode.Frames / mConfig.TimecodeRate;
+        }
+
+        // Drop-frame skips frame numbers 0 and 1 (0-3 at 60 fps) every minute except every tenth minute.
+        const int nominalRate = (int) std::lround( mConfig.TimecodeRate );
+        const int dropPerMinute = nominalRate / 15;
+        const int minutes = timecode.Hours * 60 + timecode.Minutes;
+        const long long frameNumber = (long long) wholeSeconds * nominalRate + timecode.Frames
+            - dropPerMinute * ( minutes - minutes / 10 );
+
+        return double( frameNumber ) * 1001.0 / ( nominalRate * 1000.0 );
+    }
+
+    double cClockSync::HostClockDriftPpm() const
+    {
+        return ( mStampToHost.Valid() ? ( mStampToHost.Slope() / 1e9 - 1.0 ) * 1e6 : 0.0 );
+    }
+
+    double cClockSync::ScanClockDriftPpm() const
+    {
+        if( !mScanToHost.Valid() || !mStampToHost.Valid() )
+        {
+            return 0.0;
+        }
+
+        // Scan period measured in Motive seconds against the nominal period.
+        const double period = mScanToHost.Slope() / mStampToHost.Slope();
+        return ( period * mConfig.ScanRate - 1.0 ) * 1e6;
+    }
+
+    void cClockSync::Report( FILE* out ) const
+    {
+        fprintf( out, "Clock sync: %llu frames, %llu stream reads\n", mStampToHost.Count(), mScanToHost.Count() );
+
+        if( FrameClockValid() )
+        {
+            fprintf( out, "  host vs Motive clock: %+.2f ppm, read latency floor %+.1f us, %.4f frames/s\n",
+                HostClockDriftPpm(), mStampToHost.Floor() * 1e-3, mStampToFrame.Slope() );
+        }
+        if( ScanClockValid() )
+        {
+            fprintf( out, "  LabJack vs Motive clock: %+.2f ppm, read latency floor %+.1f us\n",
+                ScanClockDriftPpm(), mScanToHost.Floor() * 1e-3 );
+        }
+        if( TimecodeValid() )
+        {
+            fprintf( out, "  timecode vs Motive clock: %+.2f ppm\n", ( mStampToTimecode.Slope() - 1.0 ) * 1e6 );
+        }
+
+        mFrameJitter.Print( out, "frame arrival residual" );
+        mScanJitter.Print( out, "stream read residual" );
+        if( mTimecodeJitter.Count() > 0 )
+        {
+            mTimecodeJitter.Print( out, "timecode residual" );
+        }
+    }
+}
@@ -0,0 +1,180 @@
+//======================================================================================================
+// Clock synchronization: drift-tracking maps between the Motive, LabJack, host and wall clocks
+//======================================================================================================
+#pragma once
+
+#include <cstdio>
+
+#include "captureengine.h"
+
+namespace Capture
+{
+    /// <summary>A time expressed on the Motive frame clock.</summary>
+    struct sFrameTime
+    {
+        double TimeStamp;  // Seconds on the FrameTimeStamp() clock
+        double FrameIndex; // Fractional FrameID(); 10.5 is halfway between frames 10 and 11
+    };
+
+    /// <summary>
+    /// Online least-squares line fit with exponential forgetting, so the fit follows
+    /// slow drift between two oscillators. Uses a weighted running mean/covariance update (no large sums
+    /// are subtracted), which stays accurate with nanosecond timestamps. Prediction is O(1).
+    /// </summary>
+    class cLinearFit
+    {
+    public:
+        /// <summary>memory is the effective number of recent observations the fit is weighted over.</summary>
+        explicit cLinearFit( double memory = 2000.0, int floorWindow = 500 );
+
+        /// <summary>Add an observation and return its residual against the fit before the update.</summary>
+        double Add( double x, double y );
+
+        /// <summary>True once two observations with different x have been added.</summary>
+        bool Valid() const { return mCovXX > 0; }
+
+        double Predict( double x ) const { return mMeanY + mSlope * ( x - mMeanX ); }
+        double Inverse( double y ) const { return mMeanX + ( y - mMeanY ) / mSlope; }
+
+        double Slope() const { return mSlope; }
+        unsigned long long Count() const { return mCount; }
+
+        /// <summary>
+        /// Smallest residual seen over the last one to two floor windows. When y is only ever observed late
+        /// (read after a USB or network transfer), Predict( x ) + Floor() is the lower envelope of the
+        /// observations, which removes the mean transfer latency from the fit.
+        /// </summary>
+        double Floor() const;
+
+    private:
+        double mForget;
+        int mFloorWindow;
+
+        unsigned long long mCount = 0;
+        double mWeight = 0;
+        double mMeanX = 0;
+        double mMeanY = 0;
+        double mCovXX = 0;
+        double mCovXY = 0;
+        double mSlope = 0;
+
+        int mFloorCount = 0;
+        double mFloorCurrent = 0;
+        double mFloorPrevious = 0;
+        bool mHasFloorPrevious = false;
+    };
+
+    /// <summary>Histogram of |residual| in power-of-two microsecond buckets, plus signed extremes and RMS.</summary>
+    class cJitterHistogram
+    {
+    public:
+        static constexpr int kBuckets = 20; // <1 us, 1-2 us, 2-4 us ... >= 2^18 us (about 0.26 s)
+
+        void Record( double residualSeconds );
+        void Reset();
+
+        unsigned long long Count() const { return mCount; }
+        unsigned long long Bucket( int index ) const { return mBuckets[index]; }
+        double Rms() const;
+        double Min() const { return mMin; }
+        double Max() const { return mMax; }
+
+        void Print( FILE* out, const char* name ) const;
+
+    private:
+        unsigned long long mBuckets[kBuckets] = {};
+        unsigned long long mCount = 0;
+        double mSumSquares = 0;
+        double mMin = 0;
+        double mMax = 0;
+    };
+
+    struct sClockSyncConfig
+    {
+        double FitMemory = 2000.0;   // Observations the drift fits are weighted over (about 10-20 s of frames)
+        int FloorWindow = 500;       // Observations per latency-floor window
+        double TimecodeRate = 30.0;  // Nominal SMPTE frame rate of the timecode source
+        double ScanRate = 1000.0;    // Nominal LabJack scan rate, for the drift figure only
+    };
+
+    /// <summary>
+    /// Continuously fits linear drift models between the Motive frame clock (FrameTimeStamp(), FrameID()),
+    /// SMPTE timecode, the LabJack stream scan counter, the host steady clock and the wall clock used by
+    /// the participant CSVs (epoch seconds). Every conversion is a couple of multiply-adds.
+    ///
+    /// Host times of frames and scans are taken when the data is read, so they are late by a varying
+    /// transfer latency; those fits are shifted to their lower envelope (cLinearFit::Floor()). What
+    /// remains is a constant offset equal to the smallest transfer latency, which cannot be observed.
+    ///
+    /// Not thread-safe: observe and convert on one thread (the trial consumer), or copy the object.
+    /// </summary>
+    class cClockSync
+    {
+    public:
+        explicit cClockSync( const sClockSyncConfig& config = sClockSyncConfig() );
+
+        /// <summary>Add a frame observation: host read time, FrameTimeStamp(), FrameID() and timecode.</summary>
+        void ObserveFrame( const sFrameRecord& frame );
+
+        /// <summary>Add a LabJack observation: the newest scan in a stream read and the host time of the read.</summary>
+        void ObserveScan( unsigned long long scanIndex, long long hostTimeNs );
+
+        bool FrameClockValid() const { return mStampToHost.Valid() && mStampToFrame.Valid(); }
+        bool ScanClockValid() const { return mScanToHost.Valid(); }
+        bool TimecodeValid() const { return mStampToTimecode.Valid(); }
+
+        /// <summary>Host steady-clock time of a stream scan.</summary>
+        long long ScanToHostNs( unsigned long long scanIndex ) const;
+
+        /// <summary>Place a host steady-clock time on the Motive frame clock. False until FrameClockValid().</summary>
+        bool HostToFrameTime( long long hostTimeNs, sFrameTime& time ) const;
+
+        /// <summary>Place a stream scan on the Motive frame clock. False until both clocks are valid.</summary>
+        bool ScanToFrameTime( unsigned long long scanIndex, sFrameTime& time ) const;
+
+        /// <summary>Place a wall-clock epoch time (Python time.time()) on the Motive frame clock.</summary>
+        bool WallToFrameTime( double epochSeconds, sFrameTime& time ) const;
+
+        /// <summary>Epoch seconds, as logged in the participant CSVs, for a host steady-clock time.</summary>
+        double HostToWallSeconds( long long hostTimeNs ) const;
+
+        /// <summary>Timecode, in seconds since midnight, at a FrameTimeStamp().</summary>
+        double TimeStampToTimecodeSeconds( double timeStamp ) const { return mStampToTimecode.Predict( timeStamp ); }
+
+        /// <summary>Seconds since midnight for a SMPTE timecode, handling 29.97 drop-frame counting.</summary>
+        double TimecodeSeconds( const sFrameTimecode& timecode ) const;
+
+        /// <summary>Drift of the LabJack and host clocks against the Motive clock in parts per million.</summary>
+        double ScanClockDriftPpm() const;
+        double HostClockDriftPpm() const;
+
+        const cJitterHistogram& FrameJitter() const { return mFrameJitter; }
+        const cJitterHistogram& ScanJitter() const { return mScanJitter; }
+        const cJitterHistogram& TimecodeJitter() const { return mTimecodeJitter; }
+
+        /// <summary>Print fit coefficients, drift and the residual-jitter histograms.</summary>
+        void Report( FILE* out = stdout ) const;
+
+        /// <summary>Host steady-clock time of a FrameTimeStamp().</summary>
+        double TimeStampToHostNs( double timeStamp ) const;
+
+    private:
+        double HostNsToStamp( double hostTimeNs ) const;
+
+        sClockSyncConfig mConfig;
+
+        cLinearFit mStampToHost;     // x: FrameTimeStamp() s,  y: host ns at Update()
+        cLinearFit mStampToFrame;    // x: FrameTimeStamp() s,  y: FrameID()
+        cLinearFit mStampToTimecode; // x: FrameTimeStamp() s,  y: timecode s
+        cLinearFit mScanToHost;      // x: scan index,          y: host ns at stream read
+        cLinearFit mHostToWall;      // x: host ns - origin,    y: wall ns - origin
+
+        // Wall-clock nanoseconds do not fit in a double exactly, so that fit works relative to the first sample.
+        long long mHostOriginNs = 0;
+        long long mWallOriginNs = 0;
+
+        cJitterHistogram mFrameJitter;
+        cJitterHistogram mScanJitter;
+        cJitterHistogram mTimecodeJitter;
+    };
+}
@@ -0,0 +1,127 @@
+//======================================================================================================
+// Column codec: lossless compression for chunks of 32-bit marker columns
+//======================================================================================================
+#include "columncodec.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace Capture
+{
+    namespace
+    {
+        constexpr size_t kMaxLiteral = 128;
+        constexpr size_t kMinZeroRun = 2;
+        constexpr size_t kMaxZeroRun = 129;
+
+        bool ZeroRunAt( const unsigned char* data, size_t i, size_t bytes )
+        {
+            return i + 1 < bytes && data[i] == 0 && data[i + 1] == 0;
+        }
+    }
+
+    size_t MaxEncodedColumnBytes( size_t bytes )
+    {
+        return bytes + bytes / kMaxLiteral + 1;
+    }
+
+    size_t EncodeColumns( const unsigned char* in, size_t bytes, unsigned char* out, unsigned char* scratch )
+    {
+        const size_t words = bytes / 4;
+
+        // XOR with the previous word and split into byte planes, low byte first.
+        uint32_t previous = 0;
+        for( size_t w = 0; w < words; ++w )
+        {
+            uint32_t word;
+            memcpy( &word, in + 4 * w, sizeof( word ) );
+            const uint32_t delta = word ^ previous;
+            previous = word;
+
+            scratch[w] = (unsigned char) delta;
+            scratch[words + w] = (unsigned char) ( delta >> 8 );
+            scratch[2 * words + w] = (unsigned char) ( delta >> 16 );
+            scratch[3 * words + w] = (unsigned char) ( delta >> 24 );
+        }
+
+        size_t o = 0;
+        size_t i = 0;
+        while( i < bytes )
+        {
+            if( ZeroRunAt( scratch, i, bytes ) )
+            {
+                size_t run = kMinZeroRun;
+                while( i + run < bytes && run < kMaxZeroRun && scratch[i + run] == 0 )
+                {
+                    ++run;
+                }
+                out[o++] = (unsigned char) ( run + 126 );
+                i += run;
+                continue;
+            }
+
+            // Literals until the next zero run; single zeros are cheaper kept inline.
+            const size_t start = i;
+            while( i < bytes && i - start < kMaxLiteral && !ZeroRunAt( scratch, i, bytes ) )
+            {
+                ++i;
+            }
+            const size_t length = i - start;
+            out[o++] = (unsigned char) ( length - 1 );
+            memcpy( out + o, scratch + start, length );
+            o += length;
+        }
+
+        return o;
+    }
+
+    bool DecodeColumns( const unsigned char* in, size_t inBytes, unsigned char* out, size_t bytes, unsigned char* scratch )
+    {
+        size_t i = 0;
+        size_t o = 0;
+        while( o < bytes )
+        {
+            if( i >= inBytes )
+            {
+                return false;
+            }
+
+            const unsigned char control = in[i++];
+            if( control < 128 )
+            {
+                const size_t length = (size_t) control + 1;
+                if( length > inBytes - i || length > bytes - o )
+                {
+                    return false;
+                }
+                memcpy( scratch + o, in + i, length );
+                i += length;
+                o += length;
+            }
+            else
+            {
+                const size_t length = (size_t) control - 126;
+                if( length > bytes - o )
+                {
+                    return false;
+                }
+                memset( scratch + o, 0, length );
+                o += length;
+            }
+        }
+
+        const size_t words = bytes / 4;
+        uint32_t previous = 0;
+        for( size_t w = 0; w < words; ++w )
+        {
+            const uint32_t delta = (uint32_t) scratch[w]
+                | ( (uint32_t) scratch[words + w] << 8 )
+                | ( (uint32_t) scratch[2 * words + w] << 16 )
+                | ( (uint32_t) scratch[3 * words + w] << 24 );
+            previous ^= delta;
+            memcpy( out + 4 * w, &previous, sizeof( previous ) );
+        }
+
+        return true;
+    }
+}
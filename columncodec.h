@@ -0,0 +1,31 @@
+//======================================================================================================
+// Column codec: lossless compression for chunks of 32-bit marker columns
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+
+namespace Capture
+{
+    /// <summary>
+    /// Compresses a block of little-endian 32-bit words, such as the columns of a recording chunk. Each
+    /// word is XORed with the word before it, the results are split into four byte planes, and zero runs
+    /// are run-length encoded. Consecutive samples of a trajectory share their sign, exponent and top
+    /// mantissa bits, and occluded (NaN) stretches are identical. As a result, the high planes become
+    /// long zero runs. The codec has no dependencies and runs at memory speed.
+    ///
+    /// Stream: a sequence of tokens. A control byte c < 128 is followed by c + 1 literal bytes; c >= 128
+    /// stands for c - 126 zero bytes (2 to 129).
+    /// </summary>
+
+    /// <summary>Worst-case encoded size of bytes input bytes.</summary>
+    size_t MaxEncodedColumnBytes( size_t bytes );
+
+    /// <summary>Encode bytes (a multiple of 4) from in to out, which must hold MaxEncodedColumnBytes( bytes ).
+    /// scratch must hold bytes. Returns the encoded size.</summary>
+    size_t EncodeColumns( const unsigned char* in, size_t bytes, unsigned char* out, unsigned char* scratch );
+
+    /// <summary>Decode exactly bytes (a multiple of 4) into out, using scratch of the same size. Bytes of in
+    /// past the end of the stream are ignored. Returns false if in is truncated or corrupt.</summary>
+    bool DecodeColumns( const unsigned char* in, size_t inBytes, unsigned char* out, size_t bytes, unsigned char* scratch );
+}
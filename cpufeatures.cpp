@@ -0,0 +1,135 @@
+//======================================================================================================
+// CPU features: runtime detection of the SIMD instruction sets the batch kernels can use
+//======================================================================================================
+#include "cpufeatures.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+
+#if defined(CAPTURE_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#ifndef _MSC_VER
+#include <strings.h>
+#endif
+
+namespace Capture
+{
+    namespace
+    {
+        eSimdLevel Detect()
+        {
+#if !defined(CAPTURE_X86)
+            return eSimdLevel::Scalar;
+#elif defined(_MSC_VER)
+            int info[4];
+            __cpuid( info, 0 );
+            const int maxLeaf = info[0];
+
+            __cpuid( info, 1 );
+            const bool sse2 = ( info[3] & ( 1 << 26 ) ) != 0;
+            const bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+            const bool avx = ( info[2] & ( 1 << 28 ) ) != 0;
+            const bool fma = ( info[2] & ( 1 << 12 ) ) != 0;
+
+            // The OS has to save the YMM registers on context switches, or AVX code is unusable.
+            const bool ymmSaved = osxsave && ( _xgetbv( 0 ) & 0x6 ) == 0x6;
+
+            bool avx2 = false, avx512 = false;
+            if( maxLeaf >= 7 )
+            {
+                __cpuidex( info, 7, 0 );
+                avx2 = ( info[1] & ( 1 << 5 ) ) != 0;
+                avx512 = ( info[1] & ( 1 << 16 ) ) != 0;
+            }
+
+            // AVX-512 also needs the opmask and both halves of the ZMM registers saved.
+            const bool zmmSaved = ymmSaved && ( _xgetbv( 0 ) & 0xE0 ) == 0xE0;
+
+            if( avx && ymmSaved )
+            {
+                if( avx2 && fma )
+                {
+                    return ( avx512 && zmmSaved ) ? eSimdLevel::AVX512 : eSimdLevel::AVX2;
+                }
+                return eSimdLevel::AVX;
+            }
+            return sse2 ? eSimdLevel::SSE2 : eSimdLevel::Scalar;
+#else
+            __builtin_cpu_init();
+            if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+            {
+                return __builtin_cpu_supports( "avx512f" ) ? eSimdLevel::AVX512 : eSimdLevel::AVX2;
+            }
+            if( __builtin_cpu_supports( "avx" ) )
+            {
+                return eSimdLevel::AVX;
+            }
+            return __builtin_cpu_supports( "sse2" ) ? eSimdLevel::SSE2 : eSimdLevel::Scalar;
+#endif
+        }
+
+        eSimdLevel EnvironmentLimit()
+        {
+            const char* value = getenv( "CAPTURE_SIMD" );
+            if( value == nullptr )
+            {
+                return eSimdLevel::AVX512;
+            }
+
+            for( eSimdLevel level : { eSimdLevel::Scalar, eSimdLevel::SSE2, eSimdLevel::AVX, eSimdLevel::AVX2, eSimdLevel::AVX512 } )
+            {
+#ifdef _MSC_VER
+                if( _stricmp( value, SimdLevelName( level ) ) == 0 )
+#else
+                if( strcasecmp( value, SimdLevelName( level ) ) == 0 )
+#endif
+                {
+                    return level;
+                }
+            }
+            return eSimdLevel::AVX512;
+        }
+
+        std::atomic<int> sLimit{ -1 };
+    }
+
+    const char* SimdLevelName( eSimdLevel level )
+    {
+        switch( level )
+        {
+        case eSimdLevel::Scalar: return "scalar";
+        case eSimdLevel::SSE2:   return "sse2";
+        case eSimdLevel::AVX:    return "avx";
+        case eSimdLevel::AVX2:   return "avx2";
+        case eSimdLevel::AVX512: return "avx512";
+        }
+        return "unknown";
+    }
+
+    eSimdLevel DetectedSimdLevel()
+    {
+        static const eSimdLevel sDetected = Detect();
+        return sDetected;
+    }
+
+    eSimdLevel ActiveSimdLevel()
+    {
+        int limit = sLimit.load( std::memory_order_relaxed );
+        if( limit < 0 )
+        {
+            limit = (int) EnvironmentLimit();
+            sLimit.store( limit, std::memory_order_relaxed );
+        }
+
+        const eSimdLevel detected = DetectedSimdLevel();
+        return ( limit < (int) detected ? (eSimdLevel) limit : detected );
+    }
+
+    void SetSimdLevelLimit( eSimdLevel limit )
+    {
+        sLimit.store( (int) limit, std::memory_order_relaxed );
+    }
+}
@@ -0,0 +1,45 @@
+//======================================================================================================
+// CPU features: runtime detection of the SIMD instruction sets the batch kernels can use
+//======================================================================================================
+#pragma once
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CAPTURE_X86 1
+#endif
+
+// Functions using SIMD intrinsics are compiled for their instruction set one by one, so the rest of the
+// binary keeps running on any x64 machine. MSVC emits whatever intrinsics are used without a switch.
+#if defined(CAPTURE_X86) && ( defined(__GNUC__) || defined(__clang__) )
+#define CAPTURE_TARGET_SSE2 __attribute__(( target( "sse2" ) ))
+#define CAPTURE_TARGET_AVX __attribute__(( target( "avx" ) ))
+#define CAPTURE_TARGET_AVX2 __attribute__(( target( "avx2,fma" ) ))
+#else
+#define CAPTURE_TARGET_SSE2
+#define CAPTURE_TARGET_AVX
+#define CAPTURE_TARGET_AVX2
+#endif
+
+namespace Capture
+{
+    /// <summary>SIMD levels in increasing order; each implies the ones below it.</summary>
+    enum class eSimdLevel
+    {
+        Scalar = 0,
+        SSE2,
+        AVX,
+        AVX2,
+        AVX512
+    };
+
+    const char* SimdLevelName( eSimdLevel level );
+
+    /// <summary>The highest level this CPU and OS support, detected once.</summary>
+    eSimdLevel DetectedSimdLevel();
+
+    /// <summary>The level batch kernels dispatch to: the detected level, unless lowered with
+    /// SetSimdLevelLimit() or the CAPTURE_SIMD environment variable (scalar, sse2, avx, avx2, avx512).</summary>
+    eSimdLevel ActiveSimdLevel();
+
+    /// <summary>Cap the level kernels dispatch to, e.g. to compare paths. Levels above the detected one are ignored.</summary>
+    void SetSimdLevelLimit( eSimdLevel limit );
+}
@@ -0,0 +1,167 @@
+//======================================================================================================
+// Digital events: debounced edge detection over the LabJack digital stream
+//======================================================================================================
+#include "digitalevents.h"
+
+#include "latencyprobe.h"
+#include "tracepoint.h"
+
+namespace Capture
+{
+    namespace
+    {
+        int DebounceScans( double seconds, double scanRate )
+        {
+            const int scans = (int) ( seconds * scanRate + 0.5 );
+            return ( scans < 1 ? 1 : scans );
+        }
+    }
+
+    const char* DigitalEventName( eDigitalEvent type )
+    {
+        switch( type )
+        {
+        case eDigitalEvent::FingerLift:         return "finger_lift";
+        case eDigitalEvent::FingerReturn:       return "finger_return";
+        case eDigitalEvent::GogglesTransparent: return "goggles_transparent";
+        case eDigitalEvent::GogglesOpaque:      return "goggles_opaque";
+        }
+        return "unknown";
+    }
+
+    cDigitalEdgeDetector::cDigitalEdgeDetector( const cLabJackStream& stream, cClockSync& clock,
+        const sEdgeDetectorConfig& config ) : mStream( stream ), mClock( clock )
+    {
+        const double scanRate = stream.ScanRate();
+
+        mLines[0].Mask = kFingerSensorBit;
+        mLines[0].DebounceScans = DebounceScans( config.FingerDebounceSeconds, scanRate );
+        mLines[0].RiseEvent = eDigitalEvent::FingerReturn;
+        mLines[0].FallEvent = eDigitalEvent::FingerLift;
+
+        mLines[1].Mask = kGogglesBit;
+        mLines[1].DebounceScans = DebounceScans( config.GogglesDebounceSeconds, scanRate );
+        mLines[1].RiseEvent = eDigitalEvent::GogglesTransparent;
+        mLines[1].FallEvent = eDigitalEvent::GogglesOpaque;
+    }
+
+    void cDigitalEdgeDetector::Reset()
+    {
+        mPrimed = false;
+        mReadHostNs = -1;
+        for( sLine& line : mLines )
+        {
+            line.Pending = false;
+            line.PendingScans = 0;
+        }
+    }
+
+    void cDigitalEdgeDetector::ObserveReads( const sDigitalSample* samples, int count )
+    {
+        // Every scan of one stream read shares its host time. The newest scan of each read is the one
+        // closest to that time, so a read is reported once the first scan of the next one appears.
+        for( int i = 0; i < count; ++i )
+        {
+            if( samples[i].HostTimeNs != mReadHostNs )
+            {
+                if( mReadHostNs >= 0 )
+                {
+                    mClock.ObserveScan( mReadScan, mReadHostNs );
+                }
+                mReadHostNs = samples[i].HostTimeNs;
+            }
+            mReadScan = samples[i].ScanIndex;
+        }
+    }
+
+    void cDigitalEdgeDetector::Process( const sDigitalSample* samples, int count, const DigitalEventSink& sink )
+    {
+        ObserveReads( samples, count );
+
+        int first = 0;
+        if( !mPrimed && count > 0 )
+        {
+            for( sLine& line : mLines )
+            {
+                line.Level = ( samples[0].State & line.Mask ) != 0;
+            }
+            mPrimed = true;
+            first = 1;
+        }
+
+        for( int i = first; i < count; ++i )
+        {
+            const unsigned short state = samples[i].State;
+
+            for( sLine& line : mLines )
+            {
+                const bool level = ( state & line.Mask ) != 0;
+
+                if( level == line.Level )
+                {
+                    // Bounced back before the window closed.
+                    line.Pending = false;
+                    continue;
+                }
+
+                if( !line.Pending )
+                {
+                    line.Pending = true;
+                    line.PendingScans = 0;
+                    line.PendingStart = samples[i].ScanIndex;
+                }
+
+                if( ++line.PendingScans >= line.DebounceScans )
+                {
+                    line.Level = level;
+                    line.Pending = false;
+                    Emit( level ? line.RiseEvent : line.FallEvent, line.PendingStart, sink );
+                }
+            }
+        }
+    }
+
+    void cDigitalEdgeDetector::Drain( cSpscRing<sDigitalSample>& ring, const DigitalEventSink& sink )
+    {
+        LATENCY_SCOPE( EventDetection );
+        TRACE_SCOPE( Input, "edge_detection" );
+        for( ;; )
+        {
+            int count = 0;
+            while( count < kBlockSize && ring.TryPop( mBlock[count] ) )
+            {
+                ++count;
+            }
+
+            if( count == 0 )
+            {
+                return;
+            }
+            Process( mBlock, count, sink );
+
+            if( count < kBlockSize )
+            {
+                return;
+            }
+        }
+    }
+
+    void cDigitalEdgeDetector::Emit( eDigitalEvent type, unsigned long long scanIndex, const DigitalEventSink& sink )
+    {
+        sDigitalEvent event;
+        event.Type = type;
+        event.ScanIndex = scanIndex;
+        event.FrameTime = sFrameTime{ 0, 0 };
+        event.Aligned = mClock.ScanToFrameTime( scanIndex, event.FrameTime );
+
+        // Before the scan clock fit is valid, fall back to the nominal rate from the stream start.
+        event.HostTimeNs = ( mClock.ScanClockValid() ? mClock.ScanToHostNs( scanIndex )
+            : mStream.StartHostTimeNs() + (long long) ( mStream.ScanTime( scanIndex ) * 1e9 ) );
+
+        ++mEventCount;
+        if( sink )
+        {
+            sink( event );
+        }
+    }
+}
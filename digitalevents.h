@@ -0,0 +1,97 @@
+//======================================================================================================
+// Digital events: debounced edge detection over the LabJack digital stream
+//======================================================================================================
+#pragma once
+
+#include <functional>
+
+#include "clocksync.h"
+#include "labjackstream.h"
+
+namespace Capture
+{
+    enum class eDigitalEvent
+    {
+        FingerLift,          // FIO0 high -> low: finger leaves the IR sensor
+        FingerReturn,        // FIO0 low -> high: finger back on the sensor
+        GogglesTransparent,  // FIO1 low -> high
+        GogglesOpaque        // FIO1 high -> low
+    };
+
+    /// <summary>Event name as written in the trial data ("finger_lift", "goggles_opaque", ...).</summary>
+    const char* DigitalEventName( eDigitalEvent type );
+
+    /// <summary>One debounced edge, timed at the first scan that showed the new level.</summary>
+    struct sDigitalEvent
+    {
+        eDigitalEvent Type;
+        unsigned long long ScanIndex; // Stream scan of the edge
+        long long HostTimeNs;         // Scan time on the host steady clock
+        sFrameTime FrameTime;         // Scan time on the Motive frame clock; valid only if Aligned
+        bool Aligned;                 // False until the clock sync has fitted both clocks
+    };
+
+    /// <summary>Called for every event as its debounce window closes.</summary>
+    using DigitalEventSink = std::function<void( const sDigitalEvent& )>;
+
+    struct sEdgeDetectorConfig
+    {
+        double FingerDebounceSeconds = 0.005;  // A new FIO0 level must hold this long to count
+        double GogglesDebounceSeconds = 0.001; // FIO1 is driven by us, so it only needs a short window
+    };
+
+    /// <summary>
+    /// Turns stream scans into finger_lift/finger_return/goggles_transparent/goggles_opaque events.
+    /// A level change is accepted once it has held for the debounce window; the event is then stamped
+    /// with the first scan of the new level, so timing resolution is one scan period rather than the
+    /// debounce window or the frame period. Scan times are converted through cClockSync, which this detector
+    /// also feeds with the stream read times it sees. Not thread-safe: one thread processes all blocks.
+    /// </summary>
+    class cDigitalEdgeDetector
+    {
+    public:
+        cDigitalEdgeDetector( const cLabJackStream& stream, cClockSync& clock,
+            const sEdgeDetectorConfig& config = sEdgeDetectorConfig() );
+
+        /// <summary>Process a block of consecutive scans and emit any completed edges.</summary>
+        void Process( const sDigitalSample* samples, int count, const DigitalEventSink& sink );
+
+        /// <summary>Pop everything queued in the stream's sample ring and process it block by block.</summary>
+        void Drain( cSpscRing<sDigitalSample>& ring, const DigitalEventSink& sink );
+
+        /// <summary>Forget the current line levels; the next scan sets them without emitting events.</summary>
+        void Reset();
+
+        unsigned long long EventCount() const { return mEventCount; }
+
+    private:
+        /// <summary>Debounce state of one digital line.</summary>
+        struct sLine
+        {
+            unsigned short Mask;
+            int DebounceScans;
+            eDigitalEvent RiseEvent;
+            eDigitalEvent FallEvent;
+
+            bool Level = false;
+            bool Pending = false;                 // A different level has been seen but not held long enough
+            int PendingScans = 0;
+            unsigned long long PendingStart = 0;  // First scan of the pending level
+        };
+
+        void Emit( eDigitalEvent type, unsigned long long scanIndex, const DigitalEventSink& sink );
+        void ObserveReads( const sDigitalSample* samples, int count );
+
+        static constexpr int kLineCount = 2;
+        static constexpr int kBlockSize = 256;
+
+        const cLabJackStream& mStream;
+        cClockSync& mClock;
+        sLine mLines[kLineCount];
+        bool mPrimed = false;
+        unsigned long long mReadScan = 0;   // Newest scan of the stream read currently being processed
+        long long mReadHostNs = -1;         // Host time of that read
+        unsigned long long mEventCount = 0;
+        sDigitalSample mBlock[kBlockSize];
+    };
+}
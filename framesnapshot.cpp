@@ -0,0 +1,81 @@
+//======================================================================================================
+// Frame snapshot: whole-frame marker readout into reusable structure-of-arrays buffers
+//======================================================================================================
+#include "framesnapshot.h"
+
+using namespace MotiveAPI;
+
+namespace Capture
+{
+    cFrameSnapshot::cFrameSnapshot( int capacity )
+    {
+        Reserve( capacity );
+    }
+
+    void cFrameSnapshot::Reserve( int capacity )
+    {
+        if( capacity <= mCapacity )
+        {
+            return;
+        }
+
+        mX.resize( capacity );
+        mY.resize( capacity );
+        mZ.resize( capacity );
+        mResidual.resize( capacity );
+        mIDHigh.resize( capacity );
+        mIDLow.resize( capacity );
+        mFlags.resize( capacity );
+        mRays.resize( capacity );
+
+        mCapacity = capacity;
+    }
+
+    int cFrameSnapshot::Capture()
+    {
+        mFrameID = FrameID();
+        mTimeStamp = FrameTimeStamp();
+
+        const int count = MarkerCount();
+        if( count > mCapacity )
+        {
+            Reserve( count > 2 * mCapacity ? count : 2 * mCapacity );
+            ++mReallocations;
+        }
+
+        // Raw column pointers keep the loop free of bounds checks and vector indirection.
+        float* x = mX.data();
+        float* y = mY.data();
+        float* z = mZ.data();
+        float* residual = mResidual.data();
+        unsigned long long* idHigh = mIDHigh.data();
+        unsigned long long* idLow = mIDLow.data();
+        unsigned short* flags = mFlags.data();
+
+        int size = 0;
+        for( int i = 0; i < count; ++i )
+        {
+            if( !Marker( i, mMarker ) )
+            {
+                continue;
+            }
+
+            x[size] = mMarker.X;
+            y[size] = mMarker.Y;
+            z[size] = mMarker.Z;
+            residual[size] = mMarker.Residual;
+            idHigh[size] = mMarker.ID.HighBits();
+            idLow[size] = mMarker.ID.LowBits();
+            flags[size] = mMarker.Flags;
+
+            if( mCaptureRays )
+            {
+                mRays[size] = MarkerContributingRaysCount( i );
+            }
+            ++size;
+        }
+        mSize = size;
+
+        return mSize;
+    }
+}
@@ -0,0 +1,71 @@
+//======================================================================================================
+// Frame snapshot: whole-frame marker readout into reusable structure-of-arrays buffers
+//======================================================================================================
+#pragma once
+
+#include <vector>
+
+#include "MotiveAPI.h"
+
+namespace Capture
+{
+    /// <summary>
+    /// Reads every marker of the current Motive frame in one pass into structure-of-arrays columns
+    /// (x[], y[], z[], idHigh[], idLow[], residual[], flags[]). Each marker costs a single exported
+    /// MotiveAPI::Marker() call instead of separate MarkerXYZ/MarkerID/MarkerResidual calls.
+    /// Column storage is kept between frames; Capture() only reallocates when a frame has more
+    /// markers than any frame before it, so calling Reserve() up front keeps the frame loop allocation-free.
+    /// </summary>
+    class cFrameSnapshot
+    {
+    public:
+        explicit cFrameSnapshot( int capacity = 256 );
+
+        /// <summary>Grow the columns to hold at least capacity markers.</summary>
+        void Reserve( int capacity );
+
+        /// <summary>Also read MarkerContributingRaysCount() per marker (one extra exported call each).</summary>
+        void SetCaptureRays( bool enable ) { mCaptureRays = enable; }
+
+        /// <summary>Read the current frame (call after a successful Update()). Returns the marker count.</summary>
+        int Capture();
+
+        int FrameID() const { return mFrameID; }
+        double TimeStamp() const { return mTimeStamp; }
+        int Size() const { return mSize; }
+        int Capacity() const { return mCapacity; }
+
+        /// <summary>Number of times Capture() had to grow the columns.</summary>
+        int Reallocations() const { return mReallocations; }
+
+        const float* X() const { return mX.data(); }
+        const float* Y() const { return mY.data(); }
+        const float* Z() const { return mZ.data(); }
+        const float* Residual() const { return mResidual.data(); }
+        const unsigned long long* IDHigh() const { return mIDHigh.data(); }
+        const unsigned long long* IDLow() const { return mIDLow.data(); }
+        const unsigned short* Flags() const { return mFlags.data(); }
+
+        /// <summary>Contributing ray counts; only filled when SetCaptureRays( true ).</summary>
+        const int* Rays() const { return mRays.data(); }
+
+    private:
+        int mCapacity = 0;
+        int mSize = 0;
+        int mFrameID = 0;
+        double mTimeStamp = 0;
+        int mReallocations = 0;
+        bool mCaptureRays = false;
+
+        Core::cMarker mMarker; // Reused for every MotiveAPI::Marker() call
+
+        std::vector<float> mX;
+        std::vector<float> mY;
+        std::vector<float> mZ;
+        std::vector<float> mResidual;
+        std::vector<unsigned long long> mIDHigh;
+        std::vector<unsigned long long> mIDLow;
+        std::vector<unsigned short> mFlags;
+        std::vector<int> mRays;
+    };
+}
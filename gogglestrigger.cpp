@@ -0,0 +1,263 @@
+//======================================================================================================
+// Goggles trigger: closed-loop Plato goggles switching on movement onset and offset
+//======================================================================================================
+#include "gogglestrigger.h"
+
+#include <algorithm>
+
+#include "hostclock.h"
+#include "labjackstream.h"
+#include "latencyprobe.h"
+#include "tracepoint.h"
+
+namespace Capture
+{
+    namespace
+    {
+        // Scan host times come from the clock fit, so a confirming edge may be stamped a little before
+        // the decision that caused it. Older edges belong to an earlier switch.
+        const long long kConfirmSlackNs = 2000000;
+
+        double Milliseconds( long long ns )
+        {
+            return ns / 1.0e6;
+        }
+    }
+
+    const char* GogglesStateName( eGogglesState state )
+    {
+        switch( state )
+        {
+        case eGogglesState::Unchanged:   return "unchanged";
+        case eGogglesState::Transparent: return "transparent";
+        case eGogglesState::Opaque:      return "opaque";
+        }
+        return "unknown";
+    }
+
+    const char* TriggerCauseName( eTriggerCause cause )
+    {
+        switch( cause )
+        {
+        case eTriggerCause::Onset:  return "movement_onset";
+        case eTriggerCause::Offset: return "movement_offset";
+        }
+        return "unknown";
+    }
+
+    cGogglesTrigger::cGogglesTrigger( LJ_HANDLE handle, const sGogglesTriggerConfig& config )
+        : mHandle( handle ), mConfig( config )
+    {
+        mConfirmTimeoutNs = (long long) ( mConfig.ConfirmTimeoutSeconds * 1e9 );
+        mRecords.reserve( 1024 );
+    }
+
+    void cGogglesTrigger::Arm()
+    {
+        ++mTrial;
+        mPhase = ePhase::WaitOnset;
+        mRun = 0;
+    }
+
+    void cGogglesTrigger::Disarm()
+    {
+        mPhase = ePhase::Idle;
+        mRun = 0;
+    }
+
+    void cGogglesTrigger::ProcessFrame( const sFrameRecord& frame, const cMarkerFilterBank& filters, const TriggerRecordSink& sink )
+    {
+        mLastFrameID = frame.FrameID;
+
+        if( mPending && frame.HostTimeNs - mPendingRecord.CommandHostNs > mConfirmTimeoutNs )
+        {
+            mPending = false;
+            Complete( mPendingRecord, sink );
+        }
+
+        if( mPhase == ePhase::DelayOnset )
+        {
+            if( frame.FrameID - mDelayFrom >= mConfig.DelayFrames )
+            {
+                Switch( sink );
+            }
+            return;
+        }
+
+        if( mConfig.Source != eTriggerSource::MarkerSpeed || mPhase == ePhase::Idle )
+        {
+            return;
+        }
+
+        // Looked up every frame: the bank reuses the slots of markers that have been gone for a while.
+        const int slot = filters.FindSlot( mConfig.Marker );
+
+        // A frame without the marker breaks the run: the criterion needs consecutive frames.
+        const bool seen = slot >= 0 && filters.Current( slot );
+        const double speed = seen ? filters.Velocity( slot ).Length() : 0.0;
+
+        const bool onset = mPhase == ePhase::WaitOnset;
+        const bool met = seen && ( onset ? speed > mConfig.OnsetSpeed : speed < mConfig.OffsetSpeed );
+        mRun = met ? mRun + 1 : 0;
+
+        if( mRun >= ( onset ? mConfig.OnsetFrames : mConfig.OffsetFrames ) )
+        {
+            Detect( onset ? eTriggerCause::Onset : eTriggerCause::Offset, frame.FrameID, speed, frame.HostTimeNs, sink );
+        }
+    }
+
+    bool cGogglesTrigger::ProcessEvent( const sDigitalEvent& event, const TriggerRecordSink& sink )
+    {
+        if( mConfig.Source == eTriggerSource::FingerLift )
+        {
+            const int frameID = event.Aligned ? (int) event.FrameTime.FrameIndex : -1;
+            if( event.Type == eDigitalEvent::FingerLift && mPhase == ePhase::WaitOnset )
+            {
+                Detect( eTriggerCause::Onset, frameID, 0.0, event.HostTimeNs, sink );
+            }
+            else if( event.Type == eDigitalEvent::FingerReturn && mPhase == ePhase::WaitOffset )
+            {
+                Detect( eTriggerCause::Offset, frameID, 0.0, event.HostTimeNs, sink );
+            }
+        }
+
+        if( !mPending )
+        {
+            return false;
+        }
+
+        const eGogglesState shown = event.Type == eDigitalEvent::GogglesTransparent ? eGogglesState::Transparent
+            : event.Type == eDigitalEvent::GogglesOpaque ? eGogglesState::Opaque : eGogglesState::Unchanged;
+        if( shown != mPendingRecord.State || event.HostTimeNs < mPendingRecord.DecisionHostNs - kConfirmSlackNs )
+        {
+            return false;
+        }
+
+        mPending = false;
+        mPendingRecord.ConfirmHostNs = event.HostTimeNs;
+        TRACE_INSTANT( Input, "goggles_confirmed" );
+        Complete( mPendingRecord, sink );
+        return true;
+    }
+
+    void cGogglesTrigger::Detect( eTriggerCause cause, int frameID, double speed, long long sourceHostNs, const TriggerRecordSink& sink )
+    {
+        mRun = 0;
+
+        sTriggerRecord& record = mDetected;
+        record.Trial = mTrial;
+        record.Cause = cause;
+        record.State = cause == eTriggerCause::Onset ? mConfig.OnsetState : mConfig.OffsetState;
+        record.SourceFrameID = frameID;
+        record.Speed = speed;
+        record.SourceHostNs = sourceHostNs;
+        record.DecisionHostNs = -1;
+        record.CommandHostNs = -1;
+        record.ConfirmHostNs = -1;
+        record.Error = LJE_NOERROR;
+
+        if( cause == eTriggerCause::Onset && mConfig.DelayFrames > 0 )
+        {
+            mPhase = ePhase::DelayOnset;
+            mDelayFrom = mLastFrameID;
+            return;
+        }
+        Switch( sink );
+    }
+
+    void cGogglesTrigger::Switch( const TriggerRecordSink& sink )
+    {
+        sTriggerRecord& record = mDetected;
+        mPhase = record.Cause == eTriggerCause::Onset ? ePhase::WaitOffset : ePhase::Idle;
+        record.DecisionHostNs = HostTimeNs();
+
+        if( record.State == eGogglesState::Unchanged )
+        {
+            Complete( record, sink );
+            return;
+        }
+
+        // A previous switch still unconfirmed will not be: its level is about to be overwritten.
+        if( mPending )
+        {
+            mPending = false;
+            Complete( mPendingRecord, sink );
+        }
+
+        TRACE_INSTANT( Input, record.State == eGogglesState::Transparent ? "goggles_transparent" : "goggles_opaque" );
+        LATENCY_START( writeStart );
+        {
+            std::lock_guard<std::mutex> lock( LabJackMutex() );
+            record.Error = ePut( mHandle, LJ_ioPUT_DIGITAL_BIT, mConfig.Channel, record.State == eGogglesState::Transparent ? 1 : 0, 0 );
+        }
+        record.CommandHostNs = HostTimeNs();
+        LATENCY_VALUE( LabJackWrite, record.CommandHostNs - writeStart );
+
+        if( record.Error != LJE_NOERROR )
+        {
+            Complete( record, sink );
+            return;
+        }
+        mPendingRecord = record;
+        mPending = true;
+    }
+
+    void cGogglesTrigger::Complete( sTriggerRecord& record, const TriggerRecordSink& sink )
+    {
+        mRecords.push_back( record );
+        if( sink )
+        {
+            sink( record );
+        }
+    }
+
+    bool cGogglesTrigger::WriteCsv( const char* path ) const
+    {
+        FILE* file = fopen( path, "w" );
+        if( !file )
+        {
+            return false;
+        }
+
+        auto since = []( long long ns, long long source ) { return ns >= 0 ? Milliseconds( ns - source ) : -1.0; };
+
+        fprintf( file, "trial,event,goggles,source_frame,speed,decision_ms,command_ms,confirm_ms,error\n" );
+        for( const sTriggerRecord& record : mRecords )
+        {
+            fprintf( file, "%d,%s,%s,%d,%.4f,%.3f,%.3f,%.3f,%ld\n", record.Trial, TriggerCauseName( record.Cause ),
+                GogglesStateName( record.State ), record.SourceFrameID, record.Speed,
+                since( record.DecisionHostNs, record.SourceHostNs ), since( record.CommandHostNs, record.SourceHostNs ),
+                since( record.ConfirmHostNs, record.SourceHostNs ), (long) record.Error );
+        }
+
+        return fclose( file ) == 0;
+    }
+
+    void cGogglesTrigger::Report( FILE* out ) const
+    {
+        std::vector<long long> endToEnd;
+        int switches = 0, errors = 0;
+        for( const sTriggerRecord& record : mRecords )
+        {
+            if( record.State == eGogglesState::Unchanged )
+            {
+                continue;
+            }
+            ++switches;
+            errors += record.Error != LJE_NOERROR;
+            if( record.ConfirmHostNs >= 0 )
+            {
+                endToEnd.push_back( record.EndToEndNs() );
+            }
+        }
+
+        fprintf( out, "Goggles trigger: %d trials, %d switches, %d confirmed, %d write errors\n",
+            mTrial, switches, (int) endToEnd.size(), errors );
+        if( !endToEnd.empty() )
+        {
+            std::sort( endToEnd.begin(), endToEnd.end() );
+            fprintf( out, "  end-to-end latency: min %.2f ms, median %.2f ms, max %.2f ms\n", Milliseconds( endToEnd.front() ),
+                Milliseconds( endToEnd[endToEnd.size() / 2] ), Milliseconds( endToEnd.back() ) );
+        }
+    }
+}
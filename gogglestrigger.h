@@ -0,0 +1,153 @@
+//======================================================================================================
+// Goggles trigger: closed-loop Plato goggles switching on movement onset and offset
+//======================================================================================================
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+
+#include "Core/UID.h"
+#include "LabJackUD.h"
+#include "captureengine.h"
+#include "digitalevents.h"
+#include "markerfilter.h"
+
+namespace Capture
+{
+    enum class eGogglesState
+    {
+        Unchanged,
+        Transparent,
+        Opaque
+    };
+
+    /// <summary>What decides movement onset and offset.</summary>
+    enum class eTriggerSource
+    {
+        MarkerSpeed,    // Filtered speed of one marker crosses a threshold for a number of frames
+        FingerLift      // FIO0 finger_lift is the onset, finger_return the offset
+    };
+
+    enum class eTriggerCause
+    {
+        Onset,
+        Offset
+    };
+
+    struct sGogglesTriggerConfig
+    {
+        eTriggerSource Source = eTriggerSource::MarkerSpeed;
+        Core::cUID Marker;                  // MarkerSpeed: marker whose filtered speed is watched
+
+        double OnsetSpeed = 0.10;           // Onset once the speed stays above this (m/s) ...
+        int OnsetFrames = 3;                // ... for this many consecutive frames
+        double OffsetSpeed = 0.05;          // Offset once the speed stays below this (m/s) ...
+        int OffsetFrames = 18;              // ... for this many consecutive frames
+        int DelayFrames = 0;                // Frames between the onset (or lift) and the switch
+
+        eGogglesState OnsetState = eGogglesState::Opaque;
+        eGogglesState OffsetState = eGogglesState::Unchanged;
+
+        long Channel = 1;                   // Digital line driving the goggles: FIO1
+        double ConfirmTimeoutSeconds = 0.1; // Give up waiting for the stream to show the new level
+    };
+
+    /// <summary>
+    /// One onset or offset of a trial. Times are on the host steady clock, in nanoseconds; -1 when the step
+    /// did not happen (no switch commanded, or the stream never showed the new level).
+    /// </summary>
+    struct sTriggerRecord
+    {
+        int Trial;                  // Arm() count
+        eTriggerCause Cause;
+        eGogglesState State;        // Level commanded, Unchanged when the cause only ends the trial
+        int SourceFrameID;          // Frame that met the criterion, or holding the lift; -1 if not aligned
+        double Speed;               // Filtered marker speed at the criterion (MarkerSpeed), m/s
+        long long SourceHostNs;     // Acquisition of that frame, or the lift scan
+        long long DecisionHostNs;   // Switch decided, after DelayFrames
+        long long CommandHostNs;    // LJ_ioPUT_DIGITAL_BIT returned
+        long long ConfirmHostNs;    // Stream scan that first showed the new level
+        LJ_ERROR Error;             // Error from the digital write, LJE_NOERROR if none
+
+        /// <summary>Source to confirmed switch, or -1.</summary>
+        long long EndToEndNs() const { return ConfirmHostNs >= 0 ? ConfirmHostNs - SourceHostNs : -1; }
+    };
+
+    using TriggerRecordSink = std::function<void( const sTriggerRecord& )>;
+
+    const char* GogglesStateName( eGogglesState state );
+    const char* TriggerCauseName( eTriggerCause cause );
+
+    /// <summary>
+    /// Watches the filtered speed of a marker, or the finger sensor, and switches the goggles on movement
+    /// onset and offset, without a round trip through Python. The digital write goes straight out with
+    /// ePut() on the calling thread, and the goggles edge that then shows up in the LabJack stream closes
+    /// the loop: each record carries the source, decision, command and confirmation times, so the full
+    /// trigger latency is measured per trial, down to the stream's scan period.
+    ///
+    /// Onset is searched once per Arm(), then offset, which is recorded even when OffsetState leaves the
+    /// goggles alone, so it can end the trial. ProcessFrame() and ProcessEvent() are meant for the trial
+    /// logic consumer thread; records are delivered from there.
+    /// </summary>
+    class cGogglesTrigger
+    {
+    public:
+        cGogglesTrigger( LJ_HANDLE handle, const sGogglesTriggerConfig& config = sGogglesTriggerConfig() );
+
+        const sGogglesTriggerConfig& Config() const { return mConfig; }
+
+        /// <summary>Start a trial: look for the next onset.</summary>
+        void Arm();
+
+        /// <summary>Stop looking for onset or offset; switches already commanded are still confirmed.</summary>
+        void Disarm();
+
+        bool Armed() const { return mPhase != ePhase::Idle; }
+
+        /// <summary>Run the criteria on a frame. filters must already have processed it.</summary>
+        void ProcessFrame( const sFrameRecord& frame, const cMarkerFilterBank& filters, const TriggerRecordSink& sink );
+
+        /// <summary>Feed a digital event. Returns true when it is the confirmation of a switch this trigger
+        /// commanded, as opposed to one made elsewhere (keyboard, Python).</summary>
+        bool ProcessEvent( const sDigitalEvent& event, const TriggerRecordSink& sink );
+
+        /// <summary>Every record completed so far.</summary>
+        const std::vector<sTriggerRecord>& Records() const { return mRecords; }
+
+        /// <summary>One CSV row per record, latencies in milliseconds from the source.</summary>
+        bool WriteCsv( const char* path ) const;
+
+        /// <summary>Counts and end-to-end latency (min / median / max) of the confirmed switches.</summary>
+        void Report( FILE* out = stdout ) const;
+
+    private:
+        enum class ePhase
+        {
+            Idle,
+            WaitOnset,
+            DelayOnset,
+            WaitOffset
+        };
+
+        void Detect( eTriggerCause cause, int frameID, double speed, long long sourceHostNs, const TriggerRecordSink& sink );
+        void Switch( const TriggerRecordSink& sink );
+        void Complete( sTriggerRecord& record, const TriggerRecordSink& sink );
+
+        LJ_HANDLE mHandle;
+        sGogglesTriggerConfig mConfig;
+        long long mConfirmTimeoutNs;
+
+        ePhase mPhase = ePhase::Idle;
+        int mTrial = 0;
+        int mRun = 0;                   // Consecutive frames meeting the current criterion
+        int mLastFrameID = -1;          // Latest frame seen by ProcessFrame()
+        int mDelayFrom = -1;            // mLastFrameID when the onset was detected
+        sTriggerRecord mDetected;       // Onset waiting for its delay
+
+        bool mPending = false;          // A commanded switch waits for the stream to confirm it
+        sTriggerRecord mPendingRecord;
+
+        std::vector<sTriggerRecord> mRecords;
+    };
+}
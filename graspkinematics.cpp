@@ -0,0 +1,298 @@
+//======================================================================================================
+// Grasp kinematics: streaming grip aperture, transport speed and peak aperture from labeled markers
+//======================================================================================================
+#include "graspkinematics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "hostclock.h"
+
+namespace Capture
+{
+    cGraspKinematics::cGraspKinematics( const sGraspMarkers& markers, const sGraspKinematicsConfig& config )
+        : mConfig( config )
+    {
+        mThumb.ID = markers.Thumb;
+        mIndex.ID = markers.Index;
+        mWrist.ID = markers.Wrist;
+
+        const sBiquadCoefficients lowPass = ButterworthLowPass( mConfig.CutoffHz, mConfig.FrameRate );
+        for( sTrackedMarker* marker : { &mThumb, &mIndex, &mWrist } )
+        {
+            for( cBiquad& filter : marker->Filters )
+            {
+                filter.SetCoefficients( lowPass );
+            }
+        }
+    }
+
+    void cGraspKinematics::Reset()
+    {
+        for( sTrackedMarker* marker : { &mThumb, &mIndex, &mWrist } )
+        {
+            marker->Primed = false;
+            marker->Restarted = false;
+            marker->MissingFrames = 0;
+        }
+
+        mHavePrevious = false;
+        mRising = true;
+        mHaveMaximum = false;
+        mNeedNext = false;
+        mMaximumGripAperture = 0;
+    }
+
+    bool cGraspKinematics::Update( sTrackedMarker& marker, const sFrameRecord& frame )
+    {
+        const unsigned long long high = marker.ID.HighBits();
+        const unsigned long long low = marker.ID.LowBits();
+
+        // Labeled markers tend to keep their place in the frame, so the last index is nearly always a hit.
+        int found = -1;
+        if( marker.Hint < frame.MarkerCount && frame.IDHigh[marker.Hint] == high && frame.IDLow[marker.Hint] == low )
+        {
+            found = marker.Hint;
+        }
+        else
+        {
+            for( int i = 0; i < frame.MarkerCount; ++i )
+            {
+                if( frame.IDHigh[i] == high && frame.IDLow[i] == low )
+                {
+                    found = i;
+                    break;
+                }
+            }
+        }
+
+        marker.Restarted = false;
+        if( found < 0 )
+        {
+            ++marker.MissingFrames;
+            return false;
+        }
+
+        const double raw[3] = { frame.X[found], frame.Y[found], frame.Z[found] };
+        double filtered[3];
+        if( !marker.Primed || marker.MissingFrames > mConfig.MaxGapFrames )
+        {
+            for( int axis = 0; axis < 3; ++axis )
+            {
+                filtered[axis] = marker.Filters[axis].Prime( raw[axis] );
+            }
+            marker.Primed = true;
+            marker.Restarted = true;
+        }
+        else
+        {
+            for( int axis = 0; axis < 3; ++axis )
+            {
+                filtered[axis] = marker.Filters[axis].Process( raw[axis] );
+            }
+        }
+
+        marker.Position.SetValues( filtered[0], filtered[1], filtered[2] );
+        marker.MissingFrames = 0;
+        marker.Hint = found;
+        return true;
+    }
+
+    void cGraspKinematics::Process( const sFrameRecord& frame, const GraspSampleSink& sampleSink, const PeakApertureSink& peakSink )
+    {
+        const bool thumb = Update( mThumb, frame );
+        const bool index = Update( mIndex, frame );
+        if( mWrist.ID.Valid() )
+        {
+            Update( mWrist, frame );
+        }
+
+        sGraspSample sample = {};
+        sample.FrameID = frame.FrameID;
+        sample.TimeStamp = frame.TimeStamp;
+        sample.HostTimeNs = frame.HostTimeNs;
+        sample.Valid = thumb && index;
+
+        if( sample.Valid )
+        {
+            // A wrist that is tracked (or held through a short gap) carries the transport; otherwise the
+            // midpoint of the grip does. Switching source would read as a jump, so it breaks the derivatives.
+            const bool fromWrist = mWrist.Primed && mWrist.MissingFrames <= mConfig.MaxGapFrames;
+            sample.Aperture = mThumb.Position.Distance( mIndex.Position );
+            sample.Transport = fromWrist ? mWrist.Position : Core::cVector3d::Lerp( mThumb.Position, mIndex.Position, 0.5 );
+
+            const bool continuous = mHavePrevious && !mThumb.Restarted && !mIndex.Restarted
+                && !( fromWrist && mWrist.Restarted ) && fromWrist == mPreviousFromWrist;
+
+            double period = frame.TimeStamp - mPreviousTime;
+            if( !( period > 0 ) )
+            {
+                period = 1 / mConfig.FrameRate;
+            }
+
+            if( continuous )
+            {
+                sample.ApertureVelocity = ( sample.Aperture - mPreviousAperture ) / period;
+                sample.TransportSpeed = sample.Transport.Distance( mPreviousTransport ) / period;
+            }
+
+            const double before = continuous ? mPreviousAperture : sample.Aperture;
+
+            mHavePrevious = true;
+            mPreviousTime = frame.TimeStamp;
+            mPreviousAperture = sample.Aperture;
+            mPreviousTransport = sample.Transport;
+            mPreviousFromWrist = fromWrist;
+
+            sample.LatencyNs = HostTimeNs() - frame.HostTimeNs;
+            if( sampleSink )
+            {
+                sampleSink( sample );
+            }
+            TrackPeak( sample, before, period, peakSink );
+        }
+        else
+        {
+            sample.LatencyNs = HostTimeNs() - frame.HostTimeNs;
+            if( sampleSink )
+            {
+                sampleSink( sample );
+            }
+        }
+    }
+
+    void cGraspKinematics::TrackPeak( const sGraspSample& sample, double before, double period, const PeakApertureSink& peakSink )
+    {
+        if( mNeedNext )
+        {
+            mAfterMaximum = sample.Aperture;
+            mNeedNext = false;
+        }
+
+        // Falling: follow the aperture down until it opens again by the hysteresis, then look for the next maximum.
+        if( !mRising )
+        {
+            mMinimum = std::min( mMinimum, sample.Aperture );
+            if( sample.Aperture < mMinimum + mConfig.PeakHysteresis )
+            {
+                return;
+            }
+            mRising = true;
+            mHaveMaximum = false;
+        }
+
+        if( !mHaveMaximum || sample.Aperture > mMaximum.Aperture )
+        {
+            mMaximum = sample;
+            mBeforeMaximum = before;
+            mMaximumPeriod = period;
+            mHaveMaximum = true;
+            mNeedNext = true;
+            return;
+        }
+
+        if( mMaximum.Aperture < mConfig.MinPeakAperture || sample.Aperture > mMaximum.Aperture - mConfig.PeakHysteresis )
+        {
+            return;
+        }
+
+        // Parabola through the maximum and its neighbours; its vertex is the peak between frames.
+        sPeakAperture peak;
+        peak.FrameID = mMaximum.FrameID;
+        peak.TimeStamp = mMaximum.TimeStamp;
+        peak.Aperture = mMaximum.Aperture;
+        peak.TransportSpeed = mMaximum.TransportSpeed;
+        peak.DetectedFrameID = sample.FrameID;
+
+        const double curvature = mBeforeMaximum - 2 * mMaximum.Aperture + mAfterMaximum;
+        if( curvature < 0 )
+        {
+            const double offset = std::max( -0.5, std::min( 0.5, 0.5 * ( mBeforeMaximum - mAfterMaximum ) / curvature ) );
+            peak.TimeStamp += offset * mMaximumPeriod;
+            peak.Aperture -= 0.25 * ( mBeforeMaximum - mAfterMaximum ) * offset;
+        }
+
+        mMaximumGripAperture = std::max( mMaximumGripAperture, peak.Aperture );
+        ++mPeakCount;
+
+        mRising = false;
+        mMinimum = sample.Aperture;
+
+        peak.LatencyNs = HostTimeNs() - mMaximum.HostTimeNs;
+        if( peakSink )
+        {
+            peakSink( peak );
+        }
+    }
+
+    cGraspSampleLog::cGraspSampleLog( size_t capacity )
+        : mRing( capacity )
+    {
+    }
+
+    cGraspSampleLog::~cGraspSampleLog()
+    {
+        Close();
+    }
+
+    bool cGraspSampleLog::Open( const char* path )
+    {
+        Close();
+        mFile = fopen( path, "w" );
+        if( mFile == nullptr )
+        {
+            return false;
+        }
+
+        mFailed = fprintf( mFile, "frame,time,valid,aperture,aperture_velocity,transport_speed,transport_x,transport_y,transport_z,latency_ms\n" ) < 0;
+        return !mFailed;
+    }
+
+    bool cGraspSampleLog::Close()
+    {
+        Drain();
+        if( mFile == nullptr )
+        {
+            return !mFailed;
+        }
+
+        mFailed |= fclose( mFile ) != 0;
+        mFile = nullptr;
+        return !mFailed;
+    }
+
+    void cGraspSampleLog::Push( const sGraspSample& sample )
+    {
+        if( !mRing.TryPush( sample ) )
+        {
+            mDropped.fetch_add( 1, std::memory_order_relaxed );
+        }
+    }
+
+    size_t cGraspSampleLog::Drain()
+    {
+        size_t count = 0;
+        sGraspSample sample;
+        while( mRing.TryPop( sample ) )
+        {
+            ++count;
+            if( mFile == nullptr )
+            {
+                continue;
+            }
+
+            const int written = fprintf( mFile, "%d,%.6f,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,%.3f\n", sample.FrameID, sample.TimeStamp,
+                sample.Valid ? 1 : 0, sample.Aperture, sample.ApertureVelocity, sample.TransportSpeed, sample.Transport.X(),
+                sample.Transport.Y(), sample.Transport.Z(), sample.LatencyNs / 1e6 );
+            if( written < 0 )
+            {
+                mFailed = true;
+            }
+            else
+            {
+                ++mWritten;
+            }
+        }
+        return count;
+    }
+}
@@ -0,0 +1,159 @@
+//======================================================================================================
+// Grasp kinematics: streaming grip aperture, transport speed and peak aperture from labeled markers
+//======================================================================================================
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+#include <functional>
+
+#include "Core/UID.h"
+#include "Core/Vector3.h"
+#include "captureengine.h"
+#include "causalfilter.h"
+#include "spscring.h"
+
+namespace Capture
+{
+    /// <summary>The labeled markers of the grasping hand, by Motive marker ID.</summary>
+    struct sGraspMarkers
+    {
+        Core::cUID Thumb;
+        Core::cUID Index;
+        Core::cUID Wrist;   // Optional: without it, transport is measured at the thumb-index midpoint
+    };
+
+    struct sGraspKinematicsConfig
+    {
+        double FrameRate = 120.0;       // Camera rate the filter is designed for, Hz
+        double CutoffHz = 10.0;         // Low-pass cutoff applied to every marker coordinate
+        double PeakHysteresis = 0.002;  // Aperture must fall this far below a maximum to confirm it, meters
+        double MinPeakAperture = 0.01;  // Smaller maxima are not reported, meters
+        int MaxGapFrames = 3;           // A marker missing longer than this restarts its filter
+    };
+
+    /// <summary>Kinematics of one frame, published as soon as the frame is processed.</summary>
+    struct sGraspSample
+    {
+        int FrameID;
+        double TimeStamp;           // Frame time, seconds
+        long long HostTimeNs;       // Host time the frame was acquired
+        double Aperture;            // Thumb-index distance, meters
+        double ApertureVelocity;    // d Aperture / dt, meters per second
+        double TransportSpeed;      // Wrist (or hand midpoint) speed, meters per second
+        Core::cVector3d Transport;  // Filtered wrist (or hand midpoint) position, meters
+        bool Valid;                 // False when the thumb or index marker is missing from the frame
+        long long LatencyNs;        // From frame acquisition to publication
+    };
+
+    /// <summary>A confirmed local maximum of the grip aperture.</summary>
+    struct sPeakAperture
+    {
+        int FrameID;                // Frame holding the largest sampled aperture
+        double TimeStamp;           // Peak time refined between frames by a parabola through its neighbours
+        double Aperture;            // Refined peak aperture, meters
+        double TransportSpeed;      // Transport speed at that frame
+        int DetectedFrameID;        // Frame on which the hysteresis confirmed the peak
+        long long LatencyNs;        // From acquisition of the peak frame to publication
+    };
+
+    using GraspSampleSink = std::function<void( const sGraspSample& )>;
+    using PeakApertureSink = std::function<void( const sPeakAperture& )>;
+
+    /// <summary>
+    /// Turns each frame into grip aperture, aperture velocity and transport speed, and reports every
+    /// aperture maximum once the aperture has closed by PeakHysteresis below it. Work per frame is constant:
+    /// each marker coordinate runs through its own causal Butterworth biquad, derivatives are differences
+    /// of consecutive filtered values, and markers are located starting at the index where they were last
+    /// seen. Results go to the sinks from inside Process(), on the calling thread. Not thread-safe: call
+    /// Process() and Reset() from the trial logic consumer only.
+    /// </summary>
+    class cGraspKinematics
+    {
+    public:
+        cGraspKinematics( const sGraspMarkers& markers, const sGraspKinematicsConfig& config = sGraspKinematicsConfig() );
+
+        /// <summary>Process one frame. Either sink may be empty.</summary>
+        void Process( const sFrameRecord& frame, const GraspSampleSink& sampleSink, const PeakApertureSink& peakSink );
+
+        /// <summary>Start a new trial: forget the filters, the previous sample and the peak search.</summary>
+        void Reset();
+
+        /// <summary>Largest peak reported since Reset(), or zero.</summary>
+        double MaximumGripAperture() const { return mMaximumGripAperture; }
+
+        unsigned long long PeakCount() const { return mPeakCount; }
+
+    private:
+        /// <summary>Filter state and lookup hint of one tracked marker.</summary>
+        struct sTrackedMarker
+        {
+            Core::cUID ID;
+            int Hint = 0;               // Marker index in the last frame that contained it
+            int MissingFrames = 0;
+            bool Primed = false;
+            bool Restarted = false;     // The filter was (re)primed on this frame
+            cBiquad Filters[3];
+            Core::cVector3d Position;   // Latest filtered position
+        };
+
+        bool Update( sTrackedMarker& marker, const sFrameRecord& frame );
+        void TrackPeak( const sGraspSample& sample, double before, double period, const PeakApertureSink& peakSink );
+
+        sGraspKinematicsConfig mConfig;
+        sTrackedMarker mThumb, mIndex, mWrist;
+
+        bool mHavePrevious = false;
+        double mPreviousTime = 0;
+        double mPreviousAperture = 0;
+        Core::cVector3d mPreviousTransport;
+        bool mPreviousFromWrist = false;
+
+        // Peak search. While rising, the running maximum is kept with its neighbours for the sub-frame
+        // refinement; after a peak, the minimum is followed until the aperture opens again.
+        bool mRising = true;
+        bool mHaveMaximum = false;
+        bool mNeedNext = false;
+        sGraspSample mMaximum;
+        double mBeforeMaximum = 0;
+        double mAfterMaximum = 0;
+        double mMaximumPeriod = 0;
+        double mMinimum = 0;
+
+        double mMaximumGripAperture = 0;
+        unsigned long long mPeakCount = 0;
+    };
+    /// <summary>
+    /// Carries grasp samples off the trial logic thread into a CSV. Push() is the sample sink: it only copies
+    /// into a bounded ring and counts the samples there was no room for. Drain() writes the queued rows from
+    /// one other thread, so the trial logic never waits on the disk.
+    /// </summary>
+    class cGraspSampleLog
+    {
+    public:
+        explicit cGraspSampleLog( size_t capacity = 4096 );
+        ~cGraspSampleLog();
+
+        /// <summary>Create the CSV and write its header. Without it, Drain() discards the samples.</summary>
+        bool Open( const char* path );
+
+        /// <summary>Drain what is left and close the CSV. Returns false if any write failed.</summary>
+        bool Close();
+
+        /// <summary>Trial logic thread: queue one sample, or count it as dropped when the ring is full.</summary>
+        void Push( const sGraspSample& sample );
+
+        /// <summary>Draining thread: write every queued sample and return how many there were.</summary>
+        size_t Drain();
+
+        unsigned long long Written() const { return mWritten; }
+        unsigned long long Dropped() const { return mDropped.load( std::memory_order_relaxed ); }
+
+    private:
+        cSpscRing<sGraspSample> mRing;
+        std::atomic<unsigned long long> mDropped { 0 };
+        unsigned long long mWritten = 0;
+        FILE* mFile = nullptr;
+        bool mFailed = false;
+    };
+}
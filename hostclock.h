@@ -0,0 +1,16 @@
+//======================================================================================================
+// Host clock shared by the capture threads
+//======================================================================================================
+#pragma once
+
+#include <chrono>
+
+namespace Capture
+{
+    /// <summary>Host steady clock in nanoseconds. All capture modules timestamp with this clock.</summary>
+    inline long long HostTimeNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+}
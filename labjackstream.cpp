@@ -0,0 +1,224 @@
+//======================================================================================================
+// LabJack U3 stream acquisition: hardware-timed digital input sampling on a background thread
+//======================================================================================================
+#include "labjackstream.h"
+
+#include <chrono>
+
+#include "hostclock.h"
+#include "tracepoint.h"
+
+namespace Capture
+{
+    namespace
+    {
+        // Largest block drained per LJ_ioGET_STREAM_DATA call. At 1 kHz and a 2 ms poll this is far
+        // more than one read ever returns; it only matters when catching up on a backlog.
+        constexpr int kMaxScansPerRead = 4096;
+    }
+
+    std::mutex& LabJackMutex()
+    {
+        static std::mutex sMutex;
+        return sMutex;
+    }
+
+    cLabJackStream::cLabJackStream( LJ_HANDLE handle ) : mHandle( handle )
+    {
+    }
+
+    cLabJackStream::~cLabJackStream()
+    {
+        Stop();
+    }
+
+    LJ_ERROR cLabJackStream::Start( const sLabJackStreamConfig& config )
+    {
+        if( Running() )
+        {
+            return LJE_STREAM_IS_ACTIVE;
+        }
+
+        // The drain thread may have ended on its own after a stream error.
+        Stop();
+
+        mConfig = config;
+        mSamples.reset( new cSpscRing<sDigitalSample>( config.RingCapacity ) );
+        mReadBuffer.assign( kMaxScansPerRead, 0.0 );
+        mLatest.store( 0, std::memory_order_relaxed );
+        mScansRead.store( 0, std::memory_order_relaxed );
+        mReads.store( 0, std::memory_order_relaxed );
+        mRingOverruns.store( 0, std::memory_order_relaxed );
+        mLastError.store( LJE_NOERROR, std::memory_order_relaxed );
+
+        LJ_ERROR lngErrorcode;
+        std::unique_lock<std::mutex> lock( LabJackMutex() );
+
+        // All FIO/EIO lines digital, scan rate, non-blocking reads, then the single digital-state channel.
+        // FIO0 (IR finger sensor) and FIO1 (goggles) arrive as bits 0 and 1 of channel 193.
+        lngErrorcode = AddRequest( mHandle, LJ_ioPUT_ANALOG_ENABLE_PORT, 0, 0, 16, 0 );
+        if( lngErrorcode != LJE_NOERROR ) return lngErrorcode;
+
+        lngErrorcode = AddRequest( mHandle, LJ_ioPUT_CONFIG, LJ_chSTREAM_SCAN_FREQUENCY, config.ScanRate, 0, 0 );
+        if( lngErrorcode != LJE_NOERROR ) return lngErrorcode;
+
+        // Driver buffer sized for five seconds of scans so a stalled drain thread does not overrun immediately.
+        lngErrorcode = AddRequest( mHandle, LJ_ioPUT_CONFIG, LJ_chSTREAM_BUFFER_SIZE, config.ScanRate * 5, 0, 0 );
+        if( lngErrorcode != LJE_NOERROR ) return lngErrorcode;
+
+        lngErrorcode = AddRequest( mHandle, LJ_ioPUT_CONFIG, LJ_chSTREAM_WAIT_MODE, LJ_swNONE, 0, 0 );
+        if( lngErrorcode != LJE_NOERROR ) return lngErrorcode;
+
+        lngErrorcode = AddRequest( mHandle, LJ_ioCLEAR_STREAM_CHANNELS, 0, 0, 0, 0 );
+        if( lngErrorcode != LJE_NOERROR ) return lngErrorcode;
+
+        lngErrorcode = AddRequest( mHandle, LJ_ioADD_STREAM_CHANNEL, kU3DigitalStreamChannel, 0, 0, 0 );
+        if( lngErrorcode != LJE_NOERROR ) return lngErrorcode;
+
+        lngErrorcode = GoOne( mHandle );
+        if( lngErrorcode != LJE_NOERROR ) return lngErrorcode;
+
+        // Surface any per-request configuration error before starting.
+        long lngIOType = 0, lngChannel = 0;
+        lngErrorcode = GetNextError( mHandle, &lngIOType, &lngChannel );
+        if( lngErrorcode != LJE_NOERROR ) return lngErrorcode;
+
+        // LJ_ioSTART_STREAM returns the actual scan rate, which can differ from the requested one.
+        double actualRate = 0;
+        mStartHostTimeNs = HostTimeNs();
+        lngErrorcode = eGet( mHandle, LJ_ioSTART_STREAM, 0, &actualRate, 0 );
+        if( lngErrorcode != LJE_NOERROR ) return lngErrorcode;
+
+        mScanRate = ( actualRate > 0 ? actualRate : config.ScanRate );
+        mStreaming = true;
+        lock.unlock();
+
+        mRunning.store( true, std::memory_order_release );
+        mThread = std::thread( [this]() { DrainLoop(); } );
+
+        return LJE_NOERROR;
+    }
+
+    void cLabJackStream::Stop()
+    {
+        mRunning.store( false, std::memory_order_release );
+        if( mThread.joinable() )
+        {
+            mThread.join();
+        }
+
+        if( mStreaming )
+        {
+            double unused = 0;
+            std::lock_guard<std::mutex> lock( LabJackMutex() );
+            eGet( mHandle, LJ_ioSTOP_STREAM, 0, &unused, 0 );
+            mStreaming = false;
+        }
+    }
+
+    void cLabJackStream::SampleBacklog()
+    {
+        double backlog = 0;
+        std::lock_guard<std::mutex> lock( LabJackMutex() );
+
+        if( eGet( mHandle, LJ_ioGET_CONFIG, LJ_chSTREAM_BACKLOG_COMM, &backlog, 0 ) == LJE_NOERROR )
+        {
+            mBacklogComm.store( backlog, std::memory_order_relaxed );
+        }
+        if( eGet( mHandle, LJ_ioGET_CONFIG, LJ_chSTREAM_BACKLOG_UD, &backlog, 0 ) == LJE_NOERROR )
+        {
+            mBacklogUD.store( backlog, std::memory_order_relaxed );
+        }
+    }
+
+    void cLabJackStream::DrainLoop()
+    {
+        cTrace::SetThreadName( "labjack stream" );
+        unsigned long long scanIndex = 0;
+        long long lastMetricsNs = HostTimeNs();
+        const long long metricsIntervalNs = (long long) mConfig.MetricsIntervalMs * 1000000;
+
+        while( mRunning.load( std::memory_order_acquire ) )
+        {
+            // Value is the number of scans requested on input and the number returned on output.
+            double numScans = kMaxScansPerRead;
+            LJ_ERROR lngErrorcode;
+            {
+                std::lock_guard<std::mutex> lock( LabJackMutex() );
+                lngErrorcode = eGetPtr( mHandle, LJ_ioGET_STREAM_DATA, LJ_chALL_CHANNELS, &numScans, mReadBuffer.data() );
+            }
+            const long long readTimeNs = HostTimeNs();
+            TRACE_COUNTER( Input, "stream_scans", numScans );
+
+            if( lngErrorcode != LJE_NOERROR )
+            {
+                // Overruns, checksum and ordering errors stop the stream in the driver.
+                mLastError.store( lngErrorcode, std::memory_order_relaxed );
+                if( lngErrorcode > LJE_MIN_GROUP_ERROR || lngErrorcode == LJE_BUFFER_OVERRUN
+                    || lngErrorcode == LJE_STREAM_NOT_RUNNING )
+                {
+                    break;
+                }
+            }
+
+            const int count = (int) numScans;
+            if( count > 0 )
+            {
+                cSpscRing<sDigitalSample>& ring = *mSamples;
+                unsigned short state = 0;
+
+                for( int i = 0; i < count; ++i )
+                {
+                    state = (unsigned short) mReadBuffer[i];
+
+                    sDigitalSample* slot = ( mConfig.QueueSamples ? ring.BeginWrite() : nullptr );
+                    if( slot == nullptr )
+                    {
+                        if( mConfig.QueueSamples ) mRingOverruns.fetch_add( 1, std::memory_order_relaxed );
+                    }
+                    else
+                    {
+                        slot->ScanIndex = scanIndex;
+                        slot->HostTimeNs = readTimeNs;
+                        slot->State = state;
+                        ring.Publish();
+                    }
+                    ++scanIndex;
+                }
+
+                mLatest.store( ( ( scanIndex - 1 ) << 16 ) | state, std::memory_order_release );
+                mScansRead.fetch_add( count, std::memory_order_relaxed );
+                mReads.fetch_add( 1, std::memory_order_relaxed );
+            }
+
+            if( readTimeNs - lastMetricsNs >= metricsIntervalNs )
+            {
+                SampleBacklog();
+                lastMetricsNs = readTimeNs;
+            }
+
+            // A full buffer means we are behind; read again straight away.
+            if( count < kMaxScansPerRead )
+            {
+                std::this_thread::sleep_for( std::chrono::milliseconds( mConfig.PollIntervalMs ) );
+            }
+        }
+
+        mRunning.store( false, std::memory_order_release );
+    }
+
+    sLabJackStreamMetrics cLabJackStream::Metrics() const
+    {
+        sLabJackStreamMetrics metrics;
+
+        metrics.ScansRead = mScansRead.load( std::memory_order_relaxed );
+        metrics.Reads = mReads.load( std::memory_order_relaxed );
+        metrics.RingOverruns = mRingOverruns.load( std::memory_order_relaxed );
+        metrics.BacklogComm = mBacklogComm.load( std::memory_order_relaxed );
+        metrics.BacklogUD = mBacklogUD.load( std::memory_order_relaxed );
+        metrics.ScanRate = mScanRate;
+        metrics.LastError = mLastError.load( std::memory_order_relaxed );
+
+        return metrics;
+    }
+}
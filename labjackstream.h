@@ -0,0 +1,131 @@
+//======================================================================================================
+// LabJack U3 stream acquisition: hardware-timed digital input sampling on a background thread
+//======================================================================================================
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LabJackUD.h"
+#include "spscring.h"
+
+namespace Capture
+{
+    /// <summary>
+    /// Held around every LabJack UD call in the process. The driver keeps one request list per handle, so
+    /// an AddRequest()/GoOne() on one thread could otherwise execute requests another thread has queued,
+    /// and the stream drain, the goggles trigger and the keyboard toggle all share the one handle.
+    /// </summary>
+    std::mutex& LabJackMutex();
+
+    /// <summary>U3 special stream channel that returns the FIO/EIO digital input states as a 16-bit mask.</summary>
+    constexpr long kU3DigitalStreamChannel = 193;
+
+    /// <summary>Bits of the digital state mask that the experiment uses.</summary>
+    constexpr unsigned short kFingerSensorBit = 1 << 0; // FIO0: IR finger sensor
+    constexpr unsigned short kGogglesBit = 1 << 1;      // FIO1: Plato goggles
+
+    /// <summary>One stream scan. Time on the sample clock is ScanIndex / ScanRate() from stream start.</summary>
+    struct sDigitalSample
+    {
+        unsigned long long ScanIndex; // Scans since the stream started
+        long long HostTimeNs;         // Host steady clock when the block holding this scan was read
+        unsigned short State;         // FIO0-7 in the low byte, EIO0-7 in the high byte
+    };
+
+    struct sLabJackStreamConfig
+    {
+        double ScanRate = 1000.0;     // Requested scans per second (LJ_chSTREAM_SCAN_FREQUENCY)
+        bool QueueSamples = true;     // Queue every scan in Samples(); off when only LatestState() is used
+        int RingCapacity = 1 << 16;   // Samples held for the consumer (about a minute at 1 kHz)
+        int PollIntervalMs = 2;       // Sleep between LJ_ioGET_STREAM_DATA reads
+        int MetricsIntervalMs = 100;  // How often the driver/device backlogs are sampled
+    };
+
+    /// <summary>Live counters for the stream thread.</summary>
+    struct sLabJackStreamMetrics
+    {
+        unsigned long long ScansRead;    // Scans drained from the driver
+        unsigned long long Reads;        // LJ_ioGET_STREAM_DATA calls that returned data
+        unsigned long long RingOverruns; // Scans dropped because the consumer ring was full
+        double BacklogComm;              // LJ_chSTREAM_BACKLOG_COMM: bytes waiting in the device
+        double BacklogUD;                // LJ_chSTREAM_BACKLOG_UD: bytes waiting in the driver
+        double ScanRate;                 // Actual scan rate reported by LJ_ioSTART_STREAM
+        LJ_ERROR LastError;              // Last stream error, LJE_NOERROR if none
+    };
+
+    /// <summary>
+    /// Streams the U3 digital lines in hardware-timed stream mode and drains LJ_ioGET_STREAM_DATA on a
+    /// background thread. The frame loop only reads memory: LatestState() for the current FIO levels,
+    /// or Samples() for every scan with its scan-clock index.
+    /// </summary>
+    class cLabJackStream
+    {
+    public:
+        explicit cLabJackStream( LJ_HANDLE handle );
+        ~cLabJackStream();
+
+        cLabJackStream( const cLabJackStream& ) = delete;
+        cLabJackStream& operator=( const cLabJackStream& ) = delete;
+
+        /// <summary>Configure the stream channels and scan rate, start streaming and the drain thread.</summary>
+        /// <returns>LJE_NOERROR on success, or the first LabJack error code.</returns>
+        LJ_ERROR Start( const sLabJackStreamConfig& config = sLabJackStreamConfig() );
+
+        /// <summary>Stop the drain thread and the hardware stream.</summary>
+        void Stop();
+
+        /// <summary>False once stopped, or after a stream error ended the drain thread (see Metrics().LastError).</summary>
+        bool Running() const { return mRunning.load( std::memory_order_acquire ); }
+
+        /// <summary>Most recent digital state mask. Reads memory only.</summary>
+        unsigned short LatestState() const { return (unsigned short) ( mLatest.load( std::memory_order_acquire ) & 0xFFFF ); }
+
+        /// <summary>Scan index of the most recent sample.</summary>
+        unsigned long long LatestScan() const { return mLatest.load( std::memory_order_acquire ) >> 16; }
+
+        bool FingerOnSensor() const { return ( LatestState() & kFingerSensorBit ) != 0; }
+        bool GogglesTransparent() const { return ( LatestState() & kGogglesBit ) != 0; }
+
+        /// <summary>Every scan, in order, for a single consumer thread.</summary>
+        cSpscRing<sDigitalSample>& Samples() { return *mSamples; }
+
+        /// <summary>Actual scan rate in scans per second.</summary>
+        double ScanRate() const { return mScanRate; }
+
+        /// <summary>Host steady clock (ns) when the stream was started; scan zero happened shortly after.</summary>
+        long long StartHostTimeNs() const { return mStartHostTimeNs; }
+
+        /// <summary>Seconds since stream start on the LabJack sample clock.</summary>
+        double ScanTime( unsigned long long scanIndex ) const { return double( scanIndex ) / mScanRate; }
+
+        sLabJackStreamMetrics Metrics() const;
+
+    private:
+        void DrainLoop();
+        void SampleBacklog();
+
+        LJ_HANDLE mHandle;
+        sLabJackStreamConfig mConfig;
+        double mScanRate = 0;
+        long long mStartHostTimeNs = 0;
+
+        std::unique_ptr<cSpscRing<sDigitalSample>> mSamples;
+        std::vector<double> mReadBuffer;
+        std::thread mThread;
+        std::atomic<bool> mRunning{ false };
+        bool mStreaming = false;
+
+        std::atomic<unsigned long long> mLatest{ 0 }; // ScanIndex << 16 | State
+        std::atomic<unsigned long long> mScansRead{ 0 };
+        std::atomic<unsigned long long> mReads{ 0 };
+        std::atomic<unsigned long long> mRingOverruns{ 0 };
+        std::atomic<double> mBacklogComm{ 0 };
+        std::atomic<double> mBacklogUD{ 0 };
+        std::atomic<long> mLastError{ LJE_NOERROR };
+    };
+}
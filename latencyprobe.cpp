@@ -0,0 +1,245 @@
+//======================================================================================================
+// Latency probes: per-thread log-linear histograms of the time spent in each stage of the frame pipeline
+//======================================================================================================
+#include "latencyprobe.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "threadregistry.h"
+
+namespace Capture
+{
+    namespace
+    {
+        /// <summary>The histograms of one thread.</summary>
+        struct sThreadLatency
+        {
+            sThreadLatency( int index ) : Name( "thread " + std::to_string( index + 1 ) ) { }
+
+            std::string Name;   // Under the registry lock
+            cLatencyHistogram Stages[kLatencyStages];
+        };
+
+        using LatencyThreads = cThreadRegistry<sThreadLatency>;
+
+        double Microseconds( long long ns )
+        {
+            return ns / 1000.0;
+        }
+
+        void PrintCounts( FILE* out, const char* name, const sLatencyCounts& counts )
+        {
+            fprintf( out, "  %-18s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n", name, counts.Count,
+                Microseconds( (long long) counts.Mean() ), Microseconds( counts.Percentile( 0.5 ) ),
+                Microseconds( counts.Percentile( 0.9 ) ), Microseconds( counts.Percentile( 0.99 ) ),
+                Microseconds( counts.Percentile( 0.999 ) ), Microseconds( counts.Max() ) );
+        }
+    }
+
+    const char* LatencyStageName( eLatencyStage stage )
+    {
+        switch( stage )
+        {
+        case eLatencyStage::Wake:           return "wake";
+        case eLatencyStage::Update:         return "update";
+        case eLatencyStage::Snapshot:       return "snapshot";
+        case eLatencyStage::Delivery:       return "delivery";
+        case eLatencyStage::Filter:         return "filter";
+        case eLatencyStage::EventDetection: return "event_detection";
+        case eLatencyStage::LabJackWrite:   return "labjack_write";
+        case eLatencyStage::Decision:       return "decision";
+        case eLatencyStage::Count:          break;
+        }
+        return "unknown";
+    }
+
+    //==================================================================================================
+    // cLatencyHistogram, sLatencyCounts
+    //==================================================================================================
+
+    void cLatencyHistogram::Reset()
+    {
+        for( std::atomic<unsigned long long>& bucket : mBuckets )
+        {
+            bucket.store( 0, std::memory_order_relaxed );
+        }
+        mCount.store( 0, std::memory_order_relaxed );
+        mSum.store( 0, std::memory_order_relaxed );
+    }
+
+    void sLatencyCounts::Clear()
+    {
+        for( unsigned long long& bucket : Buckets )
+        {
+            bucket = 0;
+        }
+        Count = 0;
+        Sum = 0;
+    }
+
+    void sLatencyCounts::Add( const cLatencyHistogram& histogram )
+    {
+        // Count is summed from the buckets, so it always agrees with them even while the owner records.
+        for( int i = 0; i < cLatencyHistogram::kBuckets; ++i )
+        {
+            const unsigned long long bucket = histogram.Bucket( i );
+            Buckets[i] += bucket;
+            Count += bucket;
+        }
+        Sum += histogram.Sum();
+    }
+
+    void sLatencyCounts::Subtract( const sLatencyCounts& earlier )
+    {
+        // A ResetLatency() in between makes the earlier counts larger; treat those buckets as new.
+        Count = 0;
+        for( int i = 0; i < cLatencyHistogram::kBuckets; ++i )
+        {
+            Buckets[i] = Buckets[i] >= earlier.Buckets[i] ? Buckets[i] - earlier.Buckets[i] : Buckets[i];
+            Count += Buckets[i];
+        }
+        Sum = Sum >= earlier.Sum ? Sum - earlier.Sum : Sum;
+    }
+
+    long long sLatencyCounts::Percentile( double q ) const
+    {
+        if( Count == 0 )
+        {
+            return 0;
+        }
+
+        unsigned long long rank = (unsigned long long) ( q * Count + 0.5 );
+        rank = rank < 1 ? 1 : ( rank > Count ? Count : rank );
+
+        unsigned long long seen = 0;
+        int last = 0;
+        for( int i = 0; i < cLatencyHistogram::kBuckets; ++i )
+        {
+            if( Buckets[i] == 0 )
+            {
+                continue;
+            }
+            seen += Buckets[i];
+            last = i;
+            if( seen >= rank )
+            {
+                break;
+            }
+        }
+        return cLatencyHistogram::BucketUpperBound( last );
+    }
+
+    //==================================================================================================
+    // Registry
+    //==================================================================================================
+
+    void RecordLatency( eLatencyStage stage, long long ns )
+    {
+        LatencyThreads::Local().Stages[(int) stage].Record( ns );
+    }
+
+    void SetLatencyThreadName( const char* name )
+    {
+        sThreadLatency& thread = LatencyThreads::Local();
+        std::lock_guard<std::mutex> lock( LatencyThreads::Lock() );
+        thread.Name = name;
+    }
+
+    void CollectLatency( eLatencyStage stage, sLatencyCounts& counts )
+    {
+        counts.Clear();
+        std::lock_guard<std::mutex> lock( LatencyThreads::Lock() );
+        for( sThreadLatency* thread : LatencyThreads::Slots() )
+        {
+            counts.Add( thread->Stages[(int) stage] );
+        }
+    }
+
+    void ResetLatency()
+    {
+        std::lock_guard<std::mutex> lock( LatencyThreads::Lock() );
+        for( sThreadLatency* thread : LatencyThreads::Slots() )
+        {
+            for( cLatencyHistogram& histogram : thread->Stages )
+            {
+                histogram.Reset();
+            }
+        }
+    }
+
+    void DumpLatency( FILE* out )
+    {
+#if !CAPTURE_LATENCY_PROBES
+        fprintf( out, "Latency probes are compiled out (CAPTURE_LATENCY_PROBES=0)\n" );
+        return;
+#endif
+        std::unique_ptr<sLatencyCounts> counts( new sLatencyCounts() );
+
+        fprintf( out, "Latency (us)               count       mean        p50        p90        p99      p99.9        max\n" );
+        for( int stage = 0; stage < kLatencyStages; ++stage )
+        {
+            CollectLatency( (eLatencyStage) stage, *counts );
+            if( counts->Count == 0 )
+            {
+                continue;
+            }
+            PrintCounts( out, LatencyStageName( (eLatencyStage) stage ), *counts );
+
+            // Per thread, when more than one thread records the stage (e.g. delivery on every consumer).
+            std::lock_guard<std::mutex> lock( LatencyThreads::Lock() );
+            int threads = 0;
+            for( sThreadLatency* thread : LatencyThreads::Slots() )
+            {
+                threads += thread->Stages[stage].Count() > 0;
+            }
+            if( threads < 2 )
+            {
+                continue;
+            }
+            for( sThreadLatency* thread : LatencyThreads::Slots() )
+            {
+                if( thread->Stages[stage].Count() > 0 )
+                {
+                    counts->Clear();
+                    counts->Add( thread->Stages[stage] );
+                    PrintCounts( out, ( "  " + thread->Name ).c_str(), *counts );
+                }
+            }
+        }
+    }
+
+    //==================================================================================================
+    // cLatencyInterval
+    //==================================================================================================
+
+    cLatencyInterval::cLatencyInterval()
+    {
+        for( sLatencyCounts& counts : mPrevious )
+        {
+            counts.Clear();
+        }
+    }
+
+    void cLatencyInterval::Print( FILE* out )
+    {
+        fprintf( out, "latency p50/p99/max us:" );
+        bool any = false;
+        for( int stage = 0; stage < kLatencyStages; ++stage )
+        {
+            CollectLatency( (eLatencyStage) stage, mCurrent );
+            const sLatencyCounts total = mCurrent;
+            mCurrent.Subtract( mPrevious[stage] );
+            mPrevious[stage] = total;
+
+            if( mCurrent.Count > 0 )
+            {
+                fprintf( out, " %s %.1f/%.1f/%.1f", LatencyStageName( (eLatencyStage) stage ), Microseconds( mCurrent.Percentile( 0.5 ) ),
+                    Microseconds( mCurrent.Percentile( 0.99 ) ), Microseconds( mCurrent.Max() ) );
+                any = true;
+            }
+        }
+        fprintf( out, any ? "\n" : " no samples\n" );
+    }
+}
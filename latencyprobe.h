@@ -0,0 +1,186 @@
+//======================================================================================================
+// Latency probes: per-thread log-linear histograms of the time spent in each stage of the frame pipeline
+//======================================================================================================
+#pragma once
+
+#include <atomic>
+#include <cstdio>
+
+#include "hostclock.h"
+
+// Set to 0 to compile every probe out: the macros below then expand to nothing.
+#ifndef CAPTURE_LATENCY_PROBES
+#define CAPTURE_LATENCY_PROBES 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Capture
+{
+    /// <summary>Pipeline stages with a probe, in pipeline order.</summary>
+    enum class eLatencyStage
+    {
+        Wake,            // FrameAvailable() callback to the acquisition thread noticing it
+        Update,          // MotiveAPI::Update() call
+        Snapshot,        // Frame record fill: timecode and marker snapshot
+        Delivery,        // Update() return to a consumer thread picking the frame up
+        Filter,          // cMarkerFilterBank::Process()
+        EventDetection,  // Draining the LabJack stream through the edge detector
+        LabJackWrite,    // Digital write to the goggles
+        Decision,        // Update() return to the end of the trial logic for that frame
+        Count
+    };
+
+    constexpr int kLatencyStages = (int) eLatencyStage::Count;
+
+    const char* LatencyStageName( eLatencyStage stage );
+
+    /// <summary>
+    /// HDR-style histogram of nanosecond values: exact below 32 ns, then 32 buckets per power of two, so
+    /// every bucket is within about 3% of the values it holds, up to about 18 minutes. Written by one
+    /// thread with plain relaxed stores (no read-modify-write), read at any time by others.
+    /// </summary>
+    class cLatencyHistogram
+    {
+    public:
+        static constexpr int kSubBucketBits = 5;
+        static constexpr int kSubBuckets = 1 << kSubBucketBits;
+        static constexpr int kMaxBit = 40;
+        static constexpr int kBuckets = ( kMaxBit - kSubBucketBits + 1 ) * kSubBuckets;
+
+        cLatencyHistogram() { Reset(); }
+
+        void Record( long long ns )
+        {
+            const int index = BucketIndex( ns );
+            mBuckets[index].store( mBuckets[index].load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            mCount.store( mCount.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            mSum.store( mSum.load( std::memory_order_relaxed ) + ( ns > 0 ? ns : 0 ), std::memory_order_relaxed );
+        }
+
+        /// <summary>Zero the counts. Values recorded concurrently by the owning thread may be lost.</summary>
+        void Reset();
+
+        unsigned long long Count() const { return mCount.load( std::memory_order_relaxed ); }
+        unsigned long long Sum() const { return mSum.load( std::memory_order_relaxed ); }
+        unsigned long long Bucket( int index ) const { return mBuckets[index].load( std::memory_order_relaxed ); }
+
+        static int BucketIndex( long long ns )
+        {
+            if( ns < kSubBuckets )
+            {
+                return ns > 0 ? (int) ns : 0;
+            }
+            const unsigned long long value = ns < ( 1ll << kMaxBit ) ? (unsigned long long) ns : ( 1ull << kMaxBit ) - 1;
+            const int shift = HighestBit( value ) - kSubBucketBits;
+            return ( shift + 1 ) * kSubBuckets + (int) ( value >> shift ) - kSubBuckets;
+        }
+
+        /// <summary>Largest value that lands in the bucket.</summary>
+        static long long BucketUpperBound( int index )
+        {
+            if( index < kSubBuckets )
+            {
+                return index;
+            }
+            const int shift = index / kSubBuckets - 1;
+            const long long lower = (long long) ( index % kSubBuckets + kSubBuckets ) << shift;
+            return lower + ( 1ll << shift ) - 1;
+        }
+
+    private:
+        static int HighestBit( unsigned long long value )
+        {
+#if defined(_MSC_VER)
+            unsigned long bit;
+            _BitScanReverse64( &bit, value );
+            return (int) bit;
+#else
+            return 63 - __builtin_clzll( value );
+#endif
+        }
+
+        std::atomic<unsigned long long> mBuckets[kBuckets];
+        std::atomic<unsigned long long> mCount;
+        std::atomic<unsigned long long> mSum;
+    };
+
+    /// <summary>Counts of one stage merged over threads (or the difference of two such snapshots).</summary>
+    struct sLatencyCounts
+    {
+        unsigned long long Buckets[cLatencyHistogram::kBuckets];
+        unsigned long long Count;
+        unsigned long long Sum;
+
+        void Clear();
+        void Add( const cLatencyHistogram& histogram );
+        void Subtract( const sLatencyCounts& earlier );
+
+        /// <summary>Value at or below which the fraction q of the samples lie (bucket upper bound), ns.</summary>
+        long long Percentile( double q ) const;
+        long long Max() const { return Percentile( 1.0 ); }
+        double Mean() const { return Count ? double( Sum ) / Count : 0.0; }
+    };
+
+    /// <summary>Record a value for the calling thread. The first call on a thread registers its histograms.</summary>
+    void RecordLatency( eLatencyStage stage, long long ns );
+
+    /// <summary>Name the calling thread's histograms in the dump ("acquisition", a consumer's name...).</summary>
+    void SetLatencyThreadName( const char* name );
+
+    /// <summary>One stage merged over all threads.</summary>
+    void CollectLatency( eLatencyStage stage, sLatencyCounts& counts );
+
+    /// <summary>Zero every histogram of every thread.</summary>
+    void ResetLatency();
+
+    /// <summary>Percentile table of every stage, merged and per thread, since start or ResetLatency().</summary>
+    void DumpLatency( FILE* out = stdout );
+
+    /// <summary>
+    /// Periodic one-line summary: Print() writes p50/p99/max of each active stage over the interval since its
+    /// previous call, so the line follows the current behaviour rather than the whole session.
+    /// </summary>
+    class cLatencyInterval
+    {
+    public:
+        cLatencyInterval();
+
+        void Print( FILE* out = stdout );
+
+    private:
+        sLatencyCounts mPrevious[kLatencyStages];
+        sLatencyCounts mCurrent;
+    };
+
+    /// <summary>Records the time from construction to destruction.</summary>
+    class cLatencyScope
+    {
+    public:
+        explicit cLatencyScope( eLatencyStage stage ) : mStage( stage ), mStart( HostTimeNs() ) { }
+        ~cLatencyScope() { RecordLatency( mStage, HostTimeNs() - mStart ); }
+
+        cLatencyScope( const cLatencyScope& ) = delete;
+        cLatencyScope& operator=( const cLatencyScope& ) = delete;
+
+    private:
+        eLatencyStage mStage;
+        long long mStart;
+    };
+}
+
+// Probe macros. LATENCY_START declares a start time, LATENCY_SINCE records the time elapsed since a start
+// (or since any host timestamp, such as sFrameRecord::HostTimeNs), LATENCY_SCOPE times the enclosing block.
+#if CAPTURE_LATENCY_PROBES
+#define LATENCY_START( name ) const long long name = ::Capture::HostTimeNs()
+#define LATENCY_SINCE( stage, startNs ) ::Capture::RecordLatency( ::Capture::eLatencyStage::stage, ::Capture::HostTimeNs() - ( startNs ) )
+#define LATENCY_VALUE( stage, ns ) ::Capture::RecordLatency( ::Capture::eLatencyStage::stage, ( ns ) )
+#define LATENCY_SCOPE( stage ) const ::Capture::cLatencyScope latencyScope( ::Capture::eLatencyStage::stage )
+#else
+#define LATENCY_START( name ) ((void) 0)
+#define LATENCY_SINCE( stage, startNs ) ((void) 0)
+#define LATENCY_VALUE( stage, ns ) ((void) 0)
+#define LATENCY_SCOPE( stage ) ((void) 0)
+#endif
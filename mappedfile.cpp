@@ -0,0 +1,155 @@
+//======================================================================================================
+// Mapped file: read-only memory mapping of a whole file
+//======================================================================================================
+#include "mappedfile.h"
+
+#include "Core/Platform.h"
+
+#ifdef __PLATFORM__LINUX__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+namespace Capture
+{
+    cMappedFile::~cMappedFile()
+    {
+        Close();
+    }
+
+#ifndef __PLATFORM__LINUX__
+    bool cMappedFile::Open( const char* path )
+    {
+        Close();
+
+        HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL, nullptr );
+        if( file == INVALID_HANDLE_VALUE )
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+        if( !GetFileSizeEx( file, &size ) )
+        {
+            CloseHandle( file );
+            return false;
+        }
+
+        mFile = file;
+        mSize = (size_t) size.QuadPart;
+        mOpen = true;
+
+        // CreateFileMapping refuses zero-length files.
+        if( mSize == 0 )
+        {
+            return true;
+        }
+
+        HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        if( mapping == nullptr )
+        {
+            Close();
+            return false;
+        }
+        mMapping = mapping;
+
+        mData = (const unsigned char*) MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+        if( mData == nullptr )
+        {
+            Close();
+            return false;
+        }
+        return true;
+    }
+
+    void cMappedFile::Close()
+    {
+        if( mData )
+        {
+            UnmapViewOfFile( mData );
+        }
+        if( mMapping )
+        {
+            CloseHandle( (HANDLE) mMapping );
+        }
+        if( mFile )
+        {
+            CloseHandle( (HANDLE) mFile );
+        }
+
+        mData = nullptr;
+        mMapping = nullptr;
+        mFile = nullptr;
+        mSize = 0;
+        mOpen = false;
+    }
+
+    void cMappedFile::AdviseSequential() const
+    {
+        // Windows read-ahead on mapped views needs no hint.
+    }
+#else
+    bool cMappedFile::Open( const char* path )
+    {
+        Close();
+
+        const int fd = ::open( path, O_RDONLY );
+        if( fd < 0 )
+        {
+            return false;
+        }
+
+        struct stat info;
+        if( ::fstat( fd, &info ) != 0 )
+        {
+            ::close( fd );
+            return false;
+        }
+
+        mSize = (size_t) info.st_size;
+        if( mSize > 0 )
+        {
+            void* data = ::mmap( nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+            if( data == MAP_FAILED )
+            {
+                ::close( fd );
+                mSize = 0;
+                return false;
+            }
+            mData = (const unsigned char*) data;
+        }
+
+        // The mapping keeps the file alive.
+        ::close( fd );
+        mOpen = true;
+        return true;
+    }
+
+    void cMappedFile::Close()
+    {
+        if( mData )
+        {
+            ::munmap( (void*) mData, mSize );
+        }
+
+        mData = nullptr;
+        mSize = 0;
+        mOpen = false;
+    }
+
+    void cMappedFile::AdviseSequential() const
+    {
+        if( mData )
+        {
+            ::madvise( (void*) mData, mSize, MADV_SEQUENTIAL );
+        }
+    }
+#endif
+}
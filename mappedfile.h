@@ -0,0 +1,42 @@
+//======================================================================================================
+// Mapped file: read-only memory mapping of a whole file
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+
+namespace Capture
+{
+    /// <summary>
+    /// Maps a file read-only into memory for its lifetime. Pages are loaded on first touch, so opening a
+    /// large recording is cheap and readers can hand out pointers straight into the file.
+    /// </summary>
+    class cMappedFile
+    {
+    public:
+        cMappedFile() = default;
+        ~cMappedFile();
+
+        cMappedFile( const cMappedFile& ) = delete;
+        cMappedFile& operator=( const cMappedFile& ) = delete;
+
+        /// <summary>Map the file. Returns false if it cannot be opened or mapped; empty files map to Size() == 0.</summary>
+        bool Open( const char* path );
+        void Close();
+
+        bool IsOpen() const { return mOpen; }
+        const unsigned char* Data() const { return mData; }
+        size_t Size() const { return mSize; }
+
+        /// <summary>Hint that the file will be read front to back.</summary>
+        void AdviseSequential() const;
+
+    private:
+        const unsigned char* mData = nullptr;
+        size_t mSize = 0;
+        bool mOpen = false;
+
+        void* mFile = nullptr;     // Windows file and mapping handles
+        void* mMapping = nullptr;
+    };
+}
@@ -0,0 +1,291 @@
+//======================================================================================================
+// Synthetic marker clouds: deterministic frames of moving, occluding and mislabeled markers for benchmarks
+//======================================================================================================
+#include "markercloud.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace Capture
+{
+    namespace
+    {
+        const double kPi = 3.14159265358979323846;
+        const double kBodySpacing = 0.6;        // Meters between the workspaces of neighbouring bodies, along X
+        const double kClusterRadius = 0.04;
+
+        unsigned long long SplitMix64( unsigned long long& state )
+        {
+            unsigned long long z = ( state += 0x9E3779B97F4A7C15ull );
+            z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ull;
+            z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBull;
+            return z ^ ( z >> 31 );
+        }
+
+        /// <summary>Minimum-jerk position along a reach, s from 0 to 1.</summary>
+        double MinimumJerk( double s )
+        {
+            return s * s * s * ( 10 + s * ( -15 + 6 * s ) );
+        }
+    }
+
+    cMarkerCloud::cMarkerCloud( const sMarkerCloudConfig& config )
+        : mConfig( config )
+    {
+        mConfig.Markers = std::max( 0, mConfig.Markers );
+        mConfig.Bodies = std::max( 1, mConfig.Bodies );
+        mConfig.FrameRate = ( mConfig.FrameRate > 0 ? mConfig.FrameRate : 240.0 );
+        Reset();
+    }
+
+    // Random numbers: SplitMix64 and Box-Muller, so a seed gives the same frames with any standard library.
+
+    double cMarkerCloud::Uniform()
+    {
+        return ( SplitMix64( mRandom ) >> 11 ) * ( 1.0 / 9007199254740992.0 );
+    }
+
+    double cMarkerCloud::Gaussian()
+    {
+        if( mHasSpare )
+        {
+            mHasSpare = false;
+            return mSpareGaussian;
+        }
+        const double radius = std::sqrt( -2.0 * std::log( 1.0 - Uniform() ) );
+        const double angle = 2 * kPi * Uniform();
+        mSpareGaussian = radius * std::sin( angle );
+        mHasSpare = true;
+        return radius * std::cos( angle );
+    }
+
+    void cMarkerCloud::Reset()
+    {
+        mRandom = mConfig.Seed;
+        mHasSpare = false;
+        mFrame = 0;
+        mOcclusions = 0;
+        mSwaps = 0;
+        mNextUnlabeled = 1;
+        mUnlabeledLow = SplitMix64( mRandom );
+
+        const int markers = mConfig.Markers;
+        mBodies.assign( mConfig.Bodies, sBody() );
+        for( int b = 0; b < mConfig.Bodies; ++b )
+        {
+            sBody& body = mBodies[b];
+            const double x = ( b - 0.5 * ( mConfig.Bodies - 1 ) ) * kBodySpacing;
+            body.To[0] = x;
+            body.To[1] = 1.0;
+            body.To[2] = 0.0;
+            body.ToYaw = 0;
+            body.SwapFrames = 0;
+            NewReach( body, b, 0.0 );
+        }
+
+        mBody.resize( markers );
+        mOffsetX.resize( markers );
+        mOffsetY.resize( markers );
+        mOffsetZ.resize( markers );
+        mLabeled.resize( markers );
+        mIDHigh.resize( markers );
+        mIDLow.resize( markers );
+        mOccludedFrames.assign( markers, 0 );
+        mLastX.assign( markers, 0 );
+        mLastY.assign( markers, 0 );
+        mLastZ.assign( markers, 0 );
+
+        // Labeled markers carry their body's asset ID in the high bits and their member number in the low bits.
+        const unsigned long long assetBase = SplitMix64( mRandom ) & ~0xFFFFull;
+        std::vector<unsigned long long> members( mConfig.Bodies, 0 );
+        for( int i = 0; i < markers; ++i )
+        {
+            const int b = i % mConfig.Bodies;
+            mBody[i] = b;
+
+            // Uniform in a ball around the body origin, flattened like a hand.
+            double ox, oy, oz;
+            do
+            {
+                ox = 2 * Uniform() - 1;
+                oy = 2 * Uniform() - 1;
+                oz = 2 * Uniform() - 1;
+            } while( ox * ox + oy * oy + oz * oz > 1 );
+            mOffsetX[i] = ox * kClusterRadius;
+            mOffsetY[i] = oy * kClusterRadius * 0.4;
+            mOffsetZ[i] = oz * kClusterRadius;
+
+            mLabeled[i] = ( Uniform() >= mConfig.UnlabeledFraction );
+            if( mLabeled[i] )
+            {
+                mIDHigh[i] = assetBase + b;
+                mIDLow[i] = ++members[b];
+                mBodies[b].Labeled.push_back( i );
+            }
+            else
+            {
+                mIDHigh[i] = mNextUnlabeled++;
+                mIDLow[i] = mUnlabeledLow;
+            }
+        }
+
+        mX.resize( markers );
+        mY.resize( markers );
+        mZ.resize( markers );
+        mResidual.resize( markers );
+        mOutHigh.resize( markers );
+        mOutLow.resize( markers );
+        mFlags.resize( markers );
+        mCount = 0;
+    }
+
+    /// <summary>Start a reach from where the last one ended to a random target in the body's workspace.</summary>
+    void cMarkerCloud::NewReach( sBody& body, int index, double start )
+    {
+        const double x = ( index - 0.5 * ( mConfig.Bodies - 1 ) ) * kBodySpacing;
+        for( int axis = 0; axis < 3; ++axis )
+        {
+            body.From[axis] = body.To[axis];
+        }
+        body.To[0] = x + 0.4 * ( Uniform() - 0.5 );
+        body.To[1] = 0.9 + 0.3 * Uniform();
+        body.To[2] = 0.5 * ( Uniform() - 0.5 );
+        body.FromYaw = body.ToYaw;
+        body.ToYaw = 0.5 * kPi * ( Uniform() - 0.5 );
+        body.Start = start;
+        body.Duration = 0.6 + 0.6 * Uniform();
+        body.Dwell = 0.2 + 0.4 * Uniform();
+    }
+
+    void cMarkerCloud::Step()
+    {
+        const double rate = mConfig.FrameRate;
+        const double t = mFrame / rate;
+        const double occludeChance = mConfig.OcclusionsPerSecond / rate;
+        const double occludeFrames = std::max( 1.0, mConfig.OcclusionSeconds * rate );
+        const double swapChance = mConfig.SwapsPerSecond / rate;
+
+        for( size_t b = 0; b < mBodies.size(); ++b )
+        {
+            sBody& body = mBodies[b];
+            if( t >= body.Start + body.Duration + body.Dwell )
+            {
+                NewReach( body, (int) b, t );
+            }
+            const double s = std::min( 1.0, ( t - body.Start ) / body.Duration );
+            const double k = MinimumJerk( s );
+            const double yaw = body.FromYaw + ( body.ToYaw - body.FromYaw ) * k;
+            body.X = body.From[0] + ( body.To[0] - body.From[0] ) * k;
+            body.Y = body.From[1] + ( body.To[1] - body.From[1] ) * k;
+            body.Z = body.From[2] + ( body.To[2] - body.From[2] ) * k;
+            body.Cos = std::cos( yaw );
+            body.Sin = std::sin( yaw );
+            body.Grip = 1.0 + 0.3 * std::sin( kPi * s );    // Open on the way, closed on the object
+
+            if( body.SwapFrames > 0 )
+            {
+                --body.SwapFrames;
+            }
+            else if( body.Labeled.size() >= 2 && Uniform() < swapChance )
+            {
+                const size_t a = (size_t) ( Uniform() * body.Labeled.size() );
+                const size_t c = ( a + 1 + (size_t) ( Uniform() * ( body.Labeled.size() - 1 ) ) ) % body.Labeled.size();
+                body.SwapA = body.Labeled[a];
+                body.SwapB = body.Labeled[c];
+                body.SwapFrames = std::max( 1, (int) ( mConfig.SwapSeconds * rate ) );
+                ++mSwaps;
+            }
+        }
+
+        int n = 0;
+        for( int i = 0; i < mConfig.Markers; ++i )
+        {
+            const sBody& body = mBodies[mBody[i]];
+            if( mOccludedFrames[i] > 0 )
+            {
+                if( --mOccludedFrames[i] == 0 && !mLabeled[i] )
+                {
+                    mIDHigh[i] = mNextUnlabeled++;
+                }
+            }
+            else if( Uniform() < occludeChance )
+            {
+                mOccludedFrames[i] = (int) std::ceil( -std::log( 1.0 - Uniform() ) * occludeFrames );
+                ++mOcclusions;
+            }
+
+            if( mOccludedFrames[i] > 0 )
+            {
+                if( !mLabeled[i] || !mConfig.ReportOccluded )
+                {
+                    continue;
+                }
+                mX[n] = mLastX[i];
+                mY[n] = mLastY[i];
+                mZ[n] = mLastZ[i];
+                mResidual[n] = 0;
+                mFlags[n] = Core::Occluded;
+            }
+            else
+            {
+                const double ox = mOffsetX[i] * body.Grip;
+                const double oz = mOffsetZ[i] * body.Grip;
+                mX[n] = mLastX[i] = (float) ( body.X + body.Cos * ox + body.Sin * oz + mConfig.NoiseMeters * Gaussian() );
+                mY[n] = mLastY[i] = (float) ( body.Y + mOffsetY[i] + mConfig.NoiseMeters * Gaussian() );
+                mZ[n] = mLastZ[i] = (float) ( body.Z - body.Sin * ox + body.Cos * oz + mConfig.NoiseMeters * Gaussian() );
+                mResidual[n] = (float) ( 0.2 + 0.1 * std::fabs( Gaussian() ) );
+                mFlags[n] = (unsigned short) ( mLabeled[i] ? Core::PointCloudSolved : Core::PointCloudSolved | Core::Unlabeled );
+            }
+
+            int source = i;
+            if( body.SwapFrames > 0 && ( i == body.SwapA || i == body.SwapB ) )
+            {
+                source = ( i == body.SwapA ? body.SwapB : body.SwapA );
+            }
+            mOutHigh[n] = mIDHigh[source];
+            mOutLow[n] = mIDLow[source];
+            ++n;
+        }
+        mCount = n;
+        ++mFrame;
+    }
+
+    void cMarkerCloud::Next( std::vector<Core::cMarker>& markers )
+    {
+        Step();
+        markers.resize( mCount );
+        for( int i = 0; i < mCount; ++i )
+        {
+            Core::cMarker& marker = markers[i];
+            marker.SetPosition( mX[i], mY[i], mZ[i] );
+            marker.ID = Core::cUID( mOutHigh[i], mOutLow[i] );
+            marker.Size = 2 * 0.006f;
+            marker.Residual = mResidual[i];
+            marker.Flags = mFlags[i];
+        }
+    }
+
+    void cMarkerCloud::Next( sFrameRecord& frame )
+    {
+        Step();
+        const int count = std::min( mCount, kMaxFrameMarkers );
+        const int frameID = mFrame - 1;
+        frame.Sequence = (unsigned long long) mFrame;
+        frame.HostTimeNs = (long long) ( frameID * 1e9 / mConfig.FrameRate );
+        frame.TimeStamp = frameID / mConfig.FrameRate;
+        frame.FrameID = frameID;
+        frame.CalibrationState = MotiveAPI::Complete;
+        frame.Calibration.Quality = -1;
+        frame.Calibration.CamerasLacking = 0;
+        frame.TotalMarkers = mCount;
+        frame.MarkerCount = count;
+        frame.Timecode = sFrameTimecode();
+        std::copy( mX.begin(), mX.begin() + count, frame.X );
+        std::copy( mY.begin(), mY.begin() + count, frame.Y );
+        std::copy( mZ.begin(), mZ.begin() + count, frame.Z );
+        std::copy( mResidual.begin(), mResidual.begin() + count, frame.Residual );
+        std::copy( mOutHigh.begin(), mOutHigh.begin() + count, frame.IDHigh );
+        std::copy( mOutLow.begin(), mOutLow.begin() + count, frame.IDLow );
+        std::copy( mFlags.begin(), mFlags.begin() + count, frame.Flags );
+    }
+}
@@ -0,0 +1,113 @@
+//======================================================================================================
+// Synthetic marker clouds: deterministic frames of moving, occluding and mislabeled markers for benchmarks
+//======================================================================================================
+#pragma once
+
+#include <vector>
+
+#include "Core/Marker.h"
+#include "captureengine.h"
+
+namespace Capture
+{
+    struct sMarkerCloudConfig
+    {
+        int Markers = 100;                  // Markers in the set, dealt round robin to the bodies
+        int Bodies = 1;                     // Independently moving groups: hands, or participants
+        double FrameRate = 240.0;           // Hz
+        unsigned long long Seed = 1;        // Same seed and config, same frames
+
+        double NoiseMeters = 0.0002;        // Gaussian position noise per axis
+        double UnlabeledFraction = 0.05;    // Markers the labeler never names; they get a new ID after each occlusion
+
+        double OcclusionsPerSecond = 0.2;   // Per marker
+        double OcclusionSeconds = 0.15;     // Mean length, exponentially distributed
+        bool ReportOccluded = true;         // Occluded labeled markers stay in the frame, flagged Occluded, at
+                                            // their last position; false drops them as unlabeled ones are
+
+        double SwapsPerSecond = 0.5;        // Per body: two labeled markers trade IDs ...
+        double SwapSeconds = 0.1;           // ... for this long
+    };
+
+    /// <summary>
+    /// Generates marker frames shaped like a reach-to-grasp session, for profiling pipeline stages against
+    /// marker count and frame rate without a camera system. Each body is a cluster of markers about 8 cm
+    /// across that makes minimum-jerk reaches between random targets, turning as it goes and opening and
+    /// closing its grip mid-reach. On top of that come position noise, occlusions, unlabeled markers and
+    /// label swaps, all drawn from a private generator so a seed reproduces the same frames.
+    /// </summary>
+    class cMarkerCloud
+    {
+    public:
+        explicit cMarkerCloud( const sMarkerCloudConfig& config = sMarkerCloudConfig() );
+
+        const sMarkerCloudConfig& Config() const { return mConfig; }
+
+        /// <summary>Back to the first frame; the frames repeat exactly.</summary>
+        void Reset();
+
+        /// <summary>Produce the next frame into markers (resized to the markers in view).</summary>
+        void Next( std::vector<Core::cMarker>& markers );
+
+        /// <summary>Produce the next frame as the capture engine would record it, truncating to kMaxFrameMarkers.</summary>
+        void Next( sFrameRecord& frame );
+
+        /// <summary>Frame number of the next frame, from zero.</summary>
+        int FrameID() const { return mFrame; }
+
+        unsigned long long Occlusions() const { return mOcclusions; }
+        unsigned long long Swaps() const { return mSwaps; }
+
+    private:
+        struct sBody
+        {
+            double From[3];
+            double To[3];
+            double FromYaw;
+            double ToYaw;
+            double Start;           // Seconds the current reach began
+            double Duration;
+            double Dwell;           // Rest at the target before the next reach
+            int SwapA;              // Marker indexes trading IDs, while SwapFrames > 0
+            int SwapB;
+            int SwapFrames;
+            std::vector<int> Labeled;
+
+            // Pose this frame
+            double X, Y, Z;
+            double Cos, Sin;        // Of the yaw
+            double Grip;            // Scale of the marker layout
+        };
+
+        void Step();
+        void NewReach( sBody& body, int index, double start );
+        double Uniform();
+        double Gaussian();
+
+        sMarkerCloudConfig mConfig;
+        unsigned long long mRandom = 0;
+        double mSpareGaussian = 0;
+        bool mHasSpare = false;
+        int mFrame = 0;
+        unsigned long long mNextUnlabeled = 0;
+        unsigned long long mUnlabeledLow = 0;
+        unsigned long long mOcclusions = 0;
+        unsigned long long mSwaps = 0;
+
+        std::vector<sBody> mBodies;
+
+        // Per marker
+        std::vector<int> mBody;
+        std::vector<double> mOffsetX, mOffsetY, mOffsetZ;   // Layout in the body frame, meters
+        std::vector<bool> mLabeled;
+        std::vector<unsigned long long> mIDHigh, mIDLow;
+        std::vector<int> mOccludedFrames;                   // Frames left out of view
+        std::vector<float> mLastX, mLastY, mLastZ;
+
+        // The current frame, markers in view only
+        int mCount = 0;
+        std::vector<float> mX, mY, mZ, mResidual;
+        std::vector<unsigned long long> mOutHigh, mOutLow;
+        std::vector<unsigned short> mFlags;
+    };
+}
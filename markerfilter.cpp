@@ -0,0 +1,411 @@
+//======================================================================================================
+// Marker filter bank: causal smoothing of every marker in a frame, with filter state kept per cUID
+//======================================================================================================
+#include "markerfilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "latencyprobe.h"
+#include "tracepoint.h"
+
+namespace Capture
+{
+    namespace
+    {
+        const double kPi = 3.14159265358979323846;
+
+        size_t HashID( unsigned long long idHigh, unsigned long long idLow )
+        {
+            unsigned long long h = ( idLow ^ ( idHigh * 0x9E3779B97F4A7C15ull ) ) * 0xBF58476D1CE4E5B9ull;
+            return (size_t) ( h ^ ( h >> 31 ) );
+        }
+
+        /// <summary>Smoothing factor of a first-order low-pass at cutoffHz sampled every period seconds.</summary>
+        double OneEuroAlpha( double cutoffHz, double period )
+        {
+            // 1 / ( 1 + tau / period ) with tau = 1 / ( 2 pi cutoffHz ), in one division.
+            const double w = 2 * kPi * cutoffHz * period;
+            return w / ( w + 1 );
+        }
+    }
+
+    cMarkerFilterBank::cMarkerFilterBank( const sMarkerFilterConfig& config )
+        : mConfig( config )
+    {
+        mConfig.MaxMarkers = std::max( 1, mConfig.MaxMarkers );
+
+        switch( mConfig.Type )
+        {
+        case eMarkerFilter::Butterworth:
+            mConfig.Order = std::min( 2 * kMaxSections, std::max( 2, ( mConfig.Order + 1 ) & ~1 ) );
+            mSections = mConfig.Order / 2;
+            for( int section = 0; section < mSections; ++section )
+            {
+                mCoefficients[section] = ButterworthLowPass( mConfig.CutoffHz, mConfig.SampleRate, mConfig.Order, section );
+            }
+            break;
+        case eMarkerFilter::CriticallyDamped:
+            mSections = 1;
+            mCoefficients[0] = CriticallyDampedLowPass( mConfig.CutoffHz, mConfig.SampleRate );
+            break;
+        case eMarkerFilter::OneEuro:
+            mSections = 0;
+            mDerivativeAlpha = OneEuroAlpha( mConfig.DerivativeCutoffHz, 1 / mConfig.SampleRate );
+            break;
+        }
+
+        const size_t slots = (size_t) mConfig.MaxMarkers;
+        mIDHigh.assign( slots, 0 );
+        mIDLow.assign( slots, 0 );
+        size_t hashSize = 1;
+        while( hashSize < 2 * slots )
+        {
+            hashSize <<= 1;
+        }
+        mHashSlots.assign( hashSize, -1 );
+        mHashMask = hashSize - 1;
+
+        mLastSeen.assign( slots, 0 );
+        mFreeSlots.reserve( slots );
+        for( int section = 0; section < mSections; ++section )
+        {
+            for( cColumn( &axis )[2] : mState[section] )
+            {
+                axis[0].assign( slots, 0 );
+                axis[1].assign( slots, 0 );
+            }
+        }
+        for( cColumn* column : { &mPosX, &mPosY, &mPosZ, &mVelX, &mVelY, &mVelZ, &mDerivX, &mDerivY, &mDerivZ } )
+        {
+            column->assign( slots, 0 );
+        }
+
+        Reset();
+    }
+
+    void cMarkerFilterBank::Reset()
+    {
+        std::fill( mHashSlots.begin(), mHashSlots.end(), -1 );
+        std::fill( mLastSeen.begin(), mLastSeen.end(), 0 );
+        std::fill( mFrameSlots, mFrameSlots + kMaxFrameMarkers, -1 );
+        mSameOrder = false;
+        mPreviousCount = 0;
+        mMarkerCount = 0;
+        mFreeSlots.clear();
+        mFrameCount = 0;
+        mUntracked = 0;
+    }
+
+    int cMarkerFilterBank::LookupSlot( unsigned long long idHigh, unsigned long long idLow, size_t& index ) const
+    {
+        index = HashID( idHigh, idLow ) & mHashMask;
+        for( ;; )
+        {
+            const int slot = mHashSlots[index];
+            if( slot < 0 || ( mIDLow[slot] == idLow && mIDHigh[slot] == idHigh ) )
+            {
+                return slot;
+            }
+            index = ( index + 1 ) & mHashMask;
+        }
+    }
+
+    int cMarkerFilterBank::FindOrAddSlot( unsigned long long idHigh, unsigned long long idLow )
+    {
+        size_t index;
+        const int slot = LookupSlot( idHigh, idLow, index );
+        if( slot >= 0 )
+        {
+            return slot;
+        }
+
+        if( mFreeSlots.empty() && mMarkerCount >= mConfig.MaxMarkers )
+        {
+            if( !ReclaimSlots() )
+            {
+                return -1;
+            }
+            LookupSlot( idHigh, idLow, index );     // The table was rebuilt
+        }
+
+        int added;
+        if( !mFreeSlots.empty() )
+        {
+            added = mFreeSlots.back();
+            mFreeSlots.pop_back();
+        }
+        else
+        {
+            added = mMarkerCount++;
+        }
+        mIDHigh[added] = idHigh;
+        mIDLow[added] = idLow;
+        mLastSeen[added] = 0;
+        mHashSlots[index] = added;
+        return added;
+    }
+
+    bool cMarkerFilterBank::ReclaimSlots()
+    {
+        // Slots seen on this frame or within the gap keep their marker. The frame slot hints only ever hold
+        // slots of the last two frames, so none of them is freed.
+        for( int slot = 0; slot < mMarkerCount; ++slot )
+        {
+            if( mLastSeen[slot] != 0 && mFrameCount - mLastSeen[slot] > (unsigned long long) mConfig.MaxGapFrames + 1 )
+            {
+                mLastSeen[slot] = 0;
+                mFreeSlots.push_back( slot );
+            }
+        }
+        if( mFreeSlots.empty() )
+        {
+            return false;
+        }
+
+        // Open addressing cannot simply drop entries from a probe chain; rebuild it from the kept slots.
+        std::fill( mHashSlots.begin(), mHashSlots.end(), -1 );
+        for( int slot = 0; slot < mMarkerCount; ++slot )
+        {
+            if( mLastSeen[slot] != 0 )
+            {
+                size_t index;
+                LookupSlot( mIDHigh[slot], mIDLow[slot], index );
+                mHashSlots[index] = slot;
+            }
+        }
+        return true;
+    }
+
+    int cMarkerFilterBank::FindSlot( const Core::cUID& id ) const
+    {
+        size_t index;
+        return LookupSlot( id.HighBits(), id.LowBits(), index );
+    }
+
+    void cMarkerFilterBank::Process( const sFrameRecord& frame, float* x, float* y, float* z )
+    {
+        LATENCY_SCOPE( Filter );
+        TRACE_SCOPE( Pipeline, "marker_filter" );
+        ++mFrameCount;
+        const int count = std::min( frame.MarkerCount, kMaxFrameMarkers );
+
+        // The usual frame: the same markers in the same order as the previous one, already in slots 0 .. count - 1.
+        if( mSameOrder && count == mPreviousCount
+            && std::memcmp( frame.IDLow, mPreviousIDLow, count * sizeof( unsigned long long ) ) == 0
+            && std::memcmp( frame.IDHigh, mPreviousIDHigh, count * sizeof( unsigned long long ) ) == 0 )
+        {
+            std::fill( mLastSeen.begin(), mLastSeen.begin() + count, mFrameCount );
+            Filter( frame, count, true, x, y, z );
+            return;
+        }
+
+        // Pass 1: match every marker to its slot and settle the filters of markers that (re)appear, so the
+        // filter passes below run the same branch-free recurrence for all of them.
+        int tracked = 0;
+        bool contiguous = true;     // Marker k of the frame is in slot k, as when the set has not changed
+        for( int i = 0; i < count; ++i )
+        {
+            const unsigned long long high = frame.IDHigh[i];
+            const unsigned long long low = frame.IDLow[i];
+
+            // Labeled markers tend to keep their place in the frame, so the previous slot is nearly always a hit.
+            int slot = mFrameSlots[i];
+            if( slot < 0 || mIDLow[slot] != low || mIDHigh[slot] != high )
+            {
+                slot = FindOrAddSlot( high, low );
+            }
+
+            if( slot < 0 || mLastSeen[slot] == mFrameCount )
+            {
+                // Table full, or an ID repeated within the frame: pass the position through.
+                ++mUntracked;
+                mFrameSlots[i] = -1;
+                x[i] = frame.X[i];
+                y[i] = frame.Y[i];
+                z[i] = frame.Z[i];
+                continue;
+            }
+
+            if( mLastSeen[slot] == 0 || mFrameCount - mLastSeen[slot] > (unsigned long long) mConfig.MaxGapFrames + 1 )
+            {
+                Prime( slot, frame.X[i], frame.Y[i], frame.Z[i] );
+            }
+            mLastSeen[slot] = mFrameCount;
+            mFrameSlots[i] = slot;
+
+            mTrackedIndex[tracked] = i;
+            mTrackedSlot[tracked] = slot;
+            contiguous = contiguous && slot == tracked && i == tracked;
+            ++tracked;
+        }
+        std::fill( mFrameSlots + count, mFrameSlots + kMaxFrameMarkers, -1 );
+
+        mSameOrder = contiguous && tracked == count;
+        mPreviousCount = count;
+        std::memcpy( mPreviousIDLow, frame.IDLow, count * sizeof( unsigned long long ) );
+        std::memcpy( mPreviousIDHigh, frame.IDHigh, count * sizeof( unsigned long long ) );
+
+        // Pass 2: filter.
+        Filter( frame, tracked, contiguous, x, y, z );
+    }
+
+    void cMarkerFilterBank::Filter( const sFrameRecord& frame, int tracked, bool contiguous, float* x, float* y, float* z )
+    {
+        if( mConfig.Type == eMarkerFilter::OneEuro )
+        {
+            ProcessOneEuro( frame, tracked, x, y, z );
+        }
+        else if( contiguous )
+        {
+            ProcessBiquadsContiguous( 0, frame.X, mPosX.data(), mVelX.data(), tracked, x );
+            ProcessBiquadsContiguous( 1, frame.Y, mPosY.data(), mVelY.data(), tracked, y );
+            ProcessBiquadsContiguous( 2, frame.Z, mPosZ.data(), mVelZ.data(), tracked, z );
+        }
+        else
+        {
+            ProcessBiquads( 0, frame.X, mPosX.data(), mVelX.data(), tracked, x );
+            ProcessBiquads( 1, frame.Y, mPosY.data(), mVelY.data(), tracked, y );
+            ProcessBiquads( 2, frame.Z, mPosZ.data(), mVelZ.data(), tracked, z );
+        }
+    }
+
+    void cMarkerFilterBank::Prime( int slot, double x, double y, double z )
+    {
+        const double raw[3] = { x, y, z };
+        for( int axis = 0; axis < 3; ++axis )
+        {
+            // cBiquad::Prime() on the slot's column entries: every section settles on the same constant.
+            for( int section = 0; section < mSections; ++section )
+            {
+                const sBiquadCoefficients& c = mCoefficients[section];
+                const double s2 = ( c.B2 - c.A2 ) * raw[axis];
+                mState[section][axis][1][slot] = s2;
+                mState[section][axis][0][slot] = ( c.B1 - c.A1 ) * raw[axis] + s2;
+            }
+        }
+
+        // Previous position at the sample itself, so the first velocity is zero.
+        mPosX[slot] = x;
+        mPosY[slot] = y;
+        mPosZ[slot] = z;
+        mVelX[slot] = mVelY[slot] = mVelZ[slot] = 0;
+        mDerivX[slot] = mDerivY[slot] = mDerivZ[slot] = 0;
+    }
+
+    void cMarkerFilterBank::ProcessBiquads( int axis, const float* raw, double* position, double* velocity, int tracked, float* out )
+    {
+        const int* index = mTrackedIndex;
+        const int* slots = mTrackedSlot;
+        double* work = mWork;
+
+        for( int k = 0; k < tracked; ++k )
+        {
+            work[k] = raw[index[k]];
+        }
+
+        // Section by section over all markers: the markers are independent, so their recurrences overlap.
+        for( int section = 0; section < mSections; ++section )
+        {
+            const sBiquadCoefficients c = mCoefficients[section];
+            double* s1 = mState[section][axis][0].data();
+            double* s2 = mState[section][axis][1].data();
+            for( int k = 0; k < tracked; ++k )
+            {
+                const int slot = slots[k];
+                const double input = work[k];
+                const double value = c.B0 * input + s1[slot];
+                s1[slot] = c.B1 * input - c.A1 * value + s2[slot];
+                s2[slot] = c.B2 * input - c.A2 * value;
+                work[k] = value;
+            }
+        }
+
+        const double rate = mConfig.SampleRate;
+        for( int k = 0; k < tracked; ++k )
+        {
+            const int slot = slots[k];
+            velocity[slot] = ( work[k] - position[slot] ) * rate;
+            position[slot] = work[k];
+            out[index[k]] = (float) work[k];
+        }
+    }
+
+    void cMarkerFilterBank::ProcessBiquadsContiguous( int axis, const float* raw, double* position, double* velocity, int count, float* out )
+    {
+        // ProcessBiquads() without the gather and scatter: with unit stride the compiler vectorizes
+        // each loop across markers.
+        double* work = mWork;
+        for( int k = 0; k < count; ++k )
+        {
+            work[k] = raw[k];
+        }
+
+        for( int section = 0; section < mSections; ++section )
+        {
+            const sBiquadCoefficients c = mCoefficients[section];
+            double* s1 = mState[section][axis][0].data();
+            double* s2 = mState[section][axis][1].data();
+            for( int k = 0; k < count; ++k )
+            {
+                const double input = work[k];
+                const double value = c.B0 * input + s1[k];
+                s1[k] = c.B1 * input - c.A1 * value + s2[k];
+                s2[k] = c.B2 * input - c.A2 * value;
+                work[k] = value;
+            }
+        }
+
+        const double rate = mConfig.SampleRate;
+        for( int k = 0; k < count; ++k )
+        {
+            velocity[k] = ( work[k] - position[k] ) * rate;
+            position[k] = work[k];
+            out[k] = (float) work[k];
+        }
+    }
+
+    void cMarkerFilterBank::ProcessOneEuro( const sFrameRecord& frame, int tracked, float* x, float* y, float* z )
+    {
+        const double rate = mConfig.SampleRate;
+        const double period = 1 / rate;
+        const double derivativeAlpha = mDerivativeAlpha;
+        double* px = mPosX.data();
+        double* py = mPosY.data();
+        double* pz = mPosZ.data();
+        double* dx = mDerivX.data();
+        double* dy = mDerivY.data();
+        double* dz = mDerivZ.data();
+
+        for( int k = 0; k < tracked; ++k )
+        {
+            const int i = mTrackedIndex[k];
+            const int slot = mTrackedSlot[k];
+            const double rx = frame.X[i], ry = frame.Y[i], rz = frame.Z[i];
+
+            // Smooth the derivative first; its magnitude opens the position cutoff, so slow drift is smoothed
+            // hard while a fast reach is followed with little lag. One cutoff for all three axes.
+            dx[slot] += derivativeAlpha * ( ( rx - px[slot] ) * rate - dx[slot] );
+            dy[slot] += derivativeAlpha * ( ( ry - py[slot] ) * rate - dy[slot] );
+            dz[slot] += derivativeAlpha * ( ( rz - pz[slot] ) * rate - dz[slot] );
+            const double speed = std::sqrt( dx[slot] * dx[slot] + dy[slot] * dy[slot] + dz[slot] * dz[slot] );
+
+            const double alpha = OneEuroAlpha( mConfig.MinCutoffHz + mConfig.Beta * speed, period );
+            const double fx = px[slot] + alpha * ( rx - px[slot] );
+            const double fy = py[slot] + alpha * ( ry - py[slot] );
+            const double fz = pz[slot] + alpha * ( rz - pz[slot] );
+
+            mVelX[slot] = ( fx - px[slot] ) * rate;
+            mVelY[slot] = ( fy - py[slot] ) * rate;
+            mVelZ[slot] = ( fz - pz[slot] ) * rate;
+            px[slot] = fx;
+            py[slot] = fy;
+            pz[slot] = fz;
+
+            x[i] = (float) fx;
+            y[i] = (float) fy;
+            z[i] = (float) fz;
+        }
+    }
+}
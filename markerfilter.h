@@ -0,0 +1,139 @@
+//======================================================================================================
+// Marker filter bank: causal smoothing of every marker in a frame, with filter state kept per cUID
+//======================================================================================================
+#pragma once
+
+#include <vector>
+
+#include "Core/UID.h"
+#include "Core/Vector3.h"
+#include "alignedallocator.h"
+#include "captureengine.h"
+#include "causalfilter.h"
+
+namespace Capture
+{
+    enum class eMarkerFilter
+    {
+        Butterworth,        // Cascade of Order / 2 biquads, maximally flat pass band
+        CriticallyDamped,   // One biquad with a double real pole: no overshoot on a step
+        OneEuro             // Adaptive first-order low-pass whose cutoff rises with marker speed
+    };
+
+    struct sMarkerFilterConfig
+    {
+        eMarkerFilter Type = eMarkerFilter::Butterworth;
+        double SampleRate = 180.0;      // Camera rate the filters are designed for, Hz
+        int MaxMarkers = 256;           // Marker IDs kept at once; when full, IDs gone for MaxGapFrames give up their slot
+        int MaxGapFrames = 3;           // A marker missing longer than this restarts its filter
+
+        // Butterworth and critically damped
+        double CutoffHz = 10.0;
+        int Order = 2;                  // Butterworth only: 2, 4, 6 or 8
+
+        // One-euro (Casiez et al.): cutoff = MinCutoffHz + Beta * filtered speed
+        double MinCutoffHz = 1.0;
+        double Beta = 0.5;              // Hz per meter per second
+        double DerivativeCutoffHz = 1.0;
+    };
+
+    /// <summary>
+    /// Filters the positions of all markers of a frame at once. State lives in columns indexed by a slot
+    /// per marker ID: each biquad keeps two state values per axis and slot, the one-euro filter its smoothed
+    /// derivative, and every type the latest filtered position and velocity. When a frame holds the same IDs
+    /// in the same order as the one before (the usual case for labeled markers), the filters run straight
+    /// down the columns with unit stride, which the compiler vectorizes across markers. Otherwise each
+    /// marker is matched to its slot by the slot its frame index had on the previous frame, with a fixed
+    /// hash table behind that. Process() never allocates.
+    ///
+    /// A marker seen for the first time, or again after more than MaxGapFrames frames, starts its filter
+    /// settled on its current position (zero velocity) instead of ringing up from the origin. Since such a
+    /// marker starts over anyway, its slot is reused once the table is full: Motive gives an unlabeled marker
+    /// a new ID after every occlusion, so a long session would otherwise run out of slots. A slot index is
+    /// therefore only meaningful for the frame it was looked up on. Not thread-safe.
+    /// </summary>
+    class cMarkerFilterBank
+    {
+    public:
+        static constexpr int kMaxSections = 4;
+
+        explicit cMarkerFilterBank( const sMarkerFilterConfig& config = sMarkerFilterConfig() );
+
+        const sMarkerFilterConfig& Config() const { return mConfig; }
+
+        /// <summary>Filter every marker of frame; the filtered positions go to x, y and z by frame marker index.
+        /// The output columns may be the frame's own.</summary>
+        void Process( const sFrameRecord& frame, float* x, float* y, float* z );
+
+        /// <summary>Filter the frame's positions in place.</summary>
+        void Process( sFrameRecord& frame ) { Process( frame, frame.X, frame.Y, frame.Z ); }
+
+        /// <summary>Forget every marker and its filter state.</summary>
+        void Reset();
+
+        /// <summary>Slot of marker index i of the last processed frame, or -1 when it was not filtered.</summary>
+        int FrameSlot( int i ) const { return mFrameSlots[i]; }
+
+        /// <summary>Slot of a marker ID, or -1 when it has not been seen or its slot was reused. Look it up again every frame.</summary>
+        int FindSlot( const Core::cUID& id ) const;
+
+        /// <summary>Latest filtered position and velocity of a slot, meters and meters per second.</summary>
+        Core::cVector3d Position( int slot ) const { return Core::cVector3d( mPosX[slot], mPosY[slot], mPosZ[slot] ); }
+        Core::cVector3d Velocity( int slot ) const { return Core::cVector3d( mVelX[slot], mVelY[slot], mVelZ[slot] ); }
+
+        /// <summary>Frames processed since construction or Reset().</summary>
+        unsigned long long FrameCount() const { return mFrameCount; }
+
+        /// <summary>True when the slot was seen on the last processed frame.</summary>
+        bool Current( int slot ) const { return mLastSeen[slot] == mFrameCount; }
+
+        int MarkerCount() const { return mMarkerCount; }
+        unsigned long long Untracked() const { return mUntracked; }
+
+    private:
+        using cColumn = std::vector<double, cAlignedAllocator<double>>;
+
+        int FindOrAddSlot( unsigned long long idHigh, unsigned long long idLow );
+        bool ReclaimSlots();
+        int LookupSlot( unsigned long long idHigh, unsigned long long idLow, size_t& index ) const;
+        void Filter( const sFrameRecord& frame, int tracked, bool contiguous, float* x, float* y, float* z );
+        void Prime( int slot, double x, double y, double z );
+        void ProcessBiquads( int axis, const float* raw, double* position, double* velocity, int tracked, float* out );
+        void ProcessBiquadsContiguous( int axis, const float* raw, double* position, double* velocity, int count, float* out );
+        void ProcessOneEuro( const sFrameRecord& frame, int tracked, float* x, float* y, float* z );
+
+        sMarkerFilterConfig mConfig;
+        int mSections = 1;
+        sBiquadCoefficients mCoefficients[kMaxSections];
+        double mDerivativeAlpha = 1;    // One-euro derivative smoothing
+
+        // Marker table. mHashSlots is open addressing over slots, -1 = empty.
+        std::vector<unsigned long long> mIDHigh, mIDLow;
+        std::vector<int> mHashSlots;
+        size_t mHashMask = 0;
+        int mMarkerCount = 0;                           // Slots ever used, free ones included
+        std::vector<int> mFreeSlots;                    // Reclaimed, reserved to MaxMarkers so Process() never allocates
+
+        // Per-slot columns
+        std::vector<unsigned long long> mLastSeen;      // mFrameCount of the last frame holding the marker
+        cColumn mState[kMaxSections][3][2];             // Biquad state: section, axis, s1/s2
+        cColumn mPosX, mPosY, mPosZ;                    // Latest filtered position
+        cColumn mVelX, mVelY, mVelZ;                    // Difference of the last two filtered positions times the rate
+        cColumn mDerivX, mDerivY, mDerivZ;              // One-euro smoothed derivative, which sets its cutoff
+
+        int mFrameSlots[kMaxFrameMarkers];              // Slot of each marker index of the last frame
+
+        // IDs of the last frame, and whether marker i of it was in slot i
+        unsigned long long mPreviousIDHigh[kMaxFrameMarkers];
+        unsigned long long mPreviousIDLow[kMaxFrameMarkers];
+        int mPreviousCount = 0;
+        bool mSameOrder = false;
+
+        // Markers of the current frame that are filtered, and one axis of them in flight
+        int mTrackedIndex[kMaxFrameMarkers];
+        int mTrackedSlot[kMaxFrameMarkers];
+        double mWork[kMaxFrameMarkers];
+        unsigned long long mFrameCount = 0;
+        unsigned long long mUntracked = 0;
+    };
+}
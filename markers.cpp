@@ -2,48 +2,50 @@
 // Overwriting NaturalPoint Motive API Sample: with Experiment API
 //======================================================================================================
 #include <conio.h>
+#include <chrono>
 #include <thread>
 #include <mutex>
+#include <string>
 
 #include <MotiveAPI.h>
-#include "inputmanager.h"
-#include "apilistener.h"
 #include "transformmatrix.h"
 #include "support.h"
 
 #include "LabJackUD.h"
+#include "captureengine.h"
+#include "labjackstream.h"
+#include "digitalevents.h"
+#include "recording.h"
+#include "graspkinematics.h"
+#include "markerfilter.h"
+#include "gogglestrigger.h"
+#include "takecsv.h"
+#include "latencyprobe.h"
+#include "asynclog.h"
+#include "tracepoint.h"
 
 using namespace MotiveAPI;
 
 LJ_HANDLE lngHandle = 0;
 
+// Digital inputs are streamed by the U3 and drained on a background thread; the readers below only
+// look at the latest scan and never issue a USB transaction.
+Capture::cLabJackStream* labJackStream = nullptr;
+
 // Function to check Plato goggles transparency state (input pin DIO1)
 bool readPlatoGogglesStatus() {
-	long lngErrorcode;
-	double transparencyValue = 0;
-
-	// Read from digital input pin DIO1 for Plato Goggles status (transparent or opaque)
-	lngErrorcode = AddRequest(lngHandle, LJ_ioGET_DIGITAL_BIT, 1, 0, 0, 0);  // DIO1 pin as input
-	ErrorHandler(lngErrorcode, __LINE__, 0);
-
-	// Execute the requests
-	lngErrorcode = GoOne(lngHandle);
-	ErrorHandler(lngErrorcode, __LINE__, 0);
-
-	// Read the transparency value (0 or 1)
-	lngErrorcode = GetFirstResult(lngHandle, &lngIOType, &lngChannel, &transparencyValue, NULL, NULL);
-	ErrorHandler(lngErrorcode, __LINE__, 0);
-
-	return (transparencyValue > 0.5); // Return true if goggles are transparent (1)
+	return labJackStream && labJackStream->GogglesTransparent(); // True if goggles are transparent (1)
 }
 
 // Function to toggle Plato goggles transparency using LabJack (DIO1 pin)
 void togglePlatoGogglesTransparency() {
-	static bool transparent = false; // Initial state: opaque
 	long lngErrorcode;
 
-	// Toggle the transparency state (transparent or opaque)
-	transparent = !transparent;
+	// Toggle from the streamed level, which also follows switches made by the goggles trigger
+	bool transparent = !readPlatoGogglesStatus();
+
+	// The stream drain and the goggles trigger use the same handle from their own threads
+	std::unique_lock<std::mutex> lock(Capture::LabJackMutex());
 
 	// Set DIO0 pin to high (transparent) or low (opaque)
 	lngErrorcode = AddRequest(lngHandle, LJ_ioPUT_DIGITAL_BIT, 1, transparent ? 1 : 0, 0, 0);  // DIO0 pin as output
@@ -51,68 +53,177 @@ void togglePlatoGogglesTransparency() {
 
 	// Execute the requests to apply the state change
 	lngErrorcode = GoOne(lngHandle);
+	lock.unlock();
 	ErrorHandler(lngErrorcode, __LINE__, 0);
 
 	printf("Plato goggles are now %s.\n", transparent ? "transparent" : "opaque");
 }
 
-// Function to trigger Motive recording with Motive API
+// The capture engine, for handing Motive API calls to its acquisition thread.
+Capture::cCaptureEngine* captureEngine = nullptr;
+
+// Function to trigger Motive recording with Motive API. Called from the trial logic consumer, so the
+// call itself is queued for the acquisition thread, which is the only one allowed into the API.
 void triggerCameraRecording(bool start) {
 	if (start) {
 		// Start recording
-		printf("Starting camera recording...\n");
-		StartRecording();
+		OUTPUT(Core::cDebugSystem::Pipeline, "Starting camera recording...\n");
+		captureEngine->Post([]() { StartRecording(); });
 	}
 	else {
 		// Stop recording
-		printf("Stopping camera recording...\n");
-		StopRecording();
+		OUTPUT(Core::cDebugSystem::Pipeline, "Stopping camera recording...\n");
+		captureEngine->Post([]() { StopRecording(); });
 	}
 }
 
-int ProcessFrame(int frameCounter) {
-	float   yaw, pitch, roll;
-	float   x, y, z;
-	float   qx, qy, qz, qw;
-
-	printf("running ProcessFrame now");
-	printf("\rFrame #%d: %d Markers", frameCounter, MarkerCount());
+// Logging consumer: runs on its own thread so console output never stalls frame acquisition.
+// Every line is queued for the log flusher rather than written here. Calibration progress comes
+// with the record, read on the acquisition thread, so this never calls into the API.
+void LogFrame(const Capture::sFrameRecord& frame) {
+	OUTPUT(Core::cDebugSystem::Frame, "\rFrame #%d: %d Markers", frame.FrameID, frame.TotalMarkers);
 
 	// If calibrating, print out some state information.
-	eCalibrationState state = CalibrationState();
-	if (state == eCalibrationState::Wanding) {
-		std::vector<int> neededCameras(CalibrationCamerasLackingSamples());
-		if (!neededCameras.empty())
+	const Capture::sCalibrationProgress& calibration = frame.Calibration;
+	if (calibration.CamerasLacking > 0) {
+		OUTPUT(Core::cDebugSystem::Calibration, "\nNeed more samples for %d cameras:", calibration.CamerasLacking);
+		for (int i = 0; i < calibration.Listed(); ++i)
 		{
-			printf("\nNeed more samples for %d cameras:", (int)neededCameras.size());
-			for (int cameraIndex : neededCameras)
-			{
-				int cameraSamples = CameraCalibrationSamples(cameraIndex);
-				printf("\n%d (%d)", CameraID(cameraIndex), cameraSamples);
-			}
-			printf("\n");
+			OUTPUT(Core::cDebugSystem::Calibration, "\n%d (%d)", calibration.CameraID[i], calibration.Samples[i]);
 		}
+		OUTPUT(Core::cDebugSystem::Calibration, "\n");
 	}
-	else if (state >= eCalibrationState::PreparingSolver && state <= eCalibrationState::Complete) {
-		PrintCalibrationQuality();
+	else if (calibration.Quality >= 0) {
+		OUTPUT(Core::cDebugSystem::Calibration, "\nCalibration quality: %d of 5\n", calibration.Quality);
 	}
+}
 
-	// Check LabJack's status here (e.g., monitor a digital input pin to sync events)
-	bool cameraTriggered = readLabJackTrigger();
+// Columnar binary recording of every frame, written from its own consumer thread.
+Capture::cRecordingWriter recorder;
 
-	if (cameraTriggered) {
-		// If the trigger is active, start recording in Motive if not already started
-		printf("Pluto Goggles turned on! Starting camera recording...\n");
-		triggerCameraRecording(true);  // Trigger the camera recording
+void RecordFrame(const Capture::sFrameRecord& frame) {
+	recorder.Append(frame);
+}
+
+// Edge detection over the streamed FIO lines, timed on the Motive frame clock through the clock
+// sync. Both are only touched from the trial logic consumer thread until the engine is stopped.
+Capture::cClockSync clockSync;
+Capture::cDigitalEdgeDetector* edgeDetector = nullptr;
+
+// Live grip aperture and transport kinematics, when the hand marker IDs are given on the command line.
+// Also only touched from the trial logic consumer thread.
+Capture::cGraspKinematics* graspKinematics = nullptr;
+
+// Every grasp sample is queued here by the trial logic and written to <recording>.grasp.csv by the main loop.
+Capture::cGraspSampleLog graspLog;
+
+void OnGraspSample(const Capture::sGraspSample& sample) {
+	graspLog.Push(sample);
+}
+
+// Peak aperture handler: every confirmed grip aperture maximum goes into the trial event log.
+void OnPeakAperture(const Capture::sPeakAperture& peak) {
+	OUTPUT(Core::cDebugSystem::Pipeline, "\npeak_aperture at frame %d (%.4f s): %.1f mm, transport %.2f m/s, confirmed at frame %d, %.2f ms after the peak frame\n",
+		peak.FrameID, peak.TimeStamp, peak.Aperture * 1000.0, peak.TransportSpeed, peak.DetectedFrameID, peak.LatencyNs / 1.0e6);
+}
+
+// Causal smoothing of every marker and the closed-loop goggles trigger that reads its velocities.
+// Both only touched from the trial logic consumer thread.
+Capture::cMarkerFilterBank* filterBank = nullptr;
+Capture::cGogglesTrigger* gogglesTrigger = nullptr;
+float filteredX[Capture::kMaxFrameMarkers], filteredY[Capture::kMaxFrameMarkers], filteredZ[Capture::kMaxFrameMarkers];
+
+// Trigger record handler: logs the latency of every switch; movement offset ends the trial's camera recording.
+// Runs on the trial logic thread, so the line goes through the log queue.
+void OnTriggerRecord(const Capture::sTriggerRecord& record) {
+	OUTPUT(Core::cDebugSystem::Pipeline, "\n%s (trial %d) at frame %d: goggles %s", Capture::TriggerCauseName(record.Cause), record.Trial,
+		record.SourceFrameID, Capture::GogglesStateName(record.State));
+	if (record.CommandHostNs >= 0) {
+		OUTPUT(Core::cDebugSystem::Pipeline, ", command %.2f ms", (record.CommandHostNs - record.SourceHostNs) / 1.0e6);
+	}
+	if (record.ConfirmHostNs >= 0) {
+		OUTPUT(Core::cDebugSystem::Pipeline, ", confirmed %.2f ms", record.EndToEndNs() / 1.0e6);
+	}
+	else if (record.State != Capture::eGogglesState::Unchanged) {
+		OUTPUT(Core::cDebugSystem::Pipeline, ", NOT CONFIRMED (error %ld)", (long)record.Error);
+	}
+	OUTPUT(Core::cDebugSystem::Pipeline, "\n");
+
+	if (record.Cause == Capture::eTriggerCause::Offset) {
+		triggerCameraRecording(false);
+	}
+}
+
+// Trial event handler: goggles edges start and stop recording; every event is logged with its frame time.
+// Edges the goggles trigger made itself are its confirmations and leave the trial running.
+void OnDigitalEvent(const Capture::sDigitalEvent& event) {
+	const bool commanded = gogglesTrigger && gogglesTrigger->ProcessEvent(event, &OnTriggerRecord);
+
+	if (event.Aligned) {
+		OUTPUT(Core::cDebugSystem::Input, "\n%s at frame %.2f (%.4f s)\n", Capture::DigitalEventName(event.Type), event.FrameTime.FrameIndex, event.FrameTime.TimeStamp);
 	}
 	else {
-		// If the trigger is not active, stop recording in Motive
-		printf("Plato Goggles turned off! Stopping camera recording...\n");
+		OUTPUT(Core::cDebugSystem::Input, "\n%s at scan %llu\n", Capture::DigitalEventName(event.Type), event.ScanIndex);
+	}
+
+	if (commanded) {
+		return;
+	}
+
+	if (event.Type == Capture::eDigitalEvent::GogglesTransparent) {
+		if (graspKinematics) {
+			graspKinematics->Reset(); // New trial: new peak search
+		}
+		if (gogglesTrigger) {
+			gogglesTrigger->Arm(); // New trial: wait for movement onset
+		}
+		OUTPUT(Core::cDebugSystem::Input, "Pluto Goggles turned on! Starting camera recording...\n");
+		triggerCameraRecording(true);  // Trigger the camera recording
+	}
+	else if (event.Type == Capture::eDigitalEvent::GogglesOpaque) {
+		if (gogglesTrigger) {
+			gogglesTrigger->Disarm();
+		}
+		OUTPUT(Core::cDebugSystem::Input, "Plato Goggles turned off! Stopping camera recording...\n");
 		triggerCameraRecording(false); // Stop the camera recording
 	}
+}
+
+// Trial logic consumer: runs off the acquisition thread and only reads LabJack scans from memory.
+void TrialLogic(const Capture::sFrameRecord& frame) {
+	clockSync.ObserveFrame(frame);
+
+	if (filterBank) {
+		filterBank->Process(frame, filteredX, filteredY, filteredZ);
+	}
+
+	if (edgeDetector) {
+		edgeDetector->Drain(labJackStream->Samples(), &OnDigitalEvent);
+	}
+
+	if (gogglesTrigger) {
+		gogglesTrigger->ProcessFrame(frame, *filterBank, &OnTriggerRecord);
+	}
+
+	if (graspKinematics) {
+		graspKinematics->Process(frame, &OnGraspSample, &OnPeakAperture);
+	}
+
+	LATENCY_SINCE(Decision, frame.HostTimeNs);
+}
 
-	// Continue processing frames as usual
-	return frameCounter;
+// Print stream health: a growing backlog means the drain thread is falling behind the U3.
+void PrintLabJackStreamStats(const Capture::cLabJackStream& stream) {
+	Capture::sLabJackStreamMetrics metrics = stream.Metrics();
+
+	printf("LabJack stream: %.1f Hz, %llu scans in %llu reads, backlog comm %.0f / UD %.0f bytes, %llu ring overruns",
+		metrics.ScanRate, metrics.ScansRead, metrics.Reads, metrics.BacklogComm, metrics.BacklogUD, metrics.RingOverruns);
+	if (metrics.LastError != LJE_NOERROR) {
+		char err[255];
+		ErrorToString(metrics.LastError, err);
+		printf(", stopped: %s", err);
+	}
+	printf("\n");
 }
 
 // LabJack error handling function called after every UD function call. 
@@ -141,15 +252,39 @@ int main(int argc, char* argv[])
 {
 	const wchar_t* calibrationFile = L"C:\\ProgramData\\OptiTrack\\Motive\\System Calibration.cal";
 	const wchar_t* profileFile = L"C:\\ProgramData\\OptiTrack\\MotiveProfile.motive";
+	const char* recordingFile = (argc > 1 ? argv[1] : "markers.mkrc");
+
+	// Optional thumb, index and wrist marker IDs, written as in the ID row of a take CSV export.
+	Capture::sGraspMarkers graspMarkers;
+	if (argc > 3) {
+		graspMarkers.Thumb = Capture::ParseTakeID(argv[2]);
+		graspMarkers.Index = Capture::ParseTakeID(argv[3]);
+		graspMarkers.Wrist = (argc > 4 ? Capture::ParseTakeID(argv[4]) : Core::cUID());
+	}
+
+	// Console output from the capture threads is queued and written by the log flusher.
+	Core::cDebugSystem::SystemVisibility[Core::cDebugSystem::Frame] = true;
+	Core::cDebugSystem::SystemVisibility[Core::cDebugSystem::Input] = true;
+	Core::cDebugSystem::SystemVisibility[Core::cDebugSystem::Pipeline] = true;
+	Core::cDebugSystem::SystemVisibility[Core::cDebugSystem::Calibration] = true;
+	Capture::cAsyncLog::Start();
+
+	// Tracepoints stay off unless selected by CAPTURE_TRACE or the control file (see tracepoint.h).
+	Capture::cTrace::Start();
 
 	if (Initialize() != kApiResult_Success) {
 		printf("Unable to license Motive API\n");
 		return 1;
 	}
 
-	// Attach listener for frame notifications
-	APIListener listener;
-	AttachListener(&listener);
+	// The capture engine owns the frame listener and attaches it on Start().
+	Capture::cCaptureEngine engine;
+	captureEngine = &engine;
+	engine.SetAcquisitionCore(1);
+	engine.SetCaptureTimecode(true);
+	engine.AddConsumer("log", &LogFrame);
+	engine.AddConsumer("trial", &TrialLogic);
+	engine.AddConsumer("record", &RecordFrame);
 
 	// Automatically Load a current camera calibration and profiles saved by Motive.
 	int cameraCount = LoadCalibrationAndProfile(calibrationFile, profileFile);
@@ -181,34 +316,132 @@ int main(int argc, char* argv[])
 	lngErrorcode = GoOne(lngHandle);
 	ErrorHandler(lngErrorcode, __LINE__, 0);
 
+	// Stream FIO0 (finger sensor) and FIO1 (goggles) at 1 kHz instead of polling them every frame.
+	Capture::cLabJackStream labJack(lngHandle);
+	lngErrorcode = labJack.Start();
+	ErrorHandler(lngErrorcode, __LINE__, 0);
+	labJackStream = &labJack;
+
+	// Finger and goggles edges are extracted from every scan, not sampled once per frame.
+	Capture::cDigitalEdgeDetector detector(labJack, clockSync);
+	edgeDetector = &detector;
+
+	Capture::sGraspKinematicsConfig graspConfig;
+	graspConfig.FrameRate = CameraSystemFrameRate() > 0 ? CameraSystemFrameRate() : graspConfig.FrameRate;
+	Capture::cGraspKinematics grasp(graspMarkers, graspConfig);
+	if (graspMarkers.Thumb.Valid() && graspMarkers.Index.Valid()) {
+		graspKinematics = &grasp;
+	}
+	std::string graspFile = std::string(recordingFile) + ".grasp.csv";
+	if (graspKinematics && !graspLog.Open(graspFile.c_str())) {
+		printf("Unable to create %s\n", graspFile.c_str());
+	}
+
+	// Goggles go opaque at movement onset: when the wrist marker leaves at speed if one was given,
+	// otherwise when the finger lifts off the IR sensor. Critically damped smoothing never overshoots
+	// the speed threshold.
+	Capture::sMarkerFilterConfig filterConfig;
+	filterConfig.Type = Capture::eMarkerFilter::CriticallyDamped;
+	filterConfig.SampleRate = CameraSystemFrameRate() > 0 ? CameraSystemFrameRate() : filterConfig.SampleRate;
+	Capture::cMarkerFilterBank filters(filterConfig);
+	filterBank = &filters;
+
+	Capture::sGogglesTriggerConfig triggerConfig;
+	triggerConfig.Source = graspMarkers.Wrist.Valid() ? Capture::eTriggerSource::MarkerSpeed : Capture::eTriggerSource::FingerLift;
+	triggerConfig.Marker = graspMarkers.Wrist;
+	Capture::cGogglesTrigger trigger(lngHandle, triggerConfig);
+	gogglesTrigger = &trigger;
+
+	if (!recorder.Open(recordingFile)) {
+		printf("Unable to create recording %s\n", recordingFile);
+	}
+
+	// Acquisition and the consumers run on their own threads from here on.
+	engine.Start();
+
 	// User input for toggling Plato goggles transparency (space bar)
-	printf("Press Space to toggle Plato goggles transparency.\n");
+	printf("Press Space to toggle Plato goggles transparency, 'r' to report capture stats, 'l' for latency percentiles, 's' to save and quit, 'q' to quit.\n");
+
+	// One latency line per interval, covering that interval only (the snapshots are too big for the stack)
+	std::unique_ptr<Capture::cLatencyInterval> latencyInterval(new Capture::cLatencyInterval());
+	auto latencyLineTime = std::chrono::steady_clock::now();
+
+	bool save = false;
+	bool quit = false;
+	while (!quit) {
+		if (std::chrono::steady_clock::now() - latencyLineTime >= std::chrono::seconds(10)) {
+			latencyLineTime = std::chrono::steady_clock::now();
+			latencyInterval->Print();
+		}
+		graspLog.Drain();
 
-	// Wait for user input to toggle goggles transparency
-	while (true) {
 		if (_kbhit()) {
 			char ch = _getch();
 			if (ch == ' ') {  // Space bar pressed
 				togglePlatoGogglesTransparency(); // Toggle goggles transparency
 			}
+			else if (ch == 'r') {
+				printf("\n");
+				engine.ReportStats();
+				PrintLabJackStreamStats(labJack);
+			}
+			else if (ch == 'l') {
+				printf("\n");
+				Capture::DumpLatency();
+			}
+			else if (ch == 's' || ch == 'q') {
+				save = (ch == 's');
+				quit = true;
+			}
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
 		}
 	}
 
-	// hookup commands for user input
-	InputManager inputManager;
-
-	// set function to be called for each frame during ProcessFrames();
-	inputManager.RegisterProcessFrameFunction(&ProcessFrame);
+	engine.Stop();
+	edgeDetector = nullptr;
+	graspKinematics = nullptr;
+	gogglesTrigger = nullptr;
+	filterBank = nullptr;
+	labJackStream = nullptr;
+	labJack.Stop();
+	Capture::cAsyncLog::Stop();
+	Capture::cTrace::Stop();
+	printf("\n");
+	Capture::sTraceStats traceStats = Capture::cTrace::Stats();
+	if (traceStats.Written > 0) {
+		printf("Trace: %llu events, %llu dropped\n", traceStats.Written, traceStats.Dropped);
+	}
+	engine.ReportStats();
+	PrintLabJackStreamStats(labJack);
+	clockSync.Report();
+	Capture::DumpLatency();
+	if (graspMarkers.Thumb.Valid() && graspMarkers.Index.Valid()) {
+		bool graspWritten = graspLog.Close();
+		printf("Grasp kinematics: %llu aperture peaks, %llu samples in %s, %llu dropped%s\n", grasp.PeakCount(),
+			graspLog.Written(), graspFile.c_str(), graspLog.Dropped(), graspWritten ? "" : ", WRITE ERROR");
+	}
+	trigger.Report();
+	std::string triggerLog = std::string(recordingFile) + ".trigger.csv";
+	if (!trigger.Records().empty() && !trigger.WriteCsv(triggerLog.c_str())) {
+		printf("Unable to write %s\n", triggerLog.c_str());
+	}
 
-	// start processing frames
-	inputManager.ProcessFrames(listener);
+	if (recorder.IsOpen()) {
+		bool written = recorder.Close();
+		Capture::sRecordingStats recording = recorder.Stats();
+		printf("Recording %s: %llu frames, %d markers, %.1f MB, %llu dropped, %llu untracked%s\n", recordingFile,
+			recording.Frames, recording.MarkerCount, recording.BytesWritten / 1048576.0, recording.DroppedFrames,
+			recording.Untracked, written ? "" : ", WRITE ERROR");
+	}
 
-	if (inputManager.Save()) {
+	if (save) {
 		CheckResult(SaveProfile(profileFile));
 		CheckResult(SaveCalibration(calibrationFile));
 	}
 
-	inputManager.Shutdown();
+	Shutdown();
 
 	return 0;
 }
\ No newline at end of file
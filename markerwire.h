@@ -0,0 +1,352 @@
+//======================================================================================================
+// Marker wire layout: versioned, packed serialization of whole frames of Core::cTMarker
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <istream>
+#include <type_traits>
+#include <vector>
+
+#include "Core/Marker.h"
+
+namespace Capture
+{
+    //==================================================================================================
+    // Wire layout, version 1
+    //
+    //   sMarkerWireHeader                          16 bytes
+    //   sMarkerWireRecord<T>[Count]                72 bytes (float) or 96 bytes (double) each
+    //
+    // The record mirrors the in-memory cTMarker<T> of the 64-bit MSVC and GCC ABIs field for field,
+    // padding included. Where the host layout matches, a frame is written and read with one memcpy.
+    // Other hosts pack field by field into the same bytes. Padding is always written as zero. Values are
+    // in the writer's byte order, which ByteOrder records; readers reject data of the other byte order or
+    // of a different scalar size rather than converting it.
+    //==================================================================================================
+
+    constexpr char kMarkerWireMagic[4] = { 'M', 'K', 'W', 'R' };
+    constexpr uint16_t kMarkerWireVersion = 1;
+    constexpr uint32_t kMarkerWireByteOrder = 0x01020304;
+
+    struct sMarkerWireHeader
+    {
+        char Magic[4];
+        uint16_t Version;
+        uint8_t ScalarBytes;    // sizeof( T ): 4 or 8
+        uint8_t RecordBytes;    // sizeof( sMarkerWireRecord<T> )
+        uint32_t ByteOrder;     // kMarkerWireByteOrder as stored by the writer
+        uint32_t Count;
+    };
+
+    template<typename T>
+    struct sMarkerWireRecord
+    {
+        uint64_t IDHigh;
+        uint64_t IDLow;
+        uint32_t ActiveID;
+        T X;
+        T Y;
+        T Z;
+        T Size;
+        T Residual;
+        uint64_t LabelEntityHigh;
+        uint64_t LabelEntityLow;
+        uint32_t LabelMember;
+        uint32_t Reserved;      // cLabel's tail padding
+        uint8_t Selected;
+        uint8_t Synthetic;
+        uint16_t Flags;
+    };
+
+    static_assert( sizeof( sMarkerWireHeader ) == 16, "Marker wire header layout changed" );
+    static_assert( sizeof( sMarkerWireRecord<float> ) == 72, "Marker wire record layout changed" );
+    static_assert( sizeof( sMarkerWireRecord<double> ) == 96, "Marker wire record layout changed" );
+
+    enum class eMarkerWireStatus
+    {
+        Ok = 0,
+        Truncated,              // Fewer bytes than the header or its Count promises
+        NotMarkerData,          // Bad magic
+        UnsupportedVersion,
+        ByteOrderMismatch,      // Written on a host of the other endianness
+        ScalarMismatch,         // Written as cTMarker<float>, read as cTMarker<double> or vice versa
+        CapacityTooSmall        // The destination cannot hold every marker
+    };
+
+    inline const char* MarkerWireStatusName( eMarkerWireStatus status )
+    {
+        switch( status )
+        {
+        case eMarkerWireStatus::Ok:                 return "ok";
+        case eMarkerWireStatus::Truncated:          return "truncated";
+        case eMarkerWireStatus::NotMarkerData:      return "not marker data";
+        case eMarkerWireStatus::UnsupportedVersion: return "unsupported version";
+        case eMarkerWireStatus::ByteOrderMismatch:  return "byte order mismatch";
+        case eMarkerWireStatus::ScalarMismatch:     return "scalar size mismatch";
+        case eMarkerWireStatus::CapacityTooSmall:   return "capacity too small";
+        }
+        return "unknown";
+    }
+
+    namespace Detail
+    {
+        /// <summary>
+        /// True when cTMarker<T> already has the wire layout, so whole arrays can be copied. offsetof on
+        /// cTMarker is fine: every member is public and it has no virtual functions or bases.
+        /// </summary>
+        template<typename T>
+        constexpr bool MarkerMatchesWire()
+        {
+            using Marker = Core::cTMarker<T>;
+            using Record = sMarkerWireRecord<T>;
+            return sizeof( Marker ) == sizeof( Record )
+                && sizeof( Core::cUID ) == 16 && sizeof( Core::cLabel ) == 24
+                && sizeof( unsigned int ) == 4 && sizeof( bool ) == 1
+                && offsetof( Marker, ID ) == offsetof( Record, IDHigh )
+                && offsetof( Marker, ActiveID ) == offsetof( Record, ActiveID )
+                && offsetof( Marker, X ) == offsetof( Record, X )
+                && offsetof( Marker, Y ) == offsetof( Record, Y )
+                && offsetof( Marker, Z ) == offsetof( Record, Z )
+                && offsetof( Marker, Size ) == offsetof( Record, Size )
+                && offsetof( Marker, Residual ) == offsetof( Record, Residual )
+                && offsetof( Marker, Label ) == offsetof( Record, LabelEntityHigh )
+                && offsetof( Marker, Selected ) == offsetof( Record, Selected )
+                && offsetof( Marker, Synthetic ) == offsetof( Record, Synthetic )
+                && offsetof( Marker, Flags ) == offsetof( Record, Flags );
+        }
+
+        /// <summary>Clear the bytes of a record that are padding in cTMarker<T>.</summary>
+        template<typename T>
+        void ZeroRecordPadding( unsigned char* record )
+        {
+            using Record = sMarkerWireRecord<T>;
+            const size_t afterActiveID = offsetof( Record, ActiveID ) + sizeof( uint32_t );
+            const size_t afterResidual = offsetof( Record, Residual ) + sizeof( T );
+            const size_t afterMember = offsetof( Record, LabelMember ) + sizeof( uint32_t );
+            const size_t afterFlags = offsetof( Record, Flags ) + sizeof( uint16_t );
+
+            memset( record + afterActiveID, 0, offsetof( Record, X ) - afterActiveID );
+            memset( record + afterResidual, 0, offsetof( Record, LabelEntityHigh ) - afterResidual );
+            memset( record + afterMember, 0, offsetof( Record, Selected ) - afterMember );
+            memset( record + afterFlags, 0, sizeof( Record ) - afterFlags );
+        }
+
+        template<typename T>
+        eMarkerWireStatus CheckHeader( const sMarkerWireHeader& header )
+        {
+            if( memcmp( header.Magic, kMarkerWireMagic, sizeof( header.Magic ) ) != 0 )
+            {
+                return eMarkerWireStatus::NotMarkerData;
+            }
+            if( header.Version != kMarkerWireVersion )
+            {
+                return eMarkerWireStatus::UnsupportedVersion;
+            }
+            if( header.ByteOrder != kMarkerWireByteOrder )
+            {
+                return eMarkerWireStatus::ByteOrderMismatch;
+            }
+            if( header.ScalarBytes != sizeof( T ) || header.RecordBytes != sizeof( sMarkerWireRecord<T> ) )
+            {
+                return eMarkerWireStatus::ScalarMismatch;
+            }
+            return eMarkerWireStatus::Ok;
+        }
+
+        template<typename T>
+        void PackMarker( const Core::cTMarker<T>& marker, sMarkerWireRecord<T>& record )
+        {
+            memset( &record, 0, sizeof( record ) );
+            record.IDHigh = marker.ID.HighBits();
+            record.IDLow = marker.ID.LowBits();
+            record.ActiveID = marker.ActiveID;
+            record.X = marker.X;
+            record.Y = marker.Y;
+            record.Z = marker.Z;
+            record.Size = marker.Size;
+            record.Residual = marker.Residual;
+            record.LabelEntityHigh = marker.Label.EntityID().HighBits();
+            record.LabelEntityLow = marker.Label.EntityID().LowBits();
+            record.LabelMember = marker.Label.MemberID();
+            record.Selected = ( marker.Selected ? 1 : 0 );
+            record.Synthetic = ( marker.Synthetic ? 1 : 0 );
+            record.Flags = marker.Flags;
+        }
+
+        template<typename T>
+        void UnpackMarker( const sMarkerWireRecord<T>& record, Core::cTMarker<T>& marker )
+        {
+            marker.ID = Core::cUID( record.IDHigh, record.IDLow );
+            marker.ActiveID = record.ActiveID;
+            marker.X = record.X;
+            marker.Y = record.Y;
+            marker.Z = record.Z;
+            marker.Size = record.Size;
+            marker.Residual = record.Residual;
+            marker.Label = Core::cLabel( Core::cUID( record.LabelEntityHigh, record.LabelEntityLow ), record.LabelMember );
+            marker.Selected = ( record.Selected != 0 );
+            marker.Synthetic = ( record.Synthetic != 0 );
+            marker.Flags = record.Flags;
+        }
+    }
+
+    /// <summary>Bytes WriteMarkers() needs for count markers.</summary>
+    template<typename T>
+    constexpr size_t MarkerWireBytes( size_t count )
+    {
+        return sizeof( sMarkerWireHeader ) + count * sizeof( sMarkerWireRecord<T> );
+    }
+
+    /// <summary>
+    /// Serialize count markers into out, which holds capacity bytes. Returns the bytes written, or 0 if
+    /// capacity is below MarkerWireBytes<T>( count ).
+    /// </summary>
+    template<typename T>
+    size_t WriteMarkers( const Core::cTMarker<T>* markers, size_t count, void* out, size_t capacity )
+    {
+        static_assert( std::is_trivially_copyable<Core::cTMarker<T>>::value, "cTMarker must stay trivially copyable" );
+
+        const size_t bytes = MarkerWireBytes<T>( count );
+        if( capacity < bytes || count > UINT32_MAX )
+        {
+            return 0;
+        }
+
+        unsigned char* dest = static_cast<unsigned char*>( out );
+
+        sMarkerWireHeader header;
+        memcpy( header.Magic, kMarkerWireMagic, sizeof( header.Magic ) );
+        header.Version = kMarkerWireVersion;
+        header.ScalarBytes = (uint8_t) sizeof( T );
+        header.RecordBytes = (uint8_t) sizeof( sMarkerWireRecord<T> );
+        header.ByteOrder = kMarkerWireByteOrder;
+        header.Count = (uint32_t) count;
+        memcpy( dest, &header, sizeof( header ) );
+
+        unsigned char* records = dest + sizeof( sMarkerWireHeader );
+        if( Detail::MarkerMatchesWire<T>() )
+        {
+            memcpy( records, markers, count * sizeof( sMarkerWireRecord<T> ) );
+            for( size_t i = 0; i < count; ++i )
+            {
+                Detail::ZeroRecordPadding<T>( records + i * sizeof( sMarkerWireRecord<T> ) );
+            }
+        }
+        else
+        {
+            for( size_t i = 0; i < count; ++i )
+            {
+                sMarkerWireRecord<T> record;
+                Detail::PackMarker( markers[i], record );
+                memcpy( records + i * sizeof( record ), &record, sizeof( record ) );
+            }
+        }
+
+        return bytes;
+    }
+
+    /// <summary>
+    /// Deserialize a block written by WriteMarkers() into markers, which holds capacity entries. count
+    /// receives the number of markers; bytesRead, if given, the size of the block, so several blocks can be
+    /// read back to back from one buffer.
+    /// </summary>
+    template<typename T>
+    eMarkerWireStatus ReadMarkers( const void* in, size_t bytes, Core::cTMarker<T>* markers, size_t capacity,
+                                   size_t& count, size_t* bytesRead = nullptr )
+    {
+        count = 0;
+        if( bytes < sizeof( sMarkerWireHeader ) )
+        {
+            return eMarkerWireStatus::Truncated;
+        }
+
+        const unsigned char* src = static_cast<const unsigned char*>( in );
+        sMarkerWireHeader header;
+        memcpy( &header, src, sizeof( header ) );
+
+        const eMarkerWireStatus status = Detail::CheckHeader<T>( header );
+        if( status != eMarkerWireStatus::Ok )
+        {
+            return status;
+        }
+        if( MarkerWireBytes<T>( header.Count ) > bytes )
+        {
+            return eMarkerWireStatus::Truncated;
+        }
+        if( header.Count > capacity )
+        {
+            return eMarkerWireStatus::CapacityTooSmall;
+        }
+
+        const unsigned char* records = src + sizeof( sMarkerWireHeader );
+        if( Detail::MarkerMatchesWire<T>() )
+        {
+            memcpy( static_cast<void*>( markers ), records, header.Count * sizeof( sMarkerWireRecord<T> ) );
+
+            // Only 0 and 1 are valid bool representations; normalize whatever the wire carried.
+            unsigned char* raw = reinterpret_cast<unsigned char*>( markers );
+            for( size_t i = 0; i < header.Count; ++i )
+            {
+                unsigned char* record = raw + i * sizeof( sMarkerWireRecord<T> );
+                record[offsetof( sMarkerWireRecord<T>, Selected )] = ( record[offsetof( sMarkerWireRecord<T>, Selected )] != 0 );
+                record[offsetof( sMarkerWireRecord<T>, Synthetic )] = ( record[offsetof( sMarkerWireRecord<T>, Synthetic )] != 0 );
+            }
+        }
+        else
+        {
+            for( size_t i = 0; i < header.Count; ++i )
+            {
+                sMarkerWireRecord<T> record;
+                memcpy( &record, records + i * sizeof( record ), sizeof( record ) );
+                Detail::UnpackMarker( record, markers[i] );
+            }
+        }
+
+        count = header.Count;
+        if( bytesRead != nullptr )
+        {
+            *bytesRead = MarkerWireBytes<T>( header.Count );
+        }
+        return eMarkerWireStatus::Ok;
+    }
+
+    /// <summary>Stream form of WriteMarkers(): one ostream::write per frame. buffer is reused scratch space.</summary>
+    template<typename T>
+    bool WriteMarkers( std::ostream& os, const Core::cTMarker<T>* markers, size_t count, std::vector<unsigned char>& buffer )
+    {
+        buffer.resize( MarkerWireBytes<T>( count ) );
+        const size_t bytes = WriteMarkers( markers, count, buffer.data(), buffer.size() );
+        return bytes > 0 && os.write( reinterpret_cast<const char*>( buffer.data() ), (std::streamsize) bytes ).good();
+    }
+
+    /// <summary>Stream form of ReadMarkers(): reads one frame, resizing markers to fit.</summary>
+    template<typename T>
+    eMarkerWireStatus ReadMarkers( std::istream& is, std::vector<Core::cTMarker<T>>& markers, std::vector<unsigned char>& buffer )
+    {
+        sMarkerWireHeader header;
+        if( !is.read( reinterpret_cast<char*>( &header ), sizeof( header ) ) )
+        {
+            return eMarkerWireStatus::Truncated;
+        }
+        const eMarkerWireStatus status = Detail::CheckHeader<T>( header );
+        if( status != eMarkerWireStatus::Ok )
+        {
+            return status;
+        }
+
+        buffer.resize( MarkerWireBytes<T>( header.Count ) );
+        memcpy( buffer.data(), &header, sizeof( header ) );
+        if( !is.read( reinterpret_cast<char*>( buffer.data() + sizeof( header ) ), (std::streamsize) ( buffer.size() - sizeof( header ) ) ) )
+        {
+            return eMarkerWireStatus::Truncated;
+        }
+
+        markers.resize( header.Count );
+        size_t count = 0;
+        return ReadMarkers( buffer.data(), buffer.size(), markers.data(), markers.size(), count );
+    }
+}
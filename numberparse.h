@@ -0,0 +1,212 @@
+//======================================================================================================
+// Number parsing: fast decimal text to float/double conversion for CSV bodies
+//======================================================================================================
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+namespace Capture
+{
+    namespace Detail
+    {
+        /// <summary>Exact powers of ten up to 1e22; larger exponents are built by multiplication.</summary>
+        constexpr double kPowersOfTen[] =
+        {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        inline double ScaleByPowerOfTen( double value, int exponent )
+        {
+            if( exponent >= 0 )
+            {
+                while( exponent > 22 ) { value *= 1e22; exponent -= 22; }
+                return value * kPowersOfTen[exponent];
+            }
+            exponent = -exponent;
+            while( exponent > 22 ) { value /= 1e22; exponent -= 22; }
+            return value / kPowersOfTen[exponent];
+        }
+
+        /// <summary>True if all eight bytes are ASCII digits (SWAR check on one 64-bit load).</summary>
+        inline bool IsEightDigits( uint64_t chunk )
+        {
+            return ( ( ( chunk & 0xF0F0F0F0F0F0F0F0ull )
+                | ( ( ( chunk + 0x0606060606060606ull ) & 0xF0F0F0F0F0F0F0F0ull ) >> 4 ) )
+                == 0x3333333333333333ull );
+        }
+
+        /// <summary>Value of eight ASCII digits loaded little-endian, in three multiplies.</summary>
+        inline uint32_t ParseEightDigits( uint64_t chunk )
+        {
+            chunk -= 0x3030303030303030ull;
+            chunk = ( chunk * 10 ) + ( chunk >> 8 );
+            chunk = ( ( ( chunk & 0x000000FF000000FFull ) * ( 100 + ( 1000000ull << 32 ) ) )
+                + ( ( ( chunk >> 16 ) & 0x000000FF000000FFull ) * ( 1 + ( 10000ull << 32 ) ) ) ) >> 32;
+            return (uint32_t) chunk;
+        }
+
+        /// <summary>Accumulate digits into mantissa, eight at a time where the buffer allows.
+        /// Digits past the 19th only bump the exponent. Returns the number of digits consumed.</summary>
+        inline int AccumulateDigits( const char*& p, const char* end, uint64_t& mantissa, int& digits, int& dropped )
+        {
+            const char* start = p;
+
+            while( end - p >= 8 && digits <= 11 )
+            {
+                uint64_t chunk;
+                memcpy( &chunk, p, sizeof( chunk ) );
+                if( !IsEightDigits( chunk ) )
+                {
+                    break;
+                }
+                const uint64_t previous = mantissa;
+                mantissa = mantissa * 100000000ull + ParseEightDigits( chunk );
+                if( previous != 0 )
+                {
+                    digits += 8;
+                }
+                else
+                {
+                    // Leading zeros are not significant.
+                    for( uint64_t rest = mantissa; rest != 0; rest /= 10 )
+                    {
+                        ++digits;
+                    }
+                }
+                p += 8;
+            }
+
+            while( p < end && (unsigned) ( *p - '0' ) <= 9 )
+            {
+                if( digits < 19 )
+                {
+                    mantissa = mantissa * 10 + (unsigned) ( *p - '0' );
+                    digits += ( mantissa != 0 ? 1 : 0 );
+                }
+                else
+                {
+                    ++dropped;
+                }
+                ++p;
+            }
+
+            return (int) ( p - start );
+        }
+    }
+
+    /// <summary>
+    /// Parse a decimal number ([-+]digits[.digits][e[-+]digits]) starting at p, stopping at the first
+    /// character that cannot continue it. Returns false, leaving p unchanged, when no digits are found.
+    /// Correctly rounded whenever the significant digits fit in 53 bits and the decimal exponent is within
+    /// +-22, which covers everything Motive exports; other inputs are within a few ulps. Much faster than
+    /// strtod because it never consults the locale.
+    /// </summary>
+    inline bool ParseDouble( const char*& p, const char* end, double& value )
+    {
+        const char* s = p;
+
+        bool negative = false;
+        if( s < end && ( *s == '-' || *s == '+' ) )
+        {
+            negative = ( *s == '-' );
+            ++s;
+        }
+
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int dropped = 0;
+
+        int count = Detail::AccumulateDigits( s, end, mantissa, digits, dropped );
+        int exponent = dropped;
+
+        if( s < end && *s == '.' )
+        {
+            ++s;
+            int fractionDropped = 0;
+            const int fraction = Detail::AccumulateDigits( s, end, mantissa, digits, fractionDropped );
+            exponent -= fraction - fractionDropped;
+            count += fraction;
+        }
+
+        if( count == 0 )
+        {
+            // Accept the spellings other tools write for missing data.
+            if( end - s >= 3 && ( memcmp( s, "nan", 3 ) == 0 || memcmp( s, "NaN", 3 ) == 0 ) )
+            {
+                value = std::numeric_limits<double>::quiet_NaN();
+                p = s + 3;
+                return true;
+            }
+            return false;
+        }
+
+        if( s < end && ( *s == 'e' || *s == 'E' ) )
+        {
+            const char* e = s + 1;
+            bool negativeExponent = false;
+            if( e < end && ( *e == '-' || *e == '+' ) )
+            {
+                negativeExponent = ( *e == '-' );
+                ++e;
+            }
+            if( e < end && (unsigned) ( *e - '0' ) <= 9 )
+            {
+                int power = 0;
+                while( e < end && (unsigned) ( *e - '0' ) <= 9 )
+                {
+                    power = ( power < 10000 ? power * 10 + ( *e - '0' ) : power );
+                    ++e;
+                }
+                exponent += ( negativeExponent ? -power : power );
+                s = e;
+            }
+        }
+
+        double result = Detail::ScaleByPowerOfTen( double( mantissa ), exponent );
+        value = ( negative ? -result : result );
+        p = s;
+        return true;
+    }
+
+    inline bool ParseFloat( const char*& p, const char* end, float& value )
+    {
+        double parsed;
+        if( !ParseDouble( p, end, parsed ) )
+        {
+            return false;
+        }
+        value = (float) parsed;
+        return true;
+    }
+
+    /// <summary>Parse an optionally signed decimal integer.</summary>
+    inline bool ParseInt( const char*& p, const char* end, long long& value )
+    {
+        const char* s = p;
+        bool negative = false;
+        if( s < end && ( *s == '-' || *s == '+' ) )
+        {
+            negative = ( *s == '-' );
+            ++s;
+        }
+
+        const char* digits = s;
+        long long result = 0;
+        while( s < end && (unsigned) ( *s - '0' ) <= 9 )
+        {
+            result = result * 10 + ( *s - '0' );
+            ++s;
+        }
+        if( s == digits )
+        {
+            return false;
+        }
+
+        value = ( negative ? -result : result );
+        p = s;
+        return true;
+    }
+}
@@ -0,0 +1,184 @@
+//======================================================================================================
+// Point transform: batch affine transforms of structure-of-arrays marker positions
+//======================================================================================================
+#include "pointtransform.h"
+
+#include "cpufeatures.h"
+
+#ifdef CAPTURE_X86
+#include <immintrin.h>
+#endif
+
+namespace Capture
+{
+    namespace
+    {
+        // m is the row-major matrix: x' = x*m[0] + y*m[4] + z*m[8] (+ m[12]), and likewise for y' and z'.
+        template<typename T, bool Translate>
+        void TransformScalar( const T* m, const T* x, const T* y, const T* z, T* outX, T* outY, T* outZ,
+                              size_t begin, size_t count )
+        {
+            for( size_t i = begin; i < count; ++i )
+            {
+                const T px = x[i];
+                const T py = y[i];
+                const T pz = z[i];
+
+                T rx = px * m[0] + py * m[4] + pz * m[8];
+                T ry = px * m[1] + py * m[5] + pz * m[9];
+                T rz = px * m[2] + py * m[6] + pz * m[10];
+                if( Translate )
+                {
+                    rx += m[12];
+                    ry += m[13];
+                    rz += m[14];
+                }
+
+                outX[i] = rx;
+                outY[i] = ry;
+                outZ[i] = rz;
+            }
+        }
+
+#ifdef CAPTURE_X86
+        // Overloads on the element type let one kernel body serve float and double.
+        CAPTURE_TARGET_SSE2 inline __m128 Load128( const float* p ) { return _mm_loadu_ps( p ); }
+        CAPTURE_TARGET_SSE2 inline __m128d Load128( const double* p ) { return _mm_loadu_pd( p ); }
+        CAPTURE_TARGET_SSE2 inline void Store128( float* p, __m128 v ) { _mm_storeu_ps( p, v ); }
+        CAPTURE_TARGET_SSE2 inline void Store128( double* p, __m128d v ) { _mm_storeu_pd( p, v ); }
+        CAPTURE_TARGET_SSE2 inline __m128 Splat128( float v ) { return _mm_set1_ps( v ); }
+        CAPTURE_TARGET_SSE2 inline __m128d Splat128( double v ) { return _mm_set1_pd( v ); }
+        CAPTURE_TARGET_SSE2 inline __m128 Add( __m128 a, __m128 b ) { return _mm_add_ps( a, b ); }
+        CAPTURE_TARGET_SSE2 inline __m128d Add( __m128d a, __m128d b ) { return _mm_add_pd( a, b ); }
+        CAPTURE_TARGET_SSE2 inline __m128 Mul( __m128 a, __m128 b ) { return _mm_mul_ps( a, b ); }
+        CAPTURE_TARGET_SSE2 inline __m128d Mul( __m128d a, __m128d b ) { return _mm_mul_pd( a, b ); }
+
+        CAPTURE_TARGET_AVX inline __m256 Load256( const float* p ) { return _mm256_loadu_ps( p ); }
+        CAPTURE_TARGET_AVX inline __m256d Load256( const double* p ) { return _mm256_loadu_pd( p ); }
+        CAPTURE_TARGET_AVX inline void Store256( float* p, __m256 v ) { _mm256_storeu_ps( p, v ); }
+        CAPTURE_TARGET_AVX inline void Store256( double* p, __m256d v ) { _mm256_storeu_pd( p, v ); }
+        CAPTURE_TARGET_AVX inline __m256 Splat256( float v ) { return _mm256_set1_ps( v ); }
+        CAPTURE_TARGET_AVX inline __m256d Splat256( double v ) { return _mm256_set1_pd( v ); }
+        CAPTURE_TARGET_AVX inline __m256 Add( __m256 a, __m256 b ) { return _mm256_add_ps( a, b ); }
+        CAPTURE_TARGET_AVX inline __m256d Add( __m256d a, __m256d b ) { return _mm256_add_pd( a, b ); }
+        CAPTURE_TARGET_AVX inline __m256 Mul( __m256 a, __m256 b ) { return _mm256_mul_ps( a, b ); }
+        CAPTURE_TARGET_AVX inline __m256d Mul( __m256d a, __m256d b ) { return _mm256_mul_pd( a, b ); }
+
+        // The two kernels differ only in register width. No FMA: fused rounding would make results depend
+        // on which path ran. Each returns how many points it did; the scalar kernel finishes the tail.
+        template<typename T, bool Translate>
+        CAPTURE_TARGET_SSE2 size_t TransformSse2( const T* m, const T* x, const T* y, const T* z,
+                                                  T* outX, T* outY, T* outZ, size_t count )
+        {
+            constexpr size_t kLanes = 16 / sizeof( T );
+            const auto m0 = Splat128( m[0] ), m1 = Splat128( m[1] ), m2 = Splat128( m[2] );
+            const auto m4 = Splat128( m[4] ), m5 = Splat128( m[5] ), m6 = Splat128( m[6] );
+            const auto m8 = Splat128( m[8] ), m9 = Splat128( m[9] ), m10 = Splat128( m[10] );
+            const auto m12 = Splat128( m[12] ), m13 = Splat128( m[13] ), m14 = Splat128( m[14] );
+
+            size_t i = 0;
+            for( ; i + kLanes <= count; i += kLanes )
+            {
+                const auto px = Load128( x + i );
+                const auto py = Load128( y + i );
+                const auto pz = Load128( z + i );
+
+                auto rx = Add( Add( Mul( px, m0 ), Mul( py, m4 ) ), Mul( pz, m8 ) );
+                auto ry = Add( Add( Mul( px, m1 ), Mul( py, m5 ) ), Mul( pz, m9 ) );
+                auto rz = Add( Add( Mul( px, m2 ), Mul( py, m6 ) ), Mul( pz, m10 ) );
+                if( Translate )
+                {
+                    rx = Add( rx, m12 );
+                    ry = Add( ry, m13 );
+                    rz = Add( rz, m14 );
+                }
+
+                Store128( outX + i, rx );
+                Store128( outY + i, ry );
+                Store128( outZ + i, rz );
+            }
+            return i;
+        }
+
+        template<typename T, bool Translate>
+        CAPTURE_TARGET_AVX size_t TransformAvx( const T* m, const T* x, const T* y, const T* z,
+                                                T* outX, T* outY, T* outZ, size_t count )
+        {
+            constexpr size_t kLanes = 32 / sizeof( T );
+            const auto m0 = Splat256( m[0] ), m1 = Splat256( m[1] ), m2 = Splat256( m[2] );
+            const auto m4 = Splat256( m[4] ), m5 = Splat256( m[5] ), m6 = Splat256( m[6] );
+            const auto m8 = Splat256( m[8] ), m9 = Splat256( m[9] ), m10 = Splat256( m[10] );
+            const auto m12 = Splat256( m[12] ), m13 = Splat256( m[13] ), m14 = Splat256( m[14] );
+
+            size_t i = 0;
+            for( ; i + kLanes <= count; i += kLanes )
+            {
+                const auto px = Load256( x + i );
+                const auto py = Load256( y + i );
+                const auto pz = Load256( z + i );
+
+                auto rx = Add( Add( Mul( px, m0 ), Mul( py, m4 ) ), Mul( pz, m8 ) );
+                auto ry = Add( Add( Mul( px, m1 ), Mul( py, m5 ) ), Mul( pz, m9 ) );
+                auto rz = Add( Add( Mul( px, m2 ), Mul( py, m6 ) ), Mul( pz, m10 ) );
+                if( Translate )
+                {
+                    rx = Add( rx, m12 );
+                    ry = Add( ry, m13 );
+                    rz = Add( rz, m14 );
+                }
+
+                Store256( outX + i, rx );
+                Store256( outY + i, ry );
+                Store256( outZ + i, rz );
+            }
+            return i;
+        }
+#endif
+
+        template<typename T, bool Translate>
+        void Transform( const Core::cMatrix4<T>& matrix, const T* x, const T* y, const T* z,
+                        T* outX, T* outY, T* outZ, size_t count )
+        {
+            const T* m = matrix.Data();
+            size_t done = 0;
+
+#ifdef CAPTURE_X86
+            const eSimdLevel level = ActiveSimdLevel();
+            if( level >= eSimdLevel::AVX )
+            {
+                done = TransformAvx<T, Translate>( m, x, y, z, outX, outY, outZ, count );
+            }
+            else if( level >= eSimdLevel::SSE2 )
+            {
+                done = TransformSse2<T, Translate>( m, x, y, z, outX, outY, outZ, count );
+            }
+#endif
+
+            TransformScalar<T, Translate>( m, x, y, z, outX, outY, outZ, done, count );
+        }
+    }
+
+    void TransformPoints( const Core::cMatrix4<float>& matrix, const float* x, const float* y, const float* z,
+                          float* outX, float* outY, float* outZ, size_t count )
+    {
+        Transform<float, true>( matrix, x, y, z, outX, outY, outZ, count );
+    }
+
+    void TransformPoints( const Core::cMatrix4<double>& matrix, const double* x, const double* y, const double* z,
+                          double* outX, double* outY, double* outZ, size_t count )
+    {
+        Transform<double, true>( matrix, x, y, z, outX, outY, outZ, count );
+    }
+
+    void TransformDirections( const Core::cMatrix4<float>& matrix, const float* x, const float* y, const float* z,
+                              float* outX, float* outY, float* outZ, size_t count )
+    {
+        Transform<float, false>( matrix, x, y, z, outX, outY, outZ, count );
+    }
+
+    void TransformDirections( const Core::cMatrix4<double>& matrix, const double* x, const double* y, const double* z,
+                              double* outX, double* outY, double* outZ, size_t count )
+    {
+        Transform<double, false>( matrix, x, y, z, outX, outY, outZ, count );
+    }
+}
@@ -0,0 +1,32 @@
+//======================================================================================================
+// Point transform: batch affine transforms of structure-of-arrays marker positions
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+
+#include "Core/Vector3.h"
+#include "Core/Matrix4.h"
+
+namespace Capture
+{
+    //==================================================================================================
+    // Each call moves count points (or directions) held as separate x, y and z arrays through the matrix,
+    // with the same row-vector convention as cMatrix4::TransformPoint()/TransformDirection(). The kernels
+    // dispatch at runtime to AVX, SSE2 or scalar code (see ActiveSimdLevel()). Every path does the same
+    // multiplies and adds in the same order, so results are identical whichever one runs.
+    //
+    // The outputs may be the inputs themselves (in place), but must not otherwise overlap them.
+    //==================================================================================================
+
+    void TransformPoints( const Core::cMatrix4<float>& matrix, const float* x, const float* y, const float* z,
+                          float* outX, float* outY, float* outZ, size_t count );
+    void TransformPoints( const Core::cMatrix4<double>& matrix, const double* x, const double* y, const double* z,
+                          double* outX, double* outY, double* outZ, size_t count );
+
+    /// <summary>As TransformPoints(), ignoring the matrix translation.</summary>
+    void TransformDirections( const Core::cMatrix4<float>& matrix, const float* x, const float* y, const float* z,
+                              float* outX, float* outY, float* outZ, size_t count );
+    void TransformDirections( const Core::cMatrix4<double>& matrix, const double* x, const double* y, const double* z,
+                              double* outX, double* outY, double* outZ, size_t count );
+}
@@ -0,0 +1,37 @@
+//======================================================================================================
+// Process memory: resident set statistics for tools and benchmarks
+//======================================================================================================
+#include "processmemory.h"
+
+#include "Core/Platform.h"
+
+#ifdef __PLATFORM__LINUX__
+#include <sys/resource.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace Capture
+{
+    size_t PeakResidentBytes()
+    {
+#ifdef __PLATFORM__LINUX__
+        struct rusage usage;
+        if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        {
+            return 0;
+        }
+        return (size_t) usage.ru_maxrss * 1024;     // Kilobytes on Linux
+#else
+        PROCESS_MEMORY_COUNTERS counters;
+        if( !K32GetProcessMemoryInfo( GetCurrentProcess(), &counters, sizeof( counters ) ) )
+        {
+            return 0;
+        }
+        return (size_t) counters.PeakWorkingSetSize;
+#endif
+    }
+}
@@ -0,0 +1,12 @@
+//======================================================================================================
+// Process memory: resident set statistics for tools and benchmarks
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+
+namespace Capture
+{
+    /// <summary>Peak resident set size of this process in bytes (peak working set on Windows), or 0 if unknown.</summary>
+    size_t PeakResidentBytes();
+}
@@ -0,0 +1,126 @@
+//======================================================================================================
+// Quaternion batch: vectorized normalize, rotate, slerp and angle over structure-of-arrays quaternions
+//======================================================================================================
+#include "quaternionbatch.h"
+
+#include "cpufeatures.h"
+#include "quaternionkernels.h"
+
+namespace Capture
+{
+    namespace
+    {
+        // Each entry point runs the widest loop available, then the scalar loop over the tail.
+        template<typename T>
+        void Normalize( const sQuaternionArrays<T>& q, size_t count )
+        {
+            size_t done = 0;
+#ifdef CAPTURE_X86
+            const eSimdLevel level = ActiveSimdLevel();
+            if( level >= eSimdLevel::AVX )
+            {
+                done = Detail::NormalizeQuaternionsAvx( q, count );
+            }
+            else if( level >= eSimdLevel::SSE2 )
+            {
+                done = NormalizeLoop<sSse2Pack<T>>( q, 0, count );
+            }
+#endif
+            NormalizeLoop<sScalarPack<T>>( q, done, count );
+        }
+
+        template<typename T>
+        void Rotate( const sQuaternionArrays<const T>& q, const sVectorArrays<const T>& v, const sVectorArrays<T>& out, size_t count )
+        {
+            size_t done = 0;
+#ifdef CAPTURE_X86
+            const eSimdLevel level = ActiveSimdLevel();
+            if( level >= eSimdLevel::AVX )
+            {
+                done = Detail::RotateVectorsAvx( q, v, out, count );
+            }
+            else if( level >= eSimdLevel::SSE2 )
+            {
+                done = RotateLoop<sSse2Pack<T>>( q, v, out, 0, count );
+            }
+#endif
+            RotateLoop<sScalarPack<T>>( q, v, out, done, count );
+        }
+
+        template<typename T>
+        void Slerp( const sQuaternionArrays<const T>& from, const sQuaternionArrays<const T>& to, const T* t,
+                    const sQuaternionArrays<T>& out, size_t count )
+        {
+            size_t done = 0;
+#ifdef CAPTURE_X86
+            const eSimdLevel level = ActiveSimdLevel();
+            if( level >= eSimdLevel::AVX )
+            {
+                done = Detail::SlerpQuaternionsAvx( from, to, t, out, count );
+            }
+            else if( level >= eSimdLevel::SSE2 )
+            {
+                done = SlerpLoop<sSse2Pack<T>>( from, to, t, out, 0, count );
+            }
+#endif
+            SlerpLoop<sScalarPack<T>>( from, to, t, out, done, count );
+        }
+
+        template<typename T>
+        void Angles( const sQuaternionArrays<const T>& a, const sQuaternionArrays<const T>& b, T* angles, size_t count )
+        {
+            size_t done = 0;
+#ifdef CAPTURE_X86
+            const eSimdLevel level = ActiveSimdLevel();
+            if( level >= eSimdLevel::AVX )
+            {
+                done = Detail::QuaternionAnglesAvx( a, b, angles, count );
+            }
+            else if( level >= eSimdLevel::SSE2 )
+            {
+                done = AnglesLoop<sSse2Pack<T>>( a, b, angles, 0, count );
+            }
+#endif
+            AnglesLoop<sScalarPack<T>>( a, b, angles, done, count );
+        }
+    }
+
+    void NormalizeQuaternions( const sQuaternionArrays<float>& q, size_t count ) { Normalize( q, count ); }
+    void NormalizeQuaternions( const sQuaternionArrays<double>& q, size_t count ) { Normalize( q, count ); }
+
+    void RotateVectors( const sQuaternionArrays<const float>& q, const sVectorArrays<const float>& v,
+                        const sVectorArrays<float>& out, size_t count )
+    {
+        Rotate( q, v, out, count );
+    }
+
+    void RotateVectors( const sQuaternionArrays<const double>& q, const sVectorArrays<const double>& v,
+                        const sVectorArrays<double>& out, size_t count )
+    {
+        Rotate( q, v, out, count );
+    }
+
+    void SlerpQuaternions( const sQuaternionArrays<const float>& from, const sQuaternionArrays<const float>& to,
+                           const float* t, const sQuaternionArrays<float>& out, size_t count )
+    {
+        Slerp( from, to, t, out, count );
+    }
+
+    void SlerpQuaternions( const sQuaternionArrays<const double>& from, const sQuaternionArrays<const double>& to,
+                           const double* t, const sQuaternionArrays<double>& out, size_t count )
+    {
+        Slerp( from, to, t, out, count );
+    }
+
+    void QuaternionAngles( const sQuaternionArrays<const float>& a, const sQuaternionArrays<const float>& b,
+                           float* angles, size_t count )
+    {
+        Angles( a, b, angles, count );
+    }
+
+    void QuaternionAngles( const sQuaternionArrays<const double>& a, const sQuaternionArrays<const double>& b,
+                           double* angles, size_t count )
+    {
+        Angles( a, b, angles, count );
+    }
+}
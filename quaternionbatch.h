@@ -0,0 +1,48 @@
+//======================================================================================================
+// Quaternion batch: vectorized normalize, rotate, slerp and angle over structure-of-arrays quaternions
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#include "vectorarrays.h"
+
+namespace Capture
+{
+    //==================================================================================================
+    // Batch counterparts of cQuaternion::Normalize(), Rotate(), Slerp() and AngleTo(), element by element.
+    // They are branch-free and dispatch at runtime to AVX, SSE2 or scalar code (see ActiveSimdLevel()).
+    // Slerp and AngleTo use polynomial sin/acos in place of the C library. Against the scalar methods,
+    // every result component agrees to within kQuaternionBatchTolerance: 1e-6 for float, 1e-13 for double.
+    // Slerp keeps that accuracy for t in [-1, 2].
+    //
+    // Outputs may be the inputs themselves (in place), but must not otherwise overlap them.
+    //==================================================================================================
+
+    template<typename T>
+    constexpr T kQuaternionBatchTolerance = std::is_same<T, float>::value ? T( 1e-6 ) : T( 1e-13 );
+
+    /// <summary>Normalize in place; a zero quaternion becomes the identity, as in cQuaternion::Normalize().</summary>
+    void NormalizeQuaternions( const sQuaternionArrays<float>& q, size_t count );
+    void NormalizeQuaternions( const sQuaternionArrays<double>& q, size_t count );
+
+    /// <summary>Rotate v[i] by q[i]. Quaternions need not be unit length: the result is scaled by 2 / norm,
+    /// as cQuaternion<T, false>::Rotate() does.</summary>
+    void RotateVectors( const sQuaternionArrays<const float>& q, const sVectorArrays<const float>& v,
+                        const sVectorArrays<float>& out, size_t count );
+    void RotateVectors( const sQuaternionArrays<const double>& q, const sVectorArrays<const double>& v,
+                        const sVectorArrays<double>& out, size_t count );
+
+    /// <summary>out[i] = Slerp( from[i], to[i], t[i] ) along the shorter arc, normalized. Inputs should be unit length.</summary>
+    void SlerpQuaternions( const sQuaternionArrays<const float>& from, const sQuaternionArrays<const float>& to,
+                           const float* t, const sQuaternionArrays<float>& out, size_t count );
+    void SlerpQuaternions( const sQuaternionArrays<const double>& from, const sQuaternionArrays<const double>& to,
+                           const double* t, const sQuaternionArrays<double>& out, size_t count );
+
+    /// <summary>angles[i] = a[i].AngleTo( b[i] ), in radians.</summary>
+    void QuaternionAngles( const sQuaternionArrays<const float>& a, const sQuaternionArrays<const float>& b,
+                           float* angles, size_t count );
+    void QuaternionAngles( const sQuaternionArrays<const double>& a, const sQuaternionArrays<const double>& b,
+                           double* angles, size_t count );
+}
@@ -0,0 +1,54 @@
+//======================================================================================================
+// Quaternion batch: AVX loops. This file is compiled with AVX code generation (/arch:AVX, -mavx) and is
+// only entered after ActiveSimdLevel() has confirmed AVX support.
+//======================================================================================================
+#include "cpufeatures.h"
+#include "quaternionkernels.h"
+
+#ifdef CAPTURE_X86
+namespace Capture
+{
+    namespace Detail
+    {
+        size_t NormalizeQuaternionsAvx( const sQuaternionArrays<float>& q, size_t count )
+        {
+            return NormalizeLoop<sAvxPack<float>>( q, 0, count );
+        }
+
+        size_t NormalizeQuaternionsAvx( const sQuaternionArrays<double>& q, size_t count )
+        {
+            return NormalizeLoop<sAvxPack<double>>( q, 0, count );
+        }
+
+        size_t RotateVectorsAvx( const sQuaternionArrays<const float>& q, const sVectorArrays<const float>& v, const sVectorArrays<float>& out, size_t count )
+        {
+            return RotateLoop<sAvxPack<float>>( q, v, out, 0, count );
+        }
+
+        size_t RotateVectorsAvx( const sQuaternionArrays<const double>& q, const sVectorArrays<const double>& v, const sVectorArrays<double>& out, size_t count )
+        {
+            return RotateLoop<sAvxPack<double>>( q, v, out, 0, count );
+        }
+
+        size_t SlerpQuaternionsAvx( const sQuaternionArrays<const float>& from, const sQuaternionArrays<const float>& to, const float* t, const sQuaternionArrays<float>& out, size_t count )
+        {
+            return SlerpLoop<sAvxPack<float>>( from, to, t, out, 0, count );
+        }
+
+        size_t SlerpQuaternionsAvx( const sQuaternionArrays<const double>& from, const sQuaternionArrays<const double>& to, const double* t, const sQuaternionArrays<double>& out, size_t count )
+        {
+            return SlerpLoop<sAvxPack<double>>( from, to, t, out, 0, count );
+        }
+
+        size_t QuaternionAnglesAvx( const sQuaternionArrays<const float>& a, const sQuaternionArrays<const float>& b, float* angles, size_t count )
+        {
+            return AnglesLoop<sAvxPack<float>>( a, b, angles, 0, count );
+        }
+
+        size_t QuaternionAnglesAvx( const sQuaternionArrays<const double>& a, const sQuaternionArrays<const double>& b, double* angles, size_t count )
+        {
+            return AnglesLoop<sAvxPack<double>>( a, b, angles, 0, count );
+        }
+    }
+}
+#endif
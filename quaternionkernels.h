@@ -0,0 +1,277 @@
+//======================================================================================================
+// Quaternion kernels: the loop bodies behind quaternionbatch.h, written once against a SIMD "pack"
+//======================================================================================================
+//
+// Included only by quaternionbatch.cpp (scalar and SSE2 packs) and quaternionbatch_avx.cpp (AVX packs,
+// built with AVX code generation). Like the packs in simdpack.h, the templates sit in an anonymous
+// namespace so each translation unit keeps its own instances.
+//
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+#include "quaternionbatch.h"
+#include "simdpack.h"
+
+namespace Capture
+{
+    namespace Detail
+    {
+        // AVX entry points, defined in quaternionbatch_avx.cpp. Each returns how many elements it did.
+        size_t NormalizeQuaternionsAvx( const sQuaternionArrays<float>& q, size_t count );
+        size_t NormalizeQuaternionsAvx( const sQuaternionArrays<double>& q, size_t count );
+        size_t RotateVectorsAvx( const sQuaternionArrays<const float>& q, const sVectorArrays<const float>& v, const sVectorArrays<float>& out, size_t count );
+        size_t RotateVectorsAvx( const sQuaternionArrays<const double>& q, const sVectorArrays<const double>& v, const sVectorArrays<double>& out, size_t count );
+        size_t SlerpQuaternionsAvx( const sQuaternionArrays<const float>& from, const sQuaternionArrays<const float>& to, const float* t, const sQuaternionArrays<float>& out, size_t count );
+        size_t SlerpQuaternionsAvx( const sQuaternionArrays<const double>& from, const sQuaternionArrays<const double>& to, const double* t, const sQuaternionArrays<double>& out, size_t count );
+        size_t QuaternionAnglesAvx( const sQuaternionArrays<const float>& a, const sQuaternionArrays<const float>& b, float* angles, size_t count );
+        size_t QuaternionAnglesAvx( const sQuaternionArrays<const double>& a, const sQuaternionArrays<const double>& b, double* angles, size_t count );
+    }
+
+    namespace
+    {
+        //==============================================================================================
+        // Series coefficients, built at compile time. Float and double take different term counts so
+        // each stops once the next term is below its precision over the reduced argument range.
+        //==============================================================================================
+
+        template<int N>
+        struct sSeries
+        {
+            double C[N];
+        };
+
+        /// <summary>asin( z ) = z + z^3 * sum C[n] z^(2n), n = 0..N-1.</summary>
+        template<int N>
+        constexpr sSeries<N> AsinSeries()
+        {
+            sSeries<N> series{};
+            double c = 1.0;
+            for( int n = 1; n <= N; ++n )
+            {
+                c *= double( ( 2 * n - 1 ) * ( 2 * n - 1 ) ) / double( ( 2 * n ) * ( 2 * n + 1 ) );
+                series.C[n - 1] = c;
+            }
+            return series;
+        }
+
+        /// <summary>sin( x ) = x + x^3 * sum C[n] x^(2n), n = 0..N-1.</summary>
+        template<int N>
+        constexpr sSeries<N> SinSeries()
+        {
+            sSeries<N> series{};
+            double c = 1.0;
+            for( int n = 1; n <= N; ++n )
+            {
+                c *= -1.0 / double( ( 2 * n ) * ( 2 * n + 1 ) );
+                series.C[n - 1] = c;
+            }
+            return series;
+        }
+
+        template<typename T> struct sSeriesTerms;
+        template<> struct sSeriesTerms<float> { static constexpr int kAsin = 10; static constexpr int kSin = 7; };
+        template<> struct sSeriesTerms<double> { static constexpr int kAsin = 27; static constexpr int kSin = 11; };
+
+        template<typename T>
+        struct sAsinCoefficients
+        {
+            static constexpr int kTerms = sSeriesTerms<T>::kAsin;
+            static constexpr sSeries<kTerms> kSeries = AsinSeries<kTerms>();
+        };
+
+        template<typename T>
+        struct sSinCoefficients
+        {
+            static constexpr int kTerms = sSeriesTerms<T>::kSin;
+            static constexpr sSeries<kTerms> kSeries = SinSeries<kTerms>();
+        };
+
+        /// <summary>Horner's rule, unrolled at compile time so every coefficient is an immediate constant.</summary>
+        template<class P, class Coefficients, int I = 0>
+        struct sHorner
+        {
+            static typename P::V Evaluate( typename P::V z )
+            {
+                constexpr typename P::S c = typename P::S( Coefficients::kSeries.C[I] );
+                if constexpr( I + 1 == Coefficients::kTerms )
+                {
+                    return P::Splat( c );
+                }
+                else
+                {
+                    return P::Add( P::Mul( sHorner<P, Coefficients, I + 1>::Evaluate( z ), z ), P::Splat( c ) );
+                }
+            }
+        };
+
+        constexpr double kPi = 3.14159265358979323846;
+
+        /// <summary>acos( x ) for x in [-1, 1]. |x| > 0.5 goes through acos( a ) = 2 asin( sqrt( ( 1 - a ) / 2 ) ),
+        /// so the series only ever sees arguments up to 0.5.</summary>
+        template<class P>
+        inline typename P::V Acos( typename P::V x )
+        {
+            using S = typename P::S;
+
+            const typename P::V a = P::Abs( x );
+            const typename P::M big = P::Greater( a, P::Splat( S( 0.5 ) ) );
+            const typename P::V z = P::Select( big, P::Mul( P::Splat( S( 0.5 ) ), P::Sub( P::Splat( S( 1 ) ), a ) ), P::Mul( a, a ) );
+            const typename P::V s = P::Select( big, P::Sqrt( z ), a );
+            const typename P::V asin = P::Add( s, P::Mul( P::Mul( s, z ), sHorner<P, sAsinCoefficients<S>>::Evaluate( z ) ) );
+
+            const typename P::V r = P::Select( big, P::Add( asin, asin ), P::Sub( P::Splat( S( kPi / 2 ) ), asin ) );
+            return P::Select( P::Less( x, P::Splat( S( 0 ) ) ), P::Sub( P::Splat( S( kPi ) ), r ), r );
+        }
+
+        /// <summary>sin( x ) for |x| <= 3 pi / 2, folded onto [0, pi / 2] by symmetry.</summary>
+        template<class P>
+        inline typename P::V Sin( typename P::V x )
+        {
+            using S = typename P::S;
+
+            typename P::V a = P::Abs( x );
+            a = P::Select( P::Greater( a, P::Splat( S( kPi / 2 ) ) ), P::Sub( P::Splat( S( kPi ) ), a ), a );
+            const typename P::V a2 = P::Mul( a, a );
+            const typename P::V s = P::Add( a, P::Mul( P::Mul( a, a2 ), sHorner<P, sSinCoefficients<S>>::Evaluate( a2 ) ) );
+            return P::Select( P::Less( x, P::Splat( S( 0 ) ) ), P::Sub( P::Splat( S( 0 ) ), s ), s );
+        }
+
+        template<class P>
+        inline typename P::V Dot( typename P::V ax, typename P::V ay, typename P::V az, typename P::V aw,
+                                  typename P::V bx, typename P::V by, typename P::V bz, typename P::V bw )
+        {
+            return P::Add( P::Add( P::Add( P::Mul( ax, bx ), P::Mul( ay, by ) ), P::Mul( az, bz ) ), P::Mul( aw, bw ) );
+        }
+
+        /// <summary>cQuaternion::Normalize() without the branch.</summary>
+        template<class P>
+        inline void Normalize( typename P::V& x, typename P::V& y, typename P::V& z, typename P::V& w )
+        {
+            using S = typename P::S;
+            const typename P::V magnitude = P::Sqrt( Dot<P>( x, y, z, w, x, y, z, w ) );
+            const typename P::M positive = P::Greater( magnitude, P::Splat( S( 0 ) ) );
+            const typename P::V scale = P::Div( P::Splat( S( 1 ) ), P::Select( positive, magnitude, P::Splat( S( 1 ) ) ) );
+
+            x = P::Mul( x, scale );
+            y = P::Mul( y, scale );
+            z = P::Mul( z, scale );
+            w = P::Select( positive, P::Mul( w, scale ), P::Splat( S( 1 ) ) );
+        }
+
+        //==============================================================================================
+        // Loops. Each starts at begin, handles whole packs while they fit and returns where it stopped.
+        //==============================================================================================
+
+        template<class P>
+        size_t NormalizeLoop( const sQuaternionArrays<typename P::S>& q, size_t begin, size_t count )
+        {
+            size_t i = begin;
+            for( ; i + P::kLanes <= count; i += P::kLanes )
+            {
+                typename P::V x = P::Load( q.X + i ), y = P::Load( q.Y + i ), z = P::Load( q.Z + i ), w = P::Load( q.W + i );
+                Normalize<P>( x, y, z, w );
+                P::Store( q.X + i, x );
+                P::Store( q.Y + i, y );
+                P::Store( q.Z + i, z );
+                P::Store( q.W + i, w );
+            }
+            return i;
+        }
+
+        /// <summary>cQuaternion::Rotate(): t = q.xyz x v, u = t w + q.xyz x t, v' = v + u * 2 / |q|^2.</summary>
+        template<class P>
+        size_t RotateLoop( const sQuaternionArrays<const typename P::S>& q, const sVectorArrays<const typename P::S>& v,
+                           const sVectorArrays<typename P::S>& out, size_t begin, size_t count )
+        {
+            using S = typename P::S;
+            size_t i = begin;
+            for( ; i + P::kLanes <= count; i += P::kLanes )
+            {
+                const typename P::V qx = P::Load( q.X + i ), qy = P::Load( q.Y + i ), qz = P::Load( q.Z + i ), qw = P::Load( q.W + i );
+                const typename P::V vx = P::Load( v.X + i ), vy = P::Load( v.Y + i ), vz = P::Load( v.Z + i );
+
+                const typename P::V tx = P::Sub( P::Mul( qy, vz ), P::Mul( qz, vy ) );
+                const typename P::V ty = P::Sub( P::Mul( qz, vx ), P::Mul( qx, vz ) );
+                const typename P::V tz = P::Sub( P::Mul( qx, vy ), P::Mul( qy, vx ) );
+
+                const typename P::V ux = P::Add( P::Mul( tx, qw ), P::Sub( P::Mul( qy, tz ), P::Mul( qz, ty ) ) );
+                const typename P::V uy = P::Add( P::Mul( ty, qw ), P::Sub( P::Mul( qz, tx ), P::Mul( qx, tz ) ) );
+                const typename P::V uz = P::Add( P::Mul( tz, qw ), P::Sub( P::Mul( qx, ty ), P::Mul( qy, tx ) ) );
+
+                const typename P::V scale = P::Div( P::Splat( S( 2 ) ), Dot<P>( qx, qy, qz, qw, qx, qy, qz, qw ) );
+                P::Store( out.X + i, P::Add( vx, P::Mul( ux, scale ) ) );
+                P::Store( out.Y + i, P::Add( vy, P::Mul( uy, scale ) ) );
+                P::Store( out.Z + i, P::Add( vz, P::Mul( uz, scale ) ) );
+            }
+            return i;
+        }
+
+        /// <summary>cQuaternion::Slerp(), with both coefficient branches computed and the lerp fallback selected per lane.</summary>
+        template<class P>
+        size_t SlerpLoop( const sQuaternionArrays<const typename P::S>& from, const sQuaternionArrays<const typename P::S>& to,
+                          const typename P::S* t, const sQuaternionArrays<typename P::S>& out, size_t begin, size_t count )
+        {
+            using S = typename P::S;
+            const typename P::V one = P::Splat( S( 1 ) );
+
+            size_t i = begin;
+            for( ; i + P::kLanes <= count; i += P::kLanes )
+            {
+                const typename P::V ax = P::Load( from.X + i ), ay = P::Load( from.Y + i ), az = P::Load( from.Z + i ), aw = P::Load( from.W + i );
+                const typename P::V bx = P::Load( to.X + i ), by = P::Load( to.Y + i ), bz = P::Load( to.Z + i ), bw = P::Load( to.W + i );
+                const typename P::V ti = P::Load( t + i );
+
+                // Opposite hemispheres: negate the second quaternion to take the shorter path.
+                typename P::V cosOmega = Dot<P>( ax, ay, az, aw, bx, by, bz, bw );
+                const typename P::M opposite = P::Less( cosOmega, P::Splat( S( 0 ) ) );
+                const typename P::V mult = P::Select( opposite, P::Splat( S( -1 ) ), one );
+                cosOmega = P::Abs( cosOmega );
+
+                // Near-identical rotations fall back to lerp, as in the scalar version. Omega is kept away
+                // from zero only so the unused slerp lanes stay finite.
+                const typename P::M nearlyEqual = P::Greater( cosOmega, P::Splat( S( 0.999999 ) ) );
+                const typename P::V omega = P::Max( Acos<P>( P::Min( cosOmega, one ) ), P::Splat( S( 1e-6 ) ) );
+                const typename P::V inverseOmega = P::Div( one, omega );
+                const typename P::V oneMinusT = P::Sub( one, ti );
+
+                const typename P::V k1 = P::Select( nearlyEqual, oneMinusT, P::Mul( Sin<P>( P::Mul( oneMinusT, omega ) ), inverseOmega ) );
+                const typename P::V k2 = P::Mul( P::Select( nearlyEqual, ti, P::Mul( Sin<P>( P::Mul( ti, omega ) ), inverseOmega ) ), mult );
+
+                typename P::V x = P::Add( P::Mul( k1, ax ), P::Mul( k2, bx ) );
+                typename P::V y = P::Add( P::Mul( k1, ay ), P::Mul( k2, by ) );
+                typename P::V z = P::Add( P::Mul( k1, az ), P::Mul( k2, bz ) );
+                typename P::V w = P::Add( P::Mul( k1, aw ), P::Mul( k2, bw ) );
+                Normalize<P>( x, y, z, w );
+
+                P::Store( out.X + i, x );
+                P::Store( out.Y + i, y );
+                P::Store( out.Z + i, z );
+                P::Store( out.W + i, w );
+            }
+            return i;
+        }
+
+        /// <summary>cQuaternion::AngleTo(): acos( clamp( 2 dot^2 - 1 ) ).</summary>
+        template<class P>
+        size_t AnglesLoop( const sQuaternionArrays<const typename P::S>& a, const sQuaternionArrays<const typename P::S>& b,
+                           typename P::S* angles, size_t begin, size_t count )
+        {
+            using S = typename P::S;
+            const typename P::V one = P::Splat( S( 1 ) );
+
+            size_t i = begin;
+            for( ; i + P::kLanes <= count; i += P::kLanes )
+            {
+                const typename P::V dot = Dot<P>( P::Load( a.X + i ), P::Load( a.Y + i ), P::Load( a.Z + i ), P::Load( a.W + i ),
+                                                  P::Load( b.X + i ), P::Load( b.Y + i ), P::Load( b.Z + i ), P::Load( b.W + i ) );
+                typename P::V value = P::Sub( P::Mul( P::Mul( dot, dot ), P::Splat( S( 2 ) ) ), one );
+                value = P::Max( P::Min( value, one ), P::Splat( S( -1 ) ) );
+                P::Store( angles + i, Acos<P>( value ) );
+            }
+            return i;
+        }
+    }
+}
@@ -0,0 +1,782 @@
+//======================================================================================================
+// Marker recording: chunked columnar binary files written live from the frame loop or converted offline
+//======================================================================================================
+#include "recording.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#include "columncodec.h"
+
+namespace Capture
+{
+    namespace
+    {
+        size_t AlignUp( size_t value, size_t alignment )
+        {
+            return ( value + alignment - 1 ) & ~( alignment - 1 );
+        }
+
+        size_t HeaderBytes( uint32_t maxMarkers )
+        {
+            return AlignUp( sizeof( sRecordingFileHeader ) + maxMarkers * sizeof( sRecordingMarkerEntry ), 64 );
+        }
+
+        size_t HashID( unsigned long long idHigh, unsigned long long idLow )
+        {
+            unsigned long long h = ( idLow ^ ( idHigh * 0x9E3779B97F4A7C15ull ) ) * 0xBF58476D1CE4E5B9ull;
+            return (size_t) ( h ^ ( h >> 31 ) );
+        }
+    }
+
+    //==================================================================================================
+    // sChunkLayout
+    //==================================================================================================
+
+    sChunkLayout::sChunkLayout( uint32_t chunkFrames, bool markerIDs )
+    {
+        FloatColumn = AlignUp( chunkFrames * sizeof( float ), 16 );
+        FlagsColumn = AlignUp( chunkFrames * sizeof( uint16_t ), 16 );
+
+        TimeStamp = sizeof( sRecordingChunkHeader );
+        FrameID = TimeStamp + AlignUp( chunkFrames * sizeof( double ), 16 );
+        MarkerBase = FrameID + AlignUp( chunkFrames * sizeof( int32_t ), 16 );
+        MarkerStride = 4 * FloatColumn + FlagsColumn;
+        SlotIDs = markerIDs;
+    }
+
+    size_t sChunkLayout::ChunkBytes( int markerSlots ) const
+    {
+        const size_t ids = ( SlotIDs ? markerSlots * sizeof( sRecordingMarkerEntry ) : 0 );
+        return AlignUp( MarkerIDs( markerSlots ) + ids, 64 );
+    }
+
+    //==================================================================================================
+    // cRecordingFileWriter
+    //==================================================================================================
+
+    cRecordingFileWriter::~cRecordingFileWriter()
+    {
+        // Without Close() the file keeps its last per-chunk header: readable, but not complete.
+        if( mFile != nullptr )
+        {
+            fclose( mFile );
+        }
+    }
+
+    bool cRecordingFileWriter::Open( const char* path, int chunkFrames, int maxMarkers, bool compress )
+    {
+        if( mFile != nullptr || chunkFrames <= 0 || maxMarkers <= 0 )
+        {
+            return false;
+        }
+
+        mFile = fopen( path, "wb" );
+        if( mFile == nullptr )
+        {
+            return false;
+        }
+
+        mLayout = sChunkLayout( chunkFrames );
+        mChunkFrames = chunkFrames;
+        mMaxMarkers = maxMarkers;
+        mCompress = compress;
+        mOffset = HeaderBytes( maxMarkers );
+        mFramesWritten = 0;
+        mIndex.clear();
+
+        if( compress )
+        {
+            const size_t rawBytes = mLayout.ChunkBytes( maxMarkers );
+            const size_t body = rawBytes - sizeof( sRecordingChunkHeader );
+            mEncoded.reset( new unsigned char[AlignUp( sizeof( sRecordingChunkHeader ) + MaxEncodedColumnBytes( body ), 64 )] );
+            mScratch.reset( new unsigned char[body] );
+        }
+
+        // Reserve the header and the whole marker table up front; both are rewritten in place.
+        std::vector<unsigned char> header( (size_t) mOffset, 0 );
+        if( fwrite( header.data(), 1, header.size(), mFile ) != header.size() || !WriteHeader( nullptr, 0, false, 0 ) )
+        {
+            fclose( mFile );
+            mFile = nullptr;
+            return false;
+        }
+        return true;
+    }
+
+    bool cRecordingFileWriter::WriteChunk( unsigned char* chunk, const sRecordingMarkerEntry* markers, size_t& storedBytes )
+    {
+        sRecordingChunkHeader* header = reinterpret_cast<sRecordingChunkHeader*>( chunk );
+        const size_t rawBytes = mLayout.ChunkBytes( header->MarkerSlots );
+
+        header->Magic = kRecordingChunkMagic;
+        header->Encoding = kChunkEncodingRaw;
+        header->ChunkBytes = rawBytes;
+        if( header->MarkerSlots > 0 )
+        {
+            memcpy( chunk + mLayout.MarkerIDs( header->MarkerSlots ), markers, header->MarkerSlots * sizeof( sRecordingMarkerEntry ) );
+        }
+
+        const unsigned char* data = chunk;
+        size_t bytes = rawBytes;
+
+        if( mCompress )
+        {
+            const size_t body = rawBytes - sizeof( sRecordingChunkHeader );
+            unsigned char* out = mEncoded.get();
+            const size_t encoded = EncodeColumns( chunk + sizeof( sRecordingChunkHeader ), body, out + sizeof( sRecordingChunkHeader ), mScratch.get() );
+            const size_t padded = AlignUp( sizeof( sRecordingChunkHeader ) + encoded, 64 );
+
+            // Chunks that do not shrink, such as pure noise, are stored raw.
+            if( padded < rawBytes )
+            {
+                memcpy( out, header, sizeof( sRecordingChunkHeader ) );
+                sRecordingChunkHeader* encodedHeader = reinterpret_cast<sRecordingChunkHeader*>( out );
+                encodedHeader->Encoding = kChunkEncodingColumns;
+                encodedHeader->ChunkBytes = padded;
+                memset( out + sizeof( sRecordingChunkHeader ) + encoded, 0, padded - sizeof( sRecordingChunkHeader ) - encoded );
+
+                data = out;
+                bytes = padded;
+            }
+        }
+
+        if( fwrite( data, 1, bytes, mFile ) != bytes )
+        {
+            return false;
+        }
+
+        sRecordingIndexEntry entry;
+        entry.FirstFrame = header->FirstFrame;
+        entry.Offset = mOffset;
+        entry.ChunkBytes = bytes;
+        entry.FrameCount = header->FrameCount;
+        entry.MarkerSlots = header->MarkerSlots;
+        mIndex.push_back( entry );
+
+        mOffset += bytes;
+        mFramesWritten += header->FrameCount;
+        storedBytes = bytes;
+
+        return WriteHeader( markers, header->MarkerSlots, false, 0 ) && fflush( mFile ) == 0;
+    }
+
+    bool cRecordingFileWriter::Close( const sRecordingMarkerEntry* markers, uint32_t markerCount )
+    {
+        if( mFile == nullptr )
+        {
+            return false;
+        }
+
+        bool ok = mIndex.empty() || fwrite( mIndex.data(), sizeof( sRecordingIndexEntry ), mIndex.size(), mFile ) == mIndex.size();
+        ok = ok && WriteHeader( markers, markerCount, true, mOffset );
+        ok = ( fclose( mFile ) == 0 ) && ok;
+        mFile = nullptr;
+
+        mEncoded.reset();
+        mScratch.reset();
+        return ok;
+    }
+
+    bool cRecordingFileWriter::WriteHeader( const sRecordingMarkerEntry* markers, uint32_t markerCount, bool complete, uint64_t indexOffset )
+    {
+        sRecordingFileHeader header;
+        memset( &header, 0, sizeof( header ) );
+        memcpy( header.Magic, kRecordingMagic, sizeof( header.Magic ) );
+        header.Version = kRecordingVersion;
+        header.HeaderBytes = (uint32_t) HeaderBytes( mMaxMarkers );
+        header.ChunkFrames = (uint32_t) mChunkFrames;
+        header.MaxMarkers = (uint32_t) mMaxMarkers;
+        header.MarkerCount = markerCount;
+        header.Flags = ( complete ? kRecordingComplete : 0 );
+        header.FrameCount = mFramesWritten;
+        header.ChunkCount = mIndex.size();
+        header.IndexOffset = indexOffset;
+
+        bool ok = ( fseek( mFile, 0, SEEK_SET ) == 0 );
+        ok = ok && fwrite( &header, sizeof( header ), 1, mFile ) == 1;
+        ok = ok && ( markerCount == 0 || fwrite( markers, sizeof( sRecordingMarkerEntry ), markerCount, mFile ) == markerCount );
+        ok = ok && ( fseek( mFile, 0, SEEK_END ) == 0 );
+        return ok;
+    }
+
+    //==================================================================================================
+    // cRecordingWriter
+    //==================================================================================================
+
+    cRecordingWriter::~cRecordingWriter()
+    {
+        Close();
+    }
+
+    bool cRecordingWriter::Open( const char* path, const sRecordingConfig& config )
+    {
+        Close();
+
+        if( config.ChunkFrames <= 0 || config.MaxMarkers <= 0 || config.ChunkBuffers < 2 )
+        {
+            return false;
+        }
+
+        if( !mFile.Open( path, config.ChunkFrames, config.MaxMarkers, config.Compress ) )
+        {
+            return false;
+        }
+
+        mConfig = config;
+        mLayout = sChunkLayout( config.ChunkFrames );
+
+        mMarkers.assign( config.MaxMarkers, sRecordingMarkerEntry{ 0, 0 } );
+        mLastSeen.assign( config.MaxMarkers, 0 );
+        mFreeSlots.clear();
+        mFreeSlots.reserve( config.MaxMarkers );
+        size_t hashSize = 1;
+        while( hashSize < 2 * (size_t) config.MaxMarkers )
+        {
+            hashSize <<= 1;
+        }
+        mHashSlots.assign( hashSize, -1 );
+        mHashMask = hashSize - 1;
+        mMarkerCount = 0;
+        mChunkFirstFrame = 0;
+        mReclaimed = false;
+
+        const size_t chunkBytes = mLayout.ChunkBytes( config.MaxMarkers );
+        mBuffers.clear();
+        mBuffers.resize( config.ChunkBuffers );
+        mFree.reset( new cSpscRing<sChunkBuffer*>( config.ChunkBuffers ) );
+        mFull.reset( new cSpscRing<sChunkBuffer*>( config.ChunkBuffers ) );
+        for( sChunkBuffer& buffer : mBuffers )
+        {
+            buffer.Data.reset( new unsigned char[chunkBytes]() );
+            buffer.Markers.reset( new sRecordingMarkerEntry[config.MaxMarkers]() );
+            FillMissing( buffer.Data.get(), 0, config.MaxMarkers, config.ChunkFrames );
+            mFree->TryPush( &buffer );
+        }
+
+        mCurrent = nullptr;
+        mRow = 0;
+        mNextFrame = 0;
+        mFrames = 0;
+        mDroppedFrames = 0;
+        mUntracked = 0;
+        mChunksWritten = 0;
+        mBytesWritten = 0;
+        mRawBytes = 0;
+        mWriteError = false;
+        mOpen = true;
+
+        mStopping.store( false, std::memory_order_release );
+        mWriter = std::thread( [this]() { WriterLoop(); } );
+
+        return true;
+    }
+
+    bool cRecordingWriter::Close()
+    {
+        if( !mOpen )
+        {
+            return false;
+        }
+
+        Flush();
+
+        mStopping.store( true, std::memory_order_release );
+        if( mWriter.joinable() )
+        {
+            mWriter.join();
+        }
+
+        if( !mFile.Close( mMarkers.data(), (uint32_t) mMarkerCount ) )
+        {
+            mWriteError = true;
+        }
+        mOpen = false;
+
+        return !mWriteError.load();
+    }
+
+    int cRecordingWriter::FindOrAddSlot( unsigned long long idHigh, unsigned long long idLow )
+    {
+        size_t index = HashID( idHigh, idLow ) & mHashMask;
+
+        for( ;; )
+        {
+            const int slot = mHashSlots[index];
+            if( slot < 0 )
+            {
+                break;
+            }
+            if( mMarkers[slot].IDLow == idLow && mMarkers[slot].IDHigh == idHigh )
+            {
+                return slot;
+            }
+            index = ( index + 1 ) & mHashMask;
+        }
+
+        if( mFreeSlots.empty() && mMarkerCount >= mConfig.MaxMarkers && !ReclaimSlots() )
+        {
+            return -1;
+        }
+
+        int slot;
+        if( mFreeSlots.empty() )
+        {
+            slot = mMarkerCount++;
+        }
+        else
+        {
+            slot = mFreeSlots.back();
+            mFreeSlots.pop_back();
+        }
+        mMarkers[slot].IDHigh = idHigh;
+        mMarkers[slot].IDLow = idLow;
+        HashSlot( slot );
+
+        return slot;
+    }
+
+    void cRecordingWriter::HashSlot( int slot )
+    {
+        size_t index = HashID( mMarkers[slot].IDHigh, mMarkers[slot].IDLow ) & mHashMask;
+        while( mHashSlots[index] >= 0 )
+        {
+            index = ( index + 1 ) & mHashMask;
+        }
+        mHashSlots[index] = slot;
+    }
+
+    bool cRecordingWriter::ReclaimSlots()
+    {
+        // Slots stored to in this chunk stay taken until it is published, so one pass per chunk finds
+        // everything there is to find. A reclaimed slot is missing in every row of the chunk so far, which
+        // is what it reads as until its new marker is stored; the chunk lists whoever holds it at Flush().
+        if( mReclaimed )
+        {
+            return false;
+        }
+        mReclaimed = true;
+
+        // Only called with no free slots left, so every slot below mMarkerCount holds a marker.
+        std::fill( mHashSlots.begin(), mHashSlots.end(), -1 );
+        for( int slot = 0; slot < mMarkerCount; ++slot )
+        {
+            if( mLastSeen[slot] >= mChunkFirstFrame )
+            {
+                HashSlot( slot );
+            }
+            else
+            {
+                mMarkers[slot] = sRecordingMarkerEntry{ 0, 0 };
+                mFreeSlots.push_back( slot );
+            }
+        }
+        return !mFreeSlots.empty();
+    }
+
+    void cRecordingWriter::FillMissing( unsigned char* chunk, int firstSlot, int endSlot, int rows ) const
+    {
+        const float missing = std::numeric_limits<float>::quiet_NaN();
+
+        for( int slot = firstSlot; slot < endSlot; ++slot )
+        {
+            std::fill_n( reinterpret_cast<float*>( chunk + mLayout.X( slot ) ), rows, missing );
+            std::fill_n( reinterpret_cast<float*>( chunk + mLayout.Y( slot ) ), rows, missing );
+            std::fill_n( reinterpret_cast<float*>( chunk + mLayout.Z( slot ) ), rows, missing );
+            std::fill_n( reinterpret_cast<float*>( chunk + mLayout.Residual( slot ) ), rows, missing );
+            std::fill_n( reinterpret_cast<uint16_t*>( chunk + mLayout.Flags( slot ) ), rows, (uint16_t) 0 );
+        }
+    }
+
+    void cRecordingWriter::BeginChunk()
+    {
+        if( !mFree->TryPop( mCurrent ) )
+        {
+            mCurrent = nullptr;
+            return;
+        }
+
+        sRecordingChunkHeader* header = reinterpret_cast<sRecordingChunkHeader*>( mCurrent->Data.get() );
+        header->FirstFrame = mNextFrame;
+        mRow = 0;
+        mChunkFirstFrame = mNextFrame;
+        mReclaimed = false;
+    }
+
+    bool cRecordingWriter::Append( const sFrameRecord& frame )
+    {
+        if( !mOpen )
+        {
+            return false;
+        }
+
+        if( mCurrent == nullptr )
+        {
+            BeginChunk();
+            if( mCurrent == nullptr )
+            {
+                // The writer thread is behind; keep frame numbering so the gap shows in FirstFrame.
+                ++mNextFrame;
+                mDroppedFrames.fetch_add( 1, std::memory_order_relaxed );
+                return false;
+            }
+        }
+
+        unsigned char* base = mCurrent->Data.get();
+        const int row = mRow;
+
+        reinterpret_cast<double*>( base + mLayout.TimeStamp )[row] = frame.TimeStamp;
+        reinterpret_cast<int32_t*>( base + mLayout.FrameID )[row] = frame.FrameID;
+
+        unsigned long long untracked = 0;
+        for( int i = 0; i < frame.MarkerCount; ++i )
+        {
+            const int slot = FindOrAddSlot( frame.IDHigh[i], frame.IDLow[i] );
+            if( slot < 0 )
+            {
+                ++untracked;
+                continue;
+            }
+
+            reinterpret_cast<float*>( base + mLayout.X( slot ) )[row] = frame.X[i];
+            reinterpret_cast<float*>( base + mLayout.Y( slot ) )[row] = frame.Y[i];
+            reinterpret_cast<float*>( base + mLayout.Z( slot ) )[row] = frame.Z[i];
+            reinterpret_cast<float*>( base + mLayout.Residual( slot ) )[row] = frame.Residual[i];
+            reinterpret_cast<uint16_t*>( base + mLayout.Flags( slot ) )[row] = frame.Flags[i];
+            mLastSeen[slot] = mNextFrame;
+        }
+        if( untracked > 0 )
+        {
+            mUntracked.fetch_add( untracked, std::memory_order_relaxed );
+        }
+
+        ++mNextFrame;
+        mFrames.fetch_add( 1, std::memory_order_relaxed );
+
+        if( ++mRow == mConfig.ChunkFrames )
+        {
+            Flush();
+        }
+        return true;
+    }
+
+    void cRecordingWriter::Flush()
+    {
+        if( mCurrent == nullptr || mRow == 0 )
+        {
+            return;
+        }
+
+        sRecordingChunkHeader* header = reinterpret_cast<sRecordingChunkHeader*>( mCurrent->Data.get() );
+        header->FrameCount = (uint32_t) mRow;
+        header->MarkerSlots = (uint32_t) mMarkerCount;
+        std::copy( mMarkers.begin(), mMarkers.begin() + mMarkerCount, mCurrent->Markers.get() );
+
+        // Every buffer fits in the ring, so this cannot fail. Publishing also makes the copied slot IDs
+        // visible to the writer thread.
+        mFull->TryPush( mCurrent );
+        mCurrent = nullptr;
+        mRow = 0;
+    }
+
+    void cRecordingWriter::WriterLoop()
+    {
+        for( ;; )
+        {
+            sChunkBuffer* buffer = nullptr;
+            if( !mFull->TryPop( buffer ) )
+            {
+                if( mStopping.load( std::memory_order_acquire ) && mFull->Empty() )
+                {
+                    break;
+                }
+                std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+                continue;
+            }
+
+            const sRecordingChunkHeader* header = reinterpret_cast<const sRecordingChunkHeader*>( buffer->Data.get() );
+            const size_t rawBytes = mLayout.ChunkBytes( header->MarkerSlots );
+            const int slots = (int) header->MarkerSlots;
+            const int rows = (int) header->FrameCount;
+
+            size_t stored = 0;
+            if( mFile.WriteChunk( buffer->Data.get(), buffer->Markers.get(), stored ) )
+            {
+                mChunksWritten.fetch_add( 1, std::memory_order_relaxed );
+                mBytesWritten.fetch_add( stored, std::memory_order_relaxed );
+                mRawBytes.fetch_add( rawBytes, std::memory_order_relaxed );
+            }
+            else
+            {
+                mWriteError = true;
+            }
+
+            // Free buffers are entirely missing samples, so the frame loop only stores what it sees, and
+            // a marker first seen mid-chunk reads as missing before it. Only the rows and slots the
+            // frame loop wrote need resetting, plus the columns under the slot ID table WriteChunk() put
+            // after the last slot, which a later chunk with more slots uses.
+            const size_t idBytes = slots * sizeof( sRecordingMarkerEntry );
+            const int idSlots = (int) ( ( idBytes + mLayout.MarkerStride - 1 ) / mLayout.MarkerStride );
+            FillMissing( buffer->Data.get(), 0, slots, rows );
+            FillMissing( buffer->Data.get(), slots, std::min( slots + idSlots, mConfig.MaxMarkers ), mConfig.ChunkFrames );
+            mFree->TryPush( buffer );
+        }
+    }
+
+    sRecordingStats cRecordingWriter::Stats() const
+    {
+        sRecordingStats stats;
+
+        stats.Frames = mFrames.load( std::memory_order_relaxed );
+        stats.DroppedFrames = mDroppedFrames.load( std::memory_order_relaxed );
+        stats.Untracked = mUntracked.load( std::memory_order_relaxed );
+        stats.ChunksWritten = mChunksWritten.load( std::memory_order_relaxed );
+        stats.BytesWritten = mBytesWritten.load( std::memory_order_relaxed );
+        stats.RawBytes = mRawBytes.load( std::memory_order_relaxed );
+        stats.MarkerCount = mMarkerCount;
+        stats.WriteError = mWriteError.load( std::memory_order_relaxed );
+
+        return stats;
+    }
+
+    //==================================================================================================
+    // cRecordingChunk / cRecordingReader
+    //==================================================================================================
+
+    cRecordingChunk::cRecordingChunk( const unsigned char* base, const sChunkLayout& layout, const sRecordingMarkerEntry* fileMarkers )
+        : mBase( base ), mHeader( reinterpret_cast<const sRecordingChunkHeader*>( base ) ), mLayout( &layout ),
+          mMarkers( layout.SlotIDs ? reinterpret_cast<const sRecordingMarkerEntry*>( base + layout.MarkerIDs( mHeader->MarkerSlots ) ) : fileMarkers )
+    {
+    }
+
+    int cRecordingChunk::FindMarker( const Core::cUID& id ) const
+    {
+        for( int slot = 0; slot < MarkerSlots(); ++slot )
+        {
+            if( mMarkers[slot].IDHigh == id.HighBits() && mMarkers[slot].IDLow == id.LowBits() )
+            {
+                return slot;
+            }
+        }
+        return -1;
+    }
+
+    bool cRecordingReader::Open( const char* path )
+    {
+        Close();
+
+        if( !mFile.Open( path ) )
+        {
+            mError = "cannot open file";
+            return false;
+        }
+
+        const unsigned char* data = mFile.Data();
+        const size_t size = mFile.Size();
+
+        mHeader = reinterpret_cast<const sRecordingFileHeader*>( data );
+        if( size < sizeof( sRecordingFileHeader ) || memcmp( mHeader->Magic, kRecordingMagic, sizeof( kRecordingMagic ) ) != 0 )
+        {
+            mError = "not a marker recording";
+            Close();
+            return false;
+        }
+        if( mHeader->Version < 1 || mHeader->Version > kRecordingVersion )
+        {
+            mError = "unsupported recording version";
+            Close();
+            return false;
+        }
+        if( mHeader->ChunkFrames == 0 || mHeader->MarkerCount > mHeader->MaxMarkers
+            || mHeader->HeaderBytes != HeaderBytes( mHeader->MaxMarkers ) || mHeader->HeaderBytes > size )
+        {
+            mError = "corrupt recording header";
+            Close();
+            return false;
+        }
+
+        mMarkers = reinterpret_cast<const sRecordingMarkerEntry*>( data + sizeof( sRecordingFileHeader ) );
+        mLayout = sChunkLayout( mHeader->ChunkFrames, mHeader->Version >= 3 );
+
+        mHasIndex = LoadIndex();
+        if( !mHasIndex )
+        {
+            ScanChunks();
+        }
+
+        return true;
+    }
+
+    bool cRecordingReader::LoadIndex()
+    {
+        // Version 1 files and files whose writer did not finish have no index.
+        if( mHeader->Version < 2 || !Complete() || mHeader->IndexOffset == 0 )
+        {
+            return false;
+        }
+
+        const size_t size = mFile.Size();
+        const uint64_t offset = mHeader->IndexOffset;
+        const uint64_t count = mHeader->ChunkCount;
+        if( offset < mHeader->HeaderBytes || offset > size || count > ( size - offset ) / sizeof( sRecordingIndexEntry ) )
+        {
+            return false;
+        }
+
+        const sRecordingIndexEntry* entries = reinterpret_cast<const sRecordingIndexEntry*>( mFile.Data() + offset );
+        mChunks.assign( entries, entries + count );
+
+        // Only the index itself is checked, so opening does not touch the chunk pages.
+        unsigned long long frames = 0;
+        for( size_t i = 0; i < mChunks.size(); ++i )
+        {
+            if( !ValidEntry( mChunks[i] ) || mChunks[i].Offset + mChunks[i].ChunkBytes > offset
+                || ( i > 0 && mChunks[i].FirstFrame < mChunks[i - 1].FirstFrame + mChunks[i - 1].FrameCount ) )
+            {
+                mChunks.clear();
+                return false;
+            }
+            frames += mChunks[i].FrameCount;
+        }
+
+        mFrameCount = frames;
+        return true;
+    }
+
+    void cRecordingReader::ScanChunks()
+    {
+        const unsigned char* data = mFile.Data();
+        const size_t size = mFile.Size();
+
+        // Index every complete chunk; a truncated tail from an interrupted recording is ignored.
+        size_t offset = mHeader->HeaderBytes;
+        while( ValidChunk( offset ) )
+        {
+            const sRecordingChunkHeader* chunk = reinterpret_cast<const sRecordingChunkHeader*>( data + offset );
+
+            sRecordingIndexEntry entry;
+            entry.FirstFrame = chunk->FirstFrame;
+            entry.Offset = offset;
+            entry.ChunkBytes = chunk->ChunkBytes;
+            entry.FrameCount = chunk->FrameCount;
+            entry.MarkerSlots = chunk->MarkerSlots;
+            mChunks.push_back( entry );
+
+            mFrameCount += chunk->FrameCount;
+            offset += (size_t) chunk->ChunkBytes;
+            if( offset >= size )
+            {
+                break;
+            }
+        }
+    }
+
+    bool cRecordingReader::ValidEntry( const sRecordingIndexEntry& entry ) const
+    {
+        // A raw chunk is exactly the layout size; an encoded one is only stored when it is smaller.
+        return entry.FrameCount <= mHeader->ChunkFrames && entry.MarkerSlots <= mHeader->MaxMarkers
+            && entry.Offset >= mHeader->HeaderBytes && entry.ChunkBytes >= sizeof( sRecordingChunkHeader )
+            && entry.ChunkBytes <= mLayout.ChunkBytes( entry.MarkerSlots )
+            && entry.Offset <= mFile.Size() && entry.ChunkBytes <= mFile.Size() - entry.Offset;
+    }
+
+    bool cRecordingReader::ValidChunk( size_t offset ) const
+    {
+        const size_t size = mFile.Size();
+        if( offset + sizeof( sRecordingChunkHeader ) > size )
+        {
+            return false;
+        }
+
+        const sRecordingChunkHeader* chunk = reinterpret_cast<const sRecordingChunkHeader*>( mFile.Data() + offset );
+        sRecordingIndexEntry entry;
+        entry.Offset = offset;
+        entry.ChunkBytes = chunk->ChunkBytes;
+        entry.FrameCount = chunk->FrameCount;
+        entry.MarkerSlots = chunk->MarkerSlots;
+
+        if( chunk->Magic != kRecordingChunkMagic || !ValidEntry( entry ) )
+        {
+            return false;
+        }
+        if( chunk->Encoding == kChunkEncodingRaw )
+        {
+            return chunk->ChunkBytes == mLayout.ChunkBytes( chunk->MarkerSlots );
+        }
+        return chunk->Encoding == kChunkEncodingColumns;
+    }
+
+    cRecordingChunk cRecordingReader::Chunk( int index, std::vector<unsigned char>& buffer ) const
+    {
+        const sRecordingIndexEntry& entry = mChunks[index];
+        const unsigned char* base = mFile.Data() + entry.Offset;
+        const sRecordingChunkHeader* header = reinterpret_cast<const sRecordingChunkHeader*>( base );
+
+        const size_t rawBytes = mLayout.ChunkBytes( entry.MarkerSlots );
+        if( header->Encoding == kChunkEncodingRaw && entry.ChunkBytes == rawBytes )
+        {
+            return cRecordingChunk( base, mLayout, mMarkers );
+        }
+
+        // Decoded chunk followed by the codec's scratch space.
+        const size_t body = rawBytes - sizeof( sRecordingChunkHeader );
+        if( buffer.size() < rawBytes + body )
+        {
+            buffer.resize( rawBytes + body );
+        }
+        unsigned char* out = buffer.data();
+
+        memcpy( out, header, sizeof( sRecordingChunkHeader ) );
+        sRecordingChunkHeader* decoded = reinterpret_cast<sRecordingChunkHeader*>( out );
+        const bool ok = header->Magic == kRecordingChunkMagic && header->Encoding == kChunkEncodingColumns
+            && header->MarkerSlots == entry.MarkerSlots && header->FrameCount == entry.FrameCount
+            && DecodeColumns( base + sizeof( sRecordingChunkHeader ), (size_t) entry.ChunkBytes - sizeof( sRecordingChunkHeader ),
+                              out + sizeof( sRecordingChunkHeader ), body, out + rawBytes );
+
+        decoded->Encoding = kChunkEncodingRaw;
+        decoded->ChunkBytes = rawBytes;
+        decoded->FrameCount = ( ok ? entry.FrameCount : 0 );
+        decoded->MarkerSlots = entry.MarkerSlots;
+        return cRecordingChunk( out, mLayout, mMarkers );
+    }
+
+    int cRecordingReader::FindChunk( unsigned long long frame ) const
+    {
+        std::vector<sRecordingIndexEntry>::const_iterator it = std::upper_bound( mChunks.begin(), mChunks.end(), frame,
+            []( unsigned long long value, const sRecordingIndexEntry& entry ) { return value < entry.FirstFrame; } );
+        if( it == mChunks.begin() )
+        {
+            return -1;
+        }
+        --it;
+        return ( frame < it->FirstFrame + it->FrameCount ? (int) ( it - mChunks.begin() ) : -1 );
+    }
+
+    void cRecordingReader::Close()
+    {
+        mFile.Close();
+        mHeader = nullptr;
+        mMarkers = nullptr;
+        mChunks.clear();
+        mFrameCount = 0;
+        mHasIndex = false;
+    }
+    Core::cUID cRecordingReader::MarkerID( int slot ) const
+    {
+        return Core::cUID( mMarkers[slot].IDHigh, mMarkers[slot].IDLow );
+    }
+
+    int cRecordingReader::FindMarker( const Core::cUID& id ) const
+    {
+        for( int slot = 0; slot < MarkerCount(); ++slot )
+        {
+            if( mMarkers[slot].IDHigh == id.HighBits() && mMarkers[slot].IDLow == id.LowBits() )
+            {
+                return slot;
+            }
+        }
+        return -1;
+    }
+}
@@ -0,0 +1,419 @@
+//======================================================================================================
+// Marker recording: chunked columnar binary files written live from the frame loop or converted offline
+//======================================================================================================
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Core/UID.h"
+#include "captureengine.h"
+#include "mappedfile.h"
+#include "spscring.h"
+
+namespace Capture
+{
+    //==================================================================================================
+    // File layout
+    //
+    //   sRecordingFileHeader                        64 bytes
+    //   sRecordingMarkerEntry[MaxMarkers]           cUID of each marker slot in the last chunk
+    //   (padding to HeaderBytes)
+    //   chunk, chunk, ...                           each 64-byte aligned
+    //   sRecordingIndexEntry[ChunkCount]            at IndexOffset, written by Close()
+    //
+    // A chunk holds up to ChunkFrames frames, one column per field:
+    //
+    //   sRecordingChunkHeader                       32 bytes
+    //   double   TimeStamp[ChunkFrames]             FrameTimeStamp()
+    //   int32    FrameID[ChunkFrames]
+    //   for each marker slot < MarkerSlots:
+    //       float  X, Y, Z, Residual[ChunkFrames]   NaN where the marker was not seen
+    //       uint16 Flags[ChunkFrames]
+    //   sRecordingMarkerEntry MarkerIDs[MarkerSlots] cUID of each marker slot in this chunk
+    //
+    // Every column is padded to 16 bytes, so any column can be used in place from a mapped file. Only the
+    // first FrameCount entries of each column are valid. The header is rewritten after every chunk, so a
+    // file cut short by a crash is readable up to its last complete chunk. All values are little-endian.
+    //
+    // A chunk with Encoding kChunkEncodingColumns stores everything after its header through
+    // EncodeColumns() (columncodec.h); decoded, it has exactly the layout above. ChunkBytes is then the
+    // stored size. The index lists every chunk's first frame and offset, so a reader can seek to a frame
+    // range without touching the chunks before it. Version 1 files have neither, and read as raw chunks
+    // without an index.
+    //
+    // A slot belongs to one marker for the length of a chunk only: once every slot is taken, slots whose
+    // marker has not been seen in the current chunk go to new markers. Each chunk therefore lists its own
+    // slot IDs. Version 1 and 2 files have no such list; their slots keep the marker in the file header
+    // table for the whole recording.
+    //==================================================================================================
+
+    constexpr char kRecordingMagic[8] = { 'M', 'K', 'R', 'C', 'O', 'L', 'S', 0 };
+    constexpr uint32_t kRecordingVersion = 3;
+    constexpr uint32_t kRecordingChunkMagic = 0x4B4E4843; // "CHNK"
+
+    /// <summary>Header flag set by a clean Close().</summary>
+    constexpr uint32_t kRecordingComplete = 1;
+
+    /// <summary>sRecordingChunkHeader::Encoding values.</summary>
+    constexpr uint32_t kChunkEncodingRaw = 0;
+    constexpr uint32_t kChunkEncodingColumns = 1;
+
+    struct sRecordingFileHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t HeaderBytes;   // Offset of the first chunk
+        uint32_t ChunkFrames;   // Column length of every chunk
+        uint32_t MaxMarkers;    // Slots reserved in the marker table
+        uint32_t MarkerCount;   // Slots in use by the last chunk
+        uint32_t Flags;         // kRecordingComplete
+        uint64_t FrameCount;
+        uint64_t ChunkCount;
+        uint64_t IndexOffset;   // sRecordingIndexEntry table, or 0 if the file was not closed
+        uint64_t Reserved;
+    };
+
+    struct sRecordingMarkerEntry
+    {
+        uint64_t IDHigh;
+        uint64_t IDLow;
+    };
+
+    struct sRecordingChunkHeader
+    {
+        uint32_t Magic;         // kRecordingChunkMagic
+        uint32_t FrameCount;    // Valid entries in each column
+        uint32_t MarkerSlots;   // Marker column groups stored in this chunk
+        uint32_t Encoding;      // kChunkEncodingRaw or kChunkEncodingColumns
+        uint64_t ChunkBytes;    // Stored size including this header and trailing padding
+        uint64_t FirstFrame;    // Recording frame index of the first row
+    };
+
+    struct sRecordingIndexEntry
+    {
+        uint64_t FirstFrame;
+        uint64_t Offset;        // File offset of the chunk header
+        uint64_t ChunkBytes;    // Stored size, as in the chunk header
+        uint32_t FrameCount;
+        uint32_t MarkerSlots;
+    };
+
+    static_assert( sizeof( sRecordingFileHeader ) == 64, "Recording header layout changed" );
+    static_assert( sizeof( sRecordingMarkerEntry ) == 16, "Recording marker entry layout changed" );
+    static_assert( sizeof( sRecordingChunkHeader ) == 32, "Recording chunk header layout changed" );
+    static_assert( sizeof( sRecordingIndexEntry ) == 32, "Recording index entry layout changed" );
+
+    /// <summary>Byte offsets of the columns inside a chunk with the given column length.</summary>
+    struct sChunkLayout
+    {
+        /// <summary>markerIDs is false for version 1 and 2 chunks, which end after the last slot.</summary>
+        explicit sChunkLayout( uint32_t chunkFrames, bool markerIDs = true );
+
+        size_t TimeStamp;
+        size_t FrameID;
+        size_t MarkerBase;      // Start of slot 0
+        size_t MarkerStride;    // Bytes per marker slot
+        size_t FloatColumn;     // Bytes per float column
+        size_t FlagsColumn;     // Bytes per flags column
+        bool SlotIDs;           // Chunks end with their MarkerIDs table
+
+        size_t X( int slot ) const { return MarkerBase + slot * MarkerStride; }
+        size_t Y( int slot ) const { return X( slot ) + FloatColumn; }
+        size_t Z( int slot ) const { return X( slot ) + 2 * FloatColumn; }
+        size_t Residual( int slot ) const { return X( slot ) + 3 * FloatColumn; }
+        size_t Flags( int slot ) const { return X( slot ) + 4 * FloatColumn; }
+        size_t MarkerIDs( int markerSlots ) const { return X( markerSlots ); }
+
+        /// <summary>Chunk size with the given number of marker slots, padded to 64 bytes.</summary>
+        size_t ChunkBytes( int markerSlots ) const;
+    };
+
+    struct sRecordingConfig
+    {
+        int ChunkFrames = 256;     // Frames per chunk (about 2 s at 120 Hz)
+        int MaxMarkers = 512;      // Slots per chunk; markers past that many in one chunk are counted in Untracked
+        int ChunkBuffers = 4;      // Chunks that can wait for the writer thread before frames are dropped
+        bool Compress = false;     // Encode chunks on the writer thread; raw chunks map without decoding
+    };
+
+    struct sRecordingStats
+    {
+        unsigned long long Frames;          // Frames appended
+        unsigned long long DroppedFrames;   // Frames lost because every chunk buffer was waiting to be written
+        unsigned long long Untracked;       // Marker samples skipped because every slot was in use in the chunk
+        unsigned long long ChunksWritten;
+        unsigned long long BytesWritten;    // Stored bytes, after compression
+        unsigned long long RawBytes;        // Chunk bytes before compression
+        int MarkerCount;                    // Slots in use
+        bool WriteError;
+    };
+
+    /// <summary>
+    /// Writes assembled chunks to a recording file on the calling thread. Chunks are compressed if asked
+    /// to. The header is rewritten after each chunk, and Close() appends the frame index. Used by
+    /// cRecordingWriter's writer thread, and directly by offline converters that build chunks themselves.
+    /// </summary>
+    class cRecordingFileWriter
+    {
+    public:
+        cRecordingFileWriter() = default;
+        ~cRecordingFileWriter();
+
+        cRecordingFileWriter( const cRecordingFileWriter& ) = delete;
+        cRecordingFileWriter& operator=( const cRecordingFileWriter& ) = delete;
+
+        bool Open( const char* path, int chunkFrames, int maxMarkers, bool compress );
+
+        /// <summary>Write the index and the final header. markers holds markerCount entries.</summary>
+        bool Close( const sRecordingMarkerEntry* markers, uint32_t markerCount );
+
+        bool IsOpen() const { return mFile != nullptr; }
+
+        /// <summary>
+        /// Append one raw chunk laid out by sChunkLayout, whose FrameCount, MarkerSlots and FirstFrame are set.
+        /// Magic, Encoding and ChunkBytes are filled in here, and markers (the cUID in each of the MarkerSlots
+        /// slots) is copied into the MarkerIDs table. storedBytes receives the size written to the file.
+        /// </summary>
+        bool WriteChunk( unsigned char* chunk, const sRecordingMarkerEntry* markers, size_t& storedBytes );
+
+        unsigned long long FramesWritten() const { return mFramesWritten; }
+        unsigned long long ChunksWritten() const { return (unsigned long long) mIndex.size(); }
+
+    private:
+        bool WriteHeader( const sRecordingMarkerEntry* markers, uint32_t markerCount, bool complete, uint64_t indexOffset );
+
+        FILE* mFile = nullptr;
+        sChunkLayout mLayout{ 1 };
+        int mChunkFrames = 0;
+        int mMaxMarkers = 0;
+        bool mCompress = false;
+
+        uint64_t mOffset = 0;                       // End of the last chunk
+        unsigned long long mFramesWritten = 0;
+        std::vector<sRecordingIndexEntry> mIndex;   // Grows by one entry per chunk
+        std::unique_ptr<unsigned char[]> mEncoded;  // Header plus MaxEncodedColumnBytes of the largest chunk
+        std::unique_ptr<unsigned char[]> mScratch;
+    };
+
+    /// <summary>
+    /// Writes frames to a columnar recording. Append() runs on the frame loop (for example as a capture
+    /// engine consumer) and only copies the frame into a preallocated chunk buffer: a cUID lookup in a
+    /// fixed hash table plus a store per column, so it never allocates, locks or touches the disk. Full
+    /// chunks are handed to a writer thread through SPSC rings, which also resets each one to missing
+    /// samples before handing it back, so per-frame cost stays flat at chunk boundaries.
+    /// </summary>
+    class cRecordingWriter
+    {
+    public:
+        cRecordingWriter() = default;
+        ~cRecordingWriter();
+
+        cRecordingWriter( const cRecordingWriter& ) = delete;
+        cRecordingWriter& operator=( const cRecordingWriter& ) = delete;
+
+        /// <summary>Create the file, allocate every buffer and start the writer thread.</summary>
+        bool Open( const char* path, const sRecordingConfig& config = sRecordingConfig() );
+
+        /// <summary>Flush the partial chunk, wait for the writer thread and finalize the header.
+        /// Call once Append() is no longer being called.</summary>
+        bool Close();
+
+        bool IsOpen() const { return mOpen; }
+
+        /// <summary>Append one frame. Returns false if the frame was dropped or the writer is not open.</summary>
+        bool Append( const sFrameRecord& frame );
+
+        /// <summary>Hand the partially filled chunk to the writer thread now.</summary>
+        void Flush();
+
+        sRecordingStats Stats() const;
+
+    private:
+        struct sChunkBuffer
+        {
+            std::unique_ptr<unsigned char[]> Data;
+            std::unique_ptr<sRecordingMarkerEntry[]> Markers;  // Slot IDs when the chunk was published
+        };
+
+        int FindOrAddSlot( unsigned long long idHigh, unsigned long long idLow );
+        void HashSlot( int slot );
+        bool ReclaimSlots();
+        void BeginChunk();
+        void FillMissing( unsigned char* chunk, int firstSlot, int endSlot, int rows ) const;
+        void WriterLoop();
+
+        sRecordingConfig mConfig;
+        sChunkLayout mLayout{ 1 };
+        cRecordingFileWriter mFile;     // Owned by the writer thread between Open() and Close()
+
+        std::vector<sChunkBuffer> mBuffers;
+        std::unique_ptr<cSpscRing<sChunkBuffer*>> mFree;   // Writer thread -> frame loop
+        std::unique_ptr<cSpscRing<sChunkBuffer*>> mFull;   // Frame loop -> writer thread
+
+        // Frame loop state
+        sChunkBuffer* mCurrent = nullptr;
+        int mRow = 0;
+        unsigned long long mNextFrame = 0;
+
+        // Marker table, frame loop only. Flush() copies it into the chunk buffer for the writer thread.
+        std::vector<sRecordingMarkerEntry> mMarkers;
+        std::vector<unsigned long long> mLastSeen;    // Frame index each slot was last stored at
+        std::vector<int> mFreeSlots;                  // Reclaimed slots below mMarkerCount
+        std::vector<int> mHashSlots;                  // Open addressing, -1 = empty
+        size_t mHashMask = 0;
+        int mMarkerCount = 0;                         // Slots ever used, free ones included
+        unsigned long long mChunkFirstFrame = 0;
+        bool mReclaimed = false;                      // ReclaimSlots() already ran for this chunk
+
+        std::thread mWriter;
+        std::atomic<bool> mStopping{ false };
+
+        std::atomic<unsigned long long> mFrames{ 0 };
+        std::atomic<unsigned long long> mDroppedFrames{ 0 };
+        std::atomic<unsigned long long> mUntracked{ 0 };
+        std::atomic<unsigned long long> mChunksWritten{ 0 };
+        std::atomic<unsigned long long> mBytesWritten{ 0 };
+        std::atomic<unsigned long long> mRawBytes{ 0 };
+        std::atomic<bool> mWriteError{ false };
+        bool mOpen = false;
+    };
+
+    /// <summary>A column inside a mapped recording. Data is null when the column is not stored.</summary>
+    template<typename T>
+    struct sColumnView
+    {
+        const T* Data = nullptr;
+        int Count = 0;
+
+        bool Empty() const { return Data == nullptr || Count == 0; }
+        const T& operator[]( int index ) const { return Data[index]; }
+        const T* begin() const { return Data; }
+        const T* end() const { return Data + Count; }
+    };
+
+    /// <summary>Column views of one chunk. Pointers point into the mapped file, or into the caller's buffer
+    /// for a decoded chunk.</summary>
+    class cRecordingChunk
+    {
+    public:
+        /// <summary>fileMarkers is the header marker table, used for chunks without their own.</summary>
+        cRecordingChunk( const unsigned char* base, const sChunkLayout& layout, const sRecordingMarkerEntry* fileMarkers );
+
+        int FrameCount() const { return (int) mHeader->FrameCount; }
+        unsigned long long FirstFrame() const { return mHeader->FirstFrame; }
+        int MarkerSlots() const { return (int) mHeader->MarkerSlots; }
+
+        /// <summary>False when the slot was not in use yet when this chunk was written.</summary>
+        bool HasMarker( int slot ) const { return slot >= 0 && slot < (int) mHeader->MarkerSlots; }
+
+        /// <summary>Marker in a slot of this chunk. A zero cUID marks a slot that was free.</summary>
+        Core::cUID MarkerID( int slot ) const { return Core::cUID( mMarkers[slot].IDHigh, mMarkers[slot].IDLow ); }
+
+        /// <summary>Slot of a marker in this chunk, or -1 if it is not in the chunk.</summary>
+        int FindMarker( const Core::cUID& id ) const;
+
+        sColumnView<double> TimeStamp() const { return Column<double>( mLayout->TimeStamp ); }
+        sColumnView<int32_t> FrameID() const { return Column<int32_t>( mLayout->FrameID ); }
+        sColumnView<float> X( int slot ) const { return MarkerColumn<float>( slot, mLayout->X( slot ) ); }
+        sColumnView<float> Y( int slot ) const { return MarkerColumn<float>( slot, mLayout->Y( slot ) ); }
+        sColumnView<float> Z( int slot ) const { return MarkerColumn<float>( slot, mLayout->Z( slot ) ); }
+        sColumnView<float> Residual( int slot ) const { return MarkerColumn<float>( slot, mLayout->Residual( slot ) ); }
+        sColumnView<uint16_t> Flags( int slot ) const { return MarkerColumn<uint16_t>( slot, mLayout->Flags( slot ) ); }
+
+    private:
+        template<typename T>
+        sColumnView<T> Column( size_t offset ) const
+        {
+            sColumnView<T> view;
+            view.Data = reinterpret_cast<const T*>( mBase + offset );
+            view.Count = FrameCount();
+            return view;
+        }
+
+        template<typename T>
+        sColumnView<T> MarkerColumn( int slot, size_t offset ) const
+        {
+            return ( HasMarker( slot ) ? Column<T>( offset ) : sColumnView<T>() );
+        }
+
+        const unsigned char* mBase;
+        const sRecordingChunkHeader* mHeader;
+        const sChunkLayout* mLayout;
+        const sRecordingMarkerEntry* mMarkers;
+    };
+
+    /// <summary>
+    /// Maps a recording and exposes its columns. Open() validates the header and takes the chunk list
+    /// from the index, or scans the chunk headers when there is none. Raw chunks are used in place;
+    /// compressed chunks are decoded on request into a caller-owned buffer.
+    /// </summary>
+    class cRecordingReader
+    {
+    public:
+        /// <summary>Returns false with Error() set when the file is missing or not a recording.</summary>
+        bool Open( const char* path );
+        void Close();
+
+        const std::string& Error() const { return mError; }
+
+        /// <summary>False when the writer did not close the file; the complete chunks are still readable.</summary>
+        bool Complete() const { return ( mHeader->Flags & kRecordingComplete ) != 0; }
+
+        unsigned long long FrameCount() const { return mFrameCount; }
+        int ChunkFrames() const { return (int) mHeader->ChunkFrames; }
+        int ChunkCount() const { return (int) mChunks.size(); }
+        bool HasIndex() const { return mHasIndex; }
+
+        /// <summary>True if the chunk must be read through the decoding overload of Chunk().</summary>
+        bool Encoded( int index ) const { return ChunkHeader( index )->Encoding != kChunkEncodingRaw; }
+
+        /// <summary>A raw chunk, in place.</summary>
+        cRecordingChunk Chunk( int index ) const { return cRecordingChunk( mFile.Data() + mChunks[index].Offset, mLayout, mMarkers ); }
+
+        /// <summary>Any chunk. Raw chunks are returned in place and buffer is untouched. Encoded chunks are
+        /// decoded into buffer, which is grown as needed and reused across calls. A corrupt chunk comes
+        /// back with FrameCount() == 0.</summary>
+        cRecordingChunk Chunk( int index, std::vector<unsigned char>& buffer ) const;
+
+        /// <summary>Chunk holding the given recording frame index, or -1 if the frame was dropped or is
+        /// out of range. A binary search over the chunk list.</summary>
+        int FindChunk( unsigned long long frame ) const;
+
+        /// <summary>Slots in use by the last chunk, the most any chunk uses.</summary>
+        int MarkerCount() const { return (int) mHeader->MarkerCount; }
+
+        /// <summary>Marker in a slot of the last chunk. Version 3 slots change hands between chunks; use
+        /// cRecordingChunk::MarkerID() for any other chunk.</summary>
+        Core::cUID MarkerID( int slot ) const;
+
+        /// <summary>Slot of a marker in the last chunk, or -1 if it is not there.</summary>
+        int FindMarker( const Core::cUID& id ) const;
+
+    private:
+        const sRecordingChunkHeader* ChunkHeader( int index ) const
+        {
+            return reinterpret_cast<const sRecordingChunkHeader*>( mFile.Data() + mChunks[index].Offset );
+        }
+
+        bool LoadIndex();
+        void ScanChunks();
+        bool ValidChunk( size_t offset ) const;
+        bool ValidEntry( const sRecordingIndexEntry& entry ) const;
+
+        cMappedFile mFile;
+        const sRecordingFileHeader* mHeader = nullptr;
+        const sRecordingMarkerEntry* mMarkers = nullptr;
+        sChunkLayout mLayout{ 1 };
+        std::vector<sRecordingIndexEntry> mChunks;     // Copied from the index, or built by scanning
+        unsigned long long mFrameCount = 0;
+        bool mHasIndex = false;
+        std::string mError;
+    };
+}
@@ -0,0 +1,162 @@
+//======================================================================================================
+// Core definitions the Motive DLL exports, for builds against the Motive API simulator
+//======================================================================================================
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cwchar>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "Core/DebugSystem.h"
+#include "Core/Label.h"
+#include "Core/Platform.h"
+#include "Core/UID.h"
+
+namespace Core
+{
+    // cUID / cLabel =======================================================================================
+
+    const cUID cUID::kInvalid;
+
+    cUID cUID::Generate()
+    {
+        static std::mutex sLock;
+        static std::mt19937_64 sRandom( std::random_device{}() );
+
+        std::lock_guard<std::mutex> lock( sLock );
+        const uint64 high = sRandom();
+        const uint64 low = sRandom();
+        return cUID( high, low );
+    }
+
+    const cLabel cLabel::kInvalid;
+
+    cLabel::cLabel() : mEntityID( cUID::kInvalid ), mMemberLabelID( 0 )
+    {
+    }
+
+    cLabel::cLabel( const cUID& entityID, unsigned int memberLabelID ) : mEntityID( entityID ), mMemberLabelID( memberLabelID )
+    {
+    }
+
+    const cUID& cLabel::EntityID() const
+    {
+        return mEntityID;
+    }
+
+    unsigned int cLabel::MemberID() const
+    {
+        return mMemberLabelID;
+    }
+
+    bool cLabel::operator<( const cLabel& rhs ) const
+    {
+        return ( mEntityID < rhs.mEntityID || ( mEntityID == rhs.mEntityID && mMemberLabelID < rhs.mMemberLabelID ) );
+    }
+
+    // Platform ============================================================================================
+
+    int CoreCount()
+    {
+        const unsigned int cores = std::thread::hardware_concurrency();
+        return ( cores > 0 ? (int) cores : 1 );
+    }
+
+    void SleepMilliseconds( int milliseconds )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( milliseconds ) );
+    }
+
+    // cDebugSystem: straight to stdout, or appended to the log file =======================================
+
+    bool cDebugSystem::SystemVisibility[DebugSystemCount] = { true };
+
+    void cDebugSystem::Failure( bool failure, const char* file, int line, const char* fmt, ... )
+    {
+        if( !failure )
+        {
+            return;
+        }
+        fprintf( stderr, "%s(%d): ", file, line );
+        va_list args;
+        va_start( args, fmt );
+        vfprintf( stderr, fmt, args );
+        va_end( args );
+        fputc( '\n', stderr );
+    }
+
+    void cDebugSystem::ReportDebug( eDebugSystemName system, const char* fmt, ... )
+    {
+        if( !SystemVisibility[system] )
+        {
+            return;
+        }
+        va_list args;
+        va_start( args, fmt );
+        vprintf( fmt, args );
+        va_end( args );
+    }
+
+    void cDebugSystem::ReportDebug( eDebugSystemName system, const wchar_t* fmt, ... )
+    {
+        if( !SystemVisibility[system] )
+        {
+            return;
+        }
+        va_list args;
+        va_start( args, fmt );
+        vwprintf( fmt, args );
+        va_end( args );
+    }
+
+    void cDebugSystem::ReportDebug( const char* fmt, ... )
+    {
+        va_list args;
+        va_start( args, fmt );
+        vprintf( fmt, args );
+        va_end( args );
+    }
+
+    void cDebugSystem::ReportDebug( const wchar_t* fmt, ... )
+    {
+        va_list args;
+        va_start( args, fmt );
+        vwprintf( fmt, args );
+        va_end( args );
+    }
+
+    void cDebugSystem::ReportLog( eDebugSystemName system, const char* filename, const char* fmt, ... )
+    {
+        if( !SystemVisibility[system] )
+        {
+            return;
+        }
+        FILE* file = fopen( filename, "a" );
+        if( file == nullptr )
+        {
+            return;
+        }
+        va_list args;
+        va_start( args, fmt );
+        vfprintf( file, fmt, args );
+        va_end( args );
+        fclose( file );
+    }
+
+    void cDebugSystem::Assert( bool assertion, const char* file, int line )
+    {
+        if( !assertion )
+        {
+            fprintf( stderr, "%s(%d): assertion failed\n", file, line );
+        }
+    }
+
+    const char* cDebugSystem::SystemName( eDebugSystemName system )
+    {
+        static const char* const kNames[DebugSystemCount] = { "General", "Camera", "CameraManager", "InputManager", "Input", "Frame",
+            "Thread", "Network", "USB", "Pipeline", "UI", "Skeleton", "Calibration", "RigidBody", "PluginDevice" };
+        return ( system >= 0 && system < DebugSystemCount ? kNames[system] : "Unknown" );
+    }
+}
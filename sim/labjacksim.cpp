@@ -0,0 +1,955 @@
+//======================================================================================================
+// LabJack U3 emulator: the LabJackUD.h command-response and stream functions, without the device
+//======================================================================================================
+#include "labjacksim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hostclock.h"
+
+namespace Capture
+{
+    namespace
+    {
+        const LJ_HANDLE kSimHandle = 1;
+        const int kLines = 20;
+        const long kDigitalStateChannel = 193;  // FIO in the low byte, EIO in the high byte
+        const long kCioStateChannel = 194;
+        const long kDefaultBufferSamples = 32768;
+        const long long kStreamWaitTimeoutNs = 100000000;   // LJ_swSLEEP returns what it has after 100 ms
+
+        struct sRequest
+        {
+            long IOType;
+            long Channel;
+            double Value;       // Input value, then the result
+            intptr_t X1;        // A long, or the AddRequestPtr() / eGetPtr() pointer
+            double UserData;
+            LJ_ERROR Error;
+        };
+
+        /// <summary>The UD driver keeps requests and results per thread.</summary>
+        struct sRequestList
+        {
+            std::vector<sRequest> Requests;
+            size_t ResultCursor = 0;
+            size_t ErrorCursor = 0;
+            bool Executed = false;
+        };
+
+        thread_local sRequestList tRequests;
+
+        struct sOutputWrite
+        {
+            double Seconds;
+            int Line;
+            bool Level;
+        };
+
+        /// <summary>
+        /// The one emulated U3. Device time is seconds since OpenLabJack() on the device's clock, which runs
+        /// ScanClockPpm fast against the host. Stream scans are not produced by a thread: a read works out how
+        /// many whole packets the device has sent by now and synthesizes those scans from the line state at
+        /// each scan's time.
+        /// </summary>
+        struct sSimDevice
+        {
+            std::mutex Lock;            // Everything below
+            std::mutex Bus;             // One round trip at a time
+            bool Open = false;
+            sLabJackSimConfig Config;
+            long long OpenNs = 0;
+            std::vector<unsigned int> ScriptStates;     // Line state after each script edge
+
+            unsigned int OutputMask = 0;                // Lines that are outputs, and their level before PendingWrites
+            unsigned int OutputLevels = 0;
+            std::vector<sOutputWrite> PendingWrites;    // In time order; the bus serializes them
+
+            std::map<long, double> Settings;            // LJ_ioPUT_CONFIG values
+            double ScanRate = 0;
+            long BufferSamples = kDefaultBufferSamples;
+            long WaitMode = LJ_swNONE;
+            std::vector<long> Channels;
+            bool Streaming = false;
+            double StreamStart = 0;                     // Device seconds of scan 0
+            unsigned long long ScansRead = 0;
+            long long OverrunAfter = 0;
+            bool OverrunPending = false;
+            LJ_ERROR StreamError = LJE_NOERROR;
+
+            unsigned long long RoundTrips = 0;
+        };
+
+        sSimDevice sDevice;
+        sLabJackSimConfig sConfig;
+        bool sConfigured = false;
+
+        std::atomic<unsigned long long> sCommands{ 0 };
+        std::atomic<unsigned long long> sFailedCommands{ 0 };
+        std::atomic<unsigned long long> sDigitalWrites{ 0 };
+        std::atomic<unsigned long long> sStreamReads{ 0 };
+        std::atomic<unsigned long long> sScansStreamed{ 0 };
+        std::atomic<unsigned long long> sOverruns{ 0 };
+        std::atomic<long long> sMaxBacklog{ 0 };
+
+        double DeviceSeconds( long long hostNs )
+        {
+            return ( hostNs - sDevice.OpenNs ) * 1e-9 * ( 1.0 + sDevice.Config.ScanClockPpm * 1e-6 );
+        }
+
+        long long HostNsAt( double deviceSeconds )
+        {
+            return sDevice.OpenNs + (long long) ( deviceSeconds * 1e9 / ( 1.0 + sDevice.Config.ScanClockPpm * 1e-6 ) );
+        }
+
+        unsigned int SetLine( unsigned int state, int line, bool level )
+        {
+            return ( level ? state | ( 1u << line ) : state & ~( 1u << line ) );
+        }
+
+        // Line state and stream helpers, all under sDevice.Lock =================================================
+
+        unsigned int ScriptState( double seconds )
+        {
+            const sLabJackSimConfig& config = sDevice.Config;
+            if( config.ScriptPeriod > 0 )
+            {
+                seconds = std::fmod( seconds, config.ScriptPeriod );
+            }
+            const auto edge = std::upper_bound( config.Script.begin(), config.Script.end(), seconds,
+                []( double t, const sLabJackSimEdge& e ) { return t < e.Seconds; } );
+            return ( edge == config.Script.begin() ? config.InitialState : sDevice.ScriptStates[edge - config.Script.begin() - 1] );
+        }
+
+        unsigned int StateAt( double seconds )
+        {
+            unsigned int outputs = sDevice.OutputLevels;
+            for( const sOutputWrite& write : sDevice.PendingWrites )
+            {
+                if( write.Seconds > seconds )
+                {
+                    break;
+                }
+                outputs = SetLine( outputs, write.Line, write.Level );
+            }
+            return ( ScriptState( seconds ) & ~sDevice.OutputMask ) | ( outputs & sDevice.OutputMask );
+        }
+
+        /// <summary>Apply writes no later than seconds to the output levels; nothing asks about earlier times again.</summary>
+        void FoldWrites( double seconds )
+        {
+            std::vector<sOutputWrite>& writes = sDevice.PendingWrites;
+            size_t folded = 0;
+            while( folded < writes.size() && writes[folded].Seconds <= seconds )
+            {
+                sDevice.OutputLevels = SetLine( sDevice.OutputLevels, writes[folded].Line, writes[folded].Level );
+                ++folded;
+            }
+            writes.erase( writes.begin(), writes.begin() + folded );
+        }
+
+        /// <summary>Scans the device has sent to the driver by the given device time: whole packets only.</summary>
+        unsigned long long ScansProduced( double seconds )
+        {
+            if( !sDevice.Streaming || seconds <= sDevice.StreamStart )
+            {
+                return 0;
+            }
+            const unsigned long long scans = (unsigned long long) ( ( seconds - sDevice.StreamStart ) * sDevice.ScanRate );
+            const unsigned long long packet = (unsigned long long) std::max( sDevice.Config.ScansPerPacket, 1 );
+            return scans / packet * packet;
+        }
+
+        double ChannelValue( long channel, unsigned int state )
+        {
+            if( channel == kDigitalStateChannel )
+            {
+                return (double) ( state & 0xFFFF );
+            }
+            if( channel == kCioStateChannel )
+            {
+                return (double) ( ( state >> 16 ) & 0xF );
+            }
+            return 0.0;
+        }
+
+        void StopStream( LJ_ERROR error )
+        {
+            sDevice.Streaming = false;
+            sDevice.StreamError = error;
+            FoldWrites( DeviceSeconds( HostTimeNs() ) );
+        }
+
+        /// <summary>LJ_ioGET_STREAM_DATA: request.Value scans in, scans returned out, interleaved into X1.</summary>
+        LJ_ERROR ReadStream( sRequest& request, std::unique_lock<std::mutex>& lock )
+        {
+            sStreamReads.fetch_add( 1, std::memory_order_relaxed );
+            const long long requested = std::max( 0LL, (long long) request.Value );
+            request.Value = 0;
+            const long long waitStartNs = HostTimeNs();
+
+            for( ;; )
+            {
+                if( !sDevice.Streaming )
+                {
+                    return LJE_STREAM_NOT_RUNNING;
+                }
+
+                const unsigned long long produced = ScansProduced( DeviceSeconds( HostTimeNs() ) );
+                const long long backlog = (long long) ( produced - sDevice.ScansRead );
+                if( backlog > sMaxBacklog.load( std::memory_order_relaxed ) )
+                {
+                    sMaxBacklog.store( backlog, std::memory_order_relaxed );
+                }
+
+                const bool injected = sDevice.OverrunPending || ( sDevice.OverrunAfter > 0 && (long long) sDevice.ScansRead >= sDevice.OverrunAfter );
+                if( injected || backlog * (long long) sDevice.Channels.size() > sDevice.BufferSamples )
+                {
+                    sDevice.OverrunPending = false;
+                    sDevice.OverrunAfter = 0;
+                    sOverruns.fetch_add( 1, std::memory_order_relaxed );
+                    StopStream( LJE_BUFFER_OVERRUN );
+                    return LJE_BUFFER_OVERRUN;
+                }
+
+                long long count = std::min( requested, backlog );
+                if( sDevice.OverrunAfter > 0 )
+                {
+                    count = std::min( count, sDevice.OverrunAfter - (long long) sDevice.ScansRead );
+                }
+
+                const bool waits = ( sDevice.WaitMode == LJ_swSLEEP || sDevice.WaitMode == LJ_swPUMP );
+                if( count < requested && waits && HostTimeNs() - waitStartNs < kStreamWaitTimeoutNs )
+                {
+                    // Sleep until the packet holding the last requested scan is due, or the timeout.
+                    const double dueSeconds = sDevice.StreamStart + ( sDevice.ScansRead + requested ) / sDevice.ScanRate;
+                    const long long wakeNs = std::min( HostNsAt( dueSeconds ), waitStartNs + kStreamWaitTimeoutNs );
+                    lock.unlock();
+                    std::this_thread::sleep_for( std::chrono::nanoseconds( std::max( wakeNs - HostTimeNs(), 100000LL ) ) );
+                    lock.lock();
+                    continue;
+                }
+                if( count < requested && sDevice.WaitMode == LJ_swALL_OR_NONE )
+                {
+                    count = 0;
+                }
+
+                double* out = reinterpret_cast<double*>( request.X1 );
+                const bool allChannels = ( request.Channel == LJ_chALL_CHANNELS || sDevice.Channels.size() == 1 );
+                for( long long s = 0; s < count; ++s )
+                {
+                    const unsigned int state = StateAt( sDevice.StreamStart + ( sDevice.ScansRead + s ) / sDevice.ScanRate );
+                    if( allChannels )
+                    {
+                        for( long channel : sDevice.Channels )
+                        {
+                            *out++ = ChannelValue( channel, state );
+                        }
+                    }
+                    else
+                    {
+                        *out++ = ChannelValue( request.Channel, state );
+                    }
+                }
+                sDevice.ScansRead += count;
+                FoldWrites( sDevice.StreamStart + sDevice.ScansRead / sDevice.ScanRate );
+                sScansStreamed.fetch_add( count, std::memory_order_relaxed );
+                request.Value = (double) count;
+                return LJE_NOERROR;
+            }
+        }
+
+        LJ_ERROR GetConfig( sRequest& request )
+        {
+            const double now = DeviceSeconds( HostTimeNs() );
+            const double channels = (double) sDevice.Channels.size();
+            switch( request.Channel )
+            {
+            case LJ_chSTREAM_BACKLOG_UD:
+                request.Value = ( ScansProduced( now ) - sDevice.ScansRead ) * channels * 2;
+                break;
+            case LJ_chSTREAM_BACKLOG_COMM:
+                request.Value = ( sDevice.Streaming ? std::floor( ( now - sDevice.StreamStart ) * sDevice.ScanRate ) - ScansProduced( now ) : 0 ) * channels * 2;
+                break;
+            case LJ_chSTREAM_SCAN_FREQUENCY:
+                request.Value = sDevice.ScanRate;
+                break;
+            case LJ_chSTREAM_BUFFER_SIZE:
+                request.Value = (double) sDevice.BufferSamples;
+                break;
+            case LJ_chSTREAM_WAIT_MODE:
+                request.Value = (double) sDevice.WaitMode;
+                break;
+            case LJ_chSERIAL_NUMBER:
+                request.Value = (double) sDevice.Config.SerialNumber;
+                break;
+            case LJ_chPRODUCTID:
+                request.Value = (double) LJ_dtU3;
+                break;
+            default:
+                request.Value = sDevice.Settings.count( request.Channel ) ? sDevice.Settings[request.Channel] : 0.0;
+                break;
+            }
+            return LJE_NOERROR;
+        }
+
+        LJ_ERROR PutConfig( const sRequest& request )
+        {
+            switch( request.Channel )
+            {
+            case LJ_chSTREAM_SCAN_FREQUENCY:
+                sDevice.ScanRate = request.Value;
+                break;
+            case LJ_chSTREAM_BUFFER_SIZE:
+                sDevice.BufferSamples = std::max( 1L, (long) request.Value );
+                break;
+            case LJ_chSTREAM_WAIT_MODE:
+                sDevice.WaitMode = (long) request.Value;
+                break;
+            default:
+                sDevice.Settings[request.Channel] = request.Value;
+                break;
+            }
+            return LJE_NOERROR;
+        }
+
+        /// <summary>One request, as the device sees it at device time now.</summary>
+        LJ_ERROR Execute( sRequest& request, double now, std::unique_lock<std::mutex>& lock )
+        {
+            switch( request.IOType )
+            {
+            case LJ_ioPUT_DIGITAL_BIT:
+                if( request.Channel < 0 || request.Channel >= kLines )
+                {
+                    return LJE_INVALID_CHANNEL_NUMBER;
+                }
+                sDigitalWrites.fetch_add( 1, std::memory_order_relaxed );
+                if( !( sDevice.OutputMask & ( 1u << request.Channel ) ) )
+                {
+                    // A line turning into an output starts from its input level.
+                    FoldWrites( now );
+                    sDevice.OutputLevels = SetLine( sDevice.OutputLevels, (int) request.Channel, ( StateAt( now ) >> request.Channel ) & 1 );
+                    sDevice.OutputMask |= 1u << request.Channel;
+                }
+                sDevice.PendingWrites.push_back( sOutputWrite{ now, (int) request.Channel, request.Value != 0 } );
+                return LJE_NOERROR;
+
+            case LJ_ioGET_DIGITAL_BIT:
+                if( request.Channel < 0 || request.Channel >= kLines )
+                {
+                    return LJE_INVALID_CHANNEL_NUMBER;
+                }
+                // Reading a bit makes it an input again.
+                request.Value = (double) ( ( StateAt( now ) >> request.Channel ) & 1 );
+                FoldWrites( now );
+                sDevice.OutputMask &= ~( 1u << request.Channel );
+                return LJE_NOERROR;
+
+            case LJ_ioPUT_ANALOG_ENABLE_PORT:
+            case LJ_ioPIN_CONFIGURATION_RESET:
+                return LJE_NOERROR;
+
+            case LJ_ioPUT_CONFIG:
+                return PutConfig( request );
+
+            case LJ_ioGET_CONFIG:
+                return GetConfig( request );
+
+            case LJ_ioCLEAR_STREAM_CHANNELS:
+                if( sDevice.Streaming )
+                {
+                    return LJE_STREAM_IS_ACTIVE;
+                }
+                sDevice.Channels.clear();
+                return LJE_NOERROR;
+
+            case LJ_ioADD_STREAM_CHANNEL:
+                if( sDevice.Streaming )
+                {
+                    return LJE_STREAM_IS_ACTIVE;
+                }
+                sDevice.Channels.push_back( request.Channel );
+                return LJE_NOERROR;
+
+            case LJ_ioSTART_STREAM:
+                if( sDevice.Streaming )
+                {
+                    return LJE_STREAM_IS_ACTIVE;
+                }
+                if( sDevice.Channels.empty() )
+                {
+                    return LJE_NOTHING_TO_STREAM;
+                }
+                if( sDevice.ScanRate <= 0 || sDevice.ScanRate > sDevice.Config.MaxScanRate )
+                {
+                    return LJE_INVALID_STREAM_FREQUENCY;
+                }
+                sDevice.Streaming = true;
+                sDevice.StreamStart = now;
+                sDevice.ScansRead = 0;
+                sDevice.StreamError = LJE_NOERROR;
+                request.Value = sDevice.ScanRate;
+                return LJE_NOERROR;
+
+            case LJ_ioSTOP_STREAM:
+                if( !sDevice.Streaming )
+                {
+                    return LJE_STREAM_NOT_RUNNING;
+                }
+                StopStream( LJE_NOERROR );
+                return LJE_NOERROR;
+
+            case LJ_ioGET_STREAM_DATA:
+                return ReadStream( request, lock );
+
+            default:
+                return LJE_INVALID_PARAMETER;
+            }
+        }
+
+        /// <summary>Stream data and stream or driver settings never leave the host.</summary>
+        bool ReachesDevice( long ioType )
+        {
+            return ioType != LJ_ioGET_STREAM_DATA && ioType != LJ_ioPUT_CONFIG && ioType != LJ_ioGET_CONFIG
+                && ioType != LJ_ioCLEAR_STREAM_CHANNELS && ioType != LJ_ioADD_STREAM_CHANNEL;
+        }
+
+        /// <summary>Sleep to within a few hundred microseconds of the deadline, then spin on the clock.</summary>
+        void WaitUntil( long long dueNs )
+        {
+            const long long now = HostTimeNs();
+            if( dueNs - now > 200000 )
+            {
+                std::this_thread::sleep_for( std::chrono::nanoseconds( dueNs - now - 200000 ) );
+            }
+            while( HostTimeNs() < dueNs )
+            {
+            }
+        }
+
+        long long RoundTripNs()
+        {
+            thread_local std::mt19937 tRandom( std::random_device{}() );
+            const sLabJackSimConfig& config = sDevice.Config;
+            long long ns = config.CommandLatencyUs * 1000LL;
+            if( config.CommandJitterUs > 0 )
+            {
+                ns += std::uniform_int_distribution<long long>( 0, config.CommandJitterUs * 1000LL )( tRandom );
+            }
+            return ns;
+        }
+
+        /// <summary>
+        /// Execute the calling thread's requests. Device requests share one round trip: the bus is held for it,
+        /// and they take effect halfway through.
+        /// </summary>
+        LJ_ERROR GoRequests( LJ_HANDLE handle )
+        {
+            sRequestList& list = tRequests;
+            if( handle != kSimHandle || !sDevice.Open )
+            {
+                return LJE_INVALID_HANDLE;
+            }
+            list.Executed = true;
+            list.ResultCursor = 0;
+            list.ErrorCursor = 0;
+
+            const bool roundTrip = std::any_of( list.Requests.begin(), list.Requests.end(),
+                []( const sRequest& request ) { return ReachesDevice( request.IOType ); } );
+
+            std::unique_lock<std::mutex> bus( sDevice.Bus, std::defer_lock );
+            long long returnNs = 0;
+            bool failed = false;
+            if( roundTrip )
+            {
+                bus.lock();
+                const long long startNs = HostTimeNs();
+                const long long tripNs = RoundTripNs();
+                returnNs = startNs + tripNs;
+
+                const unsigned long long trips = sCommands.fetch_add( 1, std::memory_order_relaxed ) + 1;
+                const int failEvery = sDevice.Config.FailEveryCommands;
+                failed = ( failEvery > 0 && trips % failEvery == 0 );
+                WaitUntil( startNs + tripNs / 2 );
+            }
+
+            LJ_ERROR groupError = LJE_NOERROR;
+            {
+                std::unique_lock<std::mutex> lock( sDevice.Lock );
+                const double now = DeviceSeconds( HostTimeNs() );
+                for( sRequest& request : list.Requests )
+                {
+                    if( groupError != LJE_NOERROR )
+                    {
+                        request.Error = LJE_REQUEST_NOT_PROCESSED;
+                    }
+                    else if( failed && ReachesDevice( request.IOType ) )
+                    {
+                        request.Error = groupError = LJE_COMM_FAILURE;
+                    }
+                    else
+                    {
+                        request.Error = Execute( request, now, lock );
+                    }
+                }
+            }
+            if( failed )
+            {
+                sFailedCommands.fetch_add( 1, std::memory_order_relaxed );
+            }
+
+            if( roundTrip )
+            {
+                WaitUntil( returnNs );
+            }
+            return groupError;
+        }
+
+        LJ_ERROR AddToList( LJ_HANDLE handle, long ioType, long channel, double value, intptr_t x1, double userData )
+        {
+            if( handle != kSimHandle || !sDevice.Open )
+            {
+                return LJE_INVALID_HANDLE;
+            }
+            sRequestList& list = tRequests;
+            if( list.Executed )
+            {
+                list.Requests.clear();
+                list.Executed = false;
+            }
+            list.Requests.push_back( sRequest{ ioType, channel, value, x1, userData, LJE_NOERROR } );
+            return LJE_NOERROR;
+        }
+
+        /// <summary>The e-functions: AddRequest, GoOne and GetResult in one.</summary>
+        LJ_ERROR OneRequest( LJ_HANDLE handle, long ioType, long channel, double* pValue, intptr_t x1 )
+        {
+            LJ_ERROR error = AddToList( handle, ioType, channel, pValue ? *pValue : 0.0, x1, 0 );
+            if( error == LJE_NOERROR )
+            {
+                error = GoRequests( handle );
+            }
+            if( error != LJE_NOERROR )
+            {
+                return error;
+            }
+            const sRequest& request = tRequests.Requests.back();
+            if( pValue )
+            {
+                *pValue = request.Value;
+            }
+            return request.Error;
+        }
+
+        int ParseLine( const std::string& name )
+        {
+            static const char* const kPorts[] = { "FIO", "EIO", "CIO" };
+            for( int port = 0; port < 3; ++port )
+            {
+                if( name.compare( 0, 3, kPorts[port] ) == 0 && name.size() == 4 && name[3] >= '0' && name[3] <= ( port == 2 ? '3' : '7' ) )
+                {
+                    return port * 8 + ( name[3] - '0' );
+                }
+            }
+            char* end = nullptr;
+            const long line = strtol( name.c_str(), &end, 10 );
+            return ( !name.empty() && *end == 0 && line >= 0 && line < kLines ? (int) line : -1 );
+        }
+
+        sLabJackSimConfig ConfigFromEnvironment()
+        {
+            sLabJackSimConfig config;
+            if( const char* latency = getenv( "LABJACK_SIM_LATENCY_US" ) )
+            {
+                config.CommandLatencyUs = std::max( 0, atoi( latency ) );
+            }
+            if( const char* jitter = getenv( "LABJACK_SIM_JITTER_US" ) )
+            {
+                config.CommandJitterUs = std::max( 0, atoi( jitter ) );
+            }
+            if( const char* overrun = getenv( "LABJACK_SIM_OVERRUN_AFTER" ) )
+            {
+                config.OverrunAfterScans = std::max( 0LL, atoll( overrun ) );
+            }
+            if( const char* script = getenv( "LABJACK_SIM_SCRIPT" ) )
+            {
+                std::string error;
+                if( !LoadLabJackSimScript( script, config, error ) )
+                {
+                    fprintf( stderr, "LABJACK_SIM_SCRIPT: %s\n", error.c_str() );
+                }
+            }
+            return config;
+        }
+    }
+
+    void ConfigureLabJackSim( const sLabJackSimConfig& config )
+    {
+        sConfig = config;
+        sConfigured = true;
+    }
+
+    bool LoadLabJackSimScript( const char* path, sLabJackSimConfig& config, std::string& error )
+    {
+        FILE* file = fopen( path, "r" );
+        if( file == nullptr )
+        {
+            error = std::string( "cannot open " ) + path;
+            return false;
+        }
+
+        std::vector<sLabJackSimEdge> script;
+        char text[256];
+        int number = 0;
+        bool ok = true;
+        while( ok && fgets( text, sizeof( text ), file ) )
+        {
+            ++number;
+            if( char* comment = strchr( text, '#' ) )
+            {
+                *comment = 0;
+            }
+            char first[64] = "", second[64] = "";
+            int level = 0;
+            const int fields = sscanf( text, "%63s %63s %d", first, second, &level );
+            if( fields <= 0 )
+            {
+                continue;
+            }
+
+            const int line = ParseLine( second );
+            if( strcmp( first, "repeat" ) == 0 && fields == 2 )
+            {
+                config.ScriptPeriod = atof( second );
+            }
+            else if( fields == 3 && line >= 0 && ( level == 0 || level == 1 ) )
+            {
+                if( strcmp( first, "initial" ) == 0 )
+                {
+                    config.InitialState = SetLine( config.InitialState, line, level != 0 );
+                }
+                else
+                {
+                    char* end = nullptr;
+                    const double seconds = strtod( first, &end );
+                    ok = ( *end == 0 && seconds >= 0 );
+                    script.push_back( sLabJackSimEdge{ seconds, line, level != 0 } );
+                }
+            }
+            else
+            {
+                ok = false;
+            }
+        }
+        fclose( file );
+
+        if( !ok )
+        {
+            error = std::string( path ) + ":" + std::to_string( number ) + ": expected \"seconds line level\", \"initial line level\" or \"repeat seconds\"";
+            return false;
+        }
+        std::stable_sort( script.begin(), script.end(), []( const sLabJackSimEdge& a, const sLabJackSimEdge& b ) { return a.Seconds < b.Seconds; } );
+        config.Script = script;
+        return true;
+    }
+
+    void InjectLabJackSimOverrun()
+    {
+        std::lock_guard<std::mutex> lock( sDevice.Lock );
+        sDevice.OverrunPending = true;
+    }
+
+    sLabJackSimStats LabJackSimStats()
+    {
+        sLabJackSimStats stats;
+        stats.Commands = sCommands.load( std::memory_order_relaxed );
+        stats.FailedCommands = sFailedCommands.load( std::memory_order_relaxed );
+        stats.DigitalWrites = sDigitalWrites.load( std::memory_order_relaxed );
+        stats.StreamReads = sStreamReads.load( std::memory_order_relaxed );
+        stats.ScansStreamed = sScansStreamed.load( std::memory_order_relaxed );
+        stats.Overruns = sOverruns.load( std::memory_order_relaxed );
+        stats.MaxBacklogScans = sMaxBacklog.load( std::memory_order_relaxed );
+        return stats;
+    }
+}
+
+using namespace Capture;
+
+// Device ==============================================================================================
+
+LJ_ERROR _stdcall ListAll( long DeviceType, long ConnectionType, long* pNumFound, long* pSerialNumbers, long* pIDs, double* pAddresses )
+{
+    const sLabJackSimConfig& config = ( sConfigured ? sConfig : sDevice.Config );
+    const bool found = ( config.Present && DeviceType == LJ_dtU3 && ConnectionType == LJ_ctUSB );
+    *pNumFound = ( found ? 1 : 0 );
+    if( found )
+    {
+        pSerialNumbers[0] = config.SerialNumber;
+        pIDs[0] = 1;
+        pAddresses[0] = 0;
+    }
+    return LJE_NOERROR;
+}
+
+LJ_ERROR _stdcall OpenLabJack( long DeviceType, long ConnectionType, const char* /*pAddress*/, long /*FirstFound*/, LJ_HANDLE* pHandle )
+{
+    *pHandle = 0;
+    if( ConnectionType != LJ_ctUSB )
+    {
+        return LJE_INVALID_CONNECTION_TYPE;
+    }
+
+    std::lock_guard<std::mutex> lock( sDevice.Lock );
+    if( sDevice.Open )
+    {
+        *pHandle = kSimHandle;
+        return LJE_NOERROR;
+    }
+
+    const sLabJackSimConfig config = ( sConfigured ? sConfig : ConfigFromEnvironment() );
+    if( !config.Present || DeviceType != LJ_dtU3 )
+    {
+        return LJE_LABJACK_NOT_FOUND;
+    }
+
+    sDevice.Config = config;
+    sDevice.ScriptStates.clear();
+    unsigned int state = config.InitialState;
+    for( const sLabJackSimEdge& edge : config.Script )
+    {
+        state = SetLine( state, edge.Line, edge.Level );
+        sDevice.ScriptStates.push_back( state );
+    }
+    sDevice.OutputMask = 0;
+    sDevice.OutputLevels = 0;
+    sDevice.PendingWrites.clear();
+    sDevice.Settings.clear();
+    sDevice.ScanRate = 0;
+    sDevice.BufferSamples = kDefaultBufferSamples;
+    sDevice.WaitMode = LJ_swNONE;
+    sDevice.Channels.clear();
+    sDevice.Streaming = false;
+    sDevice.OverrunAfter = config.OverrunAfterScans;
+    sDevice.OverrunPending = false;
+    sDevice.StreamError = LJE_NOERROR;
+    sDevice.OpenNs = HostTimeNs();
+    sDevice.Open = true;
+
+    *pHandle = kSimHandle;
+    return LJE_NOERROR;
+}
+
+void _stdcall Close( void )
+{
+    std::lock_guard<std::mutex> lock( sDevice.Lock );
+    sDevice.Streaming = false;
+    sDevice.Open = false;
+}
+
+LJ_ERROR _stdcall ResetLabJack( LJ_HANDLE Handle )
+{
+    if( Handle != kSimHandle || !sDevice.Open )
+    {
+        return LJE_INVALID_HANDLE;
+    }
+    std::lock_guard<std::mutex> lock( sDevice.Lock );
+    sDevice.Streaming = false;
+    sDevice.OutputMask = 0;
+    sDevice.PendingWrites.clear();
+    return LJE_NOERROR;
+}
+
+// Request lists =======================================================================================
+
+LJ_ERROR _stdcall AddRequest( LJ_HANDLE Handle, long IOType, long Channel, double Value, long x1, double UserData )
+{
+    return AddToList( Handle, IOType, Channel, Value, (intptr_t) x1, UserData );
+}
+
+LJ_ERROR _stdcall AddRequestPtr( LJ_HANDLE Handle, long IOType, long Channel, double Value, void* x1, double UserData )
+{
+    return AddToList( Handle, IOType, Channel, Value, (intptr_t) x1, UserData );
+}
+
+LJ_ERROR _stdcall Go( void )
+{
+    return GoRequests( kSimHandle );
+}
+
+LJ_ERROR _stdcall GoOne( LJ_HANDLE Handle )
+{
+    return GoRequests( Handle );
+}
+
+LJ_ERROR _stdcall GetResult( LJ_HANDLE Handle, long IOType, long Channel, double* pValue )
+{
+    if( Handle != kSimHandle )
+    {
+        return LJE_INVALID_HANDLE;
+    }
+    const sRequestList& list = tRequests;
+    if( list.Executed )
+    {
+        for( const sRequest& request : list.Requests )
+        {
+            if( request.IOType == IOType && request.Channel == Channel )
+            {
+                *pValue = request.Value;
+                return request.Error;
+            }
+        }
+    }
+    return LJE_NO_DATA_AVAILABLE;
+}
+
+LJ_ERROR _stdcall GetNextResult( LJ_HANDLE Handle, long* pIOType, long* pChannel, double* pValue, long* px1, double* pUserData )
+{
+    if( Handle != kSimHandle )
+    {
+        return LJE_INVALID_HANDLE;
+    }
+    sRequestList& list = tRequests;
+    if( !list.Executed )
+    {
+        return LJE_NO_DATA_AVAILABLE;
+    }
+    if( list.ResultCursor >= list.Requests.size() )
+    {
+        return LJE_NO_MORE_DATA_AVAILABLE;
+    }
+    const sRequest& request = list.Requests[list.ResultCursor++];
+    *pIOType = request.IOType;
+    *pChannel = request.Channel;
+    *pValue = request.Value;
+    if( px1 )
+    {
+        *px1 = (long) request.X1;
+    }
+    if( pUserData )
+    {
+        *pUserData = request.UserData;
+    }
+    return request.Error;
+}
+
+LJ_ERROR _stdcall GetFirstResult( LJ_HANDLE Handle, long* pIOType, long* pChannel, double* pValue, long* px1, double* pUserData )
+{
+    tRequests.ResultCursor = 0;
+    return GetNextResult( Handle, pIOType, pChannel, pValue, px1, pUserData );
+}
+
+LJ_ERROR _stdcall GetNextError( LJ_HANDLE Handle, long* pIOType, long* pChannel )
+{
+    if( Handle != kSimHandle )
+    {
+        return LJE_INVALID_HANDLE;
+    }
+    sRequestList& list = tRequests;
+    while( list.Executed && list.ErrorCursor < list.Requests.size() )
+    {
+        const sRequest& request = list.Requests[list.ErrorCursor++];
+        if( request.Error != LJE_NOERROR )
+        {
+            *pIOType = request.IOType;
+            *pChannel = request.Channel;
+            return request.Error;
+        }
+    }
+    return LJE_NOERROR;
+}
+
+LJ_ERROR _stdcall GetStreamError( LJ_HANDLE Handle )
+{
+    if( Handle != kSimHandle )
+    {
+        return LJE_INVALID_HANDLE;
+    }
+    std::lock_guard<std::mutex> lock( sDevice.Lock );
+    return sDevice.StreamError;
+}
+
+// One-step functions ==================================================================================
+
+LJ_ERROR _stdcall eGet( LJ_HANDLE Handle, long IOType, long Channel, double* pValue, long x1 )
+{
+    return OneRequest( Handle, IOType, Channel, pValue, (intptr_t) x1 );
+}
+
+LJ_ERROR _stdcall eGetPtr( LJ_HANDLE Handle, long IOType, long Channel, double* pValue, void* x1 )
+{
+    return OneRequest( Handle, IOType, Channel, pValue, (intptr_t) x1 );
+}
+
+LJ_ERROR _stdcall ePut( LJ_HANDLE Handle, long IOType, long Channel, double Value, long x1 )
+{
+    return OneRequest( Handle, IOType, Channel, &Value, (intptr_t) x1 );
+}
+
+LJ_ERROR _stdcall eDI( LJ_HANDLE Handle, long Channel, long* State )
+{
+    double value = 0;
+    const LJ_ERROR error = OneRequest( Handle, LJ_ioGET_DIGITAL_BIT, Channel, &value, 0 );
+    *State = (long) value;
+    return error;
+}
+
+LJ_ERROR _stdcall eDO( LJ_HANDLE Handle, long Channel, long State )
+{
+    double value = (double) State;
+    return OneRequest( Handle, LJ_ioPUT_DIGITAL_BIT, Channel, &value, 0 );
+}
+
+// Errors and versions =================================================================================
+
+void _stdcall ErrorToString( LJ_ERROR ErrorCode, char* pString )
+{
+    struct sName
+    {
+        LJ_ERROR Code;
+        const char* Text;
+    };
+    static const sName kNames[] = {
+        { LJE_NOERROR, "No error" },
+        { LJE_INVALID_CHANNEL_NUMBER, "Invalid channel number" },
+        { LJE_NOTHING_TO_STREAM, "Nothing to stream" },
+        { LJE_BUFFER_OVERRUN, "Stream buffer overrun" },
+        { LJE_STREAM_NOT_RUNNING, "Stream not running" },
+        { LJE_INVALID_PARAMETER, "Invalid parameter" },
+        { LJE_INVALID_STREAM_FREQUENCY, "Invalid stream frequency" },
+        { LJE_REQUEST_NOT_PROCESSED, "Request not processed" },
+        { LJE_STREAM_IS_ACTIVE, "Stream is active" },
+        { LJE_INVALID_DEVICE_TYPE, "Invalid device type" },
+        { LJE_INVALID_HANDLE, "Invalid handle" },
+        { LJE_NO_DATA_AVAILABLE, "No data available" },
+        { LJE_NO_MORE_DATA_AVAILABLE, "No more data available" },
+        { LJE_LABJACK_NOT_FOUND, "LabJack not found" },
+        { LJE_COMM_FAILURE, "Communication failure" },
+        { LJE_INVALID_CONNECTION_TYPE, "Invalid connection type" },
+    };
+    pString[0] = 0;
+    for( const sName& name : kNames )
+    {
+        if( name.Code == ErrorCode )
+        {
+            snprintf( pString, 256, "%s", name.Text );
+            return;
+        }
+    }
+}
+
+double _stdcall GetDriverVersion( void )
+{
+    return DRIVER_VERSION;
+}
@@ -0,0 +1,79 @@
+//======================================================================================================
+// LabJack U3 emulator: the LabJackUD.h command-response and stream functions, without the device
+//======================================================================================================
+#pragma once
+
+#include <string>
+#include <vector>
+
+// LabJackUD.h spells the Windows calling convention on every declaration.
+#if !defined( _WIN32 ) && !defined( _stdcall )
+#define _stdcall
+#endif
+
+#include "LabJackUD.h"
+
+namespace Capture
+{
+    /// <summary>One scripted level change on a digital line, in seconds since OpenLabJack().</summary>
+    struct sLabJackSimEdge
+    {
+        double Seconds;
+        int Line;       // 0-7 FIO, 8-15 EIO, 16-19 CIO
+        bool Level;
+    };
+
+    struct sLabJackSimConfig
+    {
+        bool Present = true;                    // False: OpenLabJack() reports LJE_LABJACK_NOT_FOUND
+        long SerialNumber = 320000001;
+
+        // Every Go()/GoOne()/e-function that reaches the device costs one USB round trip, serialized per device
+        // as on the real bus. Stream data and stream settings are driver-side and return at once.
+        int CommandLatencyUs = 600;
+        int CommandJitterUs = 200;              // Uniform extra, up to this much
+        int FailEveryCommands = 0;              // Every Nth round trip fails with LJE_COMM_FAILURE; 0 = never
+
+        // Stream: scans reach the driver in whole USB packets on the device's own clock.
+        double MaxScanRate = 50000.0;           // LJ_ioSTART_STREAM fails above this with LJE_INVALID_STREAM_FREQUENCY
+        int ScansPerPacket = 25;
+        double ScanClockPpm = 0.0;              // Device scan clock error against the host clock
+        long long OverrunAfterScans = 0;        // Inject LJE_BUFFER_OVERRUN once this many scans were streamed; 0 = never
+
+        // Digital inputs. Lines written with LJ_ioPUT_DIGITAL_BIT become outputs and read back what was written,
+        // from the moment the command reaches the device (half a round trip after the call).
+        unsigned int InitialState = 0;          // Bit n is line n
+        std::vector<sLabJackSimEdge> Script;    // Sorted by time
+        double ScriptPeriod = 0.0;              // Repeat the script, from InitialState, every this many seconds; 0 = once
+    };
+
+    struct sLabJackSimStats
+    {
+        unsigned long long Commands;            // USB round trips
+        unsigned long long FailedCommands;
+        unsigned long long DigitalWrites;       // LJ_ioPUT_DIGITAL_BIT requests
+        unsigned long long StreamReads;         // LJ_ioGET_STREAM_DATA requests
+        unsigned long long ScansStreamed;       // Scans handed to the caller
+        unsigned long long Overruns;            // Streams stopped by LJE_BUFFER_OVERRUN, injected or from backlog
+        long long MaxBacklogScans;              // Deepest the driver buffer got before a read
+    };
+
+    /// <summary>
+    /// Configure the emulated U3 for the next OpenLabJack(). Without a call, OpenLabJack() takes the defaults
+    /// and LABJACK_SIM_LATENCY_US, LABJACK_SIM_JITTER_US, LABJACK_SIM_OVERRUN_AFTER and LABJACK_SIM_SCRIPT
+    /// (a script file, see LoadLabJackSimScript()) from the environment.
+    /// </summary>
+    void ConfigureLabJackSim( const sLabJackSimConfig& config );
+
+    /// <summary>
+    /// Read a waveform script: one "seconds line level" edge per line, the line as FIO0-7, EIO0-7, CIO0-3 or
+    /// its number, the level 0 or 1, and optionally "initial line level" and "repeat seconds" lines. '#'
+    /// starts a comment. Returns false with error set on a line it cannot read.
+    /// </summary>
+    bool LoadLabJackSimScript( const char* path, sLabJackSimConfig& config, std::string& error );
+
+    /// <summary>Make the next LJ_ioGET_STREAM_DATA fail with LJE_BUFFER_OVERRUN and stop the stream.</summary>
+    void InjectLabJackSimOverrun();
+
+    sLabJackSimStats LabJackSimStats();
+}
@@ -0,0 +1,675 @@
+//======================================================================================================
+// Motive API simulator: replays a recorded take through the MotiveAPI.h frame and marker functions
+//======================================================================================================
+#include "motivesim.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MotiveAPI.h"
+#include "hostclock.h"
+#include "recording.h"
+#include "takecsv.h"
+
+using namespace MotiveAPI;
+
+namespace Capture
+{
+    namespace
+    {
+        /// <summary>
+        /// A whole take in memory, markers of all frames back to back: frame f owns markers
+        /// [First[f], First[f + 1]). Only markers seen in a frame are stored, positions in meters.
+        /// </summary>
+        struct sSimTake
+        {
+            std::vector<int> FrameIDs;
+            std::vector<double> Times;
+            std::vector<size_t> First;
+            std::vector<float> X;
+            std::vector<float> Y;
+            std::vector<float> Z;
+            std::vector<float> Residual;
+            std::vector<unsigned short> Flags;
+            std::vector<int> IDIndex;           // Into IDs
+            std::vector<Core::cUID> IDs;
+            double FrameRate = 0;
+
+            int FrameCount() const { return (int) FrameIDs.size(); }
+
+            void EndFrame( int frameID, double time )
+            {
+                FrameIDs.push_back( frameID );
+                Times.push_back( time );
+                First.push_back( X.size() );
+            }
+
+            void AddMarker( float x, float y, float z, float residual, unsigned short flags, int id )
+            {
+                X.push_back( x );
+                Y.push_back( y );
+                Z.push_back( z );
+                Residual.push_back( residual );
+                Flags.push_back( flags );
+                IDIndex.push_back( id );
+            }
+        };
+
+        /// <summary>Reconstructed markers of a take export: "Marker" columns, not the solved asset marker positions.</summary>
+        bool LoadTakeCsv( const char* path, sSimTake& take, std::string& error )
+        {
+            cTakeCsv csv;
+            if( !csv.Load( path ) )
+            {
+                error = csv.Error();
+                return false;
+            }
+
+            const float scale = (float) TakeMetersPerUnit( csv.LengthUnits() );
+            std::vector<const sTakeTrajectory*> markers;
+            for( int m = 0; m < csv.MarkerCount(); ++m )
+            {
+                const sTakeTrajectory& trajectory = csv.Marker( m );
+                if( trajectory.Type == "Marker" )
+                {
+                    markers.push_back( &trajectory );
+                    take.IDs.push_back( trajectory.UID );
+                }
+            }
+
+            take.First.push_back( 0 );
+            for( int row = 0; row < csv.RowCount(); ++row )
+            {
+                for( int m = 0; m < (int) markers.size(); ++m )
+                {
+                    const Core::cVector3f& p = markers[m]->Positions[row];
+                    if( std::isnan( p.X() ) )
+                    {
+                        continue;
+                    }
+                    const unsigned short flags = ( markers[m]->Name.compare( 0, 9, "Unlabeled" ) == 0 ? Core::Unlabeled : 0 );
+                    take.AddMarker( p.X() * scale, p.Y() * scale, p.Z() * scale, 0.0f, flags, m );
+                }
+                take.EndFrame( (int) ( csv.CaptureStartFrame() + csv.FrameNumbers()[row] ), csv.Times()[row] );
+            }
+            take.FrameRate = csv.CaptureFrameRate();
+            return true;
+        }
+
+        /// <summary>A recording is replayed as is: positions in meters, as the API returned them or takeconvert scaled them.</summary>
+        bool LoadRecording( const char* path, sSimTake& take, std::string& error )
+        {
+            cRecordingReader reader;
+            if( !reader.Open( path ) )
+            {
+                error = reader.Error();
+                return false;
+            }
+
+            // Slots can change markers from one chunk to the next, so each chunk maps its slots into IDs.
+            take.First.push_back( 0 );
+            std::vector<unsigned char> buffer;
+            std::vector<int> idIndex;
+            std::map<std::pair<unsigned long long, unsigned long long>, int> known;
+            for( int c = 0; c < reader.ChunkCount(); ++c )
+            {
+                const cRecordingChunk chunk = reader.Chunk( c, buffer );
+                const sColumnView<double> times = chunk.TimeStamp();
+                const sColumnView<int32_t> frameIDs = chunk.FrameID();
+
+                idIndex.assign( chunk.MarkerSlots(), -1 );
+                for( int slot = 0; slot < chunk.MarkerSlots(); ++slot )
+                {
+                    const Core::cUID id = chunk.MarkerID( slot );
+                    if( id.HighBits() == 0 && id.LowBits() == 0 )
+                    {
+                        continue;
+                    }
+                    const std::pair<std::map<std::pair<unsigned long long, unsigned long long>, int>::iterator, bool> added =
+                        known.insert( std::make_pair( std::make_pair( id.HighBits(), id.LowBits() ), (int) take.IDs.size() ) );
+                    if( added.second )
+                    {
+                        take.IDs.push_back( id );
+                    }
+                    idIndex[slot] = added.first->second;
+                }
+
+                for( int f = 0; f < chunk.FrameCount(); ++f )
+                {
+                    for( int slot = 0; slot < chunk.MarkerSlots(); ++slot )
+                    {
+                        const float x = chunk.X( slot )[f];
+                        if( std::isnan( x ) )
+                        {
+                            continue;
+                        }
+                        take.AddMarker( x, chunk.Y( slot )[f], chunk.Z( slot )[f], chunk.Residual( slot )[f], chunk.Flags( slot )[f], idIndex[slot] );
+                    }
+                    take.EndFrame( frameIDs[f], times[f] );
+                }
+            }
+            return true;
+        }
+
+        bool LoadTake( const char* path, sSimTake& take, std::string& error )
+        {
+            // The recording header is checked first; anything that is not a recording is read as CSV.
+            if( !LoadRecording( path, take, error ) )
+            {
+                take = sSimTake();
+                if( !LoadTakeCsv( path, take, error ) )
+                {
+                    return false;
+                }
+            }
+            if( take.FrameCount() == 0 )
+            {
+                error = "the take has no frames";
+                return false;
+            }
+            if( take.FrameRate <= 0 )
+            {
+                const double span = take.Times.back() - take.Times.front();
+                take.FrameRate = ( take.FrameCount() > 1 && span > 0 ? ( take.FrameCount() - 1 ) / span : 120.0 );
+            }
+            return true;
+        }
+
+        // Simulator state. The take is immutable while the replay thread runs; the frame accessors are called
+        // from the thread that calls Update(), as with the real API.
+        sMotiveSimConfig sConfig;
+        bool sConfigured = false;
+        std::string sError;
+        std::unique_ptr<sSimTake> sTake;
+        bool sInitialized = false;
+
+        std::thread sReplay;
+        std::atomic<bool> sReplaying{ false };
+        std::mutex sListenerLock;                       // Held while notifying, so DetachListener() waits out a callback
+        cAPIListener* sListener = nullptr;
+        std::atomic<bool> sAttached{ false };
+
+        // Frames are numbered in delivery order across laps: n is frame n % FrameCount() of lap n / FrameCount().
+        std::atomic<unsigned long long> sPublished{ 0 };    // Frames delivered
+        std::atomic<unsigned long long> sConsumed{ 0 };     // Frames taken or flushed
+        long long sCurrent = -1;                            // Number of the current frame, -1 before the first Update()
+
+        std::atomic<unsigned long long> sUpdated{ 0 };
+        std::atomic<unsigned long long> sSkipped{ 0 };
+        std::atomic<unsigned long long> sFlushed{ 0 };
+        std::atomic<long long> sMaxLateNs{ 0 };
+        std::atomic<bool> sFinished{ false };
+
+        sMotiveSimConfig ConfigFromEnvironment()
+        {
+            sMotiveSimConfig config;
+            if( const char* take = getenv( "MOTIVE_SIM_TAKE" ) )
+            {
+                config.TakePath = take;
+            }
+            if( const char* speed = getenv( "MOTIVE_SIM_SPEED" ) )
+            {
+                config.Speed = ( strcmp( speed, "max" ) == 0 ? 0.0 : std::max( 0.0, atof( speed ) ) );
+            }
+            if( const char* loop = getenv( "MOTIVE_SIM_LOOP" ) )
+            {
+                config.Loop = atoi( loop ) != 0;
+            }
+            return config;
+        }
+
+        /// <summary>Sleep to within SpinUs of the deadline, then spin on the clock.</summary>
+        void WaitUntil( long long dueNs )
+        {
+            const long long spinNs = sConfig.SpinUs * 1000LL;
+            long long now = HostTimeNs();
+            if( dueNs - now > spinNs )
+            {
+                std::this_thread::sleep_for( std::chrono::nanoseconds( dueNs - now - spinNs ) );
+            }
+            while( HostTimeNs() < dueNs && sReplaying.load( std::memory_order_relaxed ) )
+            {
+            }
+        }
+
+        void Notify()
+        {
+            std::lock_guard<std::mutex> lock( sListenerLock );
+            if( sListener )
+            {
+                sListener->FrameAvailable();
+            }
+        }
+
+        void ReplayLoop()
+        {
+            const sSimTake& take = *sTake;
+            const int frames = take.FrameCount();
+            const double lapSeconds = take.Times.back() - take.Times.front() + 1.0 / take.FrameRate;
+
+            // The take starts when the first listener is attached, so nothing is replayed into the void.
+            while( !sAttached.load( std::memory_order_acquire ) )
+            {
+                if( !sReplaying.load( std::memory_order_acquire ) )
+                {
+                    return;
+                }
+                std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            }
+
+            const long long startNs = HostTimeNs();
+            for( unsigned long long n = 0; sReplaying.load( std::memory_order_acquire ); ++n )
+            {
+                const int frame = (int) ( n % frames );
+                const unsigned long long lap = n / frames;
+                if( lap > 0 && !sConfig.Loop )
+                {
+                    sFinished.store( true, std::memory_order_release );
+                    return;
+                }
+
+                if( sConfig.Speed > 0 )
+                {
+                    const double seconds = ( take.Times[frame] - take.Times.front() + lap * lapSeconds ) / sConfig.Speed;
+                    const long long dueNs = startNs + (long long) ( seconds * 1e9 );
+                    WaitUntil( dueNs );
+                    const long long lateNs = HostTimeNs() - dueNs;
+                    if( lateNs > sMaxLateNs.load( std::memory_order_relaxed ) )
+                    {
+                        sMaxLateNs.store( lateNs, std::memory_order_relaxed );
+                    }
+                }
+                else
+                {
+                    // Max speed: one frame in flight, the next goes out as soon as Update() has taken it.
+                    while( sConsumed.load( std::memory_order_acquire ) < n && sReplaying.load( std::memory_order_relaxed ) )
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+
+                sPublished.store( n + 1, std::memory_order_release );
+                Notify();
+            }
+        }
+
+        void StopReplay()
+        {
+            if( sReplaying.exchange( false ) )
+            {
+                sReplay.join();
+            }
+        }
+
+        int CurrentFrame()
+        {
+            return ( sCurrent < 0 ? -1 : (int) ( sCurrent % sTake->FrameCount() ) );
+        }
+
+        /// <summary>Index of a marker of the current frame in the take's marker arrays, or -1.</summary>
+        long long MarkerSlot( int markerIndex )
+        {
+            const int frame = CurrentFrame();
+            if( frame < 0 || markerIndex < 0 )
+            {
+                return -1;
+            }
+            const size_t slot = sTake->First[frame] + markerIndex;
+            return ( slot < sTake->First[frame + 1] ? (long long) slot : -1 );
+        }
+
+        // A return or exit() without Shutdown() does not destroy a running thread.
+        struct sStopAtExit
+        {
+            ~sStopAtExit() { StopReplay(); }
+        } sStopAtExit;
+    }
+
+    void ConfigureMotiveSim( const sMotiveSimConfig& config )
+    {
+        sConfig = config;
+        sConfigured = true;
+    }
+
+    const std::string& MotiveSimError()
+    {
+        return sError;
+    }
+
+    sMotiveSimStats MotiveSimStats()
+    {
+        sMotiveSimStats stats;
+        stats.Delivered = sPublished.load( std::memory_order_acquire );
+        stats.Updated = sUpdated.load( std::memory_order_relaxed );
+        stats.Skipped = sSkipped.load( std::memory_order_relaxed );
+        stats.Flushed = sFlushed.load( std::memory_order_relaxed );
+        stats.MaxLateNs = sMaxLateNs.load( std::memory_order_relaxed );
+        stats.Laps = ( sTake && stats.Delivered > 0 ? (int) ( ( stats.Delivered - 1 ) / sTake->FrameCount() ) : 0 );
+        stats.Finished = sFinished.load( std::memory_order_acquire );
+        return stats;
+    }
+
+    int MotiveSimFrameCount()
+    {
+        return ( sTake ? sTake->FrameCount() : 0 );
+    }
+
+    double MotiveSimFrameRate()
+    {
+        return ( sTake ? sTake->FrameRate : 0.0 );
+    }
+}
+
+using namespace Capture;
+
+namespace MotiveAPI
+{
+    // Startup / Shutdown ==================================================================================
+
+    eResult LoadLicenseFromMemory( const unsigned char* /*buffer*/, int /*bufferSize*/ )
+    {
+        return kApiResult_Success;
+    }
+
+    eResult Initialize()
+    {
+        if( sInitialized )
+        {
+            return kApiResult_Success;
+        }
+        if( !sConfigured )
+        {
+            sConfig = ConfigFromEnvironment();
+        }
+        if( sConfig.TakePath.empty() )
+        {
+            sError = "no take: call ConfigureMotiveSim() or set MOTIVE_SIM_TAKE";
+            return kApiResult_FileNotFound;
+        }
+
+        std::unique_ptr<sSimTake> take( new sSimTake() );
+        sError.clear();
+        if( !LoadTake( sConfig.TakePath.c_str(), *take, sError ) )
+        {
+            sError = sConfig.TakePath + ": " + sError;
+            return kApiResult_LoadFailed;
+        }
+        sTake = std::move( take );
+
+        sPublished.store( 0 );
+        sConsumed.store( 0 );
+        sCurrent = -1;
+        sUpdated.store( 0 );
+        sSkipped.store( 0 );
+        sFlushed.store( 0 );
+        sMaxLateNs.store( 0 );
+        sFinished.store( false );
+        sAttached.store( false );   // Wait for this session's listener, not the last one's
+
+        sReplaying.store( true, std::memory_order_release );
+        sReplay = std::thread( &ReplayLoop );
+        sInitialized = true;
+        return kApiResult_Success;
+    }
+
+    bool IsInitialized()
+    {
+        return sInitialized;
+    }
+
+    void Shutdown()
+    {
+        StopReplay();
+        sInitialized = false;
+    }
+
+    bool CanConnectToDevices()
+    {
+        return true;
+    }
+
+    int BuildNumber()
+    {
+        return 0;
+    }
+
+    // Profile and calibration: there are no cameras, so there is nothing to load or save ==================
+
+    eResult LoadProfile( const wchar_t* /*filename*/ )
+    {
+        return kApiResult_Success;
+    }
+
+    eResult SaveProfile( const wchar_t* /*filename*/ )
+    {
+        return kApiResult_SaveFailed;
+    }
+
+    eResult LoadCalibration( const wchar_t* /*filename*/, int* cameraCount )
+    {
+        if( cameraCount )
+        {
+            *cameraCount = 0;
+        }
+        return kApiResult_Success;
+    }
+
+    eResult SaveCalibration( const wchar_t* /*filename*/ )
+    {
+        return kApiResult_SaveFailed;
+    }
+
+    eCalibrationState CalibrationState()
+    {
+        return Complete;
+    }
+
+    std::vector<int> CalibrationCamerasLackingSamples()
+    {
+        return std::vector<int>();
+    }
+
+    int CameraCalibrationSamples( int /*cameraIndex*/ )
+    {
+        return 0;
+    }
+
+    int CurrentCalibrationQuality()
+    {
+        return 0;
+    }
+
+    int CameraCount()
+    {
+        return 0;
+    }
+
+    int CameraID( int /*cameraIndex*/ )
+    {
+        return 0;
+    }
+
+    int CameraSystemFrameRate()
+    {
+        return ( sTake ? (int) std::lround( sTake->FrameRate ) : 0 );
+    }
+
+    // Frame Processing ====================================================================================
+
+    eResult Update()
+    {
+        const unsigned long long published = sPublished.load( std::memory_order_acquire );
+        const unsigned long long consumed = sConsumed.load( std::memory_order_relaxed );
+        if( published == consumed )
+        {
+            return kApiResult_NoFrameAvailable;
+        }
+        sSkipped.fetch_add( published - consumed - 1, std::memory_order_relaxed );
+        sUpdated.fetch_add( 1, std::memory_order_relaxed );
+        sCurrent = (long long) published - 1;
+        sConsumed.store( published, std::memory_order_release );
+        return kApiResult_Success;
+    }
+
+    eResult UpdateSingleFrame()
+    {
+        const unsigned long long consumed = sConsumed.load( std::memory_order_relaxed );
+        if( sPublished.load( std::memory_order_acquire ) == consumed )
+        {
+            return kApiResult_NoFrameAvailable;
+        }
+        sUpdated.fetch_add( 1, std::memory_order_relaxed );
+        sCurrent = (long long) consumed;
+        sConsumed.store( consumed + 1, std::memory_order_release );
+        return kApiResult_Success;
+    }
+
+    void FlushCameraQueues()
+    {
+        const unsigned long long published = sPublished.load( std::memory_order_acquire );
+        sFlushed.fetch_add( published - sConsumed.load( std::memory_order_relaxed ), std::memory_order_relaxed );
+        sConsumed.store( published, std::memory_order_release );
+    }
+
+    // Frame Info ==========================================================================================
+
+    // Frame IDs and timestamps keep counting up across laps, as they would from live cameras.
+    int FrameID()
+    {
+        const int frame = CurrentFrame();
+        if( frame < 0 )
+        {
+            return 0;
+        }
+        const long long lap = sCurrent / sTake->FrameCount();
+        const long long lapFrames = (long long) sTake->FrameIDs.back() - sTake->FrameIDs.front() + 1;
+        return (int) ( sTake->FrameIDs[frame] + lap * lapFrames );
+    }
+
+    double FrameTimeStamp()
+    {
+        const int frame = CurrentFrame();
+        if( frame < 0 )
+        {
+            return 0.0;
+        }
+        const long long lap = sCurrent / sTake->FrameCount();
+        const double lapSeconds = sTake->Times.back() - sTake->Times.front() + 1.0 / sTake->FrameRate;
+        return sTake->Times[frame] + lap * lapSeconds;
+    }
+
+    bool FrameTimeCode( sTimecode& /*tc*/ )
+    {
+        return false;
+    }
+
+    // Marker Interface ====================================================================================
+
+    int MarkerCount()
+    {
+        const int frame = CurrentFrame();
+        return ( frame < 0 ? 0 : (int) ( sTake->First[frame + 1] - sTake->First[frame] ) );
+    }
+
+    float MarkerAverageSize()
+    {
+        return 0.0f;
+    }
+
+    bool Marker( int markerIndex, Core::cMarker& marker )
+    {
+        const long long slot = MarkerSlot( markerIndex );
+        if( slot < 0 )
+        {
+            return false;
+        }
+        marker.SetPosition( sTake->X[slot], sTake->Y[slot], sTake->Z[slot] );
+        marker.ID = sTake->IDs[sTake->IDIndex[slot]];
+        marker.Residual = sTake->Residual[slot];
+        marker.Flags = sTake->Flags[slot];
+        return true;
+    }
+
+    bool MarkerXYZ( int markerIndex, float& x, float& y, float& z )
+    {
+        const long long slot = MarkerSlot( markerIndex );
+        if( slot < 0 )
+        {
+            return false;
+        }
+        x = sTake->X[slot];
+        y = sTake->Y[slot];
+        z = sTake->Z[slot];
+        return true;
+    }
+
+    Core::cUID MarkerID( int markerIndex )
+    {
+        const long long slot = MarkerSlot( markerIndex );
+        return ( slot < 0 ? Core::cUID::kInvalid : sTake->IDs[sTake->IDIndex[slot]] );
+    }
+
+    float MarkerResidual( int markerIndex )
+    {
+        const long long slot = MarkerSlot( markerIndex );
+        return ( slot < 0 ? 0.0f : sTake->Residual[slot] );
+    }
+
+    // A take keeps no rays.
+    int MarkerContributingRaysCount( int /*markerIndex*/ )
+    {
+        return 0;
+    }
+
+    float MarkerAverageRayLength( int /*markerIndex*/ )
+    {
+        return 0.0f;
+    }
+
+    bool MarkerCameraCentroid( int /*markerIndex*/, int /*cameraIndex*/, float& /*x*/, float& /*y*/ )
+    {
+        return false;
+    }
+
+    // Rigid Body Interface: markers only ==================================================================
+
+    int RigidBodyCount()
+    {
+        return 0;
+    }
+
+    bool RigidBodyTransform( int /*rbIndex*/, float* /*x*/, float* /*y*/, float* /*z*/, float* /*qx*/, float* /*qy*/, float* /*qz*/,
+        float* /*qw*/, float* /*yaw*/, float* /*pitch*/, float* /*roll*/ )
+    {
+        return false;
+    }
+
+    // Listener ============================================================================================
+
+    void AttachListener( cAPIListener* listener )
+    {
+        {
+            std::lock_guard<std::mutex> lock( sListenerLock );
+            sListener = listener;
+        }
+        if( listener )
+        {
+            sAttached.store( true, std::memory_order_release );
+        }
+    }
+
+    void DetachListener()
+    {
+        std::lock_guard<std::mutex> lock( sListenerLock );
+        sListener = nullptr;
+    }
+}
@@ -0,0 +1,48 @@
+//======================================================================================================
+// Motive API simulator: replays a recorded take through the MotiveAPI.h frame and marker functions
+//======================================================================================================
+#pragma once
+
+#include <string>
+
+namespace Capture
+{
+    struct sMotiveSimConfig
+    {
+        std::string TakePath;   // Motive take CSV export, or a cRecordingWriter recording
+        double Speed = 1.0;     // Multiple of the recorded rate; 0 = as fast as Update() takes the frames
+        bool Loop = false;      // Start over at the end of the take instead of going quiet
+        int SpinUs = 200;       // Sleep until this close to a frame's due time, then spin, for delivery jitter
+                                // of a few microseconds rather than the scheduler's tick
+    };
+
+    struct sMotiveSimStats
+    {
+        unsigned long long Delivered;   // FrameAvailable() calls
+        unsigned long long Updated;     // Frames made current by Update() or UpdateSingleFrame()
+        unsigned long long Skipped;     // Delivered frames superseded before any Update() saw them
+        unsigned long long Flushed;     // Delivered frames discarded by FlushCameraQueues()
+        long long MaxLateNs;            // Worst delivery after a frame's due time, paced replay only
+        int Laps;                       // Completed passes through the take
+        bool Finished;                  // The take has been delivered and Loop is off
+    };
+
+    /// <summary>
+    /// Set the take and replay speed used by the next MotiveAPI::Initialize(). Without a call, Initialize() reads
+    /// MOTIVE_SIM_TAKE (path), MOTIVE_SIM_SPEED (a factor, or "max") and MOTIVE_SIM_LOOP (1 to loop) from the
+    /// environment, so programs written against the real API run unchanged.
+    /// </summary>
+    void ConfigureMotiveSim( const sMotiveSimConfig& config );
+
+    /// <summary>Why the last Initialize() failed to load its take, or empty.</summary>
+    const std::string& MotiveSimError();
+
+    sMotiveSimStats MotiveSimStats();
+
+    /// <summary>
+    /// Frames in the loaded take, and its rate in frames per second (the recorded capture rate, or the
+    /// rate implied by the timestamps when the take has none).
+    /// </summary>
+    int MotiveSimFrameCount();
+    double MotiveSimFrameRate();
+}
@@ -0,0 +1,215 @@
+//======================================================================================================
+// SIMD packs: the register types the batch kernels are written against, one lane width per struct
+//======================================================================================================
+//
+// A pack P provides: S (scalar type), V (register), M (lane mask), kLanes, and the static functions
+// Load, Store, Splat, Add, Sub, Mul, Div, Sqrt, Abs, Min, Max, Greater, Less and Select( mask, a, b ).
+//
+// sScalarPack and sSse2Pack are always available (SSE2 on x86 only). sAvxPack and sAvx512Pack only
+// exist in translation units built with that code generation (/arch:AVX, -mavx; /arch:AVX512,
+// -mavx512f), and those units are only entered after ActiveSimdLevel() has confirmed support.
+//
+// Everything sits in an anonymous namespace on purpose: each translation unit keeps its own copies of
+// the packs and of the kernel templates instantiated with them, so the linker can never substitute an
+// AVX-compiled instance into code that runs on CPUs without AVX.
+//
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "cpufeatures.h"
+
+#ifdef CAPTURE_X86
+#include <emmintrin.h>
+#if defined(__AVX__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#endif
+
+namespace Capture
+{
+    namespace
+    {
+        /// <summary>One lane: plain scalar code, also used for the tail of every vector loop.</summary>
+        template<typename T>
+        struct sScalarPack
+        {
+            using S = T;
+            using V = T;
+            using M = bool;
+            static constexpr size_t kLanes = 1;
+
+            static V Load( const S* p ) { return *p; }
+            static void Store( S* p, V v ) { *p = v; }
+            static V Splat( S v ) { return v; }
+            static V Add( V a, V b ) { return a + b; }
+            static V Sub( V a, V b ) { return a - b; }
+            static V Mul( V a, V b ) { return a * b; }
+            static V Div( V a, V b ) { return a / b; }
+            static V Sqrt( V a ) { return std::sqrt( a ); }
+            static V Abs( V a ) { return std::fabs( a ); }
+            static V Min( V a, V b ) { return b < a ? b : a; }
+            static V Max( V a, V b ) { return a < b ? b : a; }
+            static M Greater( V a, V b ) { return a > b; }
+            static M Less( V a, V b ) { return a < b; }
+            static V Select( M mask, V a, V b ) { return mask ? a : b; }
+        };
+
+#ifdef CAPTURE_X86
+        template<typename T> struct sSse2Pack;
+
+        template<>
+        struct sSse2Pack<float>
+        {
+            using S = float;
+            using V = __m128;
+            using M = __m128;
+            static constexpr size_t kLanes = 4;
+
+            static V Load( const S* p ) { return _mm_loadu_ps( p ); }
+            static void Store( S* p, V v ) { _mm_storeu_ps( p, v ); }
+            static V Splat( S v ) { return _mm_set1_ps( v ); }
+            static V Add( V a, V b ) { return _mm_add_ps( a, b ); }
+            static V Sub( V a, V b ) { return _mm_sub_ps( a, b ); }
+            static V Mul( V a, V b ) { return _mm_mul_ps( a, b ); }
+            static V Div( V a, V b ) { return _mm_div_ps( a, b ); }
+            static V Sqrt( V a ) { return _mm_sqrt_ps( a ); }
+            static V Abs( V a ) { return _mm_andnot_ps( _mm_set1_ps( -0.0f ), a ); }
+            static V Min( V a, V b ) { return _mm_min_ps( a, b ); }
+            static V Max( V a, V b ) { return _mm_max_ps( a, b ); }
+            static M Greater( V a, V b ) { return _mm_cmpgt_ps( a, b ); }
+            static M Less( V a, V b ) { return _mm_cmplt_ps( a, b ); }
+            static V Select( M mask, V a, V b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+        };
+
+        template<>
+        struct sSse2Pack<double>
+        {
+            using S = double;
+            using V = __m128d;
+            using M = __m128d;
+            static constexpr size_t kLanes = 2;
+
+            static V Load( const S* p ) { return _mm_loadu_pd( p ); }
+            static void Store( S* p, V v ) { _mm_storeu_pd( p, v ); }
+            static V Splat( S v ) { return _mm_set1_pd( v ); }
+            static V Add( V a, V b ) { return _mm_add_pd( a, b ); }
+            static V Sub( V a, V b ) { return _mm_sub_pd( a, b ); }
+            static V Mul( V a, V b ) { return _mm_mul_pd( a, b ); }
+            static V Div( V a, V b ) { return _mm_div_pd( a, b ); }
+            static V Sqrt( V a ) { return _mm_sqrt_pd( a ); }
+            static V Abs( V a ) { return _mm_andnot_pd( _mm_set1_pd( -0.0 ), a ); }
+            static V Min( V a, V b ) { return _mm_min_pd( a, b ); }
+            static V Max( V a, V b ) { return _mm_max_pd( a, b ); }
+            static M Greater( V a, V b ) { return _mm_cmpgt_pd( a, b ); }
+            static M Less( V a, V b ) { return _mm_cmplt_pd( a, b ); }
+            static V Select( M mask, V a, V b ) { return _mm_or_pd( _mm_and_pd( mask, a ), _mm_andnot_pd( mask, b ) ); }
+        };
+#endif
+
+#if defined(CAPTURE_X86) && defined(__AVX__)
+        template<typename T> struct sAvxPack;
+
+        template<>
+        struct sAvxPack<float>
+        {
+            using S = float;
+            using V = __m256;
+            using M = __m256;
+            static constexpr size_t kLanes = 8;
+
+            static V Load( const S* p ) { return _mm256_loadu_ps( p ); }
+            static void Store( S* p, V v ) { _mm256_storeu_ps( p, v ); }
+            static V Splat( S v ) { return _mm256_set1_ps( v ); }
+            static V Add( V a, V b ) { return _mm256_add_ps( a, b ); }
+            static V Sub( V a, V b ) { return _mm256_sub_ps( a, b ); }
+            static V Mul( V a, V b ) { return _mm256_mul_ps( a, b ); }
+            static V Div( V a, V b ) { return _mm256_div_ps( a, b ); }
+            static V Sqrt( V a ) { return _mm256_sqrt_ps( a ); }
+            static V Abs( V a ) { return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), a ); }
+            static V Min( V a, V b ) { return _mm256_min_ps( a, b ); }
+            static V Max( V a, V b ) { return _mm256_max_ps( a, b ); }
+            static M Greater( V a, V b ) { return _mm256_cmp_ps( a, b, _CMP_GT_OQ ); }
+            static M Less( V a, V b ) { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+            static V Select( M mask, V a, V b ) { return _mm256_blendv_ps( b, a, mask ); }
+        };
+
+        template<>
+        struct sAvxPack<double>
+        {
+            using S = double;
+            using V = __m256d;
+            using M = __m256d;
+            static constexpr size_t kLanes = 4;
+
+            static V Load( const S* p ) { return _mm256_loadu_pd( p ); }
+            static void Store( S* p, V v ) { _mm256_storeu_pd( p, v ); }
+            static V Splat( S v ) { return _mm256_set1_pd( v ); }
+            static V Add( V a, V b ) { return _mm256_add_pd( a, b ); }
+            static V Sub( V a, V b ) { return _mm256_sub_pd( a, b ); }
+            static V Mul( V a, V b ) { return _mm256_mul_pd( a, b ); }
+            static V Div( V a, V b ) { return _mm256_div_pd( a, b ); }
+            static V Sqrt( V a ) { return _mm256_sqrt_pd( a ); }
+            static V Abs( V a ) { return _mm256_andnot_pd( _mm256_set1_pd( -0.0 ), a ); }
+            static V Min( V a, V b ) { return _mm256_min_pd( a, b ); }
+            static V Max( V a, V b ) { return _mm256_max_pd( a, b ); }
+            static M Greater( V a, V b ) { return _mm256_cmp_pd( a, b, _CMP_GT_OQ ); }
+            static M Less( V a, V b ) { return _mm256_cmp_pd( a, b, _CMP_LT_OQ ); }
+            static V Select( M mask, V a, V b ) { return _mm256_blendv_pd( b, a, mask ); }
+        };
+#endif
+
+#if defined(CAPTURE_X86) && defined(__AVX512F__)
+        template<typename T> struct sAvx512Pack;
+
+        template<>
+        struct sAvx512Pack<float>
+        {
+            using S = float;
+            using V = __m512;
+            using M = __mmask16;
+            static constexpr size_t kLanes = 16;
+
+            static V Load( const S* p ) { return _mm512_loadu_ps( p ); }
+            static void Store( S* p, V v ) { _mm512_storeu_ps( p, v ); }
+            static V Splat( S v ) { return _mm512_set1_ps( v ); }
+            static V Add( V a, V b ) { return _mm512_add_ps( a, b ); }
+            static V Sub( V a, V b ) { return _mm512_sub_ps( a, b ); }
+            static V Mul( V a, V b ) { return _mm512_mul_ps( a, b ); }
+            static V Div( V a, V b ) { return _mm512_div_ps( a, b ); }
+            static V Sqrt( V a ) { return _mm512_sqrt_ps( a ); }
+            static V Abs( V a ) { return _mm512_abs_ps( a ); }
+            static V Min( V a, V b ) { return _mm512_min_ps( a, b ); }
+            static V Max( V a, V b ) { return _mm512_max_ps( a, b ); }
+            static M Greater( V a, V b ) { return _mm512_cmp_ps_mask( a, b, _CMP_GT_OQ ); }
+            static M Less( V a, V b ) { return _mm512_cmp_ps_mask( a, b, _CMP_LT_OQ ); }
+            static V Select( M mask, V a, V b ) { return _mm512_mask_blend_ps( mask, b, a ); }
+        };
+
+        template<>
+        struct sAvx512Pack<double>
+        {
+            using S = double;
+            using V = __m512d;
+            using M = __mmask8;
+            static constexpr size_t kLanes = 8;
+
+            static V Load( const S* p ) { return _mm512_loadu_pd( p ); }
+            static void Store( S* p, V v ) { _mm512_storeu_pd( p, v ); }
+            static V Splat( S v ) { return _mm512_set1_pd( v ); }
+            static V Add( V a, V b ) { return _mm512_add_pd( a, b ); }
+            static V Sub( V a, V b ) { return _mm512_sub_pd( a, b ); }
+            static V Mul( V a, V b ) { return _mm512_mul_pd( a, b ); }
+            static V Div( V a, V b ) { return _mm512_div_pd( a, b ); }
+            static V Sqrt( V a ) { return _mm512_sqrt_pd( a ); }
+            static V Abs( V a ) { return _mm512_abs_pd( a ); }
+            static V Min( V a, V b ) { return _mm512_min_pd( a, b ); }
+            static V Max( V a, V b ) { return _mm512_max_pd( a, b ); }
+            static M Greater( V a, V b ) { return _mm512_cmp_pd_mask( a, b, _CMP_GT_OQ ); }
+            static M Less( V a, V b ) { return _mm512_cmp_pd_mask( a, b, _CMP_LT_OQ ); }
+            static V Select( M mask, V a, V b ) { return _mm512_mask_blend_pd( mask, b, a ); }
+        };
+#endif
+    }
+}
@@ -0,0 +1,138 @@
+//======================================================================================================
+// Single-producer / single-consumer ring buffer used to hand frames between capture threads
+//======================================================================================================
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace Capture
+{
+    /// <summary>Size used to keep producer and consumer indices on separate cache lines.</summary>
+    constexpr size_t kCacheLineSize = 64;
+
+    /// <summary>
+    /// A fixed-capacity, lock-free ring buffer for exactly one producer thread and one consumer thread.
+    /// All storage is allocated once in the constructor; pushing and popping never allocate or block.
+    /// When the ring is full, TryPush() fails and the caller decides whether to drop the item.
+    /// </summary>
+    template<typename T>
+    class cSpscRing
+    {
+    public:
+        /// <summary>Capacity is rounded up to the next power of two.</summary>
+        explicit cSpscRing( size_t capacity )
+        {
+            mCapacity = 1;
+            while( mCapacity < capacity )
+            {
+                mCapacity <<= 1;
+            }
+            mMask = mCapacity - 1;
+            mSlots.reset( new T[mCapacity] );
+        }
+
+        cSpscRing( const cSpscRing& ) = delete;
+        cSpscRing& operator=( const cSpscRing& ) = delete;
+
+        size_t Capacity() const { return mCapacity; }
+
+        /// <summary>Number of items currently queued. Only approximate while both threads are running.</summary>
+        size_t Size() const
+        {
+            return size_t( mHead.load( std::memory_order_acquire ) - mTail.load( std::memory_order_acquire ) );
+        }
+
+        bool Empty() const { return Size() == 0; }
+
+        //====================================================================================
+        // Producer side
+        //====================================================================================
+
+        /// <summary>Returns the slot that the next Publish() will make visible, or nullptr if the ring is full.
+        /// Lets the producer fill large items in place rather than copying them in.</summary>
+        T* BeginWrite()
+        {
+            const size_t head = mHead.load( std::memory_order_relaxed );
+            if( head - mCachedTail >= mCapacity )
+            {
+                mCachedTail = mTail.load( std::memory_order_acquire );
+                if( head - mCachedTail >= mCapacity )
+                {
+                    return nullptr;
+                }
+            }
+            return &mSlots[head & mMask];
+        }
+
+        /// <summary>Makes the slot returned by BeginWrite() visible to the consumer.</summary>
+        void Publish()
+        {
+            mHead.store( mHead.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+
+        bool TryPush( const T& item )
+        {
+            T* slot = BeginWrite();
+            if( slot == nullptr )
+            {
+                return false;
+            }
+            *slot = item;
+            Publish();
+            return true;
+        }
+
+        //====================================================================================
+        // Consumer side
+        //====================================================================================
+
+        /// <summary>Returns the oldest queued item, or nullptr if the ring is empty. The item stays valid
+        /// until Release() is called.</summary>
+        const T* BeginRead()
+        {
+            const size_t tail = mTail.load( std::memory_order_relaxed );
+            if( tail == mCachedHead )
+            {
+                mCachedHead = mHead.load( std::memory_order_acquire );
+                if( tail == mCachedHead )
+                {
+                    return nullptr;
+                }
+            }
+            return &mSlots[tail & mMask];
+        }
+
+        /// <summary>Hands the slot returned by BeginRead() back to the producer.</summary>
+        void Release()
+        {
+            mTail.store( mTail.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+        }
+
+        bool TryPop( T& item )
+        {
+            const T* slot = BeginRead();
+            if( slot == nullptr )
+            {
+                return false;
+            }
+            item = *slot;
+            Release();
+            return true;
+        }
+
+    private:
+        size_t mCapacity = 0;
+        size_t mMask = 0;
+        std::unique_ptr<T[]> mSlots;
+
+        // Producer-owned
+        alignas( kCacheLineSize ) std::atomic<size_t> mHead{ 0 };
+        size_t mCachedTail = 0;
+
+        // Consumer-owned
+        alignas( kCacheLineSize ) std::atomic<size_t> mTail{ 0 };
+        size_t mCachedHead = 0;
+    };
+}
@@ -0,0 +1,509 @@
+//======================================================================================================
+// Take CSV loader: memory-mapped, multithreaded reader for Motive take CSV exports
+//======================================================================================================
+#include "takecsv.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include "mappedfile.h"
+#include "numberparse.h"
+
+namespace Capture
+{
+    namespace
+    {
+        // Rows parsed row-major before being transposed into the column arrays, so each column receives
+        // a whole cache line or more per block instead of one scattered float per row.
+        constexpr int kBlockRows = 64;
+
+        // Below this many bytes per thread, splitting costs more than it saves.
+        constexpr size_t kMinBytesPerThread = 1 << 20;
+
+        const char* FindLineEnd( const char* p, const char* end )
+        {
+            const char* newline = (const char*) memchr( p, '\n', end - p );
+            return ( newline ? newline : end );
+        }
+
+        const char* NextLine( const char* p, const char* end )
+        {
+            const char* lineEnd = FindLineEnd( p, end );
+            return ( lineEnd < end ? lineEnd + 1 : end );
+        }
+
+        bool IsBlankLine( const char* p, const char* end )
+        {
+            return p >= end || *p == '\n' || *p == '\r';
+        }
+
+        /// <summary>Split one header line into fields, honouring double quotes. Advances past the line.</summary>
+        void SplitHeaderLine( const char*& cursor, const char* end, std::vector<std::string>& fields )
+        {
+            fields.clear();
+            std::string field;
+            bool quoted = false;
+            const char* p = cursor;
+
+            for( ; p < end; ++p )
+            {
+                const char c = *p;
+                if( quoted )
+                {
+                    if( c == '"' && p + 1 < end && p[1] == '"' )
+                    {
+                        field += '"';
+                        ++p;
+                    }
+                    else if( c == '"' )
+                    {
+                        quoted = false;
+                    }
+                    else
+                    {
+                        field += c;
+                    }
+                }
+                else if( c == '"' )
+                {
+                    quoted = true;
+                }
+                else if( c == ',' )
+                {
+                    fields.push_back( field );
+                    field.clear();
+                }
+                else if( c == '\n' )
+                {
+                    ++p;
+                    break;
+                }
+                else if( c != '\r' )
+                {
+                    field += c;
+                }
+            }
+            fields.push_back( field );
+            cursor = p;
+        }
+
+        const std::string& FieldOrEmpty( const std::vector<std::string>& fields, size_t index )
+        {
+            static const std::string sEmpty;
+            return ( index < fields.size() ? fields[index] : sEmpty );
+        }
+
+        template<typename Function>
+        void RunParallel( int threads, Function function )
+        {
+            std::vector<std::thread> workers;
+            for( int t = 1; t < threads; ++t )
+            {
+                workers.emplace_back( function, t );
+            }
+            function( 0 );
+            for( std::thread& worker : workers )
+            {
+                worker.join();
+            }
+        }
+    }
+
+    Core::cUID ParseTakeID( const std::string& id )
+    {
+        unsigned long long high = 0;
+        unsigned long long low = 0;
+
+        for( char c : id )
+        {
+            unsigned digit;
+            if( c >= '0' && c <= '9' )      digit = c - '0';
+            else if( c >= 'A' && c <= 'F' ) digit = c - 'A' + 10;
+            else if( c >= 'a' && c <= 'f' ) digit = c - 'a' + 10;
+            else if( c == '"' )             continue;
+            else                            return Core::cUID();
+
+            high = ( high << 4 ) | ( low >> 60 );
+            low = ( low << 4 ) | digit;
+        }
+        return Core::cUID( high, low );
+    }
+
+    const std::string& sTakeHeader::Get( const std::string& key ) const
+    {
+        static const std::string sEmpty;
+
+        for( const std::pair<std::string, std::string>& entry : Metadata )
+        {
+            if( entry.first == key )
+            {
+                return entry.second;
+            }
+        }
+        return sEmpty;
+    }
+
+    bool ParseTakeHeader( const char*& cursor, const char* end, sTakeHeader& header, std::string& error )
+    {
+        std::vector<std::string> fields;
+        header.Metadata.clear();
+        header.Columns.clear();
+
+        // First line: alternating key/value pairs.
+        SplitHeaderLine( cursor, end, fields );
+        if( fields.empty() || fields[0] != "Format Version" )
+        {
+            error = "not a Motive take CSV (missing Format Version)";
+            return false;
+        }
+        for( size_t i = 0; i + 1 < fields.size(); i += 2 )
+        {
+            header.Metadata.emplace_back( fields[i], fields[i + 1] );
+        }
+
+        // Descriptor rows, labelled in their second field, until the "Frame,Time (Seconds),..." axis row.
+        std::vector<std::string> typeRow, nameRow, idRow, categoryRow, axisRow;
+        while( cursor < end )
+        {
+            if( IsBlankLine( cursor, end ) )
+            {
+                cursor = NextLine( cursor, end );
+                continue;
+            }
+
+            SplitHeaderLine( cursor, end, fields );
+            if( fields[0] == "Frame" )
+            {
+                axisRow.swap( fields );
+                break;
+            }
+
+            const std::string& label = FieldOrEmpty( fields, 1 );
+            if( label == "Type" )       typeRow.swap( fields );
+            else if( label == "Name" )  nameRow.swap( fields );
+            else if( label == "ID" )    idRow.swap( fields );
+            else if( label.empty() )    categoryRow.swap( fields );
+        }
+
+        if( axisRow.size() < 2 )
+        {
+            error = "missing Frame/Time header row";
+            return false;
+        }
+
+        header.Columns.resize( axisRow.size() - 2 );
+        for( size_t c = 0; c < header.Columns.size(); ++c )
+        {
+            sTakeColumn& column = header.Columns[c];
+            column.Type = FieldOrEmpty( typeRow, c + 2 );
+            column.Name = FieldOrEmpty( nameRow, c + 2 );
+            column.ID = FieldOrEmpty( idRow, c + 2 );
+            column.Category = FieldOrEmpty( categoryRow, c + 2 );
+            column.Axis = FieldOrEmpty( axisRow, c + 2 );
+        }
+
+        return true;
+    }
+
+    bool ParseTakeRow( const char* p, const char* lineEnd, int columns, long long& frame, double& time, float* values )
+    {
+        const float missing = std::numeric_limits<float>::quiet_NaN();
+
+        bool ok = true;
+        frame = 0;
+        time = std::numeric_limits<double>::quiet_NaN();
+        ok = ParseInt( p, lineEnd, frame ) && ok;
+        if( p < lineEnd && *p == ',' )
+        {
+            ++p;
+            ok = ParseDouble( p, lineEnd, time ) && ok;
+        }
+
+        for( int c = 0; c < columns; ++c )
+        {
+            // Skip anything left of the previous field, then expect a separator.
+            while( p < lineEnd && *p != ',' && *p != '\r' )
+            {
+                ++p;
+            }
+            if( p >= lineEnd || *p != ',' )
+            {
+                // Short row: the rest of the columns are missing.
+                for( ; c < columns; ++c )
+                {
+                    values[c] = missing;
+                }
+                return false;
+            }
+            ++p;
+
+            // Motive leaves a field empty when the marker is occluded.
+            if( p >= lineEnd || *p == ',' || *p == '\r' )
+            {
+                values[c] = missing;
+            }
+            else if( !ParseFloat( p, lineEnd, values[c] ) )
+            {
+                values[c] = missing;
+                ok = false;
+            }
+        }
+
+        return ok;
+    }
+
+    double TakeMetersPerUnit( const std::string& units )
+    {
+        if( units == "Millimeters" )
+        {
+            return 0.001;
+        }
+        if( units == "Centimeters" )
+        {
+            return 0.01;
+        }
+        return 1.0;
+    }
+
+    std::vector<int> FindTakeMarkerColumns( const std::vector<sTakeColumn>& columns )
+    {
+        std::vector<int> markers;
+
+        for( int c = 0; c + 2 < (int) columns.size(); ++c )
+        {
+            const sTakeColumn& x = columns[c];
+            const sTakeColumn& y = columns[c + 1];
+            const sTakeColumn& z = columns[c + 2];
+
+            if( x.Category != "Position" || x.Axis != "X" || y.Axis != "Y" || z.Axis != "Z"
+                || y.ID != x.ID || z.ID != x.ID || x.Type.find( "Marker" ) == std::string::npos )
+            {
+                continue;
+            }
+
+            markers.push_back( c );
+            c += 2;
+        }
+        return markers;
+    }
+
+    const std::string& cTakeCsv::Metadata( const std::string& key ) const
+    {
+        return mHeader.Get( key );
+    }
+
+    bool cTakeCsv::Load( const char* path, const sTakeLoadOptions& options )
+    {
+        Reset();
+
+        // The mapping is only needed while parsing; everything is copied out into the columns.
+        cMappedFile file;
+        if( !file.Open( path ) )
+        {
+            mError = "cannot open file";
+            return false;
+        }
+        file.AdviseSequential();
+
+        const char* cursor = (const char*) file.Data();
+        const char* end = cursor + file.Size();
+
+        if( !ParseTakeHeader( cursor, end, mHeader, mError ) )
+        {
+            return false;
+        }
+
+        mCaptureFrameRate = atof( Metadata( "Capture Frame Rate" ).c_str() );
+        mExportFrameRate = atof( Metadata( "Export Frame Rate" ).c_str() );
+        mCaptureStartFrame = atoll( Metadata( "Capture Start Frame" ).c_str() );
+
+        int threads = options.Threads;
+        if( threads <= 0 )
+        {
+            threads = (int) std::thread::hardware_concurrency();
+        }
+        const size_t bodyBytes = (size_t) ( end - cursor );
+        threads = (int) std::min<size_t>( std::max( threads, 1 ), std::max<size_t>( bodyBytes / kMinBytesPerThread, 1 ) );
+
+        ParseBody( cursor, end, threads );
+
+        if( options.BuildTrajectories )
+        {
+            BuildTrajectories( threads );
+        }
+        return true;
+    }
+
+    void cTakeCsv::Reset()
+    {
+        mError.clear();
+        mHeader.Metadata.clear();
+        mHeader.Columns.clear();
+        mCaptureFrameRate = 0;
+        mExportFrameRate = 0;
+        mCaptureStartFrame = 0;
+        mRowCount = 0;
+        mFrames.clear();
+        mTimes.clear();
+        mValues.reset();
+        mTrajectories.clear();
+        mByID.clear();
+        mMalformedRows = 0;
+    }
+
+    void cTakeCsv::ParseBody( const char* begin, const char* end, int threads )
+    {
+        // Split at line starts so every thread owns whole rows.
+        std::vector<const char*> bounds( threads + 1 );
+        bounds[0] = begin;
+        bounds[threads] = end;
+        for( int t = 1; t < threads; ++t )
+        {
+            const char* split = begin + (size_t) ( end - begin ) * t / threads;
+            bounds[t] = std::max( bounds[t - 1], ( split > begin && split[-1] == '\n' ) ? split : NextLine( split, end ) );
+        }
+
+        // Pass 1: rows per range, so every thread knows where its rows land.
+        std::vector<int> rowsInRange( threads, 0 );
+        RunParallel( threads, [&]( int t )
+        {
+            int rows = 0;
+            for( const char* p = bounds[t]; p < bounds[t + 1]; p = NextLine( p, bounds[t + 1] ) )
+            {
+                rows += ( IsBlankLine( p, bounds[t + 1] ) ? 0 : 1 );
+            }
+            rowsInRange[t] = rows;
+        } );
+
+        std::vector<int> firstRow( threads + 1, 0 );
+        for( int t = 0; t < threads; ++t )
+        {
+            firstRow[t + 1] = firstRow[t] + rowsInRange[t];
+        }
+        mRowCount = firstRow[threads];
+
+        const int columns = ColumnCount();
+        mFrames.resize( mRowCount );
+        mTimes.resize( mRowCount );
+        mValues.reset( new float[(size_t) columns * mRowCount] );
+
+        // Pass 2: parse blocks of rows row-major, then transpose each block into the columns.
+        std::atomic<long long> malformed{ 0 };
+        RunParallel( threads, [&]( int t )
+        {
+            std::vector<float> block( (size_t) kBlockRows * columns );
+            long long bad = 0;
+
+            int row = firstRow[t];
+            int blockStart = row;
+            int blockRows = 0;
+
+            auto flushBlock = [&]()
+            {
+                for( int c = 0; c < columns; ++c )
+                {
+                    float* out = mValues.get() + (size_t) c * mRowCount + blockStart;
+                    const float* in = block.data() + c;
+                    for( int r = 0; r < blockRows; ++r )
+                    {
+                        out[r] = in[(size_t) r * columns];
+                    }
+                }
+                blockStart += blockRows;
+                blockRows = 0;
+            };
+
+            const char* rangeEnd = bounds[t + 1];
+            for( const char* p = bounds[t]; p < rangeEnd; )
+            {
+                const char* lineEnd = FindLineEnd( p, rangeEnd );
+                if( IsBlankLine( p, rangeEnd ) )
+                {
+                    p = ( lineEnd < rangeEnd ? lineEnd + 1 : rangeEnd );
+                    continue;
+                }
+
+                long long frame;
+                double time;
+                float* values = block.data() + (size_t) blockRows * columns;
+                const bool ok = ParseTakeRow( p, lineEnd, columns, frame, time, values );
+                mFrames[row] = (int) frame;
+                mTimes[row] = time;
+
+                bad += ( ok ? 0 : 1 );
+                ++row;
+                if( ++blockRows == kBlockRows )
+                {
+                    flushBlock();
+                }
+                p = ( lineEnd < rangeEnd ? lineEnd + 1 : rangeEnd );
+            }
+            flushBlock();
+
+            malformed.fetch_add( bad, std::memory_order_relaxed );
+        } );
+
+        mMalformedRows = malformed.load();
+    }
+
+    void cTakeCsv::BuildTrajectories( int threads )
+    {
+        for( int c : FindTakeMarkerColumns( mHeader.Columns ) )
+        {
+            const sTakeColumn& x = mHeader.Columns[c];
+
+            sTakeTrajectory trajectory;
+            trajectory.ID = x.ID;
+            trajectory.UID = ParseTakeID( x.ID );
+            trajectory.Name = x.Name;
+            trajectory.Type = x.Type;
+            trajectory.XColumn = c;
+
+            mByID.emplace( x.ID, (int) mTrajectories.size() );
+            mTrajectories.push_back( std::move( trajectory ) );
+        }
+
+        // Gather X/Y/Z columns into interleaved positions, markers spread over the threads.
+        const int markers = MarkerCount();
+        threads = std::max( 1, std::min( threads, markers ) );
+        RunParallel( threads, [&]( int t )
+        {
+            for( int m = t; m < markers; m += threads )
+            {
+                sTakeTrajectory& trajectory = mTrajectories[m];
+                const float* x = Values( trajectory.XColumn );
+                const float* y = Values( trajectory.XColumn + 1 );
+                const float* z = Values( trajectory.XColumn + 2 );
+
+                trajectory.Positions.resize( mRowCount );
+                Core::cVector3f* positions = trajectory.Positions.data();
+                for( int r = 0; r < mRowCount; ++r )
+                {
+                    positions[r] = Core::cVector3f( x[r], y[r], z[r] );
+                }
+            }
+        } );
+    }
+
+    const sTakeTrajectory* cTakeCsv::FindMarker( const std::string& id ) const
+    {
+        std::unordered_map<std::string, int>::const_iterator it = mByID.find( id );
+        return ( it != mByID.end() ? &mTrajectories[it->second] : nullptr );
+    }
+
+    const sTakeTrajectory* cTakeCsv::FindMarker( const Core::cUID& id ) const
+    {
+        for( const sTakeTrajectory& trajectory : mTrajectories )
+        {
+            if( trajectory.UID == id )
+            {
+                return &trajectory;
+            }
+        }
+        return nullptr;
+    }
+}
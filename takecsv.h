@@ -0,0 +1,143 @@
+//======================================================================================================
+// Take CSV loader: memory-mapped, multithreaded reader for Motive take CSV exports
+//======================================================================================================
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Core/UID.h"
+#include "Core/Vector3.h"
+
+namespace Capture
+{
+    /// <summary>Header rows above one data column (Type, Name, ID, the category row and the axis row).</summary>
+    struct sTakeColumn
+    {
+        std::string Type;       // "Marker", "Rigid Body", "Rigid Body Marker", ...
+        std::string Name;       // "Unlabeled 1014", "Hand:Thumb", ...
+        std::string ID;         // ID row as exported, e.g. "CE30C20AAF924411EF"
+        std::string Category;   // "Position", "Rotation", "Mean Marker Error", ...
+        std::string Axis;       // "X", "Y", "Z", "W" or empty
+    };
+
+    /// <summary>Position trajectory of one marker; missing samples are NaN.</summary>
+    struct sTakeTrajectory
+    {
+        std::string ID;
+        Core::cUID UID;                            // ID row parsed as hexadecimal
+        std::string Name;
+        std::string Type;
+        int XColumn;                               // Column index of X; Y and Z follow
+        std::vector<Core::cVector3f> Positions;    // One per row, in the take's length units
+    };
+
+    /// <summary>Metadata line and column descriptors of a take export, everything above the first data row.</summary>
+    struct sTakeHeader
+    {
+        std::vector<std::pair<std::string, std::string>> Metadata;
+        std::vector<sTakeColumn> Columns;   // Data columns after Frame and Time (Seconds)
+
+        /// <summary>Value of a metadata field, or empty.</summary>
+        const std::string& Get( const std::string& key ) const;
+    };
+
+    struct sTakeLoadOptions
+    {
+        int Threads = 0;                // 0 = one per hardware thread
+        bool BuildTrajectories = true;  // Also gather X/Y/Z columns into per-marker cVector3f arrays
+    };
+
+    /// <summary>
+    /// Loads a Motive take CSV export. The file is memory mapped while loading, the metadata and column header rows are
+    /// parsed once, and the numeric body is converted on several threads, each owning a contiguous range of
+    /// rows, into one contiguous float array per column. Marker position columns are then gathered into
+    /// cVector3f trajectories keyed by the ID row.
+    /// </summary>
+    class cTakeCsv
+    {
+    public:
+        bool Load( const char* path, const sTakeLoadOptions& options = sTakeLoadOptions() );
+
+        const std::string& Error() const { return mError; }
+
+        /// <summary>Value of a first-line metadata field ("Capture Frame Rate", "Length Units", ...), or empty.</summary>
+        const std::string& Metadata( const std::string& key ) const;
+        const std::vector<std::pair<std::string, std::string>>& AllMetadata() const { return mHeader.Metadata; }
+
+        double CaptureFrameRate() const { return mCaptureFrameRate; }
+        double ExportFrameRate() const { return mExportFrameRate; }
+        long long CaptureStartFrame() const { return mCaptureStartFrame; }
+        const std::string& CaptureStartTime() const { return Metadata( "Capture Start Time" ); }
+        const std::string& LengthUnits() const { return Metadata( "Length Units" ); }
+
+        int RowCount() const { return mRowCount; }
+
+        /// <summary>Data columns after Frame and Time (Seconds).</summary>
+        int ColumnCount() const { return (int) mHeader.Columns.size(); }
+        const sTakeColumn& Column( int column ) const { return mHeader.Columns[column]; }
+        const float* Values( int column ) const { return mValues.get() + (size_t) column * mRowCount; }
+
+        const int* FrameNumbers() const { return mFrames.data(); }
+        const double* Times() const { return mTimes.data(); }
+
+        int MarkerCount() const { return (int) mTrajectories.size(); }
+        const sTakeTrajectory& Marker( int index ) const { return mTrajectories[index]; }
+
+        /// <summary>Trajectory with the given ID row value, or null. When a Marker and a Rigid Body Marker
+        /// share an ID, the first in column order is returned.</summary>
+        const sTakeTrajectory* FindMarker( const std::string& id ) const;
+        const sTakeTrajectory* FindMarker( const Core::cUID& id ) const;
+
+        /// <summary>Rows that had fewer fields than the header or an unparsable value.</summary>
+        long long MalformedRows() const { return mMalformedRows; }
+
+    private:
+        void Reset();
+        void ParseBody( const char* begin, const char* end, int threads );
+        void BuildTrajectories( int threads );
+
+        std::string mError;
+
+        sTakeHeader mHeader;
+        double mCaptureFrameRate = 0;
+        double mExportFrameRate = 0;
+        long long mCaptureStartFrame = 0;
+
+        int mRowCount = 0;
+        std::vector<int> mFrames;
+        std::vector<double> mTimes;
+        std::unique_ptr<float[]> mValues;   // Column-major: column c starts at c * mRowCount. Left
+                                            // uninitialized so the parsing threads fault the pages in.
+
+        std::vector<sTakeTrajectory> mTrajectories;
+        std::unordered_map<std::string, int> mByID;
+        long long mMalformedRows = 0;
+    };
+
+    /// <summary>Parse a Motive ID row value (hexadecimal, up to 32 digits) into a cUID.</summary>
+    Core::cUID ParseTakeID( const std::string& id );
+
+    /// <summary>
+    /// Parse the metadata line and descriptor rows up to and including the "Frame,Time (Seconds),..." axis
+    /// row, leaving cursor on the first data line. Returns false with error set if the text is not a take
+    /// export or the axis row is missing.
+    /// </summary>
+    bool ParseTakeHeader( const char*& cursor, const char* end, sTakeHeader& header, std::string& error );
+
+    /// <summary>
+    /// Parse one data row [p, lineEnd) into its frame number, time and columns values. Empty fields, which
+    /// Motive writes for occluded markers, become NaN. Returns false for a short row or an unparsable
+    /// field; the values are still filled, with NaN for whatever could not be read.
+    /// </summary>
+    bool ParseTakeRow( const char* p, const char* lineEnd, int columns, long long& frame, double& time, float* values );
+
+    /// <summary>Index of the X column of every marker position triple (X, Y, Z sharing an ID), in column order.</summary>
+    std::vector<int> FindTakeMarkerColumns( const std::vector<sTakeColumn>& columns );
+
+    /// <summary>Meters per "Length Units" of an export (0.001 for Millimeters), so positions match the live API.</summary>
+    double TakeMetersPerUnit( const std::string& units );
+}
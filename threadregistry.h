@@ -0,0 +1,122 @@
+//======================================================================================================
+// Per-thread slots for the instrumentation (log, trace, latency): lock-free on the owning thread,
+// drained and reported from any other
+//======================================================================================================
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+namespace Capture
+{
+    /// <summary>
+    /// One T per thread that uses a facility, created with T( index ) on that thread's first call, in
+    /// registration order from zero. Registration and anything else holding Lock() serialize; Local() on a
+    /// registered thread is a thread_local read. Slots, the list and the lock are never freed, so what an
+    /// exited thread left behind is still there for a drain run from a static destructor at exit.
+    /// </summary>
+    template<typename T>
+    class cThreadRegistry
+    {
+    public:
+        /// <summary>The calling thread's slot.</summary>
+        static T& Local()
+        {
+            thread_local T* tLocal = nullptr;
+            if( tLocal == nullptr )
+            {
+                std::lock_guard<std::mutex> lock( Lock() );
+                std::vector<T*>& slots = Storage();
+                slots.push_back( new T( (int) slots.size() ) );
+                tLocal = slots.back();
+            }
+            return *tLocal;
+        }
+
+        /// <summary>Guards the slot list, and whatever fields of T the facility chooses (e.g. names).</summary>
+        static std::mutex& Lock()
+        {
+            static std::mutex* sLock = new std::mutex();
+            return *sLock;
+        }
+
+        /// <summary>Every slot in registration order. Hold Lock() while using it.</summary>
+        static const std::vector<T*>& Slots() { return Storage(); }
+
+        /// <summary>Copy the slot list under the lock, to walk it without holding the lock.</summary>
+        static void Snapshot( std::vector<T*>& slots )
+        {
+            std::lock_guard<std::mutex> lock( Lock() );
+            slots = Storage();
+        }
+
+    private:
+        static std::vector<T*>& Storage()
+        {
+            static std::vector<T*>* sSlots = new std::vector<T*>();
+            return *sSlots;
+        }
+    };
+
+    /// <summary>An item taken out of a thread's queue, with the Index of that thread.</summary>
+    template<typename Item>
+    struct sDrainedItem
+    {
+        const Item* Value;
+        int Thread;
+    };
+
+    /// <summary>
+    /// Empties the cSpscRing queues of registered threads and merges their items in time order, a
+    /// thread's own order kept among equal times. Items are copied out of every queue before anything
+    /// else, so producers get their slots back before any formatting or I/O, and only pointers are sorted.
+    /// Buffers keep their capacity between passes. One drain at a time.
+    /// </summary>
+    template<typename Item>
+    class cQueueDrain
+    {
+    public:
+        /// <summary>Slot needs Queue (a cSpscRing of Item) and Index. Valid until the next Collect().</summary>
+        template<typename Slot, typename TimeOf>
+        const std::vector<sDrainedItem<Item>>& Collect( const std::vector<Slot*>& threads, TimeOf timeOf )
+        {
+            mItems.clear();
+            mOrder.clear();
+
+            Item item;
+            for( Slot* thread : threads )
+            {
+                while( thread->Queue.TryPop( item ) )
+                {
+                    mItems.push_back( item );
+                    mOrder.push_back( sDrainedItem<Item>{ nullptr, thread->Index } );
+                }
+            }
+            for( size_t i = 0; i < mOrder.size(); ++i )
+            {
+                mOrder[i].Value = &mItems[i];
+            }
+            std::stable_sort( mOrder.begin(), mOrder.end(),
+                [&timeOf]( const sDrainedItem<Item>& a, const sDrainedItem<Item>& b ) { return timeOf( *a.Value ) < timeOf( *b.Value ); } );
+            return mOrder;
+        }
+
+    private:
+        std::vector<Item> mItems;
+        std::vector<sDrainedItem<Item>> mOrder;
+    };
+
+    /// <summary>
+    /// Declared at namespace scope after a facility's state, runs its Stop() from a static destructor:
+    /// a return or exit() without Stop() still writes what is queued, and never destroys a joinable
+    /// thread. Drain buffers used from Stop() must be leaked rather than function-local statics, which
+    /// would already be destroyed by then.
+    /// </summary>
+    struct sStopAtExit
+    {
+        void ( *Stop )();
+
+        ~sStopAtExit() { Stop(); }
+    };
+}
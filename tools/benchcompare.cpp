@@ -0,0 +1,720 @@
+//======================================================================================================
+// benchcompare: compare benchmark JSON results against a stored baseline and flag regressions
+//======================================================================================================
+//
+//   benchcompare [--threshold PCT] [--min-ns N] [--absolute] [--any-context] baseline.json results.json...
+//   benchcompare --write baseline.json results.json...
+//
+// Reads the JSON the bench programs write with --benchmark_out (Google Benchmark's layout, so its output
+// works too) and matches runs by name. Several runs of one name, from --benchmark_repetitions or from
+// result files of repeated rounds, count as their median, which neither a slow spell of the machine nor
+// one lucky run moves. A shared machine also drifts as a whole between the
+// baseline and the results, so changes are measured against the median change of the suite, printed
+// first; --absolute compares raw timings, as does a comparison of fewer than 10 runs, where the median
+// would be the change itself. A run slower than the baseline by more than the threshold
+// (default 10%) is a regression; faster by as much is reported as an improvement. Runs shorter than
+// --min-ns are listed but never flagged, since timer and scheduling noise dominates them. Runs only in
+// the baseline or only in the results are listed as missing or new. --write merges the result files
+// into a new baseline instead of comparing, keeping the context of every file it came from.
+//
+// Absolute timings from another machine or build say nothing, so the comparison is refused when the
+// baseline and the results disagree on num_cpus, compiler or library_build_type; --any-context compares
+// anyway, with a warning. Returns 1 if any run regressed, the contexts differ or a file cannot be read.
+//
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    // Below this many runs in both files, their median change is taken for a real one, not for drift.
+    const size_t kMinRunsForDrift = 10;
+
+    /// <summary>A parsed JSON value; objects keep their members in file order.</summary>
+    struct sJson
+    {
+        enum class eType { Null, Bool, Number, String, Array, Object };
+
+        eType Type = eType::Null;
+        bool Bool = false;
+        double Number = 0;
+        std::string String;
+        std::vector<sJson> Items;
+        std::vector<std::pair<std::string, sJson>> Members;
+
+        const sJson* Find( const char* key ) const
+        {
+            for( const std::pair<std::string, sJson>& member : Members )
+            {
+                if( member.first == key )
+                {
+                    return &member.second;
+                }
+            }
+            return nullptr;
+        }
+    };
+
+    /// <summary>Recursive descent over the whole document; enough JSON for benchmark output, not a validator.</summary>
+    class cJsonParser
+    {
+    public:
+        cJsonParser( const char* begin, const char* end ) : mCursor( begin ), mEnd( end ) { }
+
+        bool Parse( sJson& value, std::string& error )
+        {
+            if( !ParseValue( value, 0 ) || ( SkipSpace(), mCursor != mEnd ) )
+            {
+                error = mError.empty() ? "unexpected text after the document" : mError;
+                return false;
+            }
+            return true;
+        }
+
+    private:
+        bool Fail( const char* message )
+        {
+            if( mError.empty() )
+            {
+                mError = message;
+            }
+            return false;
+        }
+
+        void SkipSpace()
+        {
+            while( mCursor != mEnd && isspace( (unsigned char) *mCursor ) )
+            {
+                ++mCursor;
+            }
+        }
+
+        bool Literal( const char* word )
+        {
+            const size_t length = strlen( word );
+            if( (size_t) ( mEnd - mCursor ) < length || strncmp( mCursor, word, length ) != 0 )
+            {
+                return Fail( "unknown literal" );
+            }
+            mCursor += length;
+            return true;
+        }
+
+        bool ParseString( std::string& out )
+        {
+            ++mCursor;  // Opening quote
+            while( mCursor != mEnd && *mCursor != '"' )
+            {
+                char c = *mCursor++;
+                if( c == '\\' )
+                {
+                    if( mCursor == mEnd )
+                    {
+                        break;
+                    }
+                    c = *mCursor++;
+                    switch( c )
+                    {
+                    case 'n': c = '\n'; break;
+                    case 't': c = '\t'; break;
+                    case 'r': c = '\r'; break;
+                    case 'b': c = '\b'; break;
+                    case 'f': c = '\f'; break;
+                    case 'u':
+                        // Names and labels are ASCII; anything else becomes '?'
+                        if( mEnd - mCursor < 4 )
+                        {
+                            return Fail( "truncated \\u escape" );
+                        }
+                        c = (char) strtol( std::string( mCursor, mCursor + 4 ).c_str(), nullptr, 16 );
+                        c = ( (unsigned char) c < 0x80 ? c : '?' );
+                        mCursor += 4;
+                        break;
+                    default: break;     // \" \\ \/
+                    }
+                }
+                out += c;
+            }
+            if( mCursor == mEnd )
+            {
+                return Fail( "unterminated string" );
+            }
+            ++mCursor;
+            return true;
+        }
+
+        bool ParseValue( sJson& value, int depth )
+        {
+            SkipSpace();
+            if( mCursor == mEnd )
+            {
+                return Fail( "unexpected end of file" );
+            }
+            if( depth > 64 )
+            {
+                return Fail( "nested too deeply" );
+            }
+
+            const char c = *mCursor;
+            if( c == '{' )
+            {
+                value.Type = sJson::eType::Object;
+                ++mCursor;
+                SkipSpace();
+                if( mCursor != mEnd && *mCursor == '}' )
+                {
+                    ++mCursor;
+                    return true;
+                }
+                for( ;; )
+                {
+                    SkipSpace();
+                    std::pair<std::string, sJson> member;
+                    if( mCursor == mEnd || *mCursor != '"' || !ParseString( member.first ) )
+                    {
+                        return Fail( "expected a member name" );
+                    }
+                    SkipSpace();
+                    if( mCursor == mEnd || *mCursor++ != ':' )
+                    {
+                        return Fail( "expected ':'" );
+                    }
+                    if( !ParseValue( member.second, depth + 1 ) )
+                    {
+                        return false;
+                    }
+                    value.Members.push_back( std::move( member ) );
+                    SkipSpace();
+                    if( mCursor != mEnd && *mCursor == ',' )
+                    {
+                        ++mCursor;
+                        continue;
+                    }
+                    if( mCursor != mEnd && *mCursor == '}' )
+                    {
+                        ++mCursor;
+                        return true;
+                    }
+                    return Fail( "expected ',' or '}'" );
+                }
+            }
+            if( c == '[' )
+            {
+                value.Type = sJson::eType::Array;
+                ++mCursor;
+                SkipSpace();
+                if( mCursor != mEnd && *mCursor == ']' )
+                {
+                    ++mCursor;
+                    return true;
+                }
+                for( ;; )
+                {
+                    value.Items.emplace_back();
+                    if( !ParseValue( value.Items.back(), depth + 1 ) )
+                    {
+                        return false;
+                    }
+                    SkipSpace();
+                    if( mCursor != mEnd && *mCursor == ',' )
+                    {
+                        ++mCursor;
+                        continue;
+                    }
+                    if( mCursor != mEnd && *mCursor == ']' )
+                    {
+                        ++mCursor;
+                        return true;
+                    }
+                    return Fail( "expected ',' or ']'" );
+                }
+            }
+            if( c == '"' )
+            {
+                value.Type = sJson::eType::String;
+                return ParseString( value.String );
+            }
+            if( c == 't' || c == 'f' )
+            {
+                value.Type = sJson::eType::Bool;
+                value.Bool = ( c == 't' );
+                return Literal( c == 't' ? "true" : "false" );
+            }
+            if( c == 'n' )
+            {
+                return Literal( "null" );
+            }
+
+            // Numbers, and the NaN / Infinity some writers emit
+            const std::string text( mCursor, std::min( mEnd, mCursor + 64 ) );
+            char* stop = nullptr;
+            value.Type = sJson::eType::Number;
+            value.Number = strtod( text.c_str(), &stop );
+            if( stop == text.c_str() )
+            {
+                return Fail( "expected a value" );
+            }
+            mCursor += stop - text.c_str();
+            return true;
+        }
+
+        const char* mCursor;
+        const char* mEnd;
+        std::string mError;
+    };
+
+    /// <summary>One benchmark run as read from a results file.</summary>
+    struct sRun
+    {
+        std::string Name;
+        double Ns = 0;              // real_time in nanoseconds
+        long long Iterations = 0;
+        double ItemsPerSecond = 0;
+        std::string Label;
+    };
+
+    struct sResults
+    {
+        std::vector<sJson> Contexts;    // One per source file; a baseline holds those it was merged from
+        std::vector<sRun> Runs;         // In file order; KeepMedians() leaves one per name
+    };
+
+    double NsPerUnit( const std::string& unit )
+    {
+        if( unit == "us" )
+        {
+            return 1e3;
+        }
+        if( unit == "ms" )
+        {
+            return 1e6;
+        }
+        if( unit == "s" )
+        {
+            return 1e9;
+        }
+        return 1.0;
+    }
+
+    bool LoadResults( const char* path, sResults& results )
+    {
+        FILE* file = fopen( path, "rb" );
+        if( !file )
+        {
+            fprintf( stderr, "benchcompare: cannot open %s\n", path );
+            return false;
+        }
+        std::string text;
+        char buffer[65536];
+        size_t read;
+        while( ( read = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 )
+        {
+            text.append( buffer, read );
+        }
+        fclose( file );
+
+        sJson document;
+        std::string error;
+        cJsonParser parser( text.data(), text.data() + text.size() );
+        if( !parser.Parse( document, error ) )
+        {
+            fprintf( stderr, "benchcompare: %s: %s\n", path, error.c_str() );
+            return false;
+        }
+        const sJson* benchmarks = document.Find( "benchmarks" );
+        if( !benchmarks || benchmarks->Type != sJson::eType::Array )
+        {
+            fprintf( stderr, "benchcompare: %s: no \"benchmarks\" array\n", path );
+            return false;
+        }
+        if( const sJson* context = document.Find( "context" ) )
+        {
+            const sJson* sources = context->Find( "sources" );
+            if( sources && sources->Type == sJson::eType::Array )
+            {
+                results.Contexts.insert( results.Contexts.end(), sources->Items.begin(), sources->Items.end() );
+            }
+            else
+            {
+                results.Contexts.push_back( *context );
+            }
+        }
+
+        for( const sJson& entry : benchmarks->Items )
+        {
+            const sJson* name = entry.Find( "name" );
+            const sJson* time = entry.Find( "real_time" );
+            const sJson* error = entry.Find( "error_occurred" );
+            const sJson* runType = entry.Find( "run_type" );
+            if( !name || !time || ( error && error->Bool ) || ( runType && runType->String != "iteration" ) )
+            {
+                continue;   // Skipped runs and Google Benchmark's mean/median/stddev aggregates
+            }
+
+            sRun run;
+            run.Name = name->String;
+            const sJson* unit = entry.Find( "time_unit" );
+            run.Ns = time->Number * NsPerUnit( unit ? unit->String : "ns" );
+            if( const sJson* iterations = entry.Find( "iterations" ) )
+            {
+                run.Iterations = (long long) iterations->Number;
+            }
+            if( const sJson* items = entry.Find( "items_per_second" ) )
+            {
+                run.ItemsPerSecond = items->Number;
+            }
+            if( const sJson* label = entry.Find( "label" ) )
+            {
+                run.Label = label->String;
+            }
+
+            results.Runs.push_back( run );
+        }
+        return true;
+    }
+
+    /// <summary>
+    /// Replace the runs of each name with the median one (the lower of the two middle runs for an even
+    /// count, so it is a run that happened), at the place of the first.
+    /// </summary>
+    void KeepMedians( sResults& results )
+    {
+        std::map<std::string, std::vector<const sRun*>> byName;
+        for( const sRun& run : results.Runs )
+        {
+            byName[run.Name].push_back( &run );
+        }
+
+        std::vector<sRun> medians;
+        for( const sRun& run : results.Runs )
+        {
+            std::map<std::string, std::vector<const sRun*>>::iterator runs = byName.find( run.Name );
+            if( runs == byName.end() )
+            {
+                continue;   // Already taken at its first run
+            }
+            std::vector<const sRun*>& same = runs->second;
+            std::sort( same.begin(), same.end(), []( const sRun* a, const sRun* b ) { return a->Ns < b->Ns; } );
+            medians.push_back( *same[( same.size() - 1 ) / 2] );
+            byName.erase( runs );
+        }
+        results.Runs.swap( medians );
+    }
+
+    /// <summary>The distinct values of a context field across the files, e.g. "1" or "8, 16".</summary>
+    std::string ContextValues( const sResults& results, const char* key )
+    {
+        std::vector<std::string> values;
+        for( const sJson& context : results.Contexts )
+        {
+            const sJson* value = context.Find( key );
+            if( !value )
+            {
+                continue;
+            }
+            char number[32];
+            snprintf( number, sizeof( number ), "%.15g", value->Number );
+            const std::string text = ( value->Type == sJson::eType::Number ? number : value->String );
+            if( std::find( values.begin(), values.end(), text ) == values.end() )
+            {
+                values.push_back( text );
+            }
+        }
+
+        std::string joined;
+        for( const std::string& value : values )
+        {
+            joined += ( joined.empty() ? "" : ", " ) + value;
+        }
+        return joined;
+    }
+
+    /// <summary>Report every field on which the two sides differ. A field missing from either side is not compared.</summary>
+    bool SameContext( const sResults& baseline, const sResults& current )
+    {
+        static const char* const kFields[] = { "num_cpus", "compiler", "library_build_type" };
+
+        bool same = true;
+        for( const char* field : kFields )
+        {
+            const std::string before = ContextValues( baseline, field );
+            const std::string after = ContextValues( current, field );
+            if( !before.empty() && !after.empty() && before != after )
+            {
+                fprintf( stderr, "benchcompare: %s differs: baseline %s, results %s\n", field, before.c_str(), after.c_str() );
+                same = false;
+            }
+        }
+        return same;
+    }
+
+    std::string JsonString( const std::string& text )
+    {
+        std::string out = "\"";
+        for( char c : text )
+        {
+            if( c == '"' || c == '\\' )
+            {
+                out += '\\';
+            }
+            out += ( (unsigned char) c < 0x20 ? ' ' : c );
+        }
+        return out + "\"";
+    }
+
+    void WriteJsonValue( FILE* out, const sJson& value )
+    {
+        switch( value.Type )
+        {
+        case sJson::eType::Null:   fprintf( out, "null" ); break;
+        case sJson::eType::Bool:   fprintf( out, value.Bool ? "true" : "false" ); break;
+        case sJson::eType::Number: fprintf( out, "%.15g", value.Number ); break;
+        case sJson::eType::String: fprintf( out, "%s", JsonString( value.String ).c_str() ); break;
+        case sJson::eType::Array:
+            fprintf( out, "[" );
+            for( size_t i = 0; i < value.Items.size(); ++i )
+            {
+                fprintf( out, i ? ", " : "" );
+                WriteJsonValue( out, value.Items[i] );
+            }
+            fprintf( out, "]" );
+            break;
+        case sJson::eType::Object:
+            fprintf( out, "{" );
+            for( size_t i = 0; i < value.Members.size(); ++i )
+            {
+                fprintf( out, "%s%s: ", i ? ", " : "", JsonString( value.Members[i].first ).c_str() );
+                WriteJsonValue( out, value.Members[i].second );
+            }
+            fprintf( out, "}" );
+            break;
+        }
+    }
+
+    /// <summary>The merged runs in the harness's layout, with the context of each source file.</summary>
+    bool WriteBaseline( const char* path, const sResults& results )
+    {
+        FILE* out = fopen( path, "w" );
+        if( !out )
+        {
+            fprintf( stderr, "benchcompare: cannot write %s\n", path );
+            return false;
+        }
+        fprintf( out, "{\n  \"context\": {\n    \"sources\": [" );
+        for( size_t i = 0; i < results.Contexts.size(); ++i )
+        {
+            fprintf( out, "%s\n      ", i ? "," : "" );
+            WriteJsonValue( out, results.Contexts[i] );
+        }
+        fprintf( out, "\n    ]\n  },\n  \"benchmarks\": [" );
+        for( size_t i = 0; i < results.Runs.size(); ++i )
+        {
+            const sRun& run = results.Runs[i];
+            fprintf( out, "%s\n    {\n      \"name\": %s,\n      \"run_name\": %s,\n      \"run_type\": \"iteration\",\n", i ? "," : "",
+                JsonString( run.Name ).c_str(), JsonString( run.Name ).c_str() );
+            fprintf( out, "      \"iterations\": %lld,\n      \"real_time\": %.4f,\n      \"cpu_time\": %.4f,\n      \"time_unit\": \"ns\"",
+                run.Iterations, run.Ns, run.Ns );
+            if( run.ItemsPerSecond > 0 )
+            {
+                fprintf( out, ",\n      \"items_per_second\": %.6g", run.ItemsPerSecond );
+            }
+            if( !run.Label.empty() )
+            {
+                fprintf( out, ",\n      \"label\": %s", JsonString( run.Label ).c_str() );
+            }
+            fprintf( out, "\n    }" );
+        }
+        fprintf( out, "\n  ]\n}\n" );
+        const bool written = ( ferror( out ) == 0 );
+        return ( fclose( out ) == 0 && written );
+    }
+
+    /// <summary>Median of results / baseline over the runs in both, or 1 for too few to tell drift from change.</summary>
+    double SuiteDrift( const sResults& baseline, const sResults& current )
+    {
+        std::map<std::string, double> baseNs;
+        for( const sRun& run : baseline.Runs )
+        {
+            baseNs[run.Name] = run.Ns;
+        }
+        std::vector<double> ratios;
+        for( const sRun& run : current.Runs )
+        {
+            std::map<std::string, double>::const_iterator base = baseNs.find( run.Name );
+            if( base != baseNs.end() && base->second > 0 && run.Ns > 0 )
+            {
+                ratios.push_back( run.Ns / base->second );
+            }
+        }
+        if( ratios.size() < kMinRunsForDrift )
+        {
+            return 1.0;
+        }
+        std::sort( ratios.begin(), ratios.end() );
+        const size_t middle = ratios.size() / 2;
+        return ( ratios.size() % 2 ? ratios[middle] : 0.5 * ( ratios[middle - 1] + ratios[middle] ) );
+    }
+
+    void PrintUsage()
+    {
+        printf( "usage: benchcompare [--threshold PCT] [--min-ns N] [--absolute] [--any-context] baseline.json results.json...\n" );
+        printf( "       benchcompare --write baseline.json results.json...\n" );
+        printf( "  --threshold PCT   slowdown that counts as a regression, in percent (default 10)\n" );
+        printf( "  --min-ns N        never flag runs faster than N ns in both files (default 0)\n" );
+        printf( "  --absolute        compare raw timings, without taking out the drift of the whole suite\n" );
+        printf( "  --any-context     compare even when CPU count, compiler or build type differ from the baseline\n" );
+        printf( "  --write           merge the results into a new baseline instead of comparing\n" );
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    double threshold = 10.0;
+    double minNs = 0.0;
+    bool write = false;
+    bool anyContext = false;
+    bool absolute = false;
+    std::vector<const char*> files;
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string arg = argv[i];
+        if( arg == "--threshold" && i + 1 < argc )
+        {
+            threshold = atof( argv[++i] );
+        }
+        else if( arg == "--min-ns" && i + 1 < argc )
+        {
+            minNs = atof( argv[++i] );
+        }
+        else if( arg == "--write" )
+        {
+            write = true;
+        }
+        else if( arg == "--any-context" )
+        {
+            anyContext = true;
+        }
+        else if( arg == "--absolute" )
+        {
+            absolute = true;
+        }
+        else if( !arg.empty() && arg[0] == '-' )
+        {
+            PrintUsage();
+            return 2;
+        }
+        else
+        {
+            files.push_back( argv[i] );
+        }
+    }
+    if( files.size() < 2 || threshold <= 0 )
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    sResults current;
+    for( size_t f = 1; f < files.size(); ++f )
+    {
+        if( !LoadResults( files[f], current ) )
+        {
+            return 1;
+        }
+    }
+    KeepMedians( current );
+
+    if( write )
+    {
+        if( !WriteBaseline( files[0], current ) )
+        {
+            return 1;
+        }
+        printf( "%s: %zu runs from %zu files\n", files[0], current.Runs.size(), files.size() - 1 );
+        return 0;
+    }
+
+    FILE* baselineFile = fopen( files[0], "rb" );
+    if( !baselineFile )
+    {
+        fprintf( stderr, "benchcompare: no baseline at %s; write one on this machine with --write first\n", files[0] );
+        return 1;
+    }
+    fclose( baselineFile );
+
+    sResults baseline;
+    if( !LoadResults( files[0], baseline ) )
+    {
+        return 1;
+    }
+    KeepMedians( baseline );
+    if( !SameContext( baseline, current ) )
+    {
+        if( !anyContext )
+        {
+            fprintf( stderr, "benchcompare: not comparing timings from a different machine or build (--any-context to override)\n" );
+            return 1;
+        }
+        fprintf( stderr, "benchcompare: warning: comparing across contexts, timings may not be comparable\n" );
+    }
+
+    std::map<std::string, const sRun*> byName;
+    for( const sRun& run : current.Runs )
+    {
+        byName[run.Name] = &run;
+    }
+
+    const double drift = ( absolute ? 1.0 : SuiteDrift( baseline, current ) );
+    if( drift != 1.0 )
+    {
+        printf( "Suite drift %+.1f%% (median change); changes below are against it\n\n", 100.0 * ( drift - 1.0 ) );
+    }
+
+    int regressions = 0, improvements = 0, missing = 0, compared = 0;
+    printf( "%-48s %14s %14s %9s\n", "Benchmark", "Baseline ns", "Current ns", "Change" );
+    for( const sRun& base : baseline.Runs )
+    {
+        std::map<std::string, const sRun*>::iterator found = byName.find( base.Name );
+        if( found == byName.end() )
+        {
+            printf( "%-48s %14.1f %14s %9s  missing\n", base.Name.c_str(), base.Ns, "-", "" );
+            ++missing;
+            continue;
+        }
+        const sRun& run = *found->second;
+        byName.erase( found );
+        ++compared;
+
+        const double change = ( base.Ns > 0 ? 100.0 * ( run.Ns / ( base.Ns * drift ) - 1.0 ) : 0.0 );
+        const bool noise = ( base.Ns < minNs && run.Ns < minNs );
+        const char* verdict = "";
+        if( !noise && change > threshold )
+        {
+            verdict = "  REGRESSION";
+            ++regressions;
+        }
+        else if( !noise && change < -threshold )
+        {
+            verdict = "  improved";
+            ++improvements;
+        }
+        printf( "%-48s %14.1f %14.1f %+8.1f%%%s\n", base.Name.c_str(), base.Ns, run.Ns, change, verdict );
+    }
+    for( const sRun& run : current.Runs )
+    {
+        if( byName.count( run.Name ) )
+        {
+            printf( "%-48s %14s %14.1f %9s  new\n", run.Name.c_str(), "-", run.Ns, "" );
+        }
+    }
+
+    printf( "\n%d compared: %d regressions and %d improvements beyond %.0f%%, %d missing, %zu new\n", compared, regressions,
+        improvements, threshold, missing, byName.size() );
+    return ( regressions > 0 ? 1 : 0 );
+}
@@ -0,0 +1,217 @@
+//======================================================================================================
+// labjackload: run the LabJack stream and digital writes together against the U3 emulator
+//======================================================================================================
+//
+//   labjackload [--rate N] [--latency-us N] [--jitter-us N] [--toggle-ms N] [--overrun-after N]
+//               [--script file] [--seconds N]
+//
+// Links cLabJackStream against sim/labjacksim.cpp instead of LabJackUD.lib. The stream thread drains
+// FIO/EIO scans while the main thread toggles FIO1 with ePut(), as the goggles trigger does, and watches
+// the stream for each new level. Prints the command round trips, command-to-scan confirmation times,
+// the stream's metrics and the emulator's counters, so the stream and command paths can be loaded and
+// timed on any machine. --overrun-after checks that an LJE_BUFFER_OVERRUN ends the stream cleanly.
+//
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sim/labjacksim.h"
+#include "hostclock.h"
+#include "labjackstream.h"
+
+using namespace Capture;
+
+namespace
+{
+    struct sOptions
+    {
+        double Rate = 1000.0;
+        int LatencyUs = -1;         // -1: the emulator's default
+        int JitterUs = -1;
+        int ToggleMs = 50;
+        long long OverrunAfter = 0;
+        std::string Script;
+        double Seconds = 5.0;
+    };
+
+    void PrintUsage()
+    {
+        printf( "usage: labjackload [--rate N] [--latency-us N] [--jitter-us N] [--toggle-ms N] [--overrun-after N] [--script file] [--seconds N]\n" );
+        printf( "  --rate N            stream scan rate (default 1000)\n" );
+        printf( "  --latency-us N      USB round trip of each command (default 600)\n" );
+        printf( "  --jitter-us N       uniform extra round-trip time, up to N (default 200)\n" );
+        printf( "  --toggle-ms N       toggle FIO1 every N ms (default 50)\n" );
+        printf( "  --overrun-after N   inject LJE_BUFFER_OVERRUN after N scans\n" );
+        printf( "  --script file       scripted FIO/EIO/CIO waveform, see sim/labjacksim.h\n" );
+        printf( "  --seconds N         run time (default 5)\n" );
+    }
+
+    bool ParseOptions( int argc, char* argv[], sOptions& options )
+    {
+        for( int i = 1; i < argc; ++i )
+        {
+            const std::string arg = argv[i];
+            if( i + 1 >= argc )
+            {
+                return false;
+            }
+            const char* value = argv[++i];
+            if( arg == "--rate" )
+            {
+                options.Rate = atof( value );
+            }
+            else if( arg == "--latency-us" )
+            {
+                options.LatencyUs = atoi( value );
+            }
+            else if( arg == "--jitter-us" )
+            {
+                options.JitterUs = atoi( value );
+            }
+            else if( arg == "--toggle-ms" )
+            {
+                options.ToggleMs = atoi( value );
+            }
+            else if( arg == "--overrun-after" )
+            {
+                options.OverrunAfter = atoll( value );
+            }
+            else if( arg == "--script" )
+            {
+                options.Script = value;
+            }
+            else if( arg == "--seconds" )
+            {
+                options.Seconds = atof( value );
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return options.Rate > 0 && options.ToggleMs > 0 && options.Seconds > 0;
+    }
+
+    void PrintPercentiles( const char* name, std::vector<long long> ns )
+    {
+        if( ns.empty() )
+        {
+            printf( "%-22s none\n", name );
+            return;
+        }
+        std::sort( ns.begin(), ns.end() );
+        auto at = [&ns]( double q ) { return ns[std::min( ns.size() - 1, (size_t) ( q * ns.size() ) )] / 1e3; };
+        printf( "%-22s n=%-6zu p50 %8.1f us  p90 %8.1f us  p99 %8.1f us  max %8.1f us\n", name, ns.size(), at( 0.5 ), at( 0.9 ),
+            at( 0.99 ), ns.back() / 1e3 );
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    sOptions options;
+    if( !ParseOptions( argc, argv, options ) )
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    sLabJackSimConfig sim;
+    if( options.LatencyUs >= 0 )
+    {
+        sim.CommandLatencyUs = options.LatencyUs;
+    }
+    if( options.JitterUs >= 0 )
+    {
+        sim.CommandJitterUs = options.JitterUs;
+    }
+    sim.OverrunAfterScans = options.OverrunAfter;
+    if( !options.Script.empty() )
+    {
+        std::string error;
+        if( !LoadLabJackSimScript( options.Script.c_str(), sim, error ) )
+        {
+            fprintf( stderr, "labjackload: %s\n", error.c_str() );
+            return 1;
+        }
+    }
+    ConfigureLabJackSim( sim );
+
+    LJ_HANDLE handle = 0;
+    LJ_ERROR error = OpenLabJack( LJ_dtU3, LJ_ctUSB, "1", 1, &handle );
+    cLabJackStream stream( handle );
+    sLabJackStreamConfig config;
+    config.ScanRate = options.Rate;
+    if( error == LJE_NOERROR )
+    {
+        error = stream.Start( config );
+    }
+    if( error != LJE_NOERROR )
+    {
+        char text[256];
+        ErrorToString( error, text );
+        fprintf( stderr, "labjackload: %s (%ld)\n", text, error );
+        return 1;
+    }
+
+    std::vector<long long> commandNs;
+    std::vector<long long> confirmNs;
+    unsigned long long edges = 0;
+    unsigned short lastState = 0;
+    bool level = false;
+    long long commandHostNs = -1;   // Waiting for the stream to show level
+
+    const long long startNs = HostTimeNs();
+    const long long endNs = startNs + (long long) ( options.Seconds * 1e9 );
+    long long nextToggleNs = startNs;
+    while( HostTimeNs() < endNs && stream.Running() )
+    {
+        if( HostTimeNs() >= nextToggleNs )
+        {
+            level = !level;
+            const long long callNs = HostTimeNs();
+            {
+                std::lock_guard<std::mutex> lock( LabJackMutex() );
+                ePut( handle, LJ_ioPUT_DIGITAL_BIT, 1, level ? 1 : 0, 0 );
+            }
+            commandHostNs = HostTimeNs();
+            commandNs.push_back( commandHostNs - callNs );
+            nextToggleNs += options.ToggleMs * 1000000LL;
+        }
+
+        sDigitalSample sample;
+        while( stream.Samples().TryPop( sample ) )
+        {
+            edges += ( sample.State != lastState );
+            lastState = sample.State;
+            if( commandHostNs >= 0 && ( ( sample.State & kGogglesBit ) != 0 ) == level )
+            {
+                confirmNs.push_back( sample.HostTimeNs - commandHostNs );
+                commandHostNs = -1;
+            }
+        }
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+
+    const sLabJackStreamMetrics metrics = stream.Metrics();
+    stream.Stop();
+    Close();
+
+    const double seconds = ( HostTimeNs() - startNs ) / 1e9;
+    const sLabJackSimStats stats = LabJackSimStats();
+    printf( "%.2f s at %.0f scans/s: %llu scans in %llu reads (%.0f scans/s), %llu state changes\n", seconds, metrics.ScanRate,
+        metrics.ScansRead, metrics.Reads, metrics.ScansRead / seconds, edges );
+    PrintPercentiles( "ePut round trip", commandNs );
+    PrintPercentiles( "command to scan", confirmNs );
+    printf( "Stream: last error %ld, backlog %.0f bytes in the driver, %llu ring overruns\n", metrics.LastError, metrics.BacklogUD,
+        metrics.RingOverruns );
+    printf( "Emulator: %llu round trips (%llu failed), %llu digital writes, %llu stream reads, %llu overruns, deepest backlog %lld scans\n",
+        stats.Commands, stats.FailedCommands, stats.DigitalWrites, stats.StreamReads, stats.Overruns, stats.MaxBacklogScans );
+
+    // An injected overrun is expected to end the stream; anything else is a failure.
+    const bool expected = ( options.OverrunAfter > 0 ? metrics.LastError == LJE_BUFFER_OVERRUN : metrics.LastError == LJE_NOERROR );
+    return ( expected ? 0 : 1 );
+}
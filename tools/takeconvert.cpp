@@ -0,0 +1,342 @@
+//======================================================================================================
+// takeconvert: stream a Motive take CSV export into a compressed, indexed columnar recording
+//======================================================================================================
+//
+//   takeconvert [--chunk-frames N] [--buffer-kb N] [--raw] take.csv [take.mkrc]
+//
+// The CSV is read front to back through one fixed-size buffer and each row is parsed straight into the
+// current chunk, so memory use depends on the buffer and the marker count, not on the length of the
+// take. Marker position triples become recording marker slots keyed by the ID row; other columns (rigid
+// body poses, marker quality) are skipped, and positions are scaled from the export's Length Units to
+// meters, the unit live recordings hold. The recording's frame index lets later analyses open any frame
+// range with cRecordingReader::FindChunk() without decoding what comes before it.
+//
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hostclock.h"
+#include "processmemory.h"
+#include "recording.h"
+#include "takecsv.h"
+
+using namespace Capture;
+
+namespace
+{
+    struct sOptions
+    {
+        std::string Input;
+        std::string Output;
+        int ChunkFrames = 256;
+        size_t BufferBytes = 4 << 20;
+        bool Compress = true;
+    };
+
+    void PrintUsage()
+    {
+        printf( "usage: takeconvert [--chunk-frames N] [--buffer-kb N] [--raw] take.csv [take.mkrc]\n" );
+        printf( "  --chunk-frames N   frames per chunk (default 256)\n" );
+        printf( "  --buffer-kb N      CSV read buffer; must hold the header and any single row (default 4096)\n" );
+        printf( "  --raw              store chunks uncompressed so readers can map them in place\n" );
+    }
+
+    bool ParseOptions( int argc, char* argv[], sOptions& options )
+    {
+        std::vector<std::string> paths;
+        for( int i = 1; i < argc; ++i )
+        {
+            const std::string arg = argv[i];
+            if( arg == "--chunk-frames" && i + 1 < argc )
+            {
+                options.ChunkFrames = atoi( argv[++i] );
+            }
+            else if( arg == "--buffer-kb" && i + 1 < argc )
+            {
+                options.BufferBytes = (size_t) atoll( argv[++i] ) * 1024;
+            }
+            else if( arg == "--raw" )
+            {
+                options.Compress = false;
+            }
+            else if( !arg.empty() && arg[0] == '-' )
+            {
+                return false;
+            }
+            else
+            {
+                paths.push_back( arg );
+            }
+        }
+
+        if( paths.empty() || paths.size() > 2 || options.ChunkFrames <= 0 || options.BufferBytes < 4096 )
+        {
+            return false;
+        }
+
+        options.Input = paths[0];
+        if( paths.size() == 2 )
+        {
+            options.Output = paths[1];
+        }
+        else
+        {
+            const size_t dot = options.Input.find_last_of( '.' );
+            const size_t slash = options.Input.find_last_of( "/\\" );
+            const bool hasExtension = ( dot != std::string::npos && ( slash == std::string::npos || dot > slash ) );
+            options.Output = ( hasExtension ? options.Input.substr( 0, dot ) : options.Input ) + ".mkrc";
+        }
+        return true;
+    }
+
+    double Megabytes( unsigned long long bytes )
+    {
+        return bytes / ( 1024.0 * 1024.0 );
+    }
+
+    /// <summary>One chunk being filled row by row, written through cRecordingFileWriter when full.</summary>
+    class cChunkBuilder
+    {
+    public:
+        cChunkBuilder( cRecordingFileWriter& writer, int chunkFrames, const std::vector<int>& markerColumns,
+                       const std::vector<sRecordingMarkerEntry>& markers, float metersPerUnit )
+            : mWriter( writer ), mLayout( chunkFrames ), mChunkFrames( chunkFrames ),
+              mMarkerColumns( markerColumns ), mMarkers( markers ), mMetersPerUnit( metersPerUnit )
+        {
+            const int slots = (int) markerColumns.size();
+            mChunk.reset( new unsigned char[mLayout.ChunkBytes( slots )]() );
+
+            // CSV exports carry neither residuals nor marker flags; those columns never change.
+            const float missing = std::numeric_limits<float>::quiet_NaN();
+            for( int slot = 0; slot < slots; ++slot )
+            {
+                float* residual = reinterpret_cast<float*>( mChunk.get() + mLayout.Residual( slot ) );
+                for( int row = 0; row < chunkFrames; ++row )
+                {
+                    residual[row] = missing;
+                }
+            }
+        }
+
+        bool AddRow( long long frame, double time, const float* values )
+        {
+            unsigned char* base = mChunk.get();
+            reinterpret_cast<double*>( base + mLayout.TimeStamp )[mRow] = time;
+            reinterpret_cast<int32_t*>( base + mLayout.FrameID )[mRow] = (int32_t) frame;
+
+            for( size_t slot = 0; slot < mMarkerColumns.size(); ++slot )
+            {
+                const float* xyz = values + mMarkerColumns[slot];
+                reinterpret_cast<float*>( base + mLayout.X( (int) slot ) )[mRow] = xyz[0] * mMetersPerUnit;
+                reinterpret_cast<float*>( base + mLayout.Y( (int) slot ) )[mRow] = xyz[1] * mMetersPerUnit;
+                reinterpret_cast<float*>( base + mLayout.Z( (int) slot ) )[mRow] = xyz[2] * mMetersPerUnit;
+            }
+
+            return ( ++mRow < mChunkFrames ? true : Flush() );
+        }
+
+        bool Flush()
+        {
+            if( mRow == 0 )
+            {
+                return true;
+            }
+
+            const int slots = (int) mMarkerColumns.size();
+            sRecordingChunkHeader* header = reinterpret_cast<sRecordingChunkHeader*>( mChunk.get() );
+            header->FrameCount = (uint32_t) mRow;
+            header->MarkerSlots = (uint32_t) slots;
+            header->FirstFrame = mFirstFrame;
+
+            size_t stored = 0;
+            if( !mWriter.WriteChunk( mChunk.get(), mMarkers.data(), stored ) )
+            {
+                return false;
+            }
+
+            mStoredBytes += stored;
+            mRawBytes += mLayout.ChunkBytes( slots );
+            mFirstFrame += mRow;
+            mRow = 0;
+            return true;
+        }
+
+        unsigned long long Frames() const { return mFirstFrame + mRow; }
+        unsigned long long StoredBytes() const { return mStoredBytes; }
+        unsigned long long RawBytes() const { return mRawBytes; }
+
+    private:
+        cRecordingFileWriter& mWriter;
+        sChunkLayout mLayout;
+        int mChunkFrames;
+        const std::vector<int>& mMarkerColumns;
+        const std::vector<sRecordingMarkerEntry>& mMarkers;
+        float mMetersPerUnit;
+
+        std::unique_ptr<unsigned char[]> mChunk;
+        int mRow = 0;
+        unsigned long long mFirstFrame = 0;
+        unsigned long long mStoredBytes = 0;
+        unsigned long long mRawBytes = 0;
+    };
+}
+
+int main( int argc, char* argv[] )
+{
+    sOptions options;
+    if( !ParseOptions( argc, argv, options ) )
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    const long long startNs = HostTimeNs();
+
+    FILE* input = fopen( options.Input.c_str(), "rb" );
+    if( input == nullptr )
+    {
+        fprintf( stderr, "takeconvert: cannot open %s\n", options.Input.c_str() );
+        return 1;
+    }
+
+    std::unique_ptr<char[]> buffer( new char[options.BufferBytes] );
+    size_t filled = fread( buffer.get(), 1, options.BufferBytes, input );
+    bool endOfFile = ( filled < options.BufferBytes );
+    unsigned long long inputBytes = filled;
+
+    const char* cursor = buffer.get();
+    const char* end = buffer.get() + filled;
+
+    // The header is parsed from the first buffer, so it has to fit in it whole.
+    sTakeHeader header;
+    std::string error;
+    const bool headerParsed = ParseTakeHeader( cursor, end, header, error );
+    if( !endOfFile && ( !headerParsed || ( cursor == end && end[-1] != '\n' ) ) )
+    {
+        fprintf( stderr, "takeconvert: %s: header does not fit in the %zu KB read buffer\n",
+                 options.Input.c_str(), options.BufferBytes / 1024 );
+        fclose( input );
+        return 1;
+    }
+    if( !headerParsed )
+    {
+        fprintf( stderr, "takeconvert: %s: %s\n", options.Input.c_str(), error.c_str() );
+        fclose( input );
+        return 1;
+    }
+
+    const int columns = (int) header.Columns.size();
+    const std::vector<int> markerColumns = FindTakeMarkerColumns( header.Columns );
+    std::vector<sRecordingMarkerEntry> markers;
+    for( int column : markerColumns )
+    {
+        const Core::cUID id = ParseTakeID( header.Columns[column].ID );
+        markers.push_back( sRecordingMarkerEntry{ id.HighBits(), id.LowBits() } );
+    }
+
+    cRecordingFileWriter writer;
+    const int maxMarkers = std::max( (int) markers.size(), 1 );
+    if( !writer.Open( options.Output.c_str(), options.ChunkFrames, maxMarkers, options.Compress ) )
+    {
+        fprintf( stderr, "takeconvert: cannot create %s\n", options.Output.c_str() );
+        fclose( input );
+        return 1;
+    }
+
+    const std::string& units = header.Get( "Length Units" );
+    cChunkBuilder builder( writer, options.ChunkFrames, markerColumns, markers, (float) TakeMetersPerUnit( units ) );
+    std::vector<float> values( columns );
+    long long malformedRows = 0;
+    bool ok = true;
+
+    while( ok )
+    {
+        // Every complete line in the buffer; the last line of the file may lack its newline.
+        while( cursor < end )
+        {
+            const char* lineEnd = (const char*) memchr( cursor, '\n', end - cursor );
+            if( lineEnd == nullptr )
+            {
+                if( !endOfFile )
+                {
+                    break;
+                }
+                lineEnd = end;
+            }
+
+            if( cursor < lineEnd && *cursor != '\r' )
+            {
+                long long frame;
+                double time;
+                malformedRows += ( ParseTakeRow( cursor, lineEnd, columns, frame, time, values.data() ) ? 0 : 1 );
+                if( !builder.AddRow( frame, time, values.data() ) )
+                {
+                    ok = false;
+                    break;
+                }
+            }
+            cursor = ( lineEnd < end ? lineEnd + 1 : end );
+        }
+
+        if( !ok || endOfFile )
+        {
+            break;
+        }
+
+        // Keep the partial last line and refill behind it.
+        const size_t remaining = (size_t) ( end - cursor );
+        if( remaining == options.BufferBytes )
+        {
+            fprintf( stderr, "takeconvert: %s: a row is longer than the %zu KB read buffer\n",
+                     options.Input.c_str(), options.BufferBytes / 1024 );
+            ok = false;
+            break;
+        }
+        memmove( buffer.get(), cursor, remaining );
+
+        const size_t wanted = options.BufferBytes - remaining;
+        const size_t got = fread( buffer.get() + remaining, 1, wanted, input );
+        endOfFile = ( got < wanted );
+        inputBytes += got;
+
+        cursor = buffer.get();
+        end = buffer.get() + remaining + got;
+    }
+
+    if( ferror( input ) )
+    {
+        fprintf( stderr, "takeconvert: read error on %s\n", options.Input.c_str() );
+        ok = false;
+    }
+    fclose( input );
+
+    ok = ok && builder.Flush();
+    ok = writer.Close( markers.data(), (uint32_t) markers.size() ) && ok;
+    if( !ok )
+    {
+        fprintf( stderr, "takeconvert: failed writing %s\n", options.Output.c_str() );
+        return 1;
+    }
+
+    const double seconds = ( HostTimeNs() - startNs ) * 1e-9;
+    const unsigned long long outputBytes = builder.StoredBytes();
+
+    printf( "%s -> %s\n", options.Input.c_str(), options.Output.c_str() );
+    printf( "  frames %llu, markers %d, columns %d (%d not marker positions), malformed rows %lld\n",
+            builder.Frames(), (int) markers.size(), columns, columns - 3 * (int) markers.size(), malformedRows );
+    printf( "  positions in meters, from %s\n", units.empty() ? "unstated length units (taken as meters)" : units.c_str() );
+    printf( "  chunks %llu of %d frames, %s\n", writer.ChunksWritten(), options.ChunkFrames,
+            options.Compress ? "compressed" : "raw" );
+    printf( "  input %.1f MB, output %.1f MB (raw %.1f MB, %.1f%% of input)\n",
+            Megabytes( inputBytes ), Megabytes( outputBytes ), Megabytes( builder.RawBytes() ),
+            inputBytes > 0 ? 100.0 * outputBytes / inputBytes : 0.0 );
+    printf( "  %.2f s, %.1f MB/s, peak RSS %.1f MB\n",
+            seconds, seconds > 0 ? Megabytes( inputBytes ) / seconds : 0.0, Megabytes( PeakResidentBytes() ) );
+
+    return 0;
+}
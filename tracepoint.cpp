@@ -0,0 +1,340 @@
+//======================================================================================================
+// Tracepoints: compiled into every build, switched on per debug system at run time, written as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev)
+//======================================================================================================
+#include "tracepoint.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "spscring.h"
+#include "threadregistry.h"
+
+namespace Capture
+{
+    namespace
+    {
+        // 128 KB per traced thread: about a second of a dozen events per frame at 360 Hz.
+        const size_t kQueueEvents = 4096;
+        const int kControlPollMs = 500;
+        const int kDrainIntervalMs = 20;
+
+        /// <summary>The queue of one thread. Trace thread IDs start at 1.</summary>
+        struct sTraceThread
+        {
+            sTraceThread( int index ) : Index( index + 1 ), Queue( kQueueEvents ) { }
+
+            int Index;
+            cSpscRing<sTraceEvent> Queue;
+            std::atomic<unsigned long long> Dropped{ 0 };   // Written by the owning thread only
+            std::string Name;                               // Under the registry lock
+            std::string NameWritten;                        // Writer only: name last put in the trace
+        };
+
+        using TraceThreads = cThreadRegistry<sTraceThread>;
+        using sPending = sDrainedItem<sTraceEvent>;
+
+        // Writer state. Drain() runs on the writer thread, or on the caller once it is stopped.
+        std::mutex sWriteLock;
+        std::thread sWriter;
+        std::atomic<bool> sRunning{ false };
+        std::atomic<unsigned long long> sWritten{ 0 };
+        long long sStartNs = HostTimeNs();
+        std::string sOutputPath = "capture_trace.json";
+        std::string sControlPath = "capture_trace.ctl";
+        std::string sControlText;
+        FILE* sOutput = nullptr;
+        bool sFirstEvent = true;
+
+        void AppendJsonString( std::string& out, const char* text )
+        {
+            out += '"';
+            for( const char* c = text; *c; ++c )
+            {
+                if( *c == '"' || *c == '\\' )
+                {
+                    out += '\\';
+                    out += *c;
+                }
+                else if( (unsigned char) *c < 0x20 )
+                {
+                    char escaped[8];
+                    snprintf( escaped, sizeof( escaped ), "\\u%04x", (unsigned) *c );
+                    out += escaped;
+                }
+                else
+                {
+                    out += *c;
+                }
+            }
+            out += '"';
+        }
+
+        /// <summary>Opens the JSON array on first use; events are comma-separated from there on.</summary>
+        bool WriteEvent( const std::string& json )
+        {
+            if( sOutput == nullptr )
+            {
+                sOutput = fopen( sOutputPath.c_str(), "w" );
+                if( sOutput == nullptr )
+                {
+                    return false;
+                }
+                fputs( "[\n", sOutput );
+                sFirstEvent = true;
+            }
+            if( !sFirstEvent )
+            {
+                fputs( ",\n", sOutput );
+            }
+            sFirstEvent = false;
+            fwrite( json.data(), 1, json.size(), sOutput );
+            return true;
+        }
+
+        void WriteThreadName( int tid, const std::string& name )
+        {
+            std::string json = "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string( tid ) + ",\"args\":{\"name\":";
+            AppendJsonString( json, name.c_str() );
+            json += "}}";
+            WriteEvent( json );
+        }
+
+        void Drain()
+        {
+            std::lock_guard<std::mutex> writeLock( sWriteLock );
+
+            std::vector<sTraceThread*> threads;
+            TraceThreads::Snapshot( threads );
+
+            // Viewers want each thread's events in time order; scopes are queued when they end.
+            static cQueueDrain<sTraceEvent>& sDrain = *new cQueueDrain<sTraceEvent>();
+            const std::vector<sPending>& events = sDrain.Collect( threads, []( const sTraceEvent& event ) { return event.StartNs; } );
+            if( events.empty() )
+            {
+                return;
+            }
+
+            for( sTraceThread* thread : threads )
+            {
+                std::string name;
+                {
+                    std::lock_guard<std::mutex> lock( TraceThreads::Lock() );
+                    name = thread->Name.empty() ? "thread " + std::to_string( thread->Index ) : thread->Name;
+                }
+                if( name != thread->NameWritten )
+                {
+                    WriteThreadName( thread->Index, name );
+                    thread->NameWritten = name;
+                }
+            }
+
+            std::string json;
+            char number[64];
+            for( const sPending& pending : events )
+            {
+                const sTraceEvent& event = *pending.Value;
+                json.assign( "{\"name\":" );
+                AppendJsonString( json, event.Name );
+                json += ",\"cat\":";
+                AppendJsonString( json, Core::cDebugSystem::SystemName( (Core::cDebugSystem::eDebugSystemName) event.System ) );
+                snprintf( number, sizeof( number ), ",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d", event.Phase,
+                    ( event.StartNs - sStartNs ) / 1e3, pending.Thread );
+                json += number;
+                if( event.Phase == 'X' )
+                {
+                    snprintf( number, sizeof( number ), ",\"dur\":%.3f}", event.Value / 1e3 );
+                }
+                else if( event.Phase == 'C' )
+                {
+                    snprintf( number, sizeof( number ), ",\"args\":{\"value\":%lld}}", event.Value );
+                }
+                else
+                {
+                    snprintf( number, sizeof( number ), ",\"s\":\"t\"}" );
+                }
+                json += number;
+                if( !WriteEvent( json ) )
+                {
+                    break;
+                }
+            }
+            sWritten.fetch_add( events.size(), std::memory_order_relaxed );
+            if( sOutput )
+            {
+                fflush( sOutput );
+            }
+        }
+
+        /// <summary>Apply the control file when its contents change. A missing file changes nothing.</summary>
+        void PollControl()
+        {
+            FILE* file = fopen( sControlPath.c_str(), "r" );
+            if( file == nullptr )
+            {
+                return;
+            }
+            std::string text;
+            char buffer[256];
+            size_t read;
+            while( ( read = fread( buffer, 1, sizeof( buffer ), file ) ) > 0 )
+            {
+                text.append( buffer, read );
+            }
+            fclose( file );
+
+            if( text != sControlText )
+            {
+                sControlText = text;
+                cTrace::Select( text.c_str() );
+            }
+        }
+
+        void WriterLoop()
+        {
+            auto lastPoll = std::chrono::steady_clock::now() - std::chrono::milliseconds( kControlPollMs );
+            while( sRunning.load( std::memory_order_acquire ) )
+            {
+                if( std::chrono::steady_clock::now() - lastPoll >= std::chrono::milliseconds( kControlPollMs ) )
+                {
+                    lastPoll = std::chrono::steady_clock::now();
+                    PollControl();
+                }
+                Drain();
+                std::this_thread::sleep_for( std::chrono::milliseconds( kDrainIntervalMs ) );
+            }
+        }
+
+        sStopAtExit sStopTrace{ &cTrace::Stop };
+    }
+
+    std::atomic<bool> cTrace::sEnabled[Core::cDebugSystem::DebugSystemCount];
+
+    void cTrace::Start()
+    {
+        if( sRunning.exchange( true ) )
+        {
+            return;
+        }
+
+        if( const char* output = getenv( "CAPTURE_TRACE_OUTPUT" ) )
+        {
+            sOutputPath = output;
+        }
+        if( const char* control = getenv( "CAPTURE_TRACE_CONTROL" ) )
+        {
+            sControlPath = control;
+        }
+        if( const char* systems = getenv( "CAPTURE_TRACE" ) )
+        {
+            Select( systems );
+        }
+
+        sWriter = std::thread( &WriterLoop );
+    }
+
+    void cTrace::Stop()
+    {
+        if( sRunning.exchange( false ) )
+        {
+            sWriter.join();
+        }
+        Drain();
+
+        std::lock_guard<std::mutex> writeLock( sWriteLock );
+        if( sOutput )
+        {
+            fputs( "\n]\n", sOutput );
+            fclose( sOutput );
+            sOutput = nullptr;
+        }
+    }
+
+    void cTrace::Enable( Core::cDebugSystem::eDebugSystemName system, bool enable )
+    {
+        sEnabled[system].store( enable, std::memory_order_relaxed );
+    }
+
+    void cTrace::Select( const char* text )
+    {
+        bool enable[Core::cDebugSystem::DebugSystemCount] = {};
+
+        std::string word;
+        for( const char* c = text; ; ++c )
+        {
+            if( *c && !isspace( (unsigned char) *c ) && *c != ',' )
+            {
+                word += (char) tolower( (unsigned char) *c );
+                continue;
+            }
+            if( word == "all" )
+            {
+                std::fill( enable, enable + Core::cDebugSystem::DebugSystemCount, true );
+            }
+            else if( !word.empty() && word != "none" )
+            {
+                for( int system = 0; system < Core::cDebugSystem::DebugSystemCount; ++system )
+                {
+                    std::string name = Core::cDebugSystem::SystemName( (Core::cDebugSystem::eDebugSystemName) system );
+                    std::transform( name.begin(), name.end(), name.begin(), []( char n ) { return (char) tolower( (unsigned char) n ); } );
+                    enable[system] |= name == word;
+                }
+            }
+            word.clear();
+            if( *c == 0 )
+            {
+                break;
+            }
+        }
+
+        for( int system = 0; system < Core::cDebugSystem::DebugSystemCount; ++system )
+        {
+            Enable( (Core::cDebugSystem::eDebugSystemName) system, enable[system] );
+        }
+    }
+
+    void cTrace::SetThreadName( const char* name )
+    {
+        sTraceThread& thread = TraceThreads::Local();
+        std::lock_guard<std::mutex> lock( TraceThreads::Lock() );
+        thread.Name = name;
+    }
+
+    void cTrace::Record( Core::cDebugSystem::eDebugSystemName system, char phase, const char* name, long long startNs, long long value )
+    {
+        sTraceThread& thread = TraceThreads::Local();
+        sTraceEvent* event = thread.Queue.BeginWrite();
+        if( event == nullptr )
+        {
+            thread.Dropped.store( thread.Dropped.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+            return;
+        }
+        event->StartNs = startNs;
+        event->Value = value;
+        event->Name = name;
+        event->System = (unsigned char) system;
+        event->Phase = phase;
+        thread.Queue.Publish();
+    }
+
+    sTraceStats cTrace::Stats()
+    {
+        sTraceStats stats;
+        stats.Written = sWritten.load( std::memory_order_relaxed );
+        stats.Dropped = 0;
+
+        std::lock_guard<std::mutex> lock( TraceThreads::Lock() );
+        for( const sTraceThread* thread : TraceThreads::Slots() )
+        {
+            stats.Dropped += thread->Dropped.load( std::memory_order_relaxed );
+        }
+        return stats;
+    }
+}
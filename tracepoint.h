@@ -0,0 +1,107 @@
+//======================================================================================================
+// Tracepoints: compiled into every build, switched on per debug system at run time, written as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev)
+//======================================================================================================
+#pragma once
+
+#include <atomic>
+
+#include "Core/BuildConfig.h"
+#include "Core/DebugSystem.h"
+#include "hostclock.h"
+
+namespace Capture
+{
+    /// <summary>One trace event as queued by the thread that made it.</summary>
+    struct sTraceEvent
+    {
+        long long StartNs;      // Host steady clock
+        long long Value;        // Duration in ns for a scope, the value for a counter
+        const char* Name;       // String literal, or a string that outlives cTrace::Stop()
+        unsigned char System;
+        char Phase;             // Chrome trace phase: 'X' complete, 'i' instant, 'C' counter
+    };
+
+    struct sTraceStats
+    {
+        unsigned long long Written;
+        unsigned long long Dropped;     // Events lost because their thread's queue was full
+    };
+
+    /// <summary>
+    /// Per-system tracepoints. A disabled tracepoint costs one relaxed load of a cached flag and a branch;
+    /// an enabled one reads the host clock and queues a 32-byte event on its thread's SPSC ring, without
+    /// locking or blocking (a full ring drops the event). A writer thread drains the rings into a Chrome
+    /// trace JSON file.
+    ///
+    /// Systems are selected without a rebuild. At Start(), by the CAPTURE_TRACE environment variable, then
+    /// at any time by the control file, which the writer reads every half second: both hold system names as
+    /// cDebugSystem::SystemName() spells them, separated by commas or white space, or "all" / "none".
+    /// CAPTURE_TRACE_CONTROL names the control file (default capture_trace.ctl in the working directory),
+    /// CAPTURE_TRACE_OUTPUT the trace (default capture_trace.json), which is created on the first event.
+    /// </summary>
+    class cTrace
+    {
+    public:
+        static void Start();
+
+        /// <summary>Write what is queued, close the JSON array and stop the writer.</summary>
+        static void Stop();
+
+        static bool Enabled( Core::cDebugSystem::eDebugSystemName system ) { return sEnabled[system].load( std::memory_order_relaxed ); }
+        static void Enable( Core::cDebugSystem::eDebugSystemName system, bool enable );
+
+        /// <summary>Enable exactly the systems named in text (the control file syntax).</summary>
+        static void Select( const char* text );
+
+        /// <summary>Name the calling thread in the trace. name is copied.</summary>
+        static void SetThreadName( const char* name );
+
+        static void Record( Core::cDebugSystem::eDebugSystemName system, char phase, const char* name, long long startNs, long long value );
+
+        static sTraceStats Stats();
+
+    private:
+        static std::atomic<bool> sEnabled[Core::cDebugSystem::DebugSystemCount];
+    };
+
+    /// <summary>Complete event from construction to destruction, when the system is traced at construction.</summary>
+    class cTraceScope
+    {
+    public:
+        cTraceScope( Core::cDebugSystem::eDebugSystemName system, const char* name )
+            : mSystem( system ), mName( name ), mStart( cTrace::Enabled( system ) ? HostTimeNs() : -1 ) { }
+
+        ~cTraceScope()
+        {
+            if( mStart >= 0 )
+            {
+                cTrace::Record( mSystem, 'X', mName, mStart, HostTimeNs() - mStart );
+            }
+        }
+
+        cTraceScope( const cTraceScope& ) = delete;
+        cTraceScope& operator=( const cTraceScope& ) = delete;
+
+    private:
+        Core::cDebugSystem::eDebugSystemName mSystem;
+        const char* mName;
+        long long mStart;
+    };
+}
+
+// Tracepoint macros take the bare system name: TRACE_SCOPE( Frame, "update" ). Names must outlive the trace.
+#define TRACE_CONCAT_( a, b ) a##b
+#define TRACE_CONCAT( a, b ) TRACE_CONCAT_( a, b )
+
+#ifdef CORE_TRACEPOINTS
+#define TRACE_SCOPE( system, name ) const ::Capture::cTraceScope TRACE_CONCAT( traceScope, __LINE__ )( ::Core::cDebugSystem::system, name )
+#define TRACE_INSTANT( system, name ) \
+    ( ::Capture::cTrace::Enabled( ::Core::cDebugSystem::system ) ? ::Capture::cTrace::Record( ::Core::cDebugSystem::system, 'i', name, ::Capture::HostTimeNs(), 0 ) : (void) 0 )
+#define TRACE_COUNTER( system, name, value ) \
+    ( ::Capture::cTrace::Enabled( ::Core::cDebugSystem::system ) ? ::Capture::cTrace::Record( ::Core::cDebugSystem::system, 'C', name, ::Capture::HostTimeNs(), (long long) ( value ) ) : (void) 0 )
+#else
+#define TRACE_SCOPE( system, name ) ((void) 0)
+#define TRACE_INSTANT( system, name ) ((void) 0)
+#define TRACE_COUNTER( system, name, value ) ((void) 0)
+#endif
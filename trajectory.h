@@ -0,0 +1,163 @@
+//======================================================================================================
+// Trajectory: a cVector3 track stored as aligned x, y and z columns for the vector batch kernels
+//======================================================================================================
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "Core/Vector3.h"
+#include "alignedallocator.h"
+#include "vectorarrays.h"
+#include "vectorbatch.h"
+
+namespace Capture
+{
+    /// <summary>
+    /// A sequence of 3D points or vectors (a marker trajectory, its velocities, ...) held as three
+    /// cache-line aligned columns instead of an array of cVector3. Element-wise arithmetic runs through
+    /// vectorbatch.h and gives exactly what the cVector3 methods give; Columns() hands the storage to the
+    /// other batch kernels (TransformPoints(), RotateVectors()), and Assign()/ToVectors() convert from
+    /// and to std::vector<cVector3>.
+    ///
+    /// Binary operations use the first min( Size(), other.Size() ) elements of both operands.
+    /// </summary>
+    template<typename T>
+    class cTrajectory3
+    {
+        static_assert( std::is_same<T, float>::value || std::is_same<T, double>::value, "cTrajectory3 holds float or double" );
+
+    public:
+        using cColumn = std::vector<T, cAlignedAllocator<T>>;
+
+        cTrajectory3() = default;
+        explicit cTrajectory3( size_t count ) : mX( count ), mY( count ), mZ( count ) { }
+        explicit cTrajectory3( const std::vector<Core::cVector3<T>>& points ) { Assign( points.data(), points.size() ); }
+
+        size_t Size() const { return mX.size(); }
+        bool Empty() const { return mX.empty(); }
+
+        /// <summary>Resize all three columns; new elements are zero.</summary>
+        void Resize( size_t count )
+        {
+            mX.resize( count );
+            mY.resize( count );
+            mZ.resize( count );
+        }
+
+        void Reserve( size_t count )
+        {
+            mX.reserve( count );
+            mY.reserve( count );
+            mZ.reserve( count );
+        }
+
+        void Clear() { Resize( 0 ); }
+
+        void PushBack( const Core::cVector3<T>& point )
+        {
+            mX.push_back( point.X() );
+            mY.push_back( point.Y() );
+            mZ.push_back( point.Z() );
+        }
+
+        /// <summary>Element i, gathered into a cVector3.</summary>
+        Core::cVector3<T> operator[]( size_t i ) const { return Core::cVector3<T>( mX[i], mY[i], mZ[i] ); }
+
+        void Set( size_t i, const Core::cVector3<T>& point )
+        {
+            mX[i] = point.X();
+            mY[i] = point.Y();
+            mZ[i] = point.Z();
+        }
+
+        /// <summary>Replace the contents with count cVector3 values.</summary>
+        void Assign( const Core::cVector3<T>* points, size_t count )
+        {
+            Resize( count );
+            for( size_t i = 0; i < count; ++i )
+            {
+                Set( i, points[i] );
+            }
+        }
+
+        /// <summary>Write Size() cVector3 values to points.</summary>
+        void CopyTo( Core::cVector3<T>* points ) const
+        {
+            for( size_t i = 0; i < Size(); ++i )
+            {
+                points[i].SetValues( mX[i], mY[i], mZ[i] );
+            }
+        }
+
+        std::vector<Core::cVector3<T>> ToVectors() const
+        {
+            std::vector<Core::cVector3<T>> points( Size() );
+            CopyTo( points.data() );
+            return points;
+        }
+
+        T* X() { return mX.data(); }
+        T* Y() { return mY.data(); }
+        T* Z() { return mZ.data(); }
+        const T* X() const { return mX.data(); }
+        const T* Y() const { return mY.data(); }
+        const T* Z() const { return mZ.data(); }
+
+        /// <summary>The columns from element first on, e.g. Columns( 1 ) pairs each point with its predecessor in Columns().</summary>
+        sVectorArrays<T> Columns( size_t first = 0 ) { return sVectorArrays<T>( mX.data() + first, mY.data() + first, mZ.data() + first ); }
+        sVectorArrays<const T> Columns( size_t first = 0 ) const { return sVectorArrays<const T>( mX.data() + first, mY.data() + first, mZ.data() + first ); }
+
+        //==============================================================================================
+        // Element-wise arithmetic
+        //==============================================================================================
+
+        cTrajectory3& operator+=( const cTrajectory3& other )
+        {
+            AddVectors( Columns(), other.Columns(), Columns(), CommonSize( other ) );
+            return *this;
+        }
+
+        cTrajectory3& operator-=( const cTrajectory3& other )
+        {
+            SubtractVectors( Columns(), other.Columns(), Columns(), CommonSize( other ) );
+            return *this;
+        }
+
+        cTrajectory3& operator*=( T scale )
+        {
+            ScaleVectors( Columns(), scale, Columns(), Size() );
+            return *this;
+        }
+
+        /// <summary>Normalize every element in place; zero vectors stay zero.</summary>
+        void Normalize() { NormalizeVectors( Columns(), Columns(), Size() ); }
+
+        /// <summary>out[i] = (*this)[i].Dot( other[i] ).</summary>
+        void Dot( const cTrajectory3& other, T* out ) const { DotVectors( Columns(), other.Columns(), out, CommonSize( other ) ); }
+
+        /// <summary>out[i] = (*this)[i].Cross( other[i] ); out is resized and may be either operand.</summary>
+        void Cross( const cTrajectory3& other, cTrajectory3& out ) const
+        {
+            const size_t count = CommonSize( other );
+            out.Resize( count );
+            CrossVectors( Columns(), other.Columns(), out.Columns(), count );
+        }
+
+        /// <summary>out[i] = (*this)[i].Length().</summary>
+        void Length( T* out ) const { VectorLengths( Columns(), out, Size() ); }
+
+        /// <summary>out[i] = (*this)[i].Distance( other[i] ).</summary>
+        void Distance( const cTrajectory3& other, T* out ) const { VectorDistances( Columns(), other.Columns(), out, CommonSize( other ) ); }
+
+    private:
+        size_t CommonSize( const cTrajectory3& other ) const { return std::min( Size(), other.Size() ); }
+
+        cColumn mX, mY, mZ;
+    };
+
+    using cTrajectory3f = cTrajectory3<float>;
+    using cTrajectory3d = cTrajectory3<double>;
+}
@@ -0,0 +1,42 @@
+//======================================================================================================
+// Vector arrays: structure-of-arrays views of vectors and quaternions, shared by the batch kernels
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+namespace Capture
+{
+    /// <summary>Quaternions held as four component arrays, e.g. a rigid-body orientation track from
+    /// RigidBodyTransform(). T may be const for inputs; mutable arrays convert to const ones.</summary>
+    template<typename T>
+    struct sQuaternionArrays
+    {
+        sQuaternionArrays() = default;
+        sQuaternionArrays( T* x, T* y, T* z, T* w ) : X( x ), Y( y ), Z( z ), W( w ) { }
+
+        template<typename U, typename = typename std::enable_if<std::is_same<const U, T>::value && !std::is_same<U, T>::value>::type>
+        sQuaternionArrays( const sQuaternionArrays<U>& other ) : X( other.X ), Y( other.Y ), Z( other.Z ), W( other.W ) { }
+
+        T* X = nullptr;
+        T* Y = nullptr;
+        T* Z = nullptr;
+        T* W = nullptr;
+    };
+
+    /// <summary>Vectors held as three component arrays.</summary>
+    template<typename T>
+    struct sVectorArrays
+    {
+        sVectorArrays() = default;
+        sVectorArrays( T* x, T* y, T* z ) : X( x ), Y( y ), Z( z ) { }
+
+        template<typename U, typename = typename std::enable_if<std::is_same<const U, T>::value && !std::is_same<U, T>::value>::type>
+        sVectorArrays( const sVectorArrays<U>& other ) : X( other.X ), Y( other.Y ), Z( other.Z ) { }
+
+        T* X = nullptr;
+        T* Y = nullptr;
+        T* Z = nullptr;
+    };
+}
@@ -0,0 +1,113 @@
+//======================================================================================================
+// Vector batch: vectorized element-wise cVector3 arithmetic over structure-of-arrays vectors
+//======================================================================================================
+#include "vectorbatch.h"
+
+#include "cpufeatures.h"
+#include "vectorkernels.h"
+
+namespace Capture
+{
+    namespace
+    {
+        template<typename T>
+        const sVectorKernels<T>& Kernels()
+        {
+#ifdef CAPTURE_X86
+            switch( ActiveSimdLevel() )
+            {
+            case eSimdLevel::AVX512:
+                return Detail::VectorKernelsAvx512<T>();
+            case eSimdLevel::AVX2:
+            case eSimdLevel::AVX:
+                return Detail::VectorKernelsAvx<T>();
+            case eSimdLevel::SSE2:
+                return kVectorKernels<sSse2Pack<T>>;
+            case eSimdLevel::Scalar:
+                break;
+            }
+#endif
+            return kVectorKernels<sScalarPack<T>>;
+        }
+    }
+
+    void AddVectors( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, const sVectorArrays<float>& out, size_t count )
+    {
+        Kernels<float>().Add( a, b, out, count );
+    }
+
+    void AddVectors( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, const sVectorArrays<double>& out, size_t count )
+    {
+        Kernels<double>().Add( a, b, out, count );
+    }
+
+    void SubtractVectors( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, const sVectorArrays<float>& out, size_t count )
+    {
+        Kernels<float>().Subtract( a, b, out, count );
+    }
+
+    void SubtractVectors( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, const sVectorArrays<double>& out, size_t count )
+    {
+        Kernels<double>().Subtract( a, b, out, count );
+    }
+
+    void ScaleVectors( const sVectorArrays<const float>& a, float scale, const sVectorArrays<float>& out, size_t count )
+    {
+        Kernels<float>().Scale( a, scale, out, count );
+    }
+
+    void ScaleVectors( const sVectorArrays<const double>& a, double scale, const sVectorArrays<double>& out, size_t count )
+    {
+        Kernels<double>().Scale( a, scale, out, count );
+    }
+
+    void DotVectors( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, float* out, size_t count )
+    {
+        Kernels<float>().Dot( a, b, out, count );
+    }
+
+    void DotVectors( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, double* out, size_t count )
+    {
+        Kernels<double>().Dot( a, b, out, count );
+    }
+
+    void CrossVectors( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, const sVectorArrays<float>& out, size_t count )
+    {
+        Kernels<float>().Cross( a, b, out, count );
+    }
+
+    void CrossVectors( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, const sVectorArrays<double>& out, size_t count )
+    {
+        Kernels<double>().Cross( a, b, out, count );
+    }
+
+    void VectorLengths( const sVectorArrays<const float>& a, float* out, size_t count )
+    {
+        Kernels<float>().Length( a, out, count );
+    }
+
+    void VectorLengths( const sVectorArrays<const double>& a, double* out, size_t count )
+    {
+        Kernels<double>().Length( a, out, count );
+    }
+
+    void VectorDistances( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, float* out, size_t count )
+    {
+        Kernels<float>().Distance( a, b, out, count );
+    }
+
+    void VectorDistances( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, double* out, size_t count )
+    {
+        Kernels<double>().Distance( a, b, out, count );
+    }
+
+    void NormalizeVectors( const sVectorArrays<const float>& a, const sVectorArrays<float>& out, size_t count )
+    {
+        Kernels<float>().Normalize( a, out, count );
+    }
+
+    void NormalizeVectors( const sVectorArrays<const double>& a, const sVectorArrays<double>& out, size_t count )
+    {
+        Kernels<double>().Normalize( a, out, count );
+    }
+}
@@ -0,0 +1,52 @@
+//======================================================================================================
+// Vector batch: vectorized element-wise cVector3 arithmetic over structure-of-arrays vectors
+//======================================================================================================
+#pragma once
+
+#include <cstddef>
+
+#include "vectorarrays.h"
+
+namespace Capture
+{
+    //==================================================================================================
+    // Batch counterparts of the cVector3 operators and methods, element by element. They dispatch at
+    // runtime to AVX-512, AVX, SSE2 or scalar code (see ActiveSimdLevel()). Every path evaluates the same
+    // expression as the cVector3 method, in the same order, so results are identical to it and to each
+    // other.
+    //
+    // Outputs may be the inputs themselves (in place), but must not otherwise overlap them.
+    //==================================================================================================
+
+    /// <summary>out[i] = a[i] + b[i].</summary>
+    void AddVectors( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, const sVectorArrays<float>& out, size_t count );
+    void AddVectors( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, const sVectorArrays<double>& out, size_t count );
+
+    /// <summary>out[i] = a[i] - b[i].</summary>
+    void SubtractVectors( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, const sVectorArrays<float>& out, size_t count );
+    void SubtractVectors( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, const sVectorArrays<double>& out, size_t count );
+
+    /// <summary>out[i] = a[i] * scale, as cVector3::Scale().</summary>
+    void ScaleVectors( const sVectorArrays<const float>& a, float scale, const sVectorArrays<float>& out, size_t count );
+    void ScaleVectors( const sVectorArrays<const double>& a, double scale, const sVectorArrays<double>& out, size_t count );
+
+    /// <summary>out[i] = a[i].Dot( b[i] ).</summary>
+    void DotVectors( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, float* out, size_t count );
+    void DotVectors( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, double* out, size_t count );
+
+    /// <summary>out[i] = a[i].Cross( b[i] ).</summary>
+    void CrossVectors( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, const sVectorArrays<float>& out, size_t count );
+    void CrossVectors( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, const sVectorArrays<double>& out, size_t count );
+
+    /// <summary>out[i] = a[i].Length().</summary>
+    void VectorLengths( const sVectorArrays<const float>& a, float* out, size_t count );
+    void VectorLengths( const sVectorArrays<const double>& a, double* out, size_t count );
+
+    /// <summary>out[i] = a[i].Distance( b[i] ).</summary>
+    void VectorDistances( const sVectorArrays<const float>& a, const sVectorArrays<const float>& b, float* out, size_t count );
+    void VectorDistances( const sVectorArrays<const double>& a, const sVectorArrays<const double>& b, double* out, size_t count );
+
+    /// <summary>out[i] = a[i].Normalized(); zero vectors stay zero.</summary>
+    void NormalizeVectors( const sVectorArrays<const float>& a, const sVectorArrays<float>& out, size_t count );
+    void NormalizeVectors( const sVectorArrays<const double>& a, const sVectorArrays<double>& out, size_t count );
+}
@@ -0,0 +1,17 @@
+//======================================================================================================
+// Vector batch: AVX loops. This file is compiled with AVX code generation (/arch:AVX, -mavx) and is only
+// entered after ActiveSimdLevel() has confirmed AVX support.
+//======================================================================================================
+#include "cpufeatures.h"
+#include "vectorkernels.h"
+
+#ifdef CAPTURE_X86
+namespace Capture
+{
+    namespace Detail
+    {
+        template<> const sVectorKernels<float>& VectorKernelsAvx<float>() { return kVectorKernels<sAvxPack<float>>; }
+        template<> const sVectorKernels<double>& VectorKernelsAvx<double>() { return kVectorKernels<sAvxPack<double>>; }
+    }
+}
+#endif
@@ -0,0 +1,28 @@
+//======================================================================================================
+// Vector batch: AVX-512 loops. This file is compiled with AVX-512 code generation (/arch:AVX512,
+// -mavx512f) and is only entered after ActiveSimdLevel() has confirmed AVX-512 support.
+//======================================================================================================
+
+// AVX-512 brings fused multiply-add with it. Keep the compiler from contracting the separate multiplies
+// and adds, so these loops give the same results as the other paths.
+#if defined(_MSC_VER) && !defined(__clang__)
+#pragma fp_contract( off )
+#elif defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize( "fp-contract=off" )
+#endif
+
+#include "cpufeatures.h"
+#include "vectorkernels.h"
+
+#ifdef CAPTURE_X86
+namespace Capture
+{
+    namespace Detail
+    {
+        template<> const sVectorKernels<float>& VectorKernelsAvx512<float>() { return kVectorKernels<sAvx512Pack<float>>; }
+        template<> const sVectorKernels<double>& VectorKernelsAvx512<double>() { return kVectorKernels<sAvx512Pack<double>>; }
+    }
+}
+#endif
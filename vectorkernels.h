@@ -0,0 +1,193 @@
+//======================================================================================================
+// Vector kernels: the loop bodies behind vectorbatch.h, written once against a SIMD pack
+//======================================================================================================
+//
+// Included only by vectorbatch.cpp (scalar and SSE2 packs), vectorbatch_avx.cpp and
+// vectorbatch_avx512.cpp. Each of those builds a table of these loops for its packs; the public
+// functions pick a table by ActiveSimdLevel(). As with simdpack.h, the loops sit in an anonymous
+// namespace so every translation unit keeps its own instances.
+//
+#pragma once
+
+#include <cstddef>
+
+#include "simdpack.h"
+#include "vectorarrays.h"
+
+namespace Capture
+{
+    /// <summary>One instruction set's implementation of every vectorbatch.h operation.</summary>
+    template<typename T>
+    struct sVectorKernels
+    {
+        void ( *Add )( const sVectorArrays<const T>& a, const sVectorArrays<const T>& b, const sVectorArrays<T>& out, size_t count );
+        void ( *Subtract )( const sVectorArrays<const T>& a, const sVectorArrays<const T>& b, const sVectorArrays<T>& out, size_t count );
+        void ( *Scale )( const sVectorArrays<const T>& a, T scale, const sVectorArrays<T>& out, size_t count );
+        void ( *Dot )( const sVectorArrays<const T>& a, const sVectorArrays<const T>& b, T* out, size_t count );
+        void ( *Cross )( const sVectorArrays<const T>& a, const sVectorArrays<const T>& b, const sVectorArrays<T>& out, size_t count );
+        void ( *Length )( const sVectorArrays<const T>& a, T* out, size_t count );
+        void ( *Distance )( const sVectorArrays<const T>& a, const sVectorArrays<const T>& b, T* out, size_t count );
+        void ( *Normalize )( const sVectorArrays<const T>& a, const sVectorArrays<T>& out, size_t count );
+    };
+
+    namespace Detail
+    {
+        // Tables for the wide instruction sets, defined in vectorbatch_avx.cpp and vectorbatch_avx512.cpp.
+        template<typename T> const sVectorKernels<T>& VectorKernelsAvx();
+        template<typename T> const sVectorKernels<T>& VectorKernelsAvx512();
+
+        template<> const sVectorKernels<float>& VectorKernelsAvx<float>();
+        template<> const sVectorKernels<double>& VectorKernelsAvx<double>();
+        template<> const sVectorKernels<float>& VectorKernelsAvx512<float>();
+        template<> const sVectorKernels<double>& VectorKernelsAvx512<double>();
+    }
+
+    namespace
+    {
+        /// <summary>Calls step( pack, i ) for every whole pack, then with the scalar pack for the tail.</summary>
+        template<typename P, typename Step>
+        void ForEachPack( size_t count, Step step )
+        {
+            size_t i = 0;
+            for( ; i + P::kLanes <= count; i += P::kLanes )
+            {
+                step( P(), i );
+            }
+            for( ; i < count; ++i )
+            {
+                step( sScalarPack<typename P::S>(), i );
+            }
+        }
+
+        template<typename P>
+        struct sVector3Pack
+        {
+            typename P::V X, Y, Z;
+        };
+
+        template<typename P>
+        sVector3Pack<P> Load3( const sVectorArrays<const typename P::S>& v, size_t i )
+        {
+            return { P::Load( v.X + i ), P::Load( v.Y + i ), P::Load( v.Z + i ) };
+        }
+
+        template<typename P>
+        void Store3( const sVectorArrays<typename P::S>& v, size_t i, const sVector3Pack<P>& value )
+        {
+            P::Store( v.X + i, value.X );
+            P::Store( v.Y + i, value.Y );
+            P::Store( v.Z + i, value.Z );
+        }
+
+        template<typename P>
+        typename P::V Dot3( const sVector3Pack<P>& a, const sVector3Pack<P>& b )
+        {
+            return P::Add( P::Add( P::Mul( a.X, b.X ), P::Mul( a.Y, b.Y ) ), P::Mul( a.Z, b.Z ) );
+        }
+
+        template<typename P>
+        void AddLoop( const sVectorArrays<const typename P::S>& a, const sVectorArrays<const typename P::S>& b, const sVectorArrays<typename P::S>& out, size_t count )
+        {
+            ForEachPack<P>( count, [&]( auto pack, size_t i )
+            {
+                using Q = decltype( pack );
+                const sVector3Pack<Q> u = Load3<Q>( a, i ), v = Load3<Q>( b, i );
+                Store3<Q>( out, i, { Q::Add( u.X, v.X ), Q::Add( u.Y, v.Y ), Q::Add( u.Z, v.Z ) } );
+            } );
+        }
+
+        template<typename P>
+        void SubtractLoop( const sVectorArrays<const typename P::S>& a, const sVectorArrays<const typename P::S>& b, const sVectorArrays<typename P::S>& out, size_t count )
+        {
+            ForEachPack<P>( count, [&]( auto pack, size_t i )
+            {
+                using Q = decltype( pack );
+                const sVector3Pack<Q> u = Load3<Q>( a, i ), v = Load3<Q>( b, i );
+                Store3<Q>( out, i, { Q::Sub( u.X, v.X ), Q::Sub( u.Y, v.Y ), Q::Sub( u.Z, v.Z ) } );
+            } );
+        }
+
+        template<typename P>
+        void ScaleLoop( const sVectorArrays<const typename P::S>& a, typename P::S scale, const sVectorArrays<typename P::S>& out, size_t count )
+        {
+            ForEachPack<P>( count, [&]( auto pack, size_t i )
+            {
+                using Q = decltype( pack );
+                const sVector3Pack<Q> u = Load3<Q>( a, i );
+                const typename Q::V s = Q::Splat( scale );
+                Store3<Q>( out, i, { Q::Mul( u.X, s ), Q::Mul( u.Y, s ), Q::Mul( u.Z, s ) } );
+            } );
+        }
+
+        template<typename P>
+        void DotLoop( const sVectorArrays<const typename P::S>& a, const sVectorArrays<const typename P::S>& b, typename P::S* out, size_t count )
+        {
+            ForEachPack<P>( count, [&]( auto pack, size_t i )
+            {
+                using Q = decltype( pack );
+                Q::Store( out + i, Dot3<Q>( Load3<Q>( a, i ), Load3<Q>( b, i ) ) );
+            } );
+        }
+
+        /// <summary>cVector3::Cross(): all of both operands is loaded before anything is stored.</summary>
+        template<typename P>
+        void CrossLoop( const sVectorArrays<const typename P::S>& a, const sVectorArrays<const typename P::S>& b, const sVectorArrays<typename P::S>& out, size_t count )
+        {
+            ForEachPack<P>( count, [&]( auto pack, size_t i )
+            {
+                using Q = decltype( pack );
+                const sVector3Pack<Q> u = Load3<Q>( a, i ), v = Load3<Q>( b, i );
+                Store3<Q>( out, i, { Q::Sub( Q::Mul( u.Y, v.Z ), Q::Mul( u.Z, v.Y ) ),
+                                     Q::Sub( Q::Mul( u.Z, v.X ), Q::Mul( u.X, v.Z ) ),
+                                     Q::Sub( Q::Mul( u.X, v.Y ), Q::Mul( u.Y, v.X ) ) } );
+            } );
+        }
+
+        template<typename P>
+        void LengthLoop( const sVectorArrays<const typename P::S>& a, typename P::S* out, size_t count )
+        {
+            ForEachPack<P>( count, [&]( auto pack, size_t i )
+            {
+                using Q = decltype( pack );
+                const sVector3Pack<Q> u = Load3<Q>( a, i );
+                Q::Store( out + i, Q::Sqrt( Dot3<Q>( u, u ) ) );
+            } );
+        }
+
+        /// <summary>cVector3::Distance(), which differences the argument minus this.</summary>
+        template<typename P>
+        void DistanceLoop( const sVectorArrays<const typename P::S>& a, const sVectorArrays<const typename P::S>& b, typename P::S* out, size_t count )
+        {
+            ForEachPack<P>( count, [&]( auto pack, size_t i )
+            {
+                using Q = decltype( pack );
+                const sVector3Pack<Q> u = Load3<Q>( a, i ), v = Load3<Q>( b, i );
+                const sVector3Pack<Q> d = { Q::Sub( v.X, u.X ), Q::Sub( v.Y, u.Y ), Q::Sub( v.Z, u.Z ) };
+                Q::Store( out + i, Q::Sqrt( Dot3<Q>( d, d ) ) );
+            } );
+        }
+
+        /// <summary>cVector3::Normalize(): scale by 1 / length where the length is positive.</summary>
+        template<typename P>
+        void NormalizeLoop( const sVectorArrays<const typename P::S>& a, const sVectorArrays<typename P::S>& out, size_t count )
+        {
+            ForEachPack<P>( count, [&]( auto pack, size_t i )
+            {
+                using Q = decltype( pack );
+                const sVector3Pack<Q> u = Load3<Q>( a, i );
+                const typename Q::V length = Q::Sqrt( Dot3<Q>( u, u ) );
+                const typename Q::M positive = Q::Greater( length, Q::Splat( 0 ) );
+                const typename Q::V inverse = Q::Div( Q::Splat( 1 ), length );
+                Store3<Q>( out, i, { Q::Select( positive, Q::Mul( u.X, inverse ), u.X ),
+                                     Q::Select( positive, Q::Mul( u.Y, inverse ), u.Y ),
+                                     Q::Select( positive, Q::Mul( u.Z, inverse ), u.Z ) } );
+            } );
+        }
+
+        template<typename P>
+        constexpr sVectorKernels<typename P::S> kVectorKernels =
+        {
+            &AddLoop<P>, &SubtractLoop<P>, &ScaleLoop<P>, &DotLoop<P>, &CrossLoop<P>, &LengthLoop<P>, &DistanceLoop<P>, &NormalizeLoop<P>
+        };
+    }
+}